@@ -149,6 +149,46 @@ extern uint64_t port_get_current_mtime( void );
 #define INCLUDE_xTaskGetIdleTaskHandle             1
 #define portGET_RUN_TIME_COUNTER_VALUE()    port_get_current_mtime()
 
+/* Kernel event tracing into a lock-free ring (bsp/event_trace.h). The hooks
+ * header defines the kernel trace macros, all but traceTASK_SWITCHED_IN(),
+ * which is shared with the MPU region policy below. */
+#ifndef configEVENT_TRACE
+    #define configEVENT_TRACE    0
+#endif
+#if configEVENT_TRACE
+    #include "event_trace_hooks.h"
+#endif
+
+/* Emulated MPU regions: preload the incoming task's working set */
+#if configMPU_REGION_POLICY
+    void vMpuPolicyTaskSwitchedIn( void );
+#endif
+#if configMPU_REGION_POLICY && configEVENT_TRACE
+    #define traceTASK_SWITCHED_IN()          \
+    do {                                     \
+        vMpuPolicyTaskSwitchedIn();          \
+        eventtraceTASK_SWITCHED_IN();        \
+    } while( 0 )
+#elif configMPU_REGION_POLICY
+    #define traceTASK_SWITCHED_IN()    vMpuPolicyTaskSwitchedIn()
+#elif configEVENT_TRACE
+    #define traceTASK_SWITCHED_IN()    eventtraceTASK_SWITCHED_IN()
+#endif
+
+/* Tickless idle: the idle task stops the tick until the next task unblocks
+ * (bsp/tickless_idle.c). The prototype is in scope where the kernel expands
+ * the macro, once TickType_t is known. */
+#ifndef configUSE_TICKLESS_IDLE
+    #define configUSE_TICKLESS_IDLE    0
+#endif
+#if configUSE_TICKLESS_IDLE
+    #define portSUPPRESS_TICKS_AND_SLEEP( xExpectedIdleTime )      \
+    do {                                                           \
+        extern void vTicklessIdleSleep( TickType_t xIdleTime );    \
+        vTicklessIdleSleep( xExpectedIdleTime );                   \
+    } while( 0 )
+#endif
+
 /* Make newlib reentrant */
 /* See http://www.nadler.com/embedded/newlibAndFreeRTOS.html */
 /* Required for thread-safety of newlib sprintf and friends */
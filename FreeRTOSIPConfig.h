@@ -45,6 +45,64 @@
 #endif
 #include <stdio.h>
 
+/* TCP/IP profile, selected with waf configure --tcp-profile.  A profile sets the
+ * MTU, the number of network buffers, the TCP window descriptor pool and the
+ * stream buffer/window sizes together, so that they stay consistent:
+ *
+ *  profile      MTU   buffers  win segs  stream buffers     window
+ *  demo         1200  60       240       1000 bytes         -
+ *  low-memory   1200  24       32        1000 bytes         1 MSS
+ *  balanced     1500  60       96        8 MSS              8 MSS
+ *  throughput   1500  120      256       64 MSS (93440)     64 MSS, scaled
+ *
+ * Platforms with a heap under 1 MiB (configCUSTOM_HEAP_SIZE, in KiB) cannot
+ * hold 64 MSS streams per direction, so throughput falls back to 60 buffers,
+ * 128 segments and 16 MSS there.  FreeRTOS+TCP negotiates window scaling by
+ * itself as soon as a receive window exceeds 64 KiB. */
+#define tcpprofileDEMO          0
+#define tcpprofileLOW_MEMORY    1
+#define tcpprofileBALANCED      2
+#define tcpprofileTHROUGHPUT    3
+
+#ifndef configTCP_PROFILE
+    #define configTCP_PROFILE    tcpprofileDEMO
+#endif
+
+#if ( configTCP_PROFILE == tcpprofileLOW_MEMORY )
+    #define tcpprofileMTU            1200
+    #define tcpprofileBUFFERS        24
+    #define tcpprofileWIN_SEGS       32
+    #define tcpprofileWINSIZE        1
+    #define tcpprofileBUFSIZE        1000 /* No more than the stack default */
+#elif ( configTCP_PROFILE == tcpprofileBALANCED )
+    #define tcpprofileMTU            1500
+    #define tcpprofileBUFFERS        60
+    #define tcpprofileWIN_SEGS       96
+    #define tcpprofileWINSIZE        8
+#elif ( configTCP_PROFILE == tcpprofileTHROUGHPUT )
+    #define tcpprofileMTU            1500
+    #if defined( configCUSTOM_HEAP_SIZE ) && ( configCUSTOM_HEAP_SIZE < 1024 )
+        #define tcpprofileBUFFERS    60
+        #define tcpprofileWIN_SEGS   128
+        #define tcpprofileWINSIZE    16
+    #else
+        #define tcpprofileBUFFERS    120
+        #define tcpprofileWIN_SEGS   256
+        #define tcpprofileWINSIZE    64
+    #endif
+#else
+    #define tcpprofileMTU            1200
+    #define tcpprofileBUFFERS        60
+    #define tcpprofileWIN_SEGS       240
+    #define tcpprofileWINSIZE        0 /* Stack defaults */
+    #define tcpprofileBUFSIZE        1000
+#endif
+
+#ifndef tcpprofileBUFSIZE
+    /* IPv4 + TCP headers without options */
+    #define tcpprofileBUFSIZE        ( tcpprofileWINSIZE * ( tcpprofileMTU - 40 ) )
+#endif
+
 /* Set to 1 to print out debug messages.  If ipconfigHAS_DEBUG_PRINTF is set to
  * 1 then FreeRTOS_debug_printf should be defined to the function used to print
  * out the debugging messages. */
@@ -73,8 +131,15 @@ extern void vLoggingPrintf( const char * pcFormatString,
 
 /* If the network card/driver includes checksum offloading (IP/TCP/UDP checksums)
  * then set ipconfigDRIVER_INCLUDED_RX_IP_CHECKSUM to 1 to prevent the software
- * stack repeating the checksum calculations. */
-#define ipconfigDRIVER_INCLUDED_RX_IP_CHECKSUM     0
+ * stack repeating the checksum calculations.  The in-tree virtio-net driver
+ * (bsp/virtio_net.c) verifies and fills in checksums itself, offloading them
+ * to the device where it can. */
+#if configVIRTIO_NET_ZERO_COPY
+    #define ipconfigDRIVER_INCLUDED_RX_IP_CHECKSUM    1
+    #define ipconfigDRIVER_INCLUDED_TX_IP_CHECKSUM    1
+#else
+    #define ipconfigDRIVER_INCLUDED_RX_IP_CHECKSUM    0
+#endif
 
 /* Several API's will block until the result is known, or the action has been
  * performed, for example FreeRTOS_send() and FreeRTOS_recv().  The timeouts can be
@@ -174,8 +239,14 @@ extern void vLoggingPrintf( const char * pcFormatString,
  * message is sent to a remote IP address that does not already appear in the ARP
  * cache then the UDP message is replaced by a ARP message that solicits the
  * required MAC address information.  ipconfigARP_CACHE_ENTRIES defines the maximum
- * number of entries that can exist in the ARP table at any one time. */
-#define ipconfigARP_CACHE_ENTRIES                      6
+ * number of entries that can exist in the ARP table at any one time.  The table
+ * is searched linearly; with --arp-hash-cache (bsp/arp_cache.c) lookups go
+ * through a hashed front cache first, so it can be sized for every peer on the
+ * subnet (--arp-cache-entries). */
+#ifndef configARP_CACHE_ENTRIES
+    #define configARP_CACHE_ENTRIES                    6
+#endif
+#define ipconfigARP_CACHE_ENTRIES                      configARP_CACHE_ENTRIES
 
 /* ARP requests that do not result in an ARP response will be re-transmitted a
  * maximum of ipconfigMAX_ARP_RETRANSMISSIONS times before the ARP request is
@@ -205,7 +276,7 @@ extern void vLoggingPrintf( const char * pcFormatString,
  * are available to the IP stack.  The total number of network buffers is limited
  * to ensure the total amount of RAM that can be consumed by the IP stack is capped
  * to a pre-determinable value. */
-#define ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS         60
+#define ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS         tcpprofileBUFFERS
 
 /* A FreeRTOS queue is used to send events from application tasks to the IP
  * stack.  ipconfigEVENT_QUEUE_LENGTH sets the maximum number of events that can
@@ -245,7 +316,7 @@ extern void vLoggingPrintf( const char * pcFormatString,
  * lower value can save RAM, depending on the buffer management scheme used.  If
  * ipconfigCAN_FRAGMENT_OUTGOING_PACKETS is 1 then (ipconfigNETWORK_MTU - 28) must
  * be divisible by 8. */
-#define ipconfigNETWORK_MTU                            1200
+#define ipconfigNETWORK_MTU                            tcpprofileMTU
 
 /* Set ipconfigUSE_DNS to 1 to include a basic DNS client/resolver.  DNS is used
  * through the FreeRTOS_gethostbyname() API function. */
@@ -321,14 +392,27 @@ extern void vLoggingPrintf( const char * pcFormatString,
  * TCP socket will use up to 2 x 6 descriptors, meaning that it can have 2 x 6
  * outstanding packets (for Rx and Tx).  When using up to 10 TP sockets
  * simultaneously, one could define TCP_WIN_SEG_COUNT as 120. */
-#define ipconfigTCP_WIN_SEG_COUNT       240
+#define ipconfigTCP_WIN_SEG_COUNT       tcpprofileWIN_SEGS
 
 /* Each TCP socket has a circular buffers for Rx and Tx, which have a fixed
  * maximum size.  Define the size of Rx buffer for TCP sockets. */
-#define ipconfigTCP_RX_BUFFER_LENGTH    ( 1000 )
+#define ipconfigTCP_RX_BUFFER_LENGTH    ( tcpprofileBUFSIZE )
 
 /* Define the size of Tx buffer for TCP sockets. */
-#define ipconfigTCP_TX_BUFFER_LENGTH    ( 1000 )
+#define ipconfigTCP_TX_BUFFER_LENGTH    ( tcpprofileBUFSIZE )
+
+/* Window properties the HTTP/FTP servers apply to their sockets (through
+ * FREERTOS_SO_WIN_PROPERTIES), unless an xSERVER_CONFIG entry overrides them. */
+#if ( tcpprofileWINSIZE > 0 )
+    #define ipconfigHTTP_RX_BUFSIZE    tcpprofileBUFSIZE
+    #define ipconfigHTTP_RX_WINSIZE    tcpprofileWINSIZE
+    #define ipconfigHTTP_TX_BUFSIZE    tcpprofileBUFSIZE
+    #define ipconfigHTTP_TX_WINSIZE    tcpprofileWINSIZE
+    #define ipconfigFTP_RX_BUFSIZE     tcpprofileBUFSIZE
+    #define ipconfigFTP_RX_WINSIZE     tcpprofileWINSIZE
+    #define ipconfigFTP_TX_BUFSIZE     tcpprofileBUFSIZE
+    #define ipconfigFTP_TX_WINSIZE     tcpprofileWINSIZE
+#endif
 
 /* When using call-back handlers, the driver may check if the handler points to
  * real program memory (RAM or flash) or just has a random non-zero value. */
@@ -343,9 +427,15 @@ extern void vLoggingPrintf( const char * pcFormatString,
 #define ipconfigTCP_KEEP_ALIVE              ( 1 )
 #define ipconfigTCP_KEEP_ALIVE_INTERVAL     ( 20 ) /* in seconds */
 
-/* Enable zero-copy network stack */
-#define ipconfigZERO_COPY_RX_DRIVER         ( 0 )
-#define ipconfigZERO_COPY_TX_DRIVER         ( 0 )
+/* Enable zero-copy network stack, only the in-tree virtio-net driver
+ * (bsp/virtio_net.c) supports it */
+#if configVIRTIO_NET_ZERO_COPY
+    #define ipconfigZERO_COPY_RX_DRIVER     ( 1 )
+    #define ipconfigZERO_COPY_TX_DRIVER     ( 1 )
+#else
+    #define ipconfigZERO_COPY_RX_DRIVER     ( 0 )
+    #define ipconfigZERO_COPY_TX_DRIVER     ( 0 )
+#endif
 
 /* Demo config */
 
@@ -0,0 +1,338 @@
+/*
+ * Hashed ARP front cache, selected with --arp-hash-cache.
+ *
+ * FreeRTOS+TCP resolves every outgoing UDP datagram and TCP connection with
+ * eARPGetCacheEntry(), a linear search of its ipconfigARP_CACHE_ENTRIES rows.
+ * The build links with --wrap=eARPGetCacheEntry so that those lookups land
+ * here first: on-link unicast peers are looked up in an open-addressed table
+ * of configARP_HASH_ENTRIES slots (power of two, probing at most
+ * configARP_HASH_PROBE slots), and only misses fall through to the stack's
+ * table. That makes it cheap to size the stack's table for all the peers of a
+ * busy subnet, so that rows stop being evicted by each other.
+ *
+ * A hashed entry is trusted for configARP_HASH_TTL_MS and then re-validated
+ * against the stack's table, which also picks up MAC changes. Entries that are
+ * still in use are refreshed in the background: a timer sends an ARP request
+ * configARP_HASH_REFRESH_MS before they run out, the reply renews (or
+ * re-creates) the stack's row, and the next lookup re-validates without ever
+ * leaving the sender waiting for resolution. Idle peers are left to age out.
+ *
+ * iptraceARP_CACHE_HIT/MISS/STALL/REFRESH report lookups served from the hash,
+ * lookups that fell through to the stack, lookups that the stack could not
+ * resolve either (the packet is dropped to generate an ARP request) and
+ * background refreshes.
+ *
+ * xARPHashLookup() gives other tasks read access to the hash (for the direct
+ * UDP transmit path, bsp/udp_fast_tx.c); the stack's table is only ever
+ * touched by the IP task.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
+
+/* Counters show up in ip-debug-stats when the demo provides DemoIPTrace.
+ * Included ahead of the stack, whose trace macro defaults are #ifndef'd. */
+#if ( configINCLUDE_DEMO_DEBUG_STATS == 1 ) && __has_include( "DemoIPTrace.h" )
+    #include "DemoIPTrace.h"
+#endif
+
+#include "FreeRTOS_IP.h"
+#include "FreeRTOS_IP_Private.h"
+#include "FreeRTOS_ARP.h"
+
+#include "arp_cache.h"
+
+#ifndef configARP_HASH_ENTRIES
+    #define configARP_HASH_ENTRIES    64
+#endif
+
+#if ( configARP_HASH_ENTRIES & ( configARP_HASH_ENTRIES - 1 ) ) != 0
+    #error configARP_HASH_ENTRIES must be a power of two
+#endif
+
+#ifndef configARP_HASH_PROBE
+    #define configARP_HASH_PROBE    8
+#endif
+
+#ifndef configARP_HASH_TTL_MS
+    #define configARP_HASH_TTL_MS    60000
+#endif
+
+#ifndef configARP_HASH_REFRESH_MS
+    #define configARP_HASH_REFRESH_MS    10000
+#endif
+
+#ifndef iptraceARP_CACHE_HIT
+    #define iptraceARP_CACHE_HIT( ulIPAddress )
+#endif
+
+#ifndef iptraceARP_CACHE_MISS
+    #define iptraceARP_CACHE_MISS( ulIPAddress )
+#endif
+
+#ifndef iptraceARP_CACHE_STALL
+    #define iptraceARP_CACHE_STALL( ulIPAddress )
+#endif
+
+#ifndef iptraceARP_CACHE_REFRESH
+    #define iptraceARP_CACHE_REFRESH( ulIPAddress )
+#endif
+
+/* Requests sent per timer run, the rest wait for the next one */
+#define arpREFRESH_BATCH    8
+
+#define arpLOCK()      taskENTER_CRITICAL()
+#define arpUNLOCK()    taskEXIT_CRITICAL()
+
+typedef struct ARP_HASH_ENTRY
+{
+    uint32_t ulIPAddress; /* Network byte order, 0 for a free slot */
+    MACAddress_t xMACAddress;
+    uint8_t ucRefreshing;
+    TickType_t xExpires;  /* Re-validate against the stack from here on */
+    TickType_t xLastUsed;
+} ARPHashEntry_t;
+
+static ARPHashEntry_t xARPHash[ configARP_HASH_ENTRIES ];
+
+/* The table is flushed when the interface address changes */
+static uint32_t ulHashedLocalIP = 0;
+static TimerHandle_t xRefreshTimer = NULL;
+
+/* The stack's own lookup, see --wrap in the wscript */
+eARPLookupResult_t __real_eARPGetCacheEntry( uint32_t * pulIPAddress,
+                                             MACAddress_t * const pxMACAddress );
+eARPLookupResult_t __wrap_eARPGetCacheEntry( uint32_t * pulIPAddress,
+                                             MACAddress_t * const pxMACAddress );
+/*-----------------------------------------------------------*/
+
+static inline UBaseType_t prvHash( uint32_t ulIPAddress )
+{
+    /* Fibonacci hashing. Peers on one subnet only differ in the host part,
+     * which has to end up in the low bits of the key to reach the product
+     * bits that are kept. */
+    uint32_t ulKey = FreeRTOS_ntohl( ulIPAddress );
+
+    return ( UBaseType_t ) ( ( uint32_t ) ( ulKey * 2654435761U ) >> 16 ) & ( configARP_HASH_ENTRIES - 1 );
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvIsHashable( uint32_t ulIPAddress )
+{
+    uint32_t ulLocal = *ipLOCAL_IP_ADDRESS_POINTER;
+
+    /* Off-link, broadcast and multicast destinations are mapped by the stack
+     * itself and cost nothing to resolve */
+    return ( ulLocal != 0 ) &&
+           ( ( ulIPAddress & xNetworkAddressing.ulNetMask ) == ( ulLocal & xNetworkAddressing.ulNetMask ) ) &&
+           ( ulIPAddress != xNetworkAddressing.ulBroadcastAddress ) &&
+           ( ( FreeRTOS_ntohl( ulIPAddress ) >> 28 ) != 0xe );
+}
+/*-----------------------------------------------------------*/
+
+/* Slot holding ulIPAddress, or the one to (re)use for it when xInsert is set */
+static ARPHashEntry_t * prvFind( uint32_t ulIPAddress,
+                                 BaseType_t xInsert,
+                                 TickType_t xNow )
+{
+    ARPHashEntry_t * pxVictim = NULL;
+    UBaseType_t uxSlot = prvHash( ulIPAddress );
+
+    /* Every slot of the probe window is checked, so freeing a slot never
+     * hides entries further along and needs no tombstones */
+    for( UBaseType_t x = 0; x < configARP_HASH_PROBE; x++ )
+    {
+        ARPHashEntry_t * pxEntry = &xARPHash[ ( uxSlot + x ) & ( configARP_HASH_ENTRIES - 1 ) ];
+
+        if( pxEntry->ulIPAddress == ulIPAddress )
+        {
+            return pxEntry;
+        }
+
+        if( xInsert != pdFALSE )
+        {
+            if( pxEntry->ulIPAddress == 0 )
+            {
+                if( ( pxVictim == NULL ) || ( pxVictim->ulIPAddress != 0 ) )
+                {
+                    pxVictim = pxEntry;
+                }
+            }
+            else if( ( pxVictim == NULL ) ||
+                     ( ( pxVictim->ulIPAddress != 0 ) && ( ( xNow - pxEntry->xLastUsed ) > ( xNow - pxVictim->xLastUsed ) ) ) )
+            {
+                /* Least recently used */
+                pxVictim = pxEntry;
+            }
+        }
+    }
+
+    return pxVictim;
+}
+/*-----------------------------------------------------------*/
+
+/* Called with the lock held */
+static BaseType_t prvLookup( uint32_t ulIPAddress,
+                             MACAddress_t * pxMACAddress,
+                             TickType_t xNow )
+{
+    ARPHashEntry_t * pxEntry = prvFind( ulIPAddress, pdFALSE, xNow );
+
+    if( ( pxEntry == NULL ) || ( ( TickType_t ) ( pxEntry->xExpires - xNow ) > pdMS_TO_TICKS( configARP_HASH_TTL_MS ) ) )
+    {
+        return pdFALSE;
+    }
+
+    *pxMACAddress = pxEntry->xMACAddress;
+    pxEntry->xLastUsed = xNow;
+
+    return pdTRUE;
+}
+/*-----------------------------------------------------------*/
+
+static void prvRefreshTimerCallback( TimerHandle_t xTimer )
+{
+    uint32_t ulRefresh[ arpREFRESH_BATCH ];
+    UBaseType_t uxCount = 0;
+    TickType_t xNow = xTaskGetTickCount();
+
+    ( void ) xTimer;
+
+    arpLOCK();
+    {
+        for( UBaseType_t x = 0; x < configARP_HASH_ENTRIES; x++ )
+        {
+            ARPHashEntry_t * pxEntry = &xARPHash[ x ];
+
+            if( pxEntry->ulIPAddress == 0 )
+            {
+                continue;
+            }
+
+            if( ( xNow - pxEntry->xLastUsed ) > pdMS_TO_TICKS( configARP_HASH_TTL_MS ) )
+            {
+                /* Not talked to for a whole TTL, let it go */
+                pxEntry->ulIPAddress = 0;
+            }
+            else if( ( pxEntry->ucRefreshing == 0 ) && ( uxCount < arpREFRESH_BATCH ) &&
+                     ( ( TickType_t ) ( pxEntry->xExpires - xNow ) <= pdMS_TO_TICKS( configARP_HASH_REFRESH_MS ) ) )
+            {
+                pxEntry->ucRefreshing = 1;
+                ulRefresh[ uxCount++ ] = pxEntry->ulIPAddress;
+            }
+        }
+    }
+    arpUNLOCK();
+
+    for( UBaseType_t x = 0; x < uxCount; x++ )
+    {
+        iptraceARP_CACHE_REFRESH( ulRefresh[ x ] );
+        FreeRTOS_OutputARPRequest( ulRefresh[ x ] );
+    }
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xARPHashLookup( uint32_t ulIPAddress,
+                           MACAddress_t * pxMACAddress )
+{
+    BaseType_t xHit = pdFALSE;
+
+    if( prvIsHashable( ulIPAddress ) == pdFALSE )
+    {
+        return pdFALSE;
+    }
+
+    arpLOCK();
+    {
+        /* A stale table is flushed by the IP task's next lookup */
+        if( ulHashedLocalIP == *ipLOCAL_IP_ADDRESS_POINTER )
+        {
+            xHit = prvLookup( ulIPAddress, pxMACAddress, xTaskGetTickCount() );
+        }
+    }
+    arpUNLOCK();
+
+    if( xHit != pdFALSE )
+    {
+        iptraceARP_CACHE_HIT( ulIPAddress );
+    }
+
+    return xHit;
+}
+/*-----------------------------------------------------------*/
+
+eARPLookupResult_t __wrap_eARPGetCacheEntry( uint32_t * pulIPAddress,
+                                             MACAddress_t * const pxMACAddress )
+{
+    uint32_t ulIPAddress = *pulIPAddress;
+    ARPHashEntry_t * pxEntry;
+    eARPLookupResult_t eResult;
+    TickType_t xNow;
+
+    if( prvIsHashable( ulIPAddress ) == pdFALSE )
+    {
+        return __real_eARPGetCacheEntry( pulIPAddress, pxMACAddress );
+    }
+
+    xNow = xTaskGetTickCount();
+
+    arpLOCK();
+    {
+        if( ulHashedLocalIP != *ipLOCAL_IP_ADDRESS_POINTER )
+        {
+            memset( xARPHash, 0, sizeof( xARPHash ) );
+            ulHashedLocalIP = *ipLOCAL_IP_ADDRESS_POINTER;
+        }
+
+        if( prvLookup( ulIPAddress, pxMACAddress, xNow ) != pdFALSE )
+        {
+            arpUNLOCK();
+
+            iptraceARP_CACHE_HIT( ulIPAddress );
+            return eARPCacheHit;
+        }
+    }
+    arpUNLOCK();
+
+    /* Not hashed yet, or due for re-validation */
+    eResult = __real_eARPGetCacheEntry( pulIPAddress, pxMACAddress );
+
+    if( eResult != eARPCacheHit )
+    {
+        iptraceARP_CACHE_STALL( ulIPAddress );
+        return eResult;
+    }
+
+    iptraceARP_CACHE_MISS( ulIPAddress );
+
+    arpLOCK();
+    {
+        pxEntry = prvFind( ulIPAddress, pdTRUE, xNow );
+
+        if( pxEntry != NULL )
+        {
+            pxEntry->ulIPAddress = ulIPAddress;
+            pxEntry->xMACAddress = *pxMACAddress;
+            pxEntry->ucRefreshing = 0;
+            pxEntry->xExpires = xNow + pdMS_TO_TICKS( configARP_HASH_TTL_MS );
+            pxEntry->xLastUsed = xNow;
+        }
+    }
+    arpUNLOCK();
+
+    /* First use from the IP task, the timer service is up by now */
+    if( xRefreshTimer == NULL )
+    {
+        xRefreshTimer = xTimerCreate( "ARPRefresh", pdMS_TO_TICKS( configARP_HASH_REFRESH_MS / 2 ),
+                                      pdTRUE, NULL, prvRefreshTimerCallback );
+        configASSERT( xRefreshTimer != NULL );
+        xTimerStart( xRefreshTimer, 0 );
+    }
+
+    return eResult;
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,20 @@
+/**
+ * Hashed ARP front cache (bsp/arp_cache.c), built with --arp-hash-cache.
+ */
+#ifndef ARP_CACHE_H
+#define ARP_CACHE_H
+
+#include "FreeRTOS.h"
+#include "FreeRTOS_IP.h"
+#include "FreeRTOS_ARP.h"
+
+/*
+ * Look ulIPAddress (network byte order) up in the hash only, never in the
+ * stack's ARP table, so it is safe to call from any task. Returns pdTRUE and
+ * fills in pxMACAddress when the peer is hashed and within its TTL; peers get
+ * hashed as the IP task resolves them.
+ */
+BaseType_t xARPHashLookup( uint32_t ulIPAddress,
+                           MACAddress_t * pxMACAddress );
+
+#endif /* ARP_CACHE_H */
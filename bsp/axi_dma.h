@@ -0,0 +1,70 @@
+/**
+ * Xilinx AXI DMA (PG021) register and scatter-gather descriptor layout, for
+ * drivers that drive the engine directly instead of through XAxiDma.
+ */
+#ifndef AXI_DMA_H
+#define AXI_DMA_H
+
+#include <stdint.h>
+
+/* Channel register blocks */
+#define AXI_DMA_MM2S                 0x00 /* TX: memory to stream */
+#define AXI_DMA_S2MM                 0x30 /* RX: stream to memory */
+
+/* Offsets within a channel block */
+#define AXI_DMA_CR                   0x00
+#define AXI_DMA_SR                   0x04
+#define AXI_DMA_CURDESC              0x08
+#define AXI_DMA_CURDESC_MSB          0x0c
+#define AXI_DMA_TAILDESC             0x10
+#define AXI_DMA_TAILDESC_MSB         0x14
+
+/* DMACR */
+#define AXI_DMA_CR_RS                ( 1U << 0 )
+#define AXI_DMA_CR_RESET             ( 1U << 2 )
+#define AXI_DMA_CR_IOC_IRQ_EN        ( 1U << 12 )
+#define AXI_DMA_CR_DLY_IRQ_EN        ( 1U << 13 )
+#define AXI_DMA_CR_ERR_IRQ_EN        ( 1U << 14 )
+#define AXI_DMA_CR_IRQ_MASK          ( AXI_DMA_CR_IOC_IRQ_EN | AXI_DMA_CR_DLY_IRQ_EN | AXI_DMA_CR_ERR_IRQ_EN )
+#define AXI_DMA_CR_THRESHOLD_SHIFT   16 /* Completions per IOC interrupt, 1-255 */
+#define AXI_DMA_CR_DELAY_SHIFT       24 /* Delay timeout, in 125 SG clock periods */
+
+/* DMASR, interrupt bits are write 1 to clear */
+#define AXI_DMA_SR_HALTED            ( 1U << 0 )
+#define AXI_DMA_SR_IDLE              ( 1U << 1 )
+#define AXI_DMA_SR_IOC_IRQ           ( 1U << 12 )
+#define AXI_DMA_SR_DLY_IRQ           ( 1U << 13 )
+#define AXI_DMA_SR_ERR_IRQ           ( 1U << 14 )
+#define AXI_DMA_SR_IRQ_MASK          ( AXI_DMA_SR_IOC_IRQ | AXI_DMA_SR_DLY_IRQ | AXI_DMA_SR_ERR_IRQ )
+
+/* Descriptor control word */
+#define AXI_DMA_BD_LEN_MASK          0x03ffffffU
+#define AXI_DMA_BD_CTRL_EOF          ( 1U << 26 )
+#define AXI_DMA_BD_CTRL_SOF          ( 1U << 27 )
+
+/* Descriptor status word, written back by the engine */
+#define AXI_DMA_BD_STS_EOF           ( 1U << 26 )
+#define AXI_DMA_BD_STS_SOF           ( 1U << 27 )
+#define AXI_DMA_BD_STS_INT_ERR       ( 1U << 28 )
+#define AXI_DMA_BD_STS_SLV_ERR       ( 1U << 29 )
+#define AXI_DMA_BD_STS_DEC_ERR       ( 1U << 30 )
+#define AXI_DMA_BD_STS_CMPLT         ( 1U << 31 )
+#define AXI_DMA_BD_STS_ERR_MASK      ( AXI_DMA_BD_STS_INT_ERR | AXI_DMA_BD_STS_SLV_ERR | AXI_DMA_BD_STS_DEC_ERR )
+
+/* Descriptors must be 16-word aligned */
+#define AXI_DMA_BD_ALIGN             64
+
+struct axi_dma_bd
+{
+    uint32_t next;
+    uint32_t next_msb;
+    uint32_t buf;
+    uint32_t buf_msb;
+    uint32_t reserved[ 2 ];
+    uint32_t control;
+    uint32_t status;
+    uint32_t app[ 5 ]; /* Control/status stream words (AXI Ethernet) */
+    uint32_t pad[ 3 ];
+} __attribute__( ( aligned( AXI_DMA_BD_ALIGN ) ) );
+
+#endif /* AXI_DMA_H */
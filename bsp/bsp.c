@@ -19,6 +19,41 @@
     #include <rtl/rtl-freertos-compartments.h>
 #endif
 
+#if configMPU_REGION_POLICY
+    #include "mpu_regions.h"
+#endif
+
+#if configEVENT_TRACE
+    #include "event_trace.h"
+#endif
+
+#if (configMPU_COMPARTMENTALIZATION == 1 || configCHERI_COMPARTMENTALIZATION == 1)
+    #include "compartment_recovery.h"
+
+    extern uint64_t get_cycle_count( void );
+
+    /* Common tail of every compartment fault in the exception handlers
+     * below: stamp the fault for the recovery timings, reset the
+     * compartment's globals from the snapshot if fast restart is on, and
+     * let libdl's fault handler notify the compartment's waiters. */
+    __attribute__((section(".text.fast"))) static BaseType_t prvCompartmentFaultRecover( size_t xCompID,
+                                                                                         uint64_t ullFaultEntry )
+    {
+        #if configCOMPARTMENT_FAULT_TIMES
+            vCompartmentRecoveryFaultEntry( xCompID, ullFaultEntry );
+        #else
+            ( void ) ullFaultEntry;
+        #endif
+
+        #if configCOMPARTMENT_FAST_RESTART
+            /* The fault handler below still runs for its notification. */
+            ( void ) xCompartmentRecoveryRestart( xCompID );
+        #endif
+
+        return rtl_cherifreertos_compartment_faultHandler( xCompID );
+    }
+#endif
+
 
 plic_instance_t Plic;
 
@@ -121,6 +156,9 @@ plic_instance_t Plic;
     __attribute__((section(".text.fast"))) static uint32_t default_exception_handler( uintptr_t * exception_frame )
     {
             BaseType_t pxHigherPriorityTaskWoken = 0;
+            #if configCHERI_COMPARTMENTALIZATION
+                uint64_t ullFaultEntry = configCOMPARTMENT_FAULT_TIMES ? get_cycle_count() : 0;
+            #endif
         #ifdef __CHERI_PURE_CAPABILITY__
             size_t cause = 0;
             size_t epc = 0;
@@ -194,7 +232,7 @@ plic_instance_t Plic;
                         backtrace(mepcc, sp, ra, xCompID);
                     #endif
 
-                    pxHigherPriorityTaskWoken = rtl_cherifreertos_compartment_faultHandler(xCompID);
+                    pxHigherPriorityTaskWoken = prvCompartmentFaultRecover( xCompID, ullFaultEntry );
 
                     /* Caller compartment return */
                     *( exception_frame ) = ( uintptr_t ) ret;
@@ -214,7 +252,7 @@ plic_instance_t Plic;
                         printf( "\033[0m" );
                     #endif
 
-                    pxHigherPriorityTaskWoken = rtl_cherifreertos_compartment_faultHandler(xCompID);
+                    pxHigherPriorityTaskWoken = prvCompartmentFaultRecover( xCompID, ullFaultEntry );
 
                     /* Caller compartment return */
                     *( exception_frame ) = ( uintptr_t ) ret;
@@ -234,6 +272,9 @@ plic_instance_t Plic;
     __attribute__((section(".text.fast"))) static uint32_t default_exception_handler( uintptr_t * exception_frame )
     {
             BaseType_t pxHigherPriorityTaskWoken = 0;
+            #if configMPU_COMPARTMENTALIZATION
+                uint64_t ullFaultEntry = configCOMPARTMENT_FAULT_TIMES ? get_cycle_count() : 0;
+            #endif
             size_t cause = 0;
             size_t epc = 0;
             size_t mtval = 0;
@@ -260,6 +301,16 @@ plic_instance_t Plic;
 
             #endif
 
+            #if configMPU_REGION_POLICY
+                /* Access faults on a registered region just need a PMP slot,
+                 * retry the instruction once it is loaded. */
+                if( ( ( cause == 1 ) || ( cause == 5 ) || ( cause == 7 ) ) &&
+                    ( xMpuPolicyHandleFault( mtval ) == pdTRUE ) )
+                {
+                    return 0;
+                }
+            #endif
+
             #if configMPU_COMPARTMENTALIZATION
                 xCompID = xPortGetCurrentCompartmentID();
             #if configMPU_COMPARTMENTALIZATION_MODE == 1
@@ -273,7 +324,7 @@ plic_instance_t Plic;
                         printf( "<<<< Fault in Task %s: Compartment #%d: %s\n", pcTaskGetName( NULL ), xCompID, obj->oname );
                     #endif
 
-                    pxHigherPriorityTaskWoken = rtl_cherifreertos_compartment_faultHandler(xCompID);
+                    pxHigherPriorityTaskWoken = prvCompartmentFaultRecover( xCompID, ullFaultEntry );
 
                     /* Caller compartment return */
                     *( exception_frame ) = ( uintptr_t ) ret;
@@ -291,7 +342,7 @@ plic_instance_t Plic;
                         printf( "<<<< Fault in Task %s: Compartment #%d: %s\n", pcTaskGetName( NULL ), xCompID, archive->name );
                     #endif
 
-                    pxHigherPriorityTaskWoken = rtl_cherifreertos_compartment_faultHandler(xCompID);
+                    pxHigherPriorityTaskWoken = prvCompartmentFaultRecover( xCompID, ullFaultEntry );
 
                     /* Caller compartment return */
                     *( exception_frame ) = ( uintptr_t ) ret;
@@ -375,11 +426,19 @@ __attribute__((section(".text.fast"))) BaseType_t external_interrupt_handler( UB
 
     plic_source source_id = PLIC_claim_interrupt( &Plic );
 
+    #if configEVENT_TRACE
+        vEventTraceRecord( eventtraceIRQ_ENTER, NULL, source_id );
+    #endif
+
     if( ( source_id >= 1 ) && ( source_id < PLIC_NUM_INTERRUPTS ) )
     {
         pxHigherPriorityTaskWoken = Plic.HandlerTable[ source_id ].Handler( Plic.HandlerTable[ source_id ].CallBackRef );
     }
 
+    #if configEVENT_TRACE
+        vEventTraceRecord( eventtraceIRQ_EXIT, NULL, source_id );
+    #endif
+
     /* clear interrupt */
     PLIC_complete_interrupt( &Plic, source_id );
     return pxHigherPriorityTaskWoken;
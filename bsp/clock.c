@@ -0,0 +1,247 @@
+/*
+ * High resolution time and a disciplined wall clock, see clock.h.
+ *
+ * The wall clock is kept as an anchor: a monotonic time, the wall clock time
+ * at that point, a frequency correction and an offset still to be slewed.
+ * Reading it extrapolates from the anchor:
+ *
+ *   wall = base + elapsed + elapsed * frequency + slewed so far
+ *
+ * where the slewed part grows at configCLOCK_SLEW_PPM until the whole offset
+ * is applied. With both corrections bounded well below 1 the wall clock keeps
+ * moving forward while it slews. Each update re-anchors at the current time,
+ * so elapsed stays short and the arithmetic fits in 64 bits.
+ *
+ * The discipline is a simple hybrid loop. The phase is corrected by slewing
+ * each measured offset away, the frequency by an FLL: the offset that built
+ * up since the previous update, less what was still being slewed then, is
+ * drift, and a fraction (configCLOCK_FLL_GAIN_SHIFT) of drift over interval
+ * is added to the frequency correction.
+ *
+ * The anchor is published through a seqlock, so readers in any task never
+ * block; updates come from one task (the NTP client).
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "clock.h"
+#include "seqlock.h"
+
+extern uint64_t get_cycle_count( void );
+
+typedef struct CLOCK_STATE
+{
+    uint64_t ullBaseMonoNs;
+    int64_t llBaseRealNs;
+    int64_t llFreqPpb;
+    int64_t llSlewNs;
+    BaseType_t xSynchronised;
+} ClockState_t;
+
+/* All zero is a valid state: the wall clock counts from boot */
+static uint8_t ucStateStorage[ seqlockSTORAGE_SIZE( sizeof( ClockState_t ) ) ] __attribute__( ( aligned( sizeof( void * ) ) ) );
+static SeqLock_t xStateLock =
+{
+    .pucStorage = ucStateStorage,
+    .uxSize     = sizeof( ClockState_t )
+};
+
+static ClockStats_t xStats;
+/*-----------------------------------------------------------*/
+
+uint64_t ullClockMonotonicNs( void )
+{
+    uint64_t ullCycles = get_cycle_count();
+
+    /* In two parts, cycles * 10^9 would overflow after a few seconds */
+    return ( ullCycles / configCPU_CLOCK_HZ ) * clockNS_PER_SECOND +
+           ( ullCycles % configCPU_CLOCK_HZ ) * clockNS_PER_SECOND / configCPU_CLOCK_HZ;
+}
+/*-----------------------------------------------------------*/
+
+/* llValue * ullElapsedNs / 10^9 without overflowing for |llValue| < 2^33 */
+static int64_t prvScale( uint64_t ullElapsedNs,
+                         int64_t llValue )
+{
+    return ( int64_t ) ( ullElapsedNs / clockNS_PER_SECOND ) * llValue +
+           ( int64_t ) ( ullElapsedNs % clockNS_PER_SECOND ) * llValue / clockNS_PER_SECOND;
+}
+/*-----------------------------------------------------------*/
+
+/* The part of pxState's offset slewed by ullNowNs */
+static int64_t prvSlewed( const ClockState_t * pxState,
+                          uint64_t ullNowNs )
+{
+    uint64_t ullElapsed = ( ullNowNs > pxState->ullBaseMonoNs ) ? ullNowNs - pxState->ullBaseMonoNs : 0;
+    int64_t llMax = prvScale( ullElapsed, configCLOCK_SLEW_PPM * 1000LL );
+
+    if( pxState->llSlewNs > llMax )
+    {
+        return llMax;
+    }
+
+    if( pxState->llSlewNs < -llMax )
+    {
+        return -llMax;
+    }
+
+    return pxState->llSlewNs;
+}
+/*-----------------------------------------------------------*/
+
+static int64_t prvRealtime( const ClockState_t * pxState,
+                            uint64_t ullNowNs )
+{
+    uint64_t ullElapsed = ( ullNowNs > pxState->ullBaseMonoNs ) ? ullNowNs - pxState->ullBaseMonoNs : 0;
+
+    return pxState->llBaseRealNs + ( int64_t ) ullElapsed + prvScale( ullElapsed, pxState->llFreqPpb ) +
+           prvSlewed( pxState, ullNowNs );
+}
+/*-----------------------------------------------------------*/
+
+int64_t llClockRealtimeNs( void )
+{
+    ClockState_t xState;
+
+    ( void ) ulSeqLockRead( &xStateLock, &xState );
+
+    return prvRealtime( &xState, ullClockMonotonicNs() );
+}
+/*-----------------------------------------------------------*/
+
+uint32_t ulClockRealtime( uint32_t * pulNanoseconds )
+{
+    int64_t llNow = llClockRealtimeNs();
+
+    if( pulNanoseconds != NULL )
+    {
+        *pulNanoseconds = ( uint32_t ) ( llNow % clockNS_PER_SECOND );
+    }
+
+    return ( uint32_t ) ( llNow / clockNS_PER_SECOND );
+}
+/*-----------------------------------------------------------*/
+
+void vClockSetRealtime( int64_t llRealtimeNs )
+{
+    ClockState_t xState;
+
+    ( void ) ulSeqLockRead( &xStateLock, &xState );
+
+    xState.ullBaseMonoNs = ullClockMonotonicNs();
+    xState.llBaseRealNs = llRealtimeNs;
+    xState.llSlewNs = 0;
+    xState.xSynchronised = pdTRUE;
+
+    vSeqLockPublish( &xStateLock, &xState );
+}
+/*-----------------------------------------------------------*/
+
+void vClockUpdate( int64_t llOffsetNs,
+                   uint64_t ullDelayNs,
+                   uint64_t ullWhenNs )
+{
+    ClockState_t xState, xNew;
+    uint64_t ullNow = ullClockMonotonicNs();
+    int64_t llMeasuredNs = llOffsetNs;
+    int64_t llStepThreshold = configCLOCK_STEP_THRESHOLD_MS * 1000000LL;
+    int64_t llMaxFreq = configCLOCK_MAX_FREQ_PPM * 1000LL;
+    BaseType_t xStep;
+
+    ( void ) ulSeqLockRead( &xStateLock, &xState );
+
+    /* The offset was measured at ullWhenNs, since when the wall clock has
+     * moved on by more (or less) than the monotonic clock */
+    if( ullWhenNs < ullNow )
+    {
+        llOffsetNs -= prvRealtime( &xState, ullNow ) - prvRealtime( &xState, ullWhenNs ) -
+                      ( int64_t ) ( ullNow - ullWhenNs );
+    }
+
+    xNew = xState;
+    xNew.ullBaseMonoNs = ullNow;
+    xNew.llBaseRealNs = prvRealtime( &xState, ullNow );
+    xNew.xSynchronised = pdTRUE;
+
+    xStep = ( xState.xSynchronised == pdFALSE ) ||
+            ( llOffsetNs > llStepThreshold ) || ( llOffsetNs < -llStepThreshold );
+
+    if( xStep != pdFALSE )
+    {
+        xNew.llBaseRealNs += llOffsetNs;
+        xNew.llSlewNs = 0;
+    }
+    else
+    {
+        uint64_t ullInterval = ullWhenNs - xStats.ullLastUpdateNs;
+
+        if( ( xStats.ullLastUpdateNs != 0 ) &&
+            ( ullInterval >= ( uint64_t ) configCLOCK_FLL_MIN_INTERVAL_S * clockNS_PER_SECOND ) )
+        {
+            /* What was still to be slewed when the offset was measured is not
+             * drift */
+            int64_t llPending = xState.llSlewNs - prvSlewed( &xState, ullWhenNs );
+            int64_t llDrift = llMeasuredNs - llPending;
+            int64_t llFreqError = llDrift * clockNS_PER_SECOND / ( int64_t ) ullInterval;
+
+            xNew.llFreqPpb += llFreqError / ( 1 << configCLOCK_FLL_GAIN_SHIFT );
+
+            if( xNew.llFreqPpb > llMaxFreq )
+            {
+                xNew.llFreqPpb = llMaxFreq;
+            }
+            else if( xNew.llFreqPpb < -llMaxFreq )
+            {
+                xNew.llFreqPpb = -llMaxFreq;
+            }
+        }
+
+        /* The offset includes what had not been slewed yet, so it replaces
+         * the remainder */
+        xNew.llSlewNs = llOffsetNs;
+    }
+
+    vSeqLockPublish( &xStateLock, &xNew );
+
+    taskENTER_CRITICAL();
+    {
+        xStats.ulUpdates++;
+        xStats.ulSteps += ( xStep != pdFALSE ) ? 1 : 0;
+        xStats.llLastOffsetNs = llMeasuredNs;
+        xStats.ullLastDelayNs = ullDelayNs;
+        xStats.llFreqPpb = xNew.llFreqPpb;
+        xStats.ullLastUpdateNs = ullWhenNs;
+    }
+    taskEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xClockIsSynchronised( void )
+{
+    ClockState_t xState;
+
+    ( void ) ulSeqLockRead( &xStateLock, &xState );
+
+    return xState.xSynchronised;
+}
+/*-----------------------------------------------------------*/
+
+void vClockGetStats( ClockStats_t * pxStats )
+{
+    ClockState_t xState;
+
+    ( void ) ulSeqLockRead( &xStateLock, &xState );
+
+    taskENTER_CRITICAL();
+    {
+        *pxStats = xStats;
+    }
+    taskEXIT_CRITICAL();
+
+    pxStats->llSlewNs = xState.llSlewNs - prvSlewed( &xState, ullClockMonotonicNs() );
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,84 @@
+/**
+ * High resolution time and a disciplined wall clock (bsp/clock.c).
+ *
+ * Monotonic time counts nanoseconds since boot from the cycle counter. The
+ * wall clock (UTC, nanoseconds since 1970) runs off it at a corrected rate,
+ * and is steered by offset measurements, from the NTP client (bsp/ntp_client.c)
+ * for instance: small offsets are slewed away, so the wall clock never goes
+ * backwards, large ones step it. Reading either clock never blocks.
+ */
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdint.h>
+#include "FreeRTOS.h"
+
+/* Offsets beyond this are stepped rather than slewed, in milliseconds */
+#ifndef configCLOCK_STEP_THRESHOLD_MS
+    #define configCLOCK_STEP_THRESHOLD_MS    128
+#endif
+
+/* Rate at which an offset is slewed away, in parts per million */
+#ifndef configCLOCK_SLEW_PPM
+    #define configCLOCK_SLEW_PPM             500
+#endif
+
+/* Largest frequency correction, in parts per million */
+#ifndef configCLOCK_MAX_FREQ_PPM
+    #define configCLOCK_MAX_FREQ_PPM         500
+#endif
+
+/* Weight of each new frequency estimate, as a shift: 1/4 by default */
+#ifndef configCLOCK_FLL_GAIN_SHIFT
+    #define configCLOCK_FLL_GAIN_SHIFT       2
+#endif
+
+/* Updates closer together than this (seconds) only correct the phase: the
+ * offset accumulated over so short a time says little about the frequency */
+#ifndef configCLOCK_FLL_MIN_INTERVAL_S
+    #define configCLOCK_FLL_MIN_INTERVAL_S   16
+#endif
+
+#define clockNS_PER_SECOND    1000000000LL
+
+typedef struct CLOCK_STATS
+{
+    uint32_t ulUpdates;      /* Offsets fed to vClockUpdate() */
+    uint32_t ulSteps;        /* Of those, the ones that stepped the clock */
+    int64_t llLastOffsetNs;  /* Reference minus wall clock at the last update */
+    uint64_t ullLastDelayNs; /* Round trip that came with it */
+    int64_t llFreqPpb;       /* Current frequency correction, parts per billion */
+    int64_t llSlewNs;        /* Offset still being slewed away */
+    uint64_t ullLastUpdateNs;/* Monotonic time of the last update, 0 for none */
+} ClockStats_t;
+
+/* Nanoseconds since boot, from the cycle counter */
+uint64_t ullClockMonotonicNs( void );
+
+/* Nanoseconds since 1970 UTC, counted from 0 at boot until the clock is set */
+int64_t llClockRealtimeNs( void );
+
+/* The wall clock in whole seconds and the nanoseconds into the second */
+uint32_t ulClockRealtime( uint32_t * pulNanoseconds );
+
+/* Step the wall clock to llRealtimeNs */
+void vClockSetRealtime( int64_t llRealtimeNs );
+
+/*
+ * Steer the wall clock by a measured offset: the reference's time minus the
+ * wall clock's (llOffsetNs) at monotonic time ullWhenNs, which came with a
+ * round trip of ullDelayNs. The first update, and any beyond
+ * configCLOCK_STEP_THRESHOLD_MS, step the clock; the others are slewed away
+ * at configCLOCK_SLEW_PPM while the frequency estimate takes up the drift.
+ * Called from one task at a time.
+ */
+void vClockUpdate( int64_t llOffsetNs,
+                   uint64_t ullDelayNs,
+                   uint64_t ullWhenNs );
+
+/* pdTRUE once the wall clock has been set or updated */
+BaseType_t xClockIsSynchronised( void );
+
+void vClockGetStats( ClockStats_t * pxStats );
+
+#endif /* CLOCK_H */
@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "compartment_recovery.h"
+
+#if ( configCHERI_COMPARTMENTALIZATION == 1 || configMPU_COMPARTMENTALIZATION == 1 )
+
+#include <rtl/rtl-obj.h>
+#include <rtl/rtl-freertos-compartments.h>
+
+extern uint64_t get_cycle_count( void );
+
+typedef struct COMPARTMENT_RANGE
+{
+    void * pvBase;
+    size_t xSize;
+    void * pvPristine; /* NULL: zero-fill */
+} CompartmentRange_t;
+
+typedef struct COMPARTMENT_SNAPSHOT
+{
+    CompartmentRange_t xRanges[ configCOMPARTMENT_RECOVERY_RANGES ];
+    UBaseType_t uxCount;
+} CompartmentSnapshot_t;
+
+static CompartmentSnapshot_t xSnapshots[ configCOMPARTMENTS_NUM ];
+static CompartmentFaultTimes_t xLastFault;
+/*-----------------------------------------------------------*/
+
+BaseType_t xCompartmentRecoveryRegister( size_t xCompID,
+                                         void * pvBase,
+                                         size_t xSize,
+                                         BaseType_t xZeroFill )
+{
+    CompartmentSnapshot_t * pxSnapshot;
+    CompartmentRange_t * pxRange;
+
+    if( ( xCompID >= configCOMPARTMENTS_NUM ) || ( pvBase == NULL ) || ( xSize == 0 ) )
+    {
+        return pdFAIL;
+    }
+
+    pxSnapshot = &xSnapshots[ xCompID ];
+
+    if( pxSnapshot->uxCount >= configCOMPARTMENT_RECOVERY_RANGES )
+    {
+        return pdFAIL;
+    }
+
+    pxRange = &pxSnapshot->xRanges[ pxSnapshot->uxCount ];
+    pxRange->pvBase = pvBase;
+    pxRange->xSize = xSize;
+    pxRange->pvPristine = NULL;
+
+    if( xZeroFill == pdFALSE )
+    {
+        /* memcpy keeps capability tags, so sealed captable entries survive
+         * the round trip and need no re-sealing. */
+        pxRange->pvPristine = pvPortMalloc( xSize );
+
+        if( pxRange->pvPristine == NULL )
+        {
+            return pdFAIL;
+        }
+
+        memcpy( pxRange->pvPristine, pvBase, xSize );
+    }
+
+    pxSnapshot->uxCount++;
+
+    return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+void vCompartmentRecoverySnapshotAll( void )
+{
+    #if ( configCHERI_COMPARTMENTALIZATION_MODE == 1 || configMPU_COMPARTMENTALIZATION_MODE == 1 )
+        for( size_t xCompID = 0; xCompID < configCOMPARTMENTS_NUM; xCompID++ )
+        {
+            rtems_rtl_obj * obj = rtl_cherifreertos_compartment_get_obj( xCompID );
+
+            if( ( obj == NULL ) || ( xSnapshots[ xCompID ].uxCount != 0 ) )
+            {
+                continue;
+            }
+
+            if( obj->data_size )
+            {
+                if( xCompartmentRecoveryRegister( xCompID, obj->data_base, obj->data_size, pdFALSE ) != pdPASS )
+                {
+                    printf( "Compartment recovery: failed to snapshot %s\n", obj->oname );
+                }
+            }
+
+            if( obj->bss_size )
+            {
+                xCompartmentRecoveryRegister( xCompID, obj->bss_base, obj->bss_size, pdTRUE );
+            }
+        }
+    #endif /* Archives (libs mode) register their members' ranges explicitly */
+}
+/*-----------------------------------------------------------*/
+
+void vCompartmentRecoveryFaultEntry( size_t xCompID,
+                                     uint64_t ullEntry )
+{
+    xLastFault.ullEntry = ullEntry;
+    xLastFault.ullRestored = ullEntry;
+    xLastFault.xRestarted = pdFALSE;
+    xLastFault.xCompID = xCompID;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xCompartmentRecoveryRestart( size_t xCompID )
+{
+    CompartmentSnapshot_t * pxSnapshot;
+
+    if( ( xCompID >= configCOMPARTMENTS_NUM ) || ( xSnapshots[ xCompID ].uxCount == 0 ) )
+    {
+        return pdFALSE;
+    }
+
+    pxSnapshot = &xSnapshots[ xCompID ];
+
+    for( UBaseType_t i = 0; i < pxSnapshot->uxCount; i++ )
+    {
+        CompartmentRange_t * pxRange = &pxSnapshot->xRanges[ i ];
+
+        if( pxRange->pvPristine != NULL )
+        {
+            memcpy( pxRange->pvBase, pxRange->pvPristine, pxRange->xSize );
+        }
+        else
+        {
+            memset( pxRange->pvBase, 0, pxRange->xSize );
+        }
+    }
+
+    xLastFault.ullRestored = get_cycle_count();
+    xLastFault.xRestarted = pdTRUE;
+
+    return pdTRUE;
+}
+/*-----------------------------------------------------------*/
+
+void vCompartmentRecoveryLastFault( CompartmentFaultTimes_t * pxTimes )
+{
+    *pxTimes = xLastFault;
+}
+/*-----------------------------------------------------------*/
+
+#endif /* configCHERI_COMPARTMENTALIZATION || configMPU_COMPARTMENTALIZATION */
@@ -0,0 +1,79 @@
+/**
+ * Fast restart of faulted compartments.
+ *
+ * Each compartment's writable globals are snapshotted once after it is loaded.
+ * When the compartment faults, the exception handler copies the pristine
+ * image back and returns an error to the caller compartment, instead of
+ * leaving the compartment to be reloaded with a full dlopen. The handler also
+ * timestamps each fault so the recovery latency can be benchmarked.
+ *
+ * Restoring globals does not undo side effects outside the compartment (held
+ * locks, queued messages); compartments shared by several tasks must only be
+ * restarted when none of them is inside it.
+ */
+#ifndef COMPARTMENT_RECOVERY_H
+#define COMPARTMENT_RECOVERY_H
+
+#include <stdint.h>
+#include "FreeRTOS.h"
+
+#if ( configCHERI_COMPARTMENTALIZATION == 1 || configMPU_COMPARTMENTALIZATION == 1 )
+
+/* Timestamp faults for vCompartmentRecoveryLastFault(), on with fast restart */
+#ifndef configCOMPARTMENT_FAULT_TIMES
+    #define configCOMPARTMENT_FAULT_TIMES        configCOMPARTMENT_FAST_RESTART
+#endif
+
+/* Writable ranges restored per compartment (.data, .bss, captable, ...) */
+#ifndef configCOMPARTMENT_RECOVERY_RANGES
+    #define configCOMPARTMENT_RECOVERY_RANGES    4
+#endif
+
+typedef struct COMPARTMENT_FAULT_TIMES
+{
+    uint64_t ullEntry;    /* Cycle count when the exception handler was entered */
+    uint64_t ullRestored; /* Cycle count when the restart (if any) completed */
+    BaseType_t xRestarted;
+    size_t xCompID;
+} CompartmentFaultTimes_t;
+
+/*
+ * Snapshot [pvBase, pvBase + xSize) of compartment xCompID. A NULL snapshot
+ * zero-fills the range on restart (used for .bss). Returns pdFAIL if out of
+ * memory or ranges.
+ */
+BaseType_t xCompartmentRecoveryRegister( size_t xCompID,
+                                         void * pvBase,
+                                         size_t xSize,
+                                         BaseType_t xZeroFill );
+
+/*
+ * Snapshot the .data/.bss of every object loaded as a compartment (objs mode).
+ * Must be called after dlopen and before any compartment runs. Archives (libs
+ * mode) are not walked: register their members' ranges with
+ * xCompartmentRecoveryRegister().
+ */
+void vCompartmentRecoverySnapshotAll( void );
+
+/*
+ * Called from the exception handler once the fault is attributed to xCompID,
+ * with configCOMPARTMENT_FAULT_TIMES set; ullEntry is the cycle count sampled
+ * on handler entry.
+ */
+void vCompartmentRecoveryFaultEntry( size_t xCompID,
+                                     uint64_t ullEntry );
+
+/*
+ * Restore xCompID's globals from its snapshot. Returns pdFALSE if the
+ * compartment has no snapshot and needs the generic fault handler.
+ */
+BaseType_t xCompartmentRecoveryRestart( size_t xCompID );
+
+/*
+ * Timestamps of the most recent fault.
+ */
+void vCompartmentRecoveryLastFault( CompartmentFaultTimes_t * pxTimes );
+
+#endif /* configCHERI_COMPARTMENTALIZATION || configMPU_COMPARTMENTALIZATION */
+
+#endif /* COMPARTMENT_RECOVERY_H */
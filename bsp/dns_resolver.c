@@ -0,0 +1,885 @@
+/*
+ * Caching, asynchronous DNS resolver.
+ *
+ * FreeRTOS_gethostbyname() blocks the caller for up to the full DNS timeout,
+ * and its cache (ipconfigUSE_DNS_CACHE) has no negative entries, so a name
+ * that does not resolve is asked for again on every call. Here:
+ *  - answers are cached for their TTL, capped at configDNS_RESOLVER_MAX_TTL;
+ *  - NXDOMAIN and answers without an address are cached as negative entries,
+ *    for the SOA minimum when the server gives one (RFC 2308), capped at
+ *    configDNS_RESOLVER_NEGATIVE_TTL;
+ *  - lookups never block: a miss sends a query and the caller's callback gets
+ *    the result. Up to configDNS_RESOLVER_PENDING queries are outstanding at
+ *    once, and lookups of a name already being asked for join that query;
+ *  - hit, miss and query counters are kept (vDNSResolverGetStats()).
+ *
+ * The resolver task owns the query socket. It takes the replies, retransmits
+ * every configDNS_RESOLVER_RETRY_MS and gives up on a query at its timeout.
+ * Queries can be routed elsewhere with vDNSResolverSetTransport(), which is
+ * how the stub responder (bsp/dns_stub.c) answers without a network.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include "FreeRTOS_IP.h"
+#include "FreeRTOS_Sockets.h"
+#include "FreeRTOS_DNS.h"
+
+#include "dns_resolver.h"
+
+#define dnsresolverPORT           53
+#define dnsresolverHEADER_SIZE    12
+
+/* Header, QNAME (at most two bytes longer than the dotted name), QTYPE and
+ * QCLASS */
+#define dnsresolverQUERY_MAX      ( dnsresolverHEADER_SIZE + configDNS_RESOLVER_NAME_LENGTH + 2 + 4 )
+
+#define dnsresolverFLAG_QR        0x8000U
+#define dnsresolverFLAG_RD        0x0100U
+#define dnsresolverRCODE_MASK     0x000FU
+#define dnsresolverRCODE_OK       0
+#define dnsresolverRCODE_NXDOMAIN 3
+
+#define dnsresolverTYPE_A         1
+#define dnsresolverTYPE_SOA       6
+#define dnsresolverCLASS_IN       1
+
+/* How often the resolver task looks for queries to retransmit or time out */
+#define dnsresolverPOLL_PERIOD    pdMS_TO_TICKS( 100 )
+
+typedef struct DNS_CACHE_ENTRY
+{
+    char cName[ configDNS_RESOLVER_NAME_LENGTH ]; /* Empty when free */
+    uint32_t ulIPAddress;                         /* 0 for a negative entry */
+    TickType_t xStored;
+    TickType_t xTTL;
+    TickType_t xLastUsed;
+} DNSCacheEntry_t;
+
+typedef struct DNS_WAITER
+{
+    DNSResolverCallback_t pxCallback;
+    void * pvContext;
+} DNSWaiter_t;
+
+typedef struct DNS_PENDING
+{
+    char cName[ configDNS_RESOLVER_NAME_LENGTH ]; /* Empty when free */
+    uint16_t usID;
+    uint8_t ucQuery[ dnsresolverQUERY_MAX ];
+    size_t uxQueryLength;
+    TickType_t xStarted;
+    TickType_t xTimeout;
+    TickType_t xLastSent;
+    UBaseType_t uxWaiters;
+    DNSWaiter_t xWaiters[ configDNS_RESOLVER_WAITERS ];
+} DNSPending_t;
+
+/* What a completed query hands to its callbacks, outside the lock */
+typedef struct DNS_COMPLETION
+{
+    char cName[ configDNS_RESOLVER_NAME_LENGTH ];
+    uint32_t ulIPAddress;
+    UBaseType_t uxWaiters;
+    DNSWaiter_t xWaiters[ configDNS_RESOLVER_WAITERS ];
+} DNSCompletion_t;
+
+static TaskHandle_t xResolverTask = NULL;
+static Socket_t xSocket = NULL;
+
+/* Everything below is protected by xLock */
+static SemaphoreHandle_t xLock = NULL;
+static DNSCacheEntry_t xCache[ configDNS_RESOLVER_ENTRIES ];
+static DNSPending_t xPending[ configDNS_RESOLVER_PENDING ];
+static DNSResolverStats_t xStats;
+static DNSResolverTransport_t pxTransport = NULL;
+static uint32_t ulServerAddress = 0;
+static uint16_t usServerPort = 0;
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvNameEqual( const char * pcA,
+                                const char * pcB )
+{
+    while( ( *pcA != '\0' ) && ( tolower( ( unsigned char ) *pcA ) == tolower( ( unsigned char ) *pcB ) ) )
+    {
+        pcA++;
+        pcB++;
+    }
+
+    return ( *pcA == *pcB ) ? pdTRUE : pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvExpired( TickType_t xStarted,
+                              TickType_t xPeriod,
+                              TickType_t xNow )
+{
+    /* Wrap-safe as long as xPeriod stays below half the tick range */
+    return ( ( TickType_t ) ( xNow - xStarted ) >= xPeriod ) ? pdTRUE : pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+static uint16_t prvRead16( const uint8_t * pucData )
+{
+    return ( uint16_t ) ( ( ( uint16_t ) pucData[ 0 ] << 8 ) | pucData[ 1 ] );
+}
+/*-----------------------------------------------------------*/
+
+static uint32_t prvRead32( const uint8_t * pucData )
+{
+    return ( ( uint32_t ) prvRead16( pucData ) << 16 ) | prvRead16( &pucData[ 2 ] );
+}
+/*-----------------------------------------------------------*/
+
+/* Offset just past the (possibly compressed) name at uxOffset, 0 if it runs
+ * off the end of the message */
+static size_t prvSkipName( const uint8_t * pucMessage,
+                           size_t uxLength,
+                           size_t uxOffset )
+{
+    while( uxOffset < uxLength )
+    {
+        uint8_t ucLabel = pucMessage[ uxOffset ];
+
+        if( ucLabel == 0 )
+        {
+            return uxOffset + 1;
+        }
+
+        if( ( ucLabel & 0xC0U ) == 0xC0U )
+        {
+            return ( uxOffset + 2 <= uxLength ) ? uxOffset + 2 : 0;
+        }
+
+        if( ( ucLabel & 0xC0U ) != 0 )
+        {
+            return 0;
+        }
+
+        uxOffset += 1U + ucLabel;
+    }
+
+    return 0;
+}
+/*-----------------------------------------------------------*/
+
+/* Cache lookup, with the lock held. Expired entries are freed on the way. */
+static DNSCacheEntry_t * prvFindEntry( const char * pcName,
+                                       TickType_t xNow )
+{
+    for( int i = 0; i < configDNS_RESOLVER_ENTRIES; i++ )
+    {
+        DNSCacheEntry_t * pxEntry = &xCache[ i ];
+
+        if( pxEntry->cName[ 0 ] == '\0' )
+        {
+            continue;
+        }
+
+        if( prvExpired( pxEntry->xStored, pxEntry->xTTL, xNow ) != pdFALSE )
+        {
+            pxEntry->cName[ 0 ] = '\0';
+        }
+        else if( prvNameEqual( pxEntry->cName, pcName ) != pdFALSE )
+        {
+            return pxEntry;
+        }
+    }
+
+    return NULL;
+}
+/*-----------------------------------------------------------*/
+
+/* With the lock held. Replaces a free entry, else the least recently used. */
+static void prvStore( const char * pcName,
+                      uint32_t ulIPAddress,
+                      uint32_t ulTTL )
+{
+    TickType_t xNow = xTaskGetTickCount();
+    DNSCacheEntry_t * pxEntry;
+
+    if( ulTTL == 0 )
+    {
+        return;
+    }
+
+    pxEntry = prvFindEntry( pcName, xNow );
+
+    for( int i = 0; ( pxEntry == NULL ) && ( i < configDNS_RESOLVER_ENTRIES ); i++ )
+    {
+        if( xCache[ i ].cName[ 0 ] == '\0' )
+        {
+            pxEntry = &xCache[ i ];
+        }
+    }
+
+    if( pxEntry == NULL )
+    {
+        pxEntry = &xCache[ 0 ];
+
+        for( int i = 1; i < configDNS_RESOLVER_ENTRIES; i++ )
+        {
+            if( ( TickType_t ) ( xNow - xCache[ i ].xLastUsed ) > ( TickType_t ) ( xNow - pxEntry->xLastUsed ) )
+            {
+                pxEntry = &xCache[ i ];
+            }
+        }
+    }
+
+    strcpy( pxEntry->cName, pcName );
+    pxEntry->ulIPAddress = ulIPAddress;
+    pxEntry->xStored = xNow;
+    pxEntry->xTTL = ( TickType_t ) ulTTL * configTICK_RATE_HZ;
+    pxEntry->xLastUsed = xNow;
+}
+/*-----------------------------------------------------------*/
+
+static DNSPending_t * prvFindPending( const char * pcName )
+{
+    for( int i = 0; i < configDNS_RESOLVER_PENDING; i++ )
+    {
+        if( ( xPending[ i ].cName[ 0 ] != '\0' ) && ( prvNameEqual( xPending[ i ].cName, pcName ) != pdFALSE ) )
+        {
+            return &xPending[ i ];
+        }
+    }
+
+    return NULL;
+}
+/*-----------------------------------------------------------*/
+
+/* Header and question for an A query, 0 if pcName is not a valid name */
+static size_t prvBuildQuery( uint8_t * pucQuery,
+                             uint16_t usID,
+                             const char * pcName )
+{
+    size_t uxOffset = dnsresolverHEADER_SIZE;
+
+    memset( pucQuery, 0, dnsresolverHEADER_SIZE );
+    pucQuery[ 0 ] = ( uint8_t ) ( usID >> 8 );
+    pucQuery[ 1 ] = ( uint8_t ) usID;
+    pucQuery[ 2 ] = ( uint8_t ) ( dnsresolverFLAG_RD >> 8 );
+    pucQuery[ 5 ] = 1; /* QDCOUNT */
+
+    while( *pcName != '\0' )
+    {
+        const char * pcDot = strchr( pcName, '.' );
+        size_t uxLabel = ( pcDot != NULL ) ? ( size_t ) ( pcDot - pcName ) : strlen( pcName );
+
+        if( ( uxLabel == 0 ) || ( uxLabel > 63 ) )
+        {
+            return 0;
+        }
+
+        pucQuery[ uxOffset++ ] = ( uint8_t ) uxLabel;
+        memcpy( &pucQuery[ uxOffset ], pcName, uxLabel );
+        uxOffset += uxLabel;
+        pcName += uxLabel;
+
+        /* A trailing dot is allowed */
+        if( *pcName == '.' )
+        {
+            pcName++;
+        }
+    }
+
+    pucQuery[ uxOffset++ ] = 0;
+    pucQuery[ uxOffset++ ] = 0;
+    pucQuery[ uxOffset++ ] = dnsresolverTYPE_A;
+    pucQuery[ uxOffset++ ] = 0;
+    pucQuery[ uxOffset++ ] = dnsresolverCLASS_IN;
+
+    return uxOffset;
+}
+/*-----------------------------------------------------------*/
+
+/* With the lock held; a failed send is retried like a lost query */
+static void prvSend( DNSPending_t * pxQuery )
+{
+    pxQuery->xLastSent = xTaskGetTickCount();
+    xStats.ulQueries++;
+
+    if( pxTransport != NULL )
+    {
+        ( void ) pxTransport( pxQuery->ucQuery, pxQuery->uxQueryLength );
+    }
+    else if( xSocket != NULL )
+    {
+        struct freertos_sockaddr xServer;
+
+        xServer.sin_addr = ulServerAddress;
+        xServer.sin_port = ( usServerPort != 0 ) ? usServerPort : FreeRTOS_htons( dnsresolverPORT );
+
+        if( xServer.sin_addr == 0 )
+        {
+            FreeRTOS_GetAddressConfiguration( NULL, NULL, NULL, &xServer.sin_addr );
+        }
+
+        ( void ) FreeRTOS_sendto( xSocket, pxQuery->ucQuery, pxQuery->uxQueryLength, 0, &xServer, sizeof( xServer ) );
+    }
+}
+/*-----------------------------------------------------------*/
+
+/* With the lock held: frees the query and takes over its waiters */
+static void prvComplete( DNSPending_t * pxQuery,
+                         uint32_t ulIPAddress,
+                         DNSCompletion_t * pxCompletion )
+{
+    strcpy( pxCompletion->cName, pxQuery->cName );
+    pxCompletion->ulIPAddress = ulIPAddress;
+    pxCompletion->uxWaiters = pxQuery->uxWaiters;
+    memcpy( pxCompletion->xWaiters, pxQuery->xWaiters, sizeof( pxQuery->xWaiters ) );
+
+    pxQuery->cName[ 0 ] = '\0';
+    pxQuery->uxWaiters = 0;
+}
+/*-----------------------------------------------------------*/
+
+/* Without the lock, callbacks may look names up again */
+static void prvNotify( const DNSCompletion_t * pxCompletion )
+{
+    for( UBaseType_t x = 0; x < pxCompletion->uxWaiters; x++ )
+    {
+        pxCompletion->xWaiters[ x ].pxCallback( pxCompletion->cName, pxCompletion->xWaiters[ x ].pvContext,
+                                                pxCompletion->ulIPAddress );
+    }
+}
+/*-----------------------------------------------------------*/
+
+/* Negative TTL from an SOA in the authority section at uxOffset (RFC 2308) */
+static uint32_t prvNegativeTTL( const uint8_t * pucReply,
+                                size_t uxLength,
+                                size_t uxOffset,
+                                uint16_t usAuthorities )
+{
+    uint32_t ulTTL = configDNS_RESOLVER_NEGATIVE_TTL;
+
+    for( uint16_t i = 0; i < usAuthorities; i++ )
+    {
+        uint16_t usType, usDataLength;
+        uint32_t ulRecordTTL;
+        size_t uxData;
+
+        uxOffset = prvSkipName( pucReply, uxLength, uxOffset );
+
+        if( ( uxOffset == 0 ) || ( uxOffset + 10 > uxLength ) )
+        {
+            break;
+        }
+
+        usType = prvRead16( &pucReply[ uxOffset ] );
+        ulRecordTTL = prvRead32( &pucReply[ uxOffset + 4 ] );
+        usDataLength = prvRead16( &pucReply[ uxOffset + 8 ] );
+        uxData = uxOffset + 10;
+        uxOffset = uxData + usDataLength;
+
+        if( uxOffset > uxLength )
+        {
+            break;
+        }
+
+        if( usType == dnsresolverTYPE_SOA )
+        {
+            /* MNAME, RNAME, then SERIAL, REFRESH, RETRY, EXPIRE, MINIMUM */
+            uxData = prvSkipName( pucReply, uxOffset, uxData );
+            uxData = ( uxData != 0 ) ? prvSkipName( pucReply, uxOffset, uxData ) : 0;
+
+            if( ( uxData != 0 ) && ( uxData + 20 <= uxOffset ) )
+            {
+                uint32_t ulMinimum = prvRead32( &pucReply[ uxData + 16 ] );
+
+                ulRecordTTL = ( ulMinimum < ulRecordTTL ) ? ulMinimum : ulRecordTTL;
+                ulTTL = ( ulRecordTTL < ulTTL ) ? ulRecordTTL : ulTTL;
+            }
+
+            break;
+        }
+    }
+
+    return ulTTL;
+}
+/*-----------------------------------------------------------*/
+
+void vDNSResolverInput( const uint8_t * pucReply,
+                        size_t uxLength )
+{
+    DNSCompletion_t xCompletion;
+    DNSPending_t * pxQuery = NULL;
+    uint16_t usFlags, usAnswers, usAuthorities;
+    uint32_t ulIPAddress = 0, ulTTL = configDNS_RESOLVER_MAX_TTL;
+    size_t uxOffset;
+
+    if( ( xLock == NULL ) || ( uxLength < dnsresolverHEADER_SIZE ) )
+    {
+        return;
+    }
+
+    usFlags = prvRead16( &pucReply[ 2 ] );
+
+    if( ( ( usFlags & dnsresolverFLAG_QR ) == 0 ) || ( prvRead16( &pucReply[ 4 ] ) != 1 ) )
+    {
+        return;
+    }
+
+    xSemaphoreTake( xLock, portMAX_DELAY );
+
+    /* The ID and the question have to match an outstanding query */
+    for( int i = 0; i < configDNS_RESOLVER_PENDING; i++ )
+    {
+        DNSPending_t * pxCandidate = &xPending[ i ];
+
+        if( ( pxCandidate->cName[ 0 ] != '\0' ) &&
+            ( pxCandidate->usID == prvRead16( pucReply ) ) &&
+            ( uxLength >= pxCandidate->uxQueryLength ) )
+        {
+            size_t x;
+
+            for( x = dnsresolverHEADER_SIZE; x < pxCandidate->uxQueryLength; x++ )
+            {
+                if( tolower( pucReply[ x ] ) != tolower( pxCandidate->ucQuery[ x ] ) )
+                {
+                    break;
+                }
+            }
+
+            if( x == pxCandidate->uxQueryLength )
+            {
+                pxQuery = pxCandidate;
+                break;
+            }
+        }
+    }
+
+    if( pxQuery == NULL )
+    {
+        xSemaphoreGive( xLock );
+        return;
+    }
+
+    usAnswers = prvRead16( &pucReply[ 6 ] );
+    usAuthorities = prvRead16( &pucReply[ 8 ] );
+    uxOffset = pxQuery->uxQueryLength;
+
+    if( ( usFlags & dnsresolverRCODE_MASK ) == dnsresolverRCODE_OK )
+    {
+        /* The first A record, through any CNAMEs; the chain expires with its
+         * shortest-lived record */
+        for( uint16_t i = 0; ( i < usAnswers ) && ( ulIPAddress == 0 ); i++ )
+        {
+            uint16_t usType, usClass, usDataLength;
+            uint32_t ulRecordTTL;
+
+            uxOffset = prvSkipName( pucReply, uxLength, uxOffset );
+
+            if( ( uxOffset == 0 ) || ( uxOffset + 10 > uxLength ) )
+            {
+                break;
+            }
+
+            usType = prvRead16( &pucReply[ uxOffset ] );
+            usClass = prvRead16( &pucReply[ uxOffset + 2 ] );
+            ulRecordTTL = prvRead32( &pucReply[ uxOffset + 4 ] );
+            usDataLength = prvRead16( &pucReply[ uxOffset + 8 ] );
+            uxOffset += 10;
+
+            if( uxOffset + usDataLength > uxLength )
+            {
+                break;
+            }
+
+            ulTTL = ( ulRecordTTL < ulTTL ) ? ulRecordTTL : ulTTL;
+
+            if( ( usType == dnsresolverTYPE_A ) && ( usClass == dnsresolverCLASS_IN ) && ( usDataLength == 4 ) )
+            {
+                memcpy( &ulIPAddress, &pucReply[ uxOffset ], sizeof( ulIPAddress ) );
+            }
+
+            uxOffset += usDataLength;
+        }
+
+        if( ulIPAddress != 0 )
+        {
+            xStats.ulAnswers++;
+            prvStore( pxQuery->cName, ulIPAddress, ulTTL );
+        }
+        else
+        {
+            /* NODATA: the name exists, without an address. The authority
+             * section follows the answers. */
+            xStats.ulNameErrors++;
+
+            if( uxOffset != 0 )
+            {
+                prvStore( pxQuery->cName, 0, prvNegativeTTL( pucReply, uxLength, uxOffset, usAuthorities ) );
+            }
+        }
+    }
+    else if( ( usFlags & dnsresolverRCODE_MASK ) == dnsresolverRCODE_NXDOMAIN )
+    {
+        xStats.ulNameErrors++;
+
+        /* Skip whatever answers came with it */
+        for( uint16_t i = 0; ( i < usAnswers ) && ( uxOffset != 0 ); i++ )
+        {
+            uxOffset = prvSkipName( pucReply, uxLength, uxOffset );
+            uxOffset = ( ( uxOffset != 0 ) && ( uxOffset + 10 <= uxLength ) ) ?
+                       uxOffset + 10 + prvRead16( &pucReply[ uxOffset + 8 ] ) : 0;
+        }
+
+        prvStore( pxQuery->cName, 0,
+                  ( uxOffset != 0 ) ? prvNegativeTTL( pucReply, uxLength, uxOffset, usAuthorities ) :
+                  configDNS_RESOLVER_NEGATIVE_TTL );
+    }
+
+    /* Any other RCODE (SERVFAIL, REFUSED...) says nothing about the name and
+     * is not cached */
+    prvComplete( pxQuery, ulIPAddress, &xCompletion );
+    xSemaphoreGive( xLock );
+
+    prvNotify( &xCompletion );
+}
+/*-----------------------------------------------------------*/
+
+/* Retransmit unanswered queries, time out the ones past their deadline */
+static void prvCheckPending( void )
+{
+    DNSCompletion_t xCompletion;
+    BaseType_t xTimedOut;
+
+    do
+    {
+        TickType_t xNow = xTaskGetTickCount();
+
+        xTimedOut = pdFALSE;
+        xSemaphoreTake( xLock, portMAX_DELAY );
+
+        for( int i = 0; i < configDNS_RESOLVER_PENDING; i++ )
+        {
+            DNSPending_t * pxQuery = &xPending[ i ];
+
+            if( pxQuery->cName[ 0 ] == '\0' )
+            {
+                continue;
+            }
+
+            if( prvExpired( pxQuery->xStarted, pxQuery->xTimeout, xNow ) != pdFALSE )
+            {
+                xStats.ulTimeouts++;
+                prvComplete( pxQuery, 0, &xCompletion );
+                xTimedOut = pdTRUE;
+                break;
+            }
+
+            if( prvExpired( pxQuery->xLastSent, pdMS_TO_TICKS( configDNS_RESOLVER_RETRY_MS ), xNow ) != pdFALSE )
+            {
+                prvSend( pxQuery );
+            }
+        }
+
+        xSemaphoreGive( xLock );
+
+        /* One at a time, the callbacks run without the lock */
+        if( xTimedOut != pdFALSE )
+        {
+            prvNotify( &xCompletion );
+        }
+    } while( xTimedOut != pdFALSE );
+}
+/*-----------------------------------------------------------*/
+
+static void prvResolverTask( void * pvParameters )
+{
+    struct freertos_sockaddr xAddress;
+    const TickType_t xReceiveTimeout = dnsresolverPOLL_PERIOD;
+    uint32_t ulAddressLength = sizeof( xAddress );
+    uint8_t * pucReply;
+    int32_t lBytes;
+    Socket_t xNewSocket;
+
+    ( void ) pvParameters;
+
+    xNewSocket = FreeRTOS_socket( FREERTOS_AF_INET, FREERTOS_SOCK_DGRAM, FREERTOS_IPPROTO_UDP );
+    configASSERT( xNewSocket != FREERTOS_INVALID_SOCKET );
+
+    FreeRTOS_setsockopt( xNewSocket, 0, FREERTOS_SO_RCVTIMEO, &xReceiveTimeout, sizeof( xReceiveTimeout ) );
+
+    /* Any local port */
+    xAddress.sin_addr = 0;
+    xAddress.sin_port = 0;
+    FreeRTOS_bind( xNewSocket, &xAddress, sizeof( xAddress ) );
+
+    /* Queries made until now go out with the first retransmission */
+    xSocket = xNewSocket;
+
+    for( ; ; )
+    {
+        lBytes = FreeRTOS_recvfrom( xSocket, &pucReply, 0, FREERTOS_ZERO_COPY, &xAddress, &ulAddressLength );
+
+        if( lBytes > 0 )
+        {
+            vDNSResolverInput( pucReply, ( size_t ) lBytes );
+            FreeRTOS_ReleaseUDPPayloadBuffer( pucReply );
+        }
+
+        prvCheckPending();
+    }
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xDNSResolverInit( uint16_t usStackSize,
+                             UBaseType_t uxPriority )
+{
+    BaseType_t xReturn = pdPASS;
+
+    vTaskSuspendAll();
+    {
+        if( xLock == NULL )
+        {
+            xLock = xSemaphoreCreateMutex();
+            xReturn = ( xLock != NULL ) ? pdPASS : pdFAIL;
+        }
+
+        if( ( xReturn == pdPASS ) && ( xResolverTask == NULL ) )
+        {
+            xReturn = xTaskCreate( prvResolverTask, "DNSResolver", usStackSize, NULL, uxPriority, &xResolverTask );
+        }
+    }
+    ( void ) xTaskResumeAll();
+
+    return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+void vDNSResolverSetServer( uint32_t ulIPAddress,
+                            uint16_t usPort )
+{
+    configASSERT( xLock != NULL );
+
+    xSemaphoreTake( xLock, portMAX_DELAY );
+    ulServerAddress = ulIPAddress;
+    usServerPort = usPort;
+    xSemaphoreGive( xLock );
+}
+/*-----------------------------------------------------------*/
+
+void vDNSResolverSetTransport( DNSResolverTransport_t pxNewTransport )
+{
+    configASSERT( xLock != NULL );
+
+    xSemaphoreTake( xLock, portMAX_DELAY );
+    pxTransport = pxNewTransport;
+    xSemaphoreGive( xLock );
+}
+/*-----------------------------------------------------------*/
+
+DNSResolverResult_t eDNSResolverLookup( const char * pcName,
+                                        uint32_t * pulIPAddress,
+                                        DNSResolverCallback_t pxCallback,
+                                        void * pvContext,
+                                        TickType_t xTimeout )
+{
+    TickType_t xNow = xTaskGetTickCount();
+    DNSResolverResult_t eResult = eDNSResolverError;
+    DNSCacheEntry_t * pxEntry;
+    DNSPending_t * pxQuery;
+
+    if( ( xLock == NULL ) || ( pcName[ 0 ] == '\0' ) || ( strlen( pcName ) >= configDNS_RESOLVER_NAME_LENGTH ) )
+    {
+        return eDNSResolverError;
+    }
+
+    xSemaphoreTake( xLock, portMAX_DELAY );
+
+    pxEntry = prvFindEntry( pcName, xNow );
+
+    if( pxEntry != NULL )
+    {
+        pxEntry->xLastUsed = xNow;
+
+        if( pxEntry->ulIPAddress != 0 )
+        {
+            xStats.ulHits++;
+            *pulIPAddress = pxEntry->ulIPAddress;
+            eResult = eDNSResolverHit;
+        }
+        else
+        {
+            xStats.ulNegativeHits++;
+            eResult = eDNSResolverNegative;
+        }
+
+        xSemaphoreGive( xLock );
+        return eResult;
+    }
+
+    xStats.ulMisses++;
+    pxQuery = prvFindPending( pcName );
+
+    if( pxQuery != NULL )
+    {
+        xStats.ulCoalesced++;
+
+        /* The longest timeout of the lookups sharing the query applies */
+        if( ( TickType_t ) ( xNow + xTimeout - pxQuery->xStarted ) > pxQuery->xTimeout )
+        {
+            pxQuery->xTimeout = ( TickType_t ) ( xNow + xTimeout - pxQuery->xStarted );
+        }
+    }
+    else
+    {
+        for( int i = 0; ( pxQuery == NULL ) && ( i < configDNS_RESOLVER_PENDING ); i++ )
+        {
+            if( xPending[ i ].cName[ 0 ] == '\0' )
+            {
+                pxQuery = &xPending[ i ];
+            }
+        }
+
+        if( pxQuery != NULL )
+        {
+            uint16_t usID;
+
+            /* Unpredictable, and unique among the outstanding queries */
+            do
+            {
+                usID = ( uint16_t ) ipconfigRAND32();
+
+                for( int i = 0; i < configDNS_RESOLVER_PENDING; i++ )
+                {
+                    if( ( xPending[ i ].cName[ 0 ] != '\0' ) && ( xPending[ i ].usID == usID ) )
+                    {
+                        usID = 0;
+                    }
+                }
+            } while( usID == 0 );
+
+            pxQuery->uxQueryLength = prvBuildQuery( pxQuery->ucQuery, usID, pcName );
+
+            if( pxQuery->uxQueryLength != 0 )
+            {
+                strcpy( pxQuery->cName, pcName );
+                pxQuery->usID = usID;
+                pxQuery->xStarted = xNow;
+                pxQuery->xTimeout = xTimeout;
+                pxQuery->uxWaiters = 0;
+                prvSend( pxQuery );
+            }
+            else
+            {
+                pxQuery = NULL;
+            }
+        }
+    }
+
+    if( ( pxQuery != NULL ) && ( pxQuery->uxWaiters < configDNS_RESOLVER_WAITERS ) )
+    {
+        pxQuery->xWaiters[ pxQuery->uxWaiters ].pxCallback = pxCallback;
+        pxQuery->xWaiters[ pxQuery->uxWaiters ].pvContext = pvContext;
+        pxQuery->uxWaiters++;
+        eResult = eDNSResolverPending;
+    }
+
+    xSemaphoreGive( xLock );
+
+    return eResult;
+}
+/*-----------------------------------------------------------*/
+
+/* A blocking lookup, on the caller's stack. Its own semaphore rather than a
+ * task notification, which the caller may be using for something else. */
+typedef struct DNS_BLOCKING_LOOKUP
+{
+    StaticSemaphore_t xDoneBuffer;
+    SemaphoreHandle_t xDone;
+    uint32_t ulIPAddress;
+} DNSBlockingLookup_t;
+
+static void prvWakeCaller( const char * pcName,
+                           void * pvContext,
+                           uint32_t ulIPAddress )
+{
+    DNSBlockingLookup_t * pxLookup = ( DNSBlockingLookup_t * ) pvContext;
+
+    ( void ) pcName;
+
+    pxLookup->ulIPAddress = ulIPAddress;
+    ( void ) xSemaphoreGive( pxLookup->xDone );
+}
+/*-----------------------------------------------------------*/
+
+uint32_t ulDNSResolverGetHostByName( const char * pcName,
+                                     TickType_t xTimeout )
+{
+    DNSBlockingLookup_t xLookup;
+    uint32_t ulIPAddress = 0;
+
+    if( xResolverTask == NULL )
+    {
+        #if ( ipconfigUSE_DNS != 0 )
+            ulIPAddress = FreeRTOS_gethostbyname( pcName );
+        #endif
+
+        return ulIPAddress;
+    }
+
+    xLookup.xDone = xSemaphoreCreateBinaryStatic( &xLookup.xDoneBuffer );
+    xLookup.ulIPAddress = 0;
+
+    switch( eDNSResolverLookup( pcName, &ulIPAddress, prvWakeCaller, &xLookup, xTimeout ) )
+    {
+        case eDNSResolverHit:
+            break;
+
+        case eDNSResolverPending:
+            /* The resolver always calls back, at the latest on timeout, so
+             * xLookup outlives the callback */
+            ( void ) xSemaphoreTake( xLookup.xDone, portMAX_DELAY );
+            ulIPAddress = xLookup.ulIPAddress;
+            break;
+
+        default:
+            ulIPAddress = 0;
+            break;
+    }
+
+    return ulIPAddress;
+}
+/*-----------------------------------------------------------*/
+
+void vDNSResolverFlush( void )
+{
+    if( xLock == NULL )
+    {
+        return;
+    }
+
+    xSemaphoreTake( xLock, portMAX_DELAY );
+
+    for( int i = 0; i < configDNS_RESOLVER_ENTRIES; i++ )
+    {
+        xCache[ i ].cName[ 0 ] = '\0';
+    }
+
+    xSemaphoreGive( xLock );
+}
+/*-----------------------------------------------------------*/
+
+void vDNSResolverGetStats( DNSResolverStats_t * pxStats )
+{
+    if( xLock == NULL )
+    {
+        memset( pxStats, 0, sizeof( *pxStats ) );
+        return;
+    }
+
+    xSemaphoreTake( xLock, portMAX_DELAY );
+    *pxStats = xStats;
+    xSemaphoreGive( xLock );
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,127 @@
+/**
+ * Caching, asynchronous DNS resolver on top of FreeRTOS+TCP sockets
+ * (bsp/dns_resolver.c).
+ */
+#ifndef DNS_RESOLVER_H
+#define DNS_RESOLVER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "FreeRTOS.h"
+
+/* Cached names, positive and negative */
+#ifndef configDNS_RESOLVER_ENTRIES
+    #define configDNS_RESOLVER_ENTRIES         16
+#endif
+
+/* Queries outstanding at the same time */
+#ifndef configDNS_RESOLVER_PENDING
+    #define configDNS_RESOLVER_PENDING         8
+#endif
+
+/* Callbacks waiting on one outstanding query */
+#ifndef configDNS_RESOLVER_WAITERS
+    #define configDNS_RESOLVER_WAITERS         4
+#endif
+
+#ifndef configDNS_RESOLVER_NAME_LENGTH
+    #define configDNS_RESOLVER_NAME_LENGTH     64
+#endif
+
+/* Upper bound on any TTL, in seconds, which also keeps it within the tick
+ * range */
+#ifndef configDNS_RESOLVER_MAX_TTL
+    #define configDNS_RESOLVER_MAX_TTL         3600
+#endif
+
+/* Seconds a name that does not resolve stays cached, when the server does not
+ * say (RFC 2308), and the upper bound when it does */
+#ifndef configDNS_RESOLVER_NEGATIVE_TTL
+    #define configDNS_RESOLVER_NEGATIVE_TTL    60
+#endif
+
+/* Milliseconds between retransmissions of an unanswered query */
+#ifndef configDNS_RESOLVER_RETRY_MS
+    #define configDNS_RESOLVER_RETRY_MS        1000
+#endif
+
+typedef enum
+{
+    eDNSResolverHit = 0,  /* Cached, the address is returned right away */
+    eDNSResolverNegative, /* Cached as not resolving */
+    eDNSResolverPending,  /* The callback gets the result */
+    eDNSResolverError     /* Bad name, or no room for another query */
+} DNSResolverResult_t;
+
+/* ulIPAddress (network byte order) is 0 when the name did not resolve */
+typedef void (* DNSResolverCallback_t)( const char * pcName,
+                                        void * pvContext,
+                                        uint32_t ulIPAddress );
+
+/* Sends one query; replies are passed back with vDNSResolverInput() */
+typedef BaseType_t (* DNSResolverTransport_t)( const uint8_t * pucQuery,
+                                               size_t uxLength );
+
+typedef struct DNS_RESOLVER_STATS
+{
+    uint32_t ulHits;         /* Answered from a positive cache entry */
+    uint32_t ulNegativeHits; /* Answered from a negative cache entry */
+    uint32_t ulMisses;       /* Lookups that needed a query */
+    uint32_t ulCoalesced;    /* Misses that joined an outstanding query */
+    uint32_t ulQueries;      /* Queries sent, retransmissions included */
+    uint32_t ulAnswers;      /* Names resolved by a server */
+    uint32_t ulNameErrors;   /* NXDOMAIN or no address, cached negatively */
+    uint32_t ulTimeouts;     /* Queries given up on */
+} DNSResolverStats_t;
+
+/*
+ * Create the resolver task, which owns the query socket, retransmits and
+ * times queries out, and runs the callbacks. Safe to call more than once.
+ */
+BaseType_t xDNSResolverInit( uint16_t usStackSize,
+                             UBaseType_t uxPriority );
+
+/*
+ * Send queries to ulIPAddress:usPort (network byte order) instead of the DNS
+ * server from the network configuration, port 53. 0 restores the default.
+ */
+void vDNSResolverSetServer( uint32_t ulIPAddress,
+                            uint16_t usPort );
+
+/*
+ * Send queries with pxTransport instead of the resolver's socket, NULL
+ * restores it. Used by the stub responder (bsp/dns_stub.c).
+ */
+void vDNSResolverSetTransport( DNSResolverTransport_t pxTransport );
+
+/*
+ * Resolve pcName without blocking. On eDNSResolverHit *pulIPAddress is set
+ * and the callback is not called; on eDNSResolverPending it is called exactly
+ * once, within about xTimeout, from the task that handles the reply (the
+ * resolver task or the stub responder), never from the caller's. Concurrent
+ * lookups of the same name share one query.
+ */
+DNSResolverResult_t eDNSResolverLookup( const char * pcName,
+                                        uint32_t * pulIPAddress,
+                                        DNSResolverCallback_t pxCallback,
+                                        void * pvContext,
+                                        TickType_t xTimeout );
+
+/*
+ * Blocking lookup for tasks, leaves the task notification alone.
+ * Returns 0 when the name does not resolve. Falls back to
+ * FreeRTOS_gethostbyname() when the resolver is not running.
+ */
+uint32_t ulDNSResolverGetHostByName( const char * pcName,
+                                     TickType_t xTimeout );
+
+/* Drop every cache entry */
+void vDNSResolverFlush( void );
+
+void vDNSResolverGetStats( DNSResolverStats_t * pxStats );
+
+/* Hand a DNS reply to the resolver, from any task */
+void vDNSResolverInput( const uint8_t * pucReply,
+                        size_t uxLength );
+
+#endif /* DNS_RESOLVER_H */
@@ -0,0 +1,242 @@
+/*
+ * Stub DNS responder, so the resolver (bsp/dns_resolver.c) can be exercised
+ * without a network or a DNS server.
+ *
+ * xDNSStubStart() installs itself as the resolver's transport: queries are
+ * queued to the responder task, which waits configDNS_STUB_DELAY_MS to stand
+ * in for the network and hands the reply back with vDNSResolverInput(). Names
+ * from xDNSStubAddRecord() get an A record, names with address 0 get no reply
+ * at all, and anything else gets NXDOMAIN with an SOA carrying
+ * configDNS_STUB_NEGATIVE_TTL, so every resolver path has something to hit.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+#include "dns_resolver.h"
+#include "dns_stub.h"
+
+#define dnsstubHEADER_SIZE    12
+#define dnsstubQUERY_MAX      ( dnsstubHEADER_SIZE + configDNS_RESOLVER_NAME_LENGTH + 2 + 4 )
+
+/* An A record, or an SOA with root names (owner, MNAME and RNAME) */
+#define dnsstubREPLY_MAX      ( dnsstubQUERY_MAX + 1 + 10 + 2 + 20 )
+
+#define dnsstubQUEUE_LENGTH   4
+
+typedef struct DNS_STUB_RECORD
+{
+    char cName[ configDNS_RESOLVER_NAME_LENGTH ];
+    uint32_t ulIPAddress;
+    uint32_t ulTTL;
+} DNSStubRecord_t;
+
+typedef struct DNS_STUB_QUERY
+{
+    size_t uxLength;
+    uint8_t ucQuery[ dnsstubQUERY_MAX ];
+} DNSStubQuery_t;
+
+static DNSStubRecord_t xRecords[ configDNS_STUB_RECORDS ];
+static volatile UBaseType_t uxRecords = 0;
+static QueueHandle_t xQueries = NULL;
+/*-----------------------------------------------------------*/
+
+BaseType_t xDNSStubAddRecord( const char * pcName,
+                              uint32_t ulIPAddress,
+                              uint32_t ulTTL )
+{
+    BaseType_t xReturn = pdFAIL;
+
+    if( strlen( pcName ) >= configDNS_RESOLVER_NAME_LENGTH )
+    {
+        return pdFAIL;
+    }
+
+    taskENTER_CRITICAL();
+    {
+        if( uxRecords < configDNS_STUB_RECORDS )
+        {
+            strcpy( xRecords[ uxRecords ].cName, pcName );
+            xRecords[ uxRecords ].ulIPAddress = ulIPAddress;
+            xRecords[ uxRecords ].ulTTL = ulTTL;
+            uxRecords++;
+            xReturn = pdPASS;
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvTransport( const uint8_t * pucQuery,
+                                size_t uxLength )
+{
+    DNSStubQuery_t xQuery;
+
+    if( uxLength > sizeof( xQuery.ucQuery ) )
+    {
+        return pdFAIL;
+    }
+
+    xQuery.uxLength = uxLength;
+    memcpy( xQuery.ucQuery, pucQuery, uxLength );
+
+    /* Called with the resolver's lock held, a full queue is a lost query */
+    return xQueueSend( xQueries, &xQuery, 0 );
+}
+/*-----------------------------------------------------------*/
+
+/* The record for the question's name, NULL if there is none */
+static const DNSStubRecord_t * prvFindRecord( const DNSStubQuery_t * pxQuery )
+{
+    char cName[ configDNS_RESOLVER_NAME_LENGTH ];
+    size_t uxIn = dnsstubHEADER_SIZE, uxOut = 0;
+
+    while( ( uxIn < pxQuery->uxLength ) && ( pxQuery->ucQuery[ uxIn ] != 0 ) )
+    {
+        size_t uxLabel = pxQuery->ucQuery[ uxIn++ ];
+
+        if( ( uxIn + uxLabel > pxQuery->uxLength ) || ( uxOut + uxLabel + 1 >= sizeof( cName ) ) )
+        {
+            return NULL;
+        }
+
+        if( uxOut != 0 )
+        {
+            cName[ uxOut++ ] = '.';
+        }
+
+        memcpy( &cName[ uxOut ], &pxQuery->ucQuery[ uxIn ], uxLabel );
+        uxOut += uxLabel;
+        uxIn += uxLabel;
+    }
+
+    cName[ uxOut ] = '\0';
+
+    for( UBaseType_t x = 0; x < uxRecords; x++ )
+    {
+        const char * pcA = xRecords[ x ].cName, * pcB = cName;
+
+        while( ( *pcA != '\0' ) && ( tolower( ( unsigned char ) *pcA ) == tolower( ( unsigned char ) *pcB ) ) )
+        {
+            pcA++;
+            pcB++;
+        }
+
+        if( *pcA == *pcB )
+        {
+            return &xRecords[ x ];
+        }
+    }
+
+    return NULL;
+}
+/*-----------------------------------------------------------*/
+
+static size_t prvPut16( uint8_t * pucData,
+                        size_t uxOffset,
+                        uint16_t usValue )
+{
+    pucData[ uxOffset ] = ( uint8_t ) ( usValue >> 8 );
+    pucData[ uxOffset + 1 ] = ( uint8_t ) usValue;
+
+    return uxOffset + 2;
+}
+/*-----------------------------------------------------------*/
+
+static size_t prvPut32( uint8_t * pucData,
+                        size_t uxOffset,
+                        uint32_t ulValue )
+{
+    uxOffset = prvPut16( pucData, uxOffset, ( uint16_t ) ( ulValue >> 16 ) );
+
+    return prvPut16( pucData, uxOffset, ( uint16_t ) ulValue );
+}
+/*-----------------------------------------------------------*/
+
+static void prvStubTask( void * pvParameters )
+{
+    static DNSStubQuery_t xQuery;
+    static uint8_t ucReply[ dnsstubREPLY_MAX ];
+    const DNSStubRecord_t * pxRecord;
+    size_t uxLength;
+
+    ( void ) pvParameters;
+
+    for( ; ; )
+    {
+        xQueueReceive( xQueries, &xQuery, portMAX_DELAY );
+        vTaskDelay( pdMS_TO_TICKS( configDNS_STUB_DELAY_MS ) );
+
+        pxRecord = prvFindRecord( &xQuery );
+
+        if( ( pxRecord != NULL ) && ( pxRecord->ulIPAddress == 0 ) )
+        {
+            continue;
+        }
+
+        /* The header and question go back as they came */
+        memcpy( ucReply, xQuery.ucQuery, xQuery.uxLength );
+        uxLength = xQuery.uxLength;
+
+        if( pxRecord != NULL )
+        {
+            ( void ) prvPut16( ucReply, 2, 0x8180 );          /* QR, RD, RA */
+            ( void ) prvPut16( ucReply, 6, 1 );               /* ANCOUNT */
+            uxLength = prvPut16( ucReply, uxLength, 0xC00C ); /* The question's name */
+            uxLength = prvPut16( ucReply, uxLength, 1 );      /* A */
+            uxLength = prvPut16( ucReply, uxLength, 1 );      /* IN */
+            uxLength = prvPut32( ucReply, uxLength, pxRecord->ulTTL );
+            uxLength = prvPut16( ucReply, uxLength, 4 );
+            memcpy( &ucReply[ uxLength ], &pxRecord->ulIPAddress, 4 );
+            uxLength += 4;
+        }
+        else
+        {
+            ( void ) prvPut16( ucReply, 2, 0x8183 );          /* QR, RD, RA, NXDOMAIN */
+            ( void ) prvPut16( ucReply, 8, 1 );               /* NSCOUNT */
+            ucReply[ uxLength++ ] = 0;                        /* Root */
+            uxLength = prvPut16( ucReply, uxLength, 6 );      /* SOA */
+            uxLength = prvPut16( ucReply, uxLength, 1 );      /* IN */
+            uxLength = prvPut32( ucReply, uxLength, configDNS_STUB_NEGATIVE_TTL );
+            uxLength = prvPut16( ucReply, uxLength, 2 + 20 );
+            ucReply[ uxLength++ ] = 0;                        /* MNAME */
+            ucReply[ uxLength++ ] = 0;                        /* RNAME */
+            memset( &ucReply[ uxLength ], 0, 16 );            /* SERIAL to EXPIRE */
+            uxLength += 16;
+            uxLength = prvPut32( ucReply, uxLength, configDNS_STUB_NEGATIVE_TTL );
+        }
+
+        vDNSResolverInput( ucReply, uxLength );
+    }
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xDNSStubStart( uint16_t usStackSize,
+                          UBaseType_t uxPriority )
+{
+    if( xQueries != NULL )
+    {
+        return pdPASS;
+    }
+
+    xQueries = xQueueCreate( dnsstubQUEUE_LENGTH, sizeof( DNSStubQuery_t ) );
+
+    if( ( xQueries == NULL ) ||
+        ( xTaskCreate( prvStubTask, "DNSStub", usStackSize, NULL, uxPriority, NULL ) != pdPASS ) )
+    {
+        return pdFAIL;
+    }
+
+    vDNSResolverSetTransport( prvTransport );
+
+    return pdPASS;
+}
+/*-----------------------------------------------------------*/
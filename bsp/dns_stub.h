@@ -0,0 +1,41 @@
+/**
+ * In-process stub DNS responder for the resolver (bsp/dns_stub.c).
+ */
+#ifndef DNS_STUB_H
+#define DNS_STUB_H
+
+#include <stdint.h>
+#include "FreeRTOS.h"
+
+#ifndef configDNS_STUB_RECORDS
+    #define configDNS_STUB_RECORDS         8
+#endif
+
+/* Simulated round trip of every query, in milliseconds */
+#ifndef configDNS_STUB_DELAY_MS
+    #define configDNS_STUB_DELAY_MS        20
+#endif
+
+/* SOA minimum sent with NXDOMAIN answers, in seconds */
+#ifndef configDNS_STUB_NEGATIVE_TTL
+    #define configDNS_STUB_NEGATIVE_TTL    30
+#endif
+
+/*
+ * Answer queries for pcName with ulIPAddress (network byte order) and ulTTL
+ * seconds. An address of 0 makes the stub drop queries for the name, to
+ * exercise retransmission and timeouts. Names not added get NXDOMAIN.
+ */
+BaseType_t xDNSStubAddRecord( const char * pcName,
+                              uint32_t ulIPAddress,
+                              uint32_t ulTTL );
+
+/*
+ * Create the responder task and route the resolver's queries to it, so that
+ * lookups work without a network or a DNS server. The resolver must have been
+ * started (xDNSResolverInit()).
+ */
+BaseType_t xDNSStubStart( uint16_t usStackSize,
+                          UBaseType_t uxPriority );
+
+#endif /* DNS_STUB_H */
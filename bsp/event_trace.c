@@ -0,0 +1,524 @@
+/*
+ * Kernel event tracing, see event_trace.h.
+ *
+ * Writers take a slot by incrementing ulReserved and publish it by storing
+ * its index + 1 into the slot's sequence, after the rest of the record; they
+ * clear the sequence first, so a record that is being overwritten is never
+ * mistaken for the one before it. The drain reads a slot's sequence before
+ * and after copying it and keeps the copy only if both are the one it
+ * expects, the way a seqlock reader does. A slot that is not published yet is
+ * waited for; one whose index is more than a ring behind ulReserved has been
+ * overwritten and is counted as lost. Nothing here spins or takes a lock, so
+ * a writer interrupted half way only costs the drain a short wait.
+ *
+ * The chunks, the sink and the drain task are a trace stream's
+ * (trace_stream.h). Task names are added to the stream's name table from the
+ * traceTASK_CREATE() hook, which the kernel calls in a critical section, and
+ * by xEventTraceStart() with the scheduler suspended, so they have one writer
+ * at a time.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "event_trace.h"
+#include "clock.h"
+
+extern uint64_t get_cycle_count( void );
+
+/* Record layout, see event_trace.h */
+#define etraceNAME_HEADER_SIZE     6
+#define etraceEVENTS_HEADER_SIZE   4
+#define etraceEVENT_SIZE           18
+#define etraceLOST_SIZE            8
+
+#define etraceMASK                 ( configEVENT_TRACE_RECORDS - 1 )
+
+typedef struct EVENT_TRACE_RECORD
+{
+    uint64_t ullCycles;
+    uint32_t ulObject;
+    uint32_t ulArgument;
+    uint8_t ucEvent;
+    uint8_t ucHart;
+    uint16_t usPad;
+    uint32_t ulSequence; /* Index + 1 once written, 0 while being written */
+} EventTraceRecord_t;
+
+static BaseType_t prvDrainStream( void );
+
+static EventTraceRecord_t * pxRing = NULL;
+static uint32_t ulReserved = 0;
+static uint32_t ulState = etraceSTATE_IDLE;
+static uint32_t ulTriggerIndex = 0;
+
+/* Set by xEventTraceStart() before the state leaves idle, read-only after */
+static uint32_t ulEventMask;
+static uint32_t ulTriggerEvent, ulTriggerObject;
+static uint32_t ulStopEvent, ulStopObject;
+static uint32_t ulStopAfter;
+static uint32_t ulPreTrigger;
+
+static uint8_t ucChunk[ configEVENT_TRACE_CHUNK_SIZE ];
+static TraceStreamName_t xNames[ configEVENT_TRACE_NAMES ];
+
+static TraceStream_t xStream =
+{
+    .ulMagic     = etraceMAGIC,
+    .pucChunk    = ucChunk,
+    .uxChunkSize = sizeof( ucChunk ),
+    .pxNames     = xNames,
+    .uxMaxNames  = configEVENT_TRACE_NAMES,
+    .uxRingSize  = configEVENT_TRACE_RECORDS * sizeof( EventTraceRecord_t ),
+    .xDrainTicks = pdMS_TO_TICKS( configEVENT_TRACE_DRAIN_MS ),
+    .pxDrain     = prvDrainStream
+};
+
+/* Owned by the drain, under the stream's lock */
+static uint32_t ulTail = 0;
+static BaseType_t xTriggerSeen = pdFALSE;
+static uint32_t ulLostSent = 0;
+
+static EventTraceStats_t xStats;
+
+static const char * const pcEventNames[ eventtraceEVENTS ] =
+{
+    "none",       "switch",     "ready",       "delay",         "delay-until",
+    "create",     "delete",     "inherit",     "disinherit",    "send",
+    "send-isr",   "receive",    "receive-isr", "block-send",    "block-receive",
+    "irq",        "irq-exit",   "tick",        "marker"
+};
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvMatches( uint32_t ulWantedEvent,
+                              uint32_t ulWantedObject,
+                              uint32_t ulEvent,
+                              uint32_t ulObject )
+{
+    return ( ulWantedEvent != eventtraceNONE ) && ( ulWantedEvent == ulEvent ) &&
+           ( ( ulWantedObject == 0 ) || ( ulWantedObject == ulObject ) );
+}
+/*-----------------------------------------------------------*/
+
+void vEventTraceRecord( uint32_t ulEvent,
+                        const void * pvObject,
+                        uint32_t ulArgument )
+{
+    uint32_t ulCurrent = __atomic_load_n( &ulState, __ATOMIC_ACQUIRE );
+    uint32_t ulObject = ( uint32_t ) ( uintptr_t ) pvObject;
+    BaseType_t xTrigger = pdFALSE, xStop = pdFALSE;
+    EventTraceRecord_t * pxRecord;
+    uint32_t ulIndex;
+    size_t uxHart;
+
+    if( ulCurrent == etraceSTATE_ARMED )
+    {
+        xTrigger = prvMatches( ulTriggerEvent, ulTriggerObject, ulEvent, ulObject );
+
+        if( ( xTrigger == pdFALSE ) && ( ulPreTrigger == 0 ) )
+        {
+            /* Nothing from before the trigger is kept */
+            return;
+        }
+    }
+    else if( ulCurrent == etraceSTATE_RUNNING )
+    {
+        xStop = prvMatches( ulStopEvent, ulStopObject, ulEvent, ulObject );
+    }
+    else
+    {
+        return;
+    }
+
+    if( ( ulEvent >= eventtraceEVENTS ) ||
+        ( ( ( ulEventMask & ( 1UL << ulEvent ) ) == 0 ) && ( xTrigger == pdFALSE ) && ( xStop == pdFALSE ) ) )
+    {
+        return;
+    }
+
+    __asm volatile ( "csrr %0, mhartid" : "=r" ( uxHart ) );
+
+    ulIndex = __atomic_fetch_add( &ulReserved, 1, __ATOMIC_RELAXED );
+    pxRecord = &pxRing[ ulIndex & etraceMASK ];
+
+    /* Unpublish the slot before overwriting it */
+    __atomic_store_n( &pxRecord->ulSequence, 0, __ATOMIC_RELAXED );
+    __atomic_thread_fence( __ATOMIC_RELEASE );
+
+    pxRecord->ullCycles = get_cycle_count();
+    pxRecord->ulObject = ulObject;
+    pxRecord->ulArgument = ulArgument;
+    pxRecord->ucEvent = ( uint8_t ) ulEvent;
+    pxRecord->ucHart = ( uint8_t ) uxHart;
+
+    __atomic_store_n( &pxRecord->ulSequence, ulIndex + 1, __ATOMIC_RELEASE );
+
+    if( xTrigger != pdFALSE )
+    {
+        uint32_t ulArmed = etraceSTATE_ARMED;
+
+        ulTriggerIndex = ulIndex;
+
+        if( __atomic_compare_exchange_n( &ulState, &ulArmed, etraceSTATE_RUNNING, pdFALSE,
+                                         __ATOMIC_RELEASE, __ATOMIC_RELAXED ) )
+        {
+            ulCurrent = etraceSTATE_RUNNING;
+        }
+    }
+
+    if( ulCurrent == etraceSTATE_RUNNING )
+    {
+        uint32_t ulSinceTrigger = ulIndex - ulTriggerIndex;
+
+        if( ( xStop != pdFALSE ) ||
+            ( ( ulStopAfter != 0 ) && ( ( int32_t ) ulSinceTrigger >= 0 ) && ( ulSinceTrigger + 1 >= ulStopAfter ) ) )
+        {
+            uint32_t ulRunning = etraceSTATE_RUNNING;
+
+            ( void ) __atomic_compare_exchange_n( &ulState, &ulRunning, etraceSTATE_STOPPED, pdFALSE,
+                                                  __ATOMIC_RELEASE, __ATOMIC_RELAXED );
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+void vEventTraceTaskCreate( const void * pvTask,
+                            const char * pcName,
+                            uint32_t ulPriority )
+{
+    uint32_t ulCurrent = __atomic_load_n( &ulState, __ATOMIC_ACQUIRE );
+
+    if( ( ulCurrent == etraceSTATE_ARMED ) || ( ulCurrent == etraceSTATE_RUNNING ) )
+    {
+        ( void ) uxTraceStreamName( &xStream, pvTask, pcName );
+        vEventTraceRecord( eventtraceTASK_CREATE, pvTask, ulPriority );
+    }
+}
+/*-----------------------------------------------------------*/
+
+/* Returns the number of names put */
+static UBaseType_t prvPutNames( UBaseType_t uxFirst )
+{
+    UBaseType_t uxKnown = xStream.uxNames, uxPut = 0;
+
+    for( UBaseType_t x = uxFirst; x < uxKnown; x++ )
+    {
+        size_t uxName = strnlen( xNames[ x ].cName, configMAX_TASK_NAME_LEN );
+
+        /* Leave room for some events */
+        if( uxTraceStreamRoom( &xStream ) < etraceNAME_HEADER_SIZE + uxName + etraceEVENTS_HEADER_SIZE + etraceEVENT_SIZE + etraceLOST_SIZE )
+        {
+            /* The rest go in the next chunk */
+            break;
+        }
+
+        vTraceStreamPut( &xStream, etraceRECORD_NAME, 1 );
+        vTraceStreamPut( &xStream, uxName, 1 );
+        vTraceStreamPut( &xStream, ( uint32_t ) ( uintptr_t ) xNames[ x ].pvTask, 4 );
+        vTraceStreamPutBytes( &xStream, xNames[ x ].cName, uxName );
+        xStream.usChunkRecords++;
+        xStream.uxNamesSent = x + 1;
+        uxPut++;
+    }
+
+    return uxPut;
+}
+/*-----------------------------------------------------------*/
+
+/* Copy slot ulIndex if it holds that record, checking it was not rewritten
+ * while it was copied */
+static BaseType_t prvCopy( uint32_t ulIndex,
+                           EventTraceRecord_t * pxCopy )
+{
+    EventTraceRecord_t * pxRecord = &pxRing[ ulIndex & etraceMASK ];
+
+    if( __atomic_load_n( &pxRecord->ulSequence, __ATOMIC_ACQUIRE ) != ulIndex + 1 )
+    {
+        return pdFALSE;
+    }
+
+    pxCopy->ullCycles = pxRecord->ullCycles;
+    pxCopy->ulObject = pxRecord->ulObject;
+    pxCopy->ulArgument = pxRecord->ulArgument;
+    pxCopy->ucEvent = pxRecord->ucEvent;
+    pxCopy->ucHart = pxRecord->ucHart;
+
+    __atomic_thread_fence( __ATOMIC_ACQUIRE );
+
+    return __atomic_load_n( &pxRecord->ulSequence, __ATOMIC_RELAXED ) == ulIndex + 1;
+}
+/*-----------------------------------------------------------*/
+
+/* Write out everything published in the ring, called with the stream's lock held.
+ * Returns pdTRUE if all of it was. */
+static BaseType_t prvDrain( void )
+{
+    uint32_t ulCurrent = __atomic_load_n( &ulState, __ATOMIC_ACQUIRE );
+    uint32_t ulEnd = __atomic_load_n( &ulReserved, __ATOMIC_ACQUIRE );
+    BaseType_t xWaiting = pdFALSE, xSaid;
+    uint16_t usEvents;
+
+    if( ulCurrent == etraceSTATE_ARMED )
+    {
+        /* Nothing is written before the trigger */
+        ulTail = ulEnd;
+        return pdTRUE;
+    }
+
+    if( xTriggerSeen == pdFALSE )
+    {
+        uint32_t ulBefore = ( ulPreTrigger < configEVENT_TRACE_RECORDS ) ? ulPreTrigger : configEVENT_TRACE_RECORDS;
+
+        ulBefore = ( ulBefore < ulTriggerIndex ) ? ulBefore : ulTriggerIndex;
+        ulTail = ulTriggerIndex - ulBefore;
+        xTriggerSeen = pdTRUE;
+    }
+
+    do
+    {
+        size_t uxEventsAt;
+
+        vTraceStreamChunkBegin( &xStream );
+        usEvents = 0;
+        xSaid = pdFALSE;
+
+        /* The two reads are a few cycles apart, the host fits a line
+         * through many of them */
+        vTraceStreamPut( &xStream, etraceRECORD_SYNC, 1 );
+        vTraceStreamPut( &xStream, 0, 1 );
+        vTraceStreamPut( &xStream, 0, 2 );
+        vTraceStreamPut( &xStream, get_cycle_count(), 8 );
+        vTraceStreamPut( &xStream, ullClockMonotonicNs(), 8 );
+        xStream.usChunkRecords++;
+
+        if( ( xStream.ulChunkSequence % configEVENT_TRACE_NAMES_EVERY ) == 0 )
+        {
+            vTraceStreamPut( &xStream, etraceRECORD_INFO, 1 );
+            vTraceStreamPut( &xStream, etraceVERSION, 1 );
+            vTraceStreamPut( &xStream, 0, 2 );
+            vTraceStreamPut( &xStream, configCPU_CLOCK_HZ, 4 );
+            xStream.usChunkRecords++;
+            ( void ) prvPutNames( 0 );
+            xSaid = pdTRUE;
+        }
+        else if( prvPutNames( xStream.uxNamesSent ) > 0 )
+        {
+            xSaid = pdTRUE;
+        }
+
+        uxEventsAt = xStream.uxChunkLength;
+        vTraceStreamPut( &xStream, etraceRECORD_EVENTS, 1 );
+        vTraceStreamPut( &xStream, 0, 1 );
+        vTraceStreamPut( &xStream, 0, 2 );
+
+        while( ( ulTail != ulEnd ) && ( uxTraceStreamRoom( &xStream ) >= etraceEVENT_SIZE + etraceLOST_SIZE ) )
+        {
+            EventTraceRecord_t xRecord;
+
+            if( ulEnd - ulTail > configEVENT_TRACE_RECORDS )
+            {
+                /* Lapped, skip to the oldest record still in the ring */
+                xStats.ulLost += ulEnd - configEVENT_TRACE_RECORDS - ulTail;
+                ulTail = ulEnd - configEVENT_TRACE_RECORDS;
+            }
+            else if( prvCopy( ulTail, &xRecord ) != pdFALSE )
+            {
+                vTraceStreamPut( &xStream, xRecord.ullCycles, 8 );
+                vTraceStreamPut( &xStream, xRecord.ulObject, 4 );
+                vTraceStreamPut( &xStream, xRecord.ulArgument, 4 );
+                vTraceStreamPut( &xStream, xRecord.ucEvent, 1 );
+                vTraceStreamPut( &xStream, xRecord.ucHart, 1 );
+                usEvents++;
+                ulTail++;
+            }
+            else if( __atomic_load_n( &ulReserved, __ATOMIC_ACQUIRE ) - ulTail > configEVENT_TRACE_RECORDS )
+            {
+                /* Overwritten since ulEnd was read */
+                xStats.ulLost++;
+                ulTail++;
+            }
+            else
+            {
+                /* Still being written, the rest waits for the next drain */
+                xWaiting = pdTRUE;
+                break;
+            }
+        }
+
+        if( usEvents > 0 )
+        {
+            ucChunk[ uxEventsAt + 2 ] = ( uint8_t ) usEvents;
+            ucChunk[ uxEventsAt + 3 ] = ( uint8_t ) ( usEvents >> 8 );
+            xStream.usChunkRecords++;
+            xStats.ulWritten += usEvents;
+            xSaid = pdTRUE;
+        }
+        else
+        {
+            xStream.uxChunkLength = uxEventsAt;
+        }
+
+        if( xStats.ulLost != ulLostSent )
+        {
+            vTraceStreamPut( &xStream, etraceRECORD_LOST, 1 );
+            vTraceStreamPut( &xStream, 0, 1 );
+            vTraceStreamPut( &xStream, 0, 2 );
+            vTraceStreamPut( &xStream, xStats.ulLost - ulLostSent, 4 );
+            xStream.usChunkRecords++;
+            ulLostSent = xStats.ulLost;
+            xSaid = pdTRUE;
+        }
+
+        if( xSaid != pdFALSE )
+        {
+            vTraceStreamChunkWrite( &xStream );
+        }
+        /* Until the ring is empty, or a chunk had no events */
+    } while( ( usEvents > 0 ) && ( xWaiting == pdFALSE ) && ( ulTail != ulEnd ) );
+
+    return ( xWaiting == pdFALSE ) && ( ulTail == ulEnd );
+}
+/*-----------------------------------------------------------*/
+
+/* The stream's pxDrain: the trace is closed once it has stopped and been
+ * written out */
+static BaseType_t prvDrainStream( void )
+{
+    /* Read the state first, so that everything recorded before the stop is in
+     * the drain */
+    uint32_t ulCurrent = __atomic_load_n( &ulState, __ATOMIC_ACQUIRE );
+
+    return ( prvDrain() != pdFALSE ) && ( ulCurrent == etraceSTATE_STOPPED );
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xEventTraceInit( uint16_t usStackSize,
+                            UBaseType_t uxPriority )
+{
+    BaseType_t xReturn = xTraceStreamInit( &xStream, "EventTrace", usStackSize, uxPriority );
+
+    pxRing = xStream.pvRing;
+
+    return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+/* With the stream's lock held and nothing being recorded */
+static void prvBegin( const void * pvArgument )
+{
+    const EventTraceConditions_t * pxConditions = pvArgument;
+    TaskStatus_t * pxTasks;
+    UBaseType_t uxTasks;
+
+    memset( pxRing, 0, configEVENT_TRACE_RECORDS * sizeof( EventTraceRecord_t ) );
+    ulReserved = 0;
+    ulTriggerIndex = 0;
+    ulTail = 0;
+    ulLostSent = 0;
+    memset( &xStats, 0, sizeof( xStats ) );
+
+    ulEventMask = ( pxConditions->ulEventMask != 0 ) ? pxConditions->ulEventMask : UINT32_MAX;
+    ulTriggerEvent = pxConditions->ulTriggerEvent;
+    ulTriggerObject = ( uint32_t ) ( uintptr_t ) pxConditions->pvTriggerObject;
+    ulPreTrigger = pxConditions->ulPreTrigger;
+    ulStopEvent = pxConditions->ulStopEvent;
+    ulStopObject = ( uint32_t ) ( uintptr_t ) pxConditions->pvStopObject;
+    ulStopAfter = pxConditions->ulStopAfter;
+    xTriggerSeen = pdFALSE;
+
+    /* Name the tasks there are now; no task can be created from here until
+     * the state is set, and those created after that name themselves */
+    vTaskSuspendAll();
+    {
+        uxTasks = uxTaskGetNumberOfTasks();
+        pxTasks = pvPortMalloc( uxTasks * sizeof( TaskStatus_t ) );
+
+        if( pxTasks != NULL )
+        {
+            uxTasks = uxTaskGetSystemState( pxTasks, uxTasks, NULL );
+
+            for( UBaseType_t x = 0; x < uxTasks; x++ )
+            {
+                ( void ) uxTraceStreamName( &xStream, pxTasks[ x ].xHandle, pxTasks[ x ].pcTaskName );
+            }
+
+            vPortFree( pxTasks );
+        }
+
+        __atomic_store_n( &ulState, ( ulTriggerEvent != eventtraceNONE ) ? etraceSTATE_ARMED : etraceSTATE_RUNNING,
+                          __ATOMIC_RELEASE );
+    }
+    ( void ) xTaskResumeAll();
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xEventTraceStart( const EventTraceConditions_t * pxConditions,
+                             EventTraceWrite_t pxWrite,
+                             void * pvContext )
+{
+    EventTraceConditions_t xAll;
+
+    if( pxConditions == NULL )
+    {
+        memset( &xAll, 0, sizeof( xAll ) );
+        pxConditions = &xAll;
+    }
+
+    return xTraceStreamStart( &xStream, pxWrite, pvContext, prvBegin, pxConditions );
+}
+/*-----------------------------------------------------------*/
+
+static void prvHalt( void )
+{
+    if( __atomic_exchange_n( &ulState, etraceSTATE_STOPPED, __ATOMIC_ACQ_REL ) == etraceSTATE_ARMED )
+    {
+        /* Never triggered, write out what is kept from before now */
+        ulTriggerIndex = __atomic_load_n( &ulReserved, __ATOMIC_ACQUIRE );
+    }
+}
+/*-----------------------------------------------------------*/
+
+void vEventTraceStop( void )
+{
+    vTraceStreamStop( &xStream, prvHalt );
+}
+/*-----------------------------------------------------------*/
+
+void vEventTraceGetStats( EventTraceStats_t * pxStats )
+{
+    xSemaphoreTake( xStream.xLock, portMAX_DELAY );
+    {
+        *pxStats = xStats;
+        pxStats->ulChunks = xStream.ulChunks;
+        pxStats->ulWriteErrors = xStream.ulWriteErrors;
+        pxStats->ulRecorded = __atomic_load_n( &ulReserved, __ATOMIC_RELAXED );
+        pxStats->ulNames = xStream.uxNames;
+        pxStats->ulState = __atomic_load_n( &ulState, __ATOMIC_RELAXED );
+    }
+    xSemaphoreGive( xStream.xLock );
+}
+/*-----------------------------------------------------------*/
+
+uint32_t ulEventTraceEventFromName( const char * pcName,
+                                    size_t uxLength )
+{
+    for( uint32_t x = eventtraceNONE + 1; x < eventtraceEVENTS; x++ )
+    {
+        if( ( strlen( pcEventNames[ x ] ) == uxLength ) && ( strncmp( pcEventNames[ x ], pcName, uxLength ) == 0 ) )
+        {
+            return x;
+        }
+    }
+
+    return eventtraceNONE;
+}
+/*-----------------------------------------------------------*/
+
+const char * pcEventTraceEventName( uint32_t ulEvent )
+{
+    return ( ulEvent < eventtraceEVENTS ) ? pcEventNames[ ulEvent ] : "?";
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,157 @@
+/**
+ * Kernel event tracing (bsp/event_trace.c).
+ *
+ * With configEVENT_TRACE set, the kernel trace macros in event_trace_hooks.h
+ * record context switches, tasks becoming ready, delays, priority inheritance,
+ * queue sends, receives and blocks, task creation and deletion and the tick;
+ * external_interrupt_handler() records interrupt entry and exit, and
+ * application code can add its own markers with vEventTraceRecord(). Each
+ * record is timestamped with the cycle counter and tagged with the hart that
+ * wrote it.
+ *
+ * Records go into a ring that writers reserve slots in with an atomic
+ * increment, so recording takes no lock and never calls into the kernel, and
+ * is safe from any task or interrupt. Once the ring is full the oldest
+ * records are overwritten. A low priority task polls the ring, rather than
+ * being woken by writers that may be deep in the scheduler, and hands
+ * self-describing chunks to a sink: a file on FAT or UDP datagrams to the
+ * host, see "event-trace" in CLI-commands.c.
+ * demo/servers/scripts/etrace2perfetto.py turns them into a timeline for
+ * Perfetto or chrome://tracing.
+ *
+ * Tracing can wait for a trigger event before it keeps anything, keep some
+ * records from before the trigger, and stop by itself on a stop event or a
+ * record count, see EventTraceConditions_t. The sink is closed once a
+ * stopped trace has been written out.
+ *
+ * Everything in a chunk is little-endian:
+ *
+ *   uint32 magic ("ETR1")  uint32 sequence  uint16 length (header included)
+ *   uint16 records
+ *
+ * then records, each a uint8 type followed by:
+ *
+ *   INFO    uint8 version, uint16 pad, uint32 nominal cycles per second
+ *   SYNC    uint8 pad, uint16 pad, uint64 cycles, uint64 ullClockMonotonicNs()
+ *           read together, to map cycles to time
+ *   NAME    uint8 name length, uint32 task, the name
+ *   EVENTS  uint8 pad, uint16 count, then per event: uint64 cycles,
+ *           uint32 object, uint32 argument, uint8 event id, uint8 hart
+ *   LOST    uint8 pad, uint16 pad, uint32 records overwritten before they
+ *           were written out, since the last one
+ *
+ * Every chunk starts with SYNC. INFO and the names of every task known so far
+ * start the first chunk and are repeated every configEVENT_TRACE_NAMES_EVERY
+ * chunks, so that a stream joined late, or with datagrams lost, can still be
+ * decoded. Objects are the low 32 bits of the task or queue address.
+ */
+#ifndef EVENT_TRACE_H
+#define EVENT_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "FreeRTOS.h"
+
+#include "event_trace_hooks.h"
+#include "trace_stream.h"
+
+#ifndef configEVENT_TRACE
+    #define configEVENT_TRACE                  0
+#endif
+
+/* Records the ring holds, a power of two */
+#ifndef configEVENT_TRACE_RECORDS
+    #define configEVENT_TRACE_RECORDS          2048
+#endif
+
+/* Distinct tasks that get a name */
+#ifndef configEVENT_TRACE_NAMES
+    #define configEVENT_TRACE_NAMES            48
+#endif
+
+/* Largest chunk handed to the sink, small enough for one UDP datagram */
+#ifndef configEVENT_TRACE_CHUNK_SIZE
+    #define configEVENT_TRACE_CHUNK_SIZE       1024
+#endif
+
+/* How often the drain task looks at the ring */
+#ifndef configEVENT_TRACE_DRAIN_MS
+    #define configEVENT_TRACE_DRAIN_MS         20
+#endif
+
+/* Chunks between repeats of INFO and the task names */
+#ifndef configEVENT_TRACE_NAMES_EVERY
+    #define configEVENT_TRACE_NAMES_EVERY      64
+#endif
+
+#if ( configEVENT_TRACE_RECORDS & ( configEVENT_TRACE_RECORDS - 1 ) ) != 0
+    #error configEVENT_TRACE_RECORDS must be a power of two
+#endif
+
+#define etraceMAGIC                    0x31525445UL /* "ETR1" */
+#define etraceVERSION                  1
+
+#define etraceRECORD_INFO              1
+#define etraceRECORD_SYNC              2
+#define etraceRECORD_NAME              3
+#define etraceRECORD_EVENTS            4
+#define etraceRECORD_LOST              5
+
+/* Trace states */
+#define etraceSTATE_IDLE               0 /* No sink */
+#define etraceSTATE_ARMED              1 /* Waiting for the trigger event */
+#define etraceSTATE_RUNNING            2
+#define etraceSTATE_STOPPED            3 /* Stop condition met, writing out */
+
+/* Writes one chunk, see TraceStreamWrite_t */
+typedef TraceStreamWrite_t EventTraceWrite_t;
+
+/*
+ * When to record. All zero records every event from the start until
+ * vEventTraceStop(). An object of NULL matches any object.
+ */
+typedef struct EVENT_TRACE_CONDITIONS
+{
+    uint32_t ulEventMask;       /* Bit per event id to record, 0 for all */
+    uint32_t ulTriggerEvent;    /* Record nothing until this, eventtraceNONE to start at once */
+    const void * pvTriggerObject;
+    uint32_t ulPreTrigger;      /* Records from before the trigger to keep */
+    uint32_t ulStopEvent;       /* Stop after recording this, eventtraceNONE for no stop event */
+    const void * pvStopObject;
+    uint32_t ulStopAfter;       /* Stop after this many records from the trigger on, 0 for no limit */
+} EventTraceConditions_t;
+
+typedef struct EVENT_TRACE_STATS
+{
+    uint32_t ulRecorded;    /* Slots taken in the ring, the pre-trigger history included */
+    uint32_t ulWritten;     /* Records handed to the sink */
+    uint32_t ulLost;        /* Overwritten before they were written out */
+    uint32_t ulChunks;      /* Handed to the sink */
+    uint32_t ulWriteErrors; /* Chunks the sink failed to write */
+    uint32_t ulNames;       /* Tasks with a name */
+    uint32_t ulState;       /* etraceSTATE_ */
+} EventTraceStats_t;
+
+/* Create the drain task, once */
+BaseType_t xEventTraceInit( uint16_t usStackSize,
+                            UBaseType_t uxPriority );
+
+/* Clear the ring and start tracing into pxWrite, pxConditions NULL for all
+ * events from now on */
+BaseType_t xEventTraceStart( const EventTraceConditions_t * pxConditions,
+                             EventTraceWrite_t pxWrite,
+                             void * pvContext );
+
+/* Stop tracing, write what is left and close the sink */
+void vEventTraceStop( void );
+
+void vEventTraceGetStats( EventTraceStats_t * pxStats );
+
+/* Event id for a name as the CLI and etrace2perfetto.py spell it ("switch",
+ * "irq", "marker", ...), eventtraceNONE if there is none */
+uint32_t ulEventTraceEventFromName( const char * pcName,
+                                    size_t uxLength );
+
+const char * pcEventTraceEventName( uint32_t ulEvent );
+
+#endif /* EVENT_TRACE_H */
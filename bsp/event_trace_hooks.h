@@ -0,0 +1,92 @@
+/**
+ * Kernel trace hooks for the event tracer (bsp/event_trace.h).
+ *
+ * Included by FreeRTOSConfig.h when configEVENT_TRACE is set, before the
+ * kernel has defined any of its types, so this header only needs stdint.h.
+ * The macros expand inside tasks.c and queue.c, where the TCB and queue
+ * fields they read are in scope. traceTASK_SWITCHED_IN() is put together in
+ * FreeRTOSConfig.h from eventtraceTASK_SWITCHED_IN() and whatever else wants
+ * that hook.
+ */
+#ifndef EVENT_TRACE_HOOKS_H
+#define EVENT_TRACE_HOOKS_H
+
+#include <stdint.h>
+
+/* Event ids, also bit numbers in EventTraceConditions_t.ulEventMask. Object
+ * and argument of each: */
+#define eventtraceNONE                 0
+#define eventtraceSWITCHED_IN          1  /* Task, its priority */
+#define eventtraceREADY                2  /* Task, its priority */
+#define eventtraceDELAY                3  /* Running task, ticks */
+#define eventtraceDELAY_UNTIL          4  /* Running task, tick to wake at */
+#define eventtraceTASK_CREATE          5  /* Task, its priority */
+#define eventtraceTASK_DELETE          6  /* Task, 0 */
+#define eventtracePRIORITY_INHERIT     7  /* Mutex holder, priority it inherits */
+#define eventtracePRIORITY_DISINHERIT  8  /* Mutex holder, priority it gets back */
+#define eventtraceQUEUE_SEND           9  /* Queue, items before the send */
+#define eventtraceQUEUE_SEND_ISR       10 /* Queue, items before the send */
+#define eventtraceQUEUE_RECEIVE        11 /* Queue, items before the receive */
+#define eventtraceQUEUE_RECEIVE_ISR    12 /* Queue, items before the receive */
+#define eventtraceQUEUE_BLOCK_SEND     13 /* Queue, 0 */
+#define eventtraceQUEUE_BLOCK_RECEIVE  14 /* Queue, 0 */
+#define eventtraceIRQ_ENTER            15 /* 0, PLIC source */
+#define eventtraceIRQ_EXIT             16 /* 0, PLIC source */
+#define eventtraceTICK                 17 /* 0, tick count */
+#define eventtraceMARKER               18 /* Anything, from vEventTraceRecord() */
+#define eventtraceEVENTS               19
+
+void vEventTraceRecord( uint32_t ulEvent,
+                        const void * pvObject,
+                        uint32_t ulArgument );
+
+void vEventTraceTaskCreate( const void * pvTask,
+                            const char * pcName,
+                            uint32_t ulPriority );
+
+#define eventtraceTASK_SWITCHED_IN() \
+    vEventTraceRecord( eventtraceSWITCHED_IN, pxCurrentTCB, pxCurrentTCB->uxPriority )
+
+#define traceMOVED_TASK_TO_READY_STATE( pxTCB ) \
+    vEventTraceRecord( eventtraceREADY, pxTCB, ( pxTCB )->uxPriority )
+
+#define traceTASK_DELAY() \
+    vEventTraceRecord( eventtraceDELAY, pxCurrentTCB, xTicksToDelay )
+
+#define traceTASK_DELAY_UNTIL( xTimeToWake ) \
+    vEventTraceRecord( eventtraceDELAY_UNTIL, pxCurrentTCB, xTimeToWake )
+
+#define traceTASK_CREATE( pxNewTCB ) \
+    vEventTraceTaskCreate( pxNewTCB, ( pxNewTCB )->pcTaskName, ( pxNewTCB )->uxPriority )
+
+#define traceTASK_DELETE( pxTCB ) \
+    vEventTraceRecord( eventtraceTASK_DELETE, pxTCB, 0 )
+
+#define traceTASK_PRIORITY_INHERIT( pxTCBOfMutexHolder, uxInheritedPriority ) \
+    vEventTraceRecord( eventtracePRIORITY_INHERIT, pxTCBOfMutexHolder, uxInheritedPriority )
+
+#define traceTASK_PRIORITY_DISINHERIT( pxTCBOfMutexHolder, uxOriginalPriority ) \
+    vEventTraceRecord( eventtracePRIORITY_DISINHERIT, pxTCBOfMutexHolder, uxOriginalPriority )
+
+#define traceQUEUE_SEND( pxQueue ) \
+    vEventTraceRecord( eventtraceQUEUE_SEND, pxQueue, ( pxQueue )->uxMessagesWaiting )
+
+#define traceQUEUE_SEND_FROM_ISR( pxQueue ) \
+    vEventTraceRecord( eventtraceQUEUE_SEND_ISR, pxQueue, ( pxQueue )->uxMessagesWaiting )
+
+#define traceQUEUE_RECEIVE( pxQueue ) \
+    vEventTraceRecord( eventtraceQUEUE_RECEIVE, pxQueue, ( pxQueue )->uxMessagesWaiting )
+
+#define traceQUEUE_RECEIVE_FROM_ISR( pxQueue ) \
+    vEventTraceRecord( eventtraceQUEUE_RECEIVE_ISR, pxQueue, ( pxQueue )->uxMessagesWaiting )
+
+#define traceBLOCKING_ON_QUEUE_SEND( pxQueue ) \
+    vEventTraceRecord( eventtraceQUEUE_BLOCK_SEND, pxQueue, 0 )
+
+#define traceBLOCKING_ON_QUEUE_RECEIVE( pxQueue ) \
+    vEventTraceRecord( eventtraceQUEUE_BLOCK_RECEIVE, pxQueue, 0 )
+
+#define traceTASK_INCREMENT_TICK( xTickCount ) \
+    vEventTraceRecord( eventtraceTICK, 0, ( xTickCount ) + 1 )
+
+#endif /* EVENT_TRACE_HOOKS_H */
@@ -0,0 +1,602 @@
+/*
+ * Ring-based NetworkInterface for the GFE AXI DMA + AXI Ethernet, selected
+ * with --gfe-eth-ring in place of FreeRTOS+TCP's riscv_hal_eth.c, which
+ * keeps a single descriptor in flight and takes one interrupt per frame.
+ *
+ * Both DMA channels run in scatter-gather mode over circular descriptor rings
+ * in uncached memory, with ring-owned frame buffers (the DMA is not cache
+ * coherent, network buffers are copied in and out).
+ *
+ * RX is NAPI style: the S2MM interrupt, already coalesced by the engine's
+ * IRQThreshold/IRQDelay, masks itself and wakes the driver task. The task
+ * then polls the ring, at most configGFE_ETH_NAPI_BUDGET frames per round,
+ * yielding to the IP task between rounds while the ring keeps filling, and
+ * only re-enables the interrupt once a round comes up short. Processed
+ * descriptors are handed back with a single TAILDESC write per round.
+ *
+ * TX completions do not interrupt. Completed descriptors are reclaimed in
+ * batches on the next transmit and on every driver task wake-up; the MM2S
+ * interrupt is only armed while a transmit waits for a full ring to drain.
+ *
+ * With configGFE_ETH_SIM the register accesses go to the software model in
+ * gfe_eth_sim.c instead, so the driver can be exercised on QEMU.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include "FreeRTOS_IP.h"
+#include "FreeRTOS_IP_Private.h"
+#include "NetworkInterface.h"
+#include "NetworkBufferManagement.h"
+
+#include "bsp.h"
+#include "axi_dma.h"
+#include "gfe_eth.h"
+
+#if !configGFE_ETH_SIM
+    #include "xaxiethernet.h"
+#endif
+
+#ifdef __CHERI_PURE_CAPABILITY__
+    #include <cheri/cheri-utility.h>
+#endif /* __CHERI_PURE_CAPABILITY__ */
+
+#ifndef configGFE_ETH_RX_RING
+    #define configGFE_ETH_RX_RING    32
+#endif
+
+#ifndef configGFE_ETH_TX_RING
+    #define configGFE_ETH_TX_RING    32
+#endif
+
+/* Frames handled per poll round before giving the IP task a turn */
+#ifndef configGFE_ETH_NAPI_BUDGET
+    #define configGFE_ETH_NAPI_BUDGET    16
+#endif
+
+/* S2MM interrupt coalescing: one interrupt per configGFE_ETH_RX_COALESCE
+ * frames, or after configGFE_ETH_RX_DELAY x 125 SG clocks without one */
+#ifndef configGFE_ETH_RX_COALESCE
+    #define configGFE_ETH_RX_COALESCE    4
+#endif
+
+#ifndef configGFE_ETH_RX_DELAY
+    #define configGFE_ETH_RX_DELAY    16
+#endif
+
+/* Same priority as the IP task, so that yielding between poll rounds lets it
+ * drain what was just delivered */
+#ifndef configGFE_ETH_TASK_PRIORITY
+    #define configGFE_ETH_TASK_PRIORITY    ipconfigIP_TASK_PRIORITY
+#endif
+
+#ifndef configGFE_ETH_TX_RECLAIM_MS
+    #define configGFE_ETH_TX_RECLAIM_MS    10
+#endif
+
+/* Rings and frame buffers live in uncached memory, the model needs no such thing */
+#if configGFE_ETH_SIM
+    #define gfeethDMA_MEM
+#else
+    #define gfeethDMA_MEM    __attribute__( ( section( ".uncached" ) ) )
+#endif
+
+#define gfeethBUF_SIZE                                                        \
+    ( ( ipTOTAL_ETHERNET_FRAME_SIZE + AXI_DMA_BD_ALIGN - 1 ) & ~( AXI_DMA_BD_ALIGN - 1 ) )
+#define gfeethTX_WAIT_MS       50
+
+#define gfeethBARRIER()        __sync_synchronize()
+#define gfeethDMA_ADDR( p )    ( ( uint64_t ) ( uintptr_t ) ( p ) )
+
+static struct axi_dma_bd xRxRing[ configGFE_ETH_RX_RING ] gfeethDMA_MEM;
+static struct axi_dma_bd xTxRing[ configGFE_ETH_TX_RING ] gfeethDMA_MEM;
+static uint8_t ucRxBuffers[ configGFE_ETH_RX_RING ][ gfeethBUF_SIZE ] gfeethDMA_MEM __attribute__( ( aligned( AXI_DMA_BD_ALIGN ) ) );
+static uint8_t ucTxBuffers[ configGFE_ETH_TX_RING ][ gfeethBUF_SIZE ] gfeethDMA_MEM __attribute__( ( aligned( AXI_DMA_BD_ALIGN ) ) );
+
+static UBaseType_t uxRxHead;  /* Next RX descriptor the engine completes */
+static UBaseType_t uxTxHead;  /* Next free TX descriptor */
+static UBaseType_t uxTxClean; /* Oldest TX descriptor not yet reclaimed */
+static UBaseType_t uxTxFree;
+
+static TaskHandle_t xDriverTask = NULL;
+static TaskHandle_t xTxWaiter = NULL;
+static SemaphoreHandle_t xTxLock = NULL;
+static BaseType_t xInitialised = pdFALSE;
+static GfeEthStats_t xStats;
+
+#if !configGFE_ETH_SIM
+    static volatile uint32_t * pulAxiDma;
+    static XAxiEthernet xAxiEthernet;
+#endif
+/*-----------------------------------------------------------*/
+
+static inline uint32_t prvRead( uint32_t ulOffset )
+{
+    #if configGFE_ETH_SIM
+        return ulGfeEthSimRead( ulOffset );
+    #else
+        return pulAxiDma[ ulOffset / sizeof( uint32_t ) ];
+    #endif
+}
+
+static inline void prvWrite( uint32_t ulOffset,
+                             uint32_t ulValue )
+{
+    #if configGFE_ETH_SIM
+        vGfeEthSimWrite( ulOffset, ulValue );
+    #else
+        pulAxiDma[ ulOffset / sizeof( uint32_t ) ] = ulValue;
+    #endif
+}
+
+static inline void prvWriteDesc( uint32_t ulChannel,
+                                 uint32_t ulRegister,
+                                 const struct axi_dma_bd * pxBd )
+{
+    /* The MSB half must be written first, the LSB write is what kicks the
+     * engine for TAILDESC */
+    prvWrite( ulChannel + ulRegister + 4, ( uint32_t ) ( gfeethDMA_ADDR( pxBd ) >> 32 ) );
+    prvWrite( ulChannel + ulRegister, ( uint32_t ) gfeethDMA_ADDR( pxBd ) );
+}
+/*-----------------------------------------------------------*/
+
+static void prvInitRing( struct axi_dma_bd * pxRing,
+                         UBaseType_t uxCount,
+                         uint8_t * pucBuffers,
+                         uint32_t ulControl )
+{
+    memset( pxRing, 0, uxCount * sizeof( pxRing[ 0 ] ) );
+
+    for( UBaseType_t x = 0; x < uxCount; x++ )
+    {
+        struct axi_dma_bd * pxNext = &pxRing[ ( x + 1 ) % uxCount ];
+        uint8_t * pucBuffer = &pucBuffers[ x * gfeethBUF_SIZE ];
+
+        pxRing[ x ].next = ( uint32_t ) gfeethDMA_ADDR( pxNext );
+        pxRing[ x ].next_msb = ( uint32_t ) ( gfeethDMA_ADDR( pxNext ) >> 32 );
+        pxRing[ x ].buf = ( uint32_t ) gfeethDMA_ADDR( pucBuffer );
+        pxRing[ x ].buf_msb = ( uint32_t ) ( gfeethDMA_ADDR( pucBuffer ) >> 32 );
+        pxRing[ x ].control = ulControl;
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void prvRxIrqEnable( BaseType_t xEnable )
+{
+    uint32_t ulCr = prvRead( AXI_DMA_S2MM + AXI_DMA_CR );
+
+    if( xEnable != pdFALSE )
+    {
+        ulCr |= AXI_DMA_CR_IOC_IRQ_EN | AXI_DMA_CR_DLY_IRQ_EN;
+    }
+    else
+    {
+        ulCr &= ~( AXI_DMA_CR_IOC_IRQ_EN | AXI_DMA_CR_DLY_IRQ_EN );
+    }
+
+    prvWrite( AXI_DMA_S2MM + AXI_DMA_CR, ulCr );
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvRxPending( void )
+{
+    return ( xRxRing[ uxRxHead ].status & AXI_DMA_BD_STS_CMPLT ) ? pdTRUE : pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+static void prvDeliver( const uint8_t * pucFrame,
+                        size_t uxLength )
+{
+    NetworkBufferDescriptor_t * pxBuffer;
+    IPStackEvent_t xRxEvent;
+
+    if( eConsiderFrameForProcessing( pucFrame ) != eProcessBuffer )
+    {
+        return;
+    }
+
+    pxBuffer = pxGetNetworkBufferWithDescriptor( uxLength, 0 );
+
+    if( pxBuffer == NULL )
+    {
+        xStats.ulRxDropped++;
+        iptraceETHERNET_RX_EVENT_LOST();
+        return;
+    }
+
+    memcpy( pxBuffer->pucEthernetBuffer, pucFrame, uxLength );
+    pxBuffer->xDataLength = uxLength;
+
+    xRxEvent.eEventType = eNetworkRxEvent;
+    xRxEvent.pvData = ( void * ) pxBuffer;
+
+    if( xSendEventStructToIPTask( &xRxEvent, 0 ) == pdFAIL )
+    {
+        vReleaseNetworkBufferAndDescriptor( pxBuffer );
+        xStats.ulRxDropped++;
+        iptraceETHERNET_RX_EVENT_LOST();
+    }
+    else
+    {
+        iptraceNETWORK_INTERFACE_RECEIVE();
+    }
+}
+/*-----------------------------------------------------------*/
+
+static UBaseType_t prvRxPoll( UBaseType_t uxBudget )
+{
+    UBaseType_t uxDone = 0;
+    struct axi_dma_bd * pxLast = NULL;
+
+    while( ( uxDone < uxBudget ) && ( prvRxPending() != pdFALSE ) )
+    {
+        struct axi_dma_bd * pxBd = &xRxRing[ uxRxHead ];
+        uint32_t ulStatus = pxBd->status;
+        size_t uxLength = ulStatus & AXI_DMA_BD_LEN_MASK;
+
+        gfeethBARRIER();
+
+        if( ( ulStatus & AXI_DMA_BD_STS_ERR_MASK ) ||
+            ( ( ulStatus & ( AXI_DMA_BD_STS_SOF | AXI_DMA_BD_STS_EOF ) ) != ( AXI_DMA_BD_STS_SOF | AXI_DMA_BD_STS_EOF ) ) ||
+            ( uxLength > ipTOTAL_ETHERNET_FRAME_SIZE ) )
+        {
+            xStats.ulRxDropped++;
+        }
+        else
+        {
+            xStats.ulRxFrames++;
+            prvDeliver( ucRxBuffers[ uxRxHead ], uxLength );
+        }
+
+        /* Hand the descriptor back */
+        pxBd->status = 0;
+        pxBd->control = gfeethBUF_SIZE;
+        pxLast = pxBd;
+
+        uxRxHead = ( uxRxHead + 1 ) % configGFE_ETH_RX_RING;
+        uxDone++;
+    }
+
+    if( pxLast != NULL )
+    {
+        gfeethBARRIER();
+        prvWriteDesc( AXI_DMA_S2MM, AXI_DMA_TAILDESC, pxLast );
+    }
+
+    return uxDone;
+}
+/*-----------------------------------------------------------*/
+
+static void prvTxReclaim( void )
+{
+    UBaseType_t uxFreed = 0;
+
+    while( ( uxTxFree < configGFE_ETH_TX_RING ) &&
+           ( xTxRing[ uxTxClean ].status & AXI_DMA_BD_STS_CMPLT ) )
+    {
+        xTxRing[ uxTxClean ].status = 0;
+        uxTxClean = ( uxTxClean + 1 ) % configGFE_ETH_TX_RING;
+        uxTxFree++;
+        uxFreed++;
+    }
+
+    if( uxFreed != 0 )
+    {
+        xStats.ulTxReclaims++;
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void prvGfeEthTask( void * pvParameters )
+{
+    ( void ) pvParameters;
+
+    for( ; ; )
+    {
+        ( void ) ulTaskNotifyTake( pdTRUE, pdMS_TO_TICKS( configGFE_ETH_TX_RECLAIM_MS ) );
+
+        for( ; ; )
+        {
+            UBaseType_t uxDone = prvRxPoll( configGFE_ETH_NAPI_BUDGET );
+
+            if( xSemaphoreTake( xTxLock, 0 ) == pdPASS )
+            {
+                prvTxReclaim();
+                xSemaphoreGive( xTxLock );
+            }
+
+            if( uxDone == configGFE_ETH_NAPI_BUDGET )
+            {
+                /* Under load: stay in polling mode, interrupts stay masked */
+                xStats.ulBudgetPolls++;
+                taskYIELD();
+                continue;
+            }
+
+            prvRxIrqEnable( pdTRUE );
+
+            /* Catch a frame that completed before the interrupt was unmasked
+             * but after the ring was last checked */
+            if( prvRxPending() == pdFALSE )
+            {
+                break;
+            }
+
+            prvRxIrqEnable( pdFALSE );
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+/* Acknowledge and mask the S2MM interrupt, the task to wake or NULL */
+static TaskHandle_t prvS2mmInterrupt( void )
+{
+    uint32_t ulStatus = prvRead( AXI_DMA_S2MM + AXI_DMA_SR );
+
+    prvWrite( AXI_DMA_S2MM + AXI_DMA_SR, ulStatus & AXI_DMA_SR_IRQ_MASK );
+    configASSERT( ( ulStatus & AXI_DMA_SR_ERR_IRQ ) == 0 );
+
+    /* Mask until the driver task runs out of work */
+    prvRxIrqEnable( pdFALSE );
+    xStats.ulRxInterrupts++;
+
+    return xDriverTask;
+}
+/*-----------------------------------------------------------*/
+
+/* Acknowledge and disarm the MM2S interrupt, the task to wake or NULL */
+static TaskHandle_t prvMm2sInterrupt( void )
+{
+    uint32_t ulStatus = prvRead( AXI_DMA_MM2S + AXI_DMA_SR );
+
+    prvWrite( AXI_DMA_MM2S + AXI_DMA_SR, ulStatus & AXI_DMA_SR_IRQ_MASK );
+    configASSERT( ( ulStatus & AXI_DMA_SR_ERR_IRQ ) == 0 );
+
+    prvWrite( AXI_DMA_MM2S + AXI_DMA_CR, prvRead( AXI_DMA_MM2S + AXI_DMA_CR ) & ~AXI_DMA_CR_IOC_IRQ_EN );
+    xStats.ulTxInterrupts++;
+
+    return xTxWaiter;
+}
+/*-----------------------------------------------------------*/
+
+#if configGFE_ETH_SIM
+    /* Called by the device model from its task */
+    static void prvS2mmSimIrq( void )
+    {
+        TaskHandle_t xTask = prvS2mmInterrupt();
+
+        if( xTask != NULL )
+        {
+            xTaskNotifyGive( xTask );
+        }
+    }
+    /*-----------------------------------------------------------*/
+
+    static void prvMm2sSimIrq( void )
+    {
+        TaskHandle_t xTask = prvMm2sInterrupt();
+
+        if( xTask != NULL )
+        {
+            xTaskNotifyGive( xTask );
+        }
+    }
+#else /* if configGFE_ETH_SIM */
+    static BaseType_t prvS2mmInterruptHandler( void * pvRef )
+    {
+        BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+        TaskHandle_t xTask = prvS2mmInterrupt();
+
+        ( void ) pvRef;
+
+        if( xTask != NULL )
+        {
+            vTaskNotifyGiveFromISR( xTask, &xHigherPriorityTaskWoken );
+        }
+
+        return xHigherPriorityTaskWoken;
+    }
+    /*-----------------------------------------------------------*/
+
+    static BaseType_t prvMm2sInterruptHandler( void * pvRef )
+    {
+        BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+        TaskHandle_t xTask = prvMm2sInterrupt();
+
+        ( void ) pvRef;
+
+        if( xTask != NULL )
+        {
+            vTaskNotifyGiveFromISR( xTask, &xHigherPriorityTaskWoken );
+        }
+
+        return xHigherPriorityTaskWoken;
+    }
+#endif /* if configGFE_ETH_SIM */
+/*-----------------------------------------------------------*/
+
+#if !configGFE_ETH_SIM
+    static BaseType_t prvMacInit( void )
+    {
+        XAxiEthernet_Config * pxConfig = XAxiEthernet_LookupConfig( XPAR_AXIETHERNET_0_DEVICE_ID );
+
+        if( ( pxConfig == NULL ) ||
+            ( XAxiEthernet_CfgInitialize( &xAxiEthernet, pxConfig, pxConfig->BaseAddress ) != XST_SUCCESS ) )
+        {
+            return pdFAIL;
+        }
+
+        XAxiEthernet_SetMacAddress( &xAxiEthernet, ( void * ) ipLOCAL_MAC_ADDRESS );
+        XAxiEthernet_SetOptions( &xAxiEthernet, XAE_RECEIVER_ENABLE_OPTION | XAE_TRANSMITTER_ENABLE_OPTION |
+                                 XAE_BROADCAST_OPTION | XAE_FCS_STRIP_OPTION );
+        XAxiEthernet_Start( &xAxiEthernet );
+
+        return pdPASS;
+    }
+#endif /* !configGFE_ETH_SIM */
+/*-----------------------------------------------------------*/
+
+BaseType_t xNetworkInterfaceInitialise( void )
+{
+    if( xInitialised != pdFALSE )
+    {
+        return pdPASS;
+    }
+
+    #if configGFE_ETH_SIM
+        vGfeEthSimInit( prvMm2sSimIrq, prvS2mmSimIrq );
+    #else
+        #ifdef __CHERI_PURE_CAPABILITY__
+            pulAxiDma = ( volatile uint32_t * ) cheri_build_data_cap( ( ptraddr_t ) XPAR_AXIDMA_0_BASEADDR,
+                                                                      XPAR_AXIDMA_0_SIZE,
+                                                                      __CHERI_CAP_PERMISSION_PERMIT_LOAD__ |
+                                                                      __CHERI_CAP_PERMISSION_PERMIT_STORE__ );
+        #else
+            pulAxiDma = ( volatile uint32_t * ) XPAR_AXIDMA_0_BASEADDR;
+        #endif /* __CHERI_PURE_CAPABILITY__ */
+    #endif /* configGFE_ETH_SIM */
+
+    /* Resetting one channel resets the whole engine */
+    prvWrite( AXI_DMA_MM2S + AXI_DMA_CR, AXI_DMA_CR_RESET );
+
+    while( prvRead( AXI_DMA_MM2S + AXI_DMA_CR ) & AXI_DMA_CR_RESET )
+    {
+    }
+
+    prvInitRing( xRxRing, configGFE_ETH_RX_RING, &ucRxBuffers[ 0 ][ 0 ], gfeethBUF_SIZE );
+    prvInitRing( xTxRing, configGFE_ETH_TX_RING, &ucTxBuffers[ 0 ][ 0 ], 0 );
+    uxRxHead = 0;
+    uxTxHead = 0;
+    uxTxClean = 0;
+    uxTxFree = configGFE_ETH_TX_RING;
+
+    xTxLock = xSemaphoreCreateMutex();
+    configASSERT( xTxLock != NULL );
+
+    if( xTaskCreate( prvGfeEthTask, "GfeEth", configMINIMAL_STACK_SIZE * 4, NULL,
+                     configGFE_ETH_TASK_PRIORITY, &xDriverTask ) != pdPASS )
+    {
+        return pdFAIL;
+    }
+
+    #if !configGFE_ETH_SIM
+        if( prvMacInit() != pdPASS )
+        {
+            FreeRTOS_printf( ( "gfe-eth: AXI Ethernet init failed\n" ) );
+            return pdFAIL;
+        }
+
+        configASSERT( PLIC_register_interrupt_handler( &Plic, PLIC_SOURCE_DMA_S2MM, prvS2mmInterruptHandler, NULL ) != 0 );
+        configASSERT( PLIC_register_interrupt_handler( &Plic, PLIC_SOURCE_DMA_MM2S, prvMm2sInterruptHandler, NULL ) != 0 );
+    #endif
+
+    /* TX: no completion interrupts, see prvTxReclaim() */
+    prvWriteDesc( AXI_DMA_MM2S, AXI_DMA_CURDESC, &xTxRing[ 0 ] );
+    prvWrite( AXI_DMA_MM2S + AXI_DMA_CR, AXI_DMA_CR_RS | AXI_DMA_CR_ERR_IRQ_EN |
+              ( 1U << AXI_DMA_CR_THRESHOLD_SHIFT ) );
+
+    /* RX: the whole ring is handed to the engine */
+    prvWriteDesc( AXI_DMA_S2MM, AXI_DMA_CURDESC, &xRxRing[ 0 ] );
+    prvWrite( AXI_DMA_S2MM + AXI_DMA_CR, AXI_DMA_CR_RS | AXI_DMA_CR_IRQ_MASK |
+              ( ( uint32_t ) configGFE_ETH_RX_COALESCE << AXI_DMA_CR_THRESHOLD_SHIFT ) |
+              ( ( uint32_t ) configGFE_ETH_RX_DELAY << AXI_DMA_CR_DELAY_SHIFT ) );
+    prvWriteDesc( AXI_DMA_S2MM, AXI_DMA_TAILDESC, &xRxRing[ configGFE_ETH_RX_RING - 1 ] );
+
+    xInitialised = pdTRUE;
+
+    return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xNetworkInterfaceOutput( NetworkBufferDescriptor_t * const pxNetworkBuffer,
+                                    BaseType_t xReleaseAfterSend )
+{
+    struct axi_dma_bd * pxBd;
+    TickType_t xStart;
+    BaseType_t xReturn = pdFAIL;
+
+    if( ( xInitialised == pdFALSE ) || ( pxNetworkBuffer->xDataLength > gfeethBUF_SIZE ) )
+    {
+        goto out;
+    }
+
+    xSemaphoreTake( xTxLock, portMAX_DELAY );
+
+    prvTxReclaim();
+
+    if( uxTxFree == 0 )
+    {
+        xStats.ulTxRingFull++;
+        xStart = xTaskGetTickCount();
+        xTxWaiter = xTaskGetCurrentTaskHandle();
+
+        while( uxTxFree == 0 )
+        {
+            if( ( xTaskGetTickCount() - xStart ) >= pdMS_TO_TICKS( gfeethTX_WAIT_MS ) )
+            {
+                break;
+            }
+
+            /* Arm the MM2S interrupt for the next completion and wait for it */
+            iptraceWAITING_FOR_TX_DMA_DESCRIPTOR();
+            prvWrite( AXI_DMA_MM2S + AXI_DMA_CR, prvRead( AXI_DMA_MM2S + AXI_DMA_CR ) | AXI_DMA_CR_IOC_IRQ_EN );
+            ( void ) ulTaskNotifyTake( pdTRUE, 1 );
+            prvTxReclaim();
+        }
+
+        xTxWaiter = NULL;
+    }
+
+    if( uxTxFree != 0 )
+    {
+        pxBd = &xTxRing[ uxTxHead ];
+
+        memcpy( ucTxBuffers[ uxTxHead ], pxNetworkBuffer->pucEthernetBuffer, pxNetworkBuffer->xDataLength );
+        memset( pxBd->app, 0, sizeof( pxBd->app ) ); /* No TX checksum offload */
+        pxBd->status = 0;
+        pxBd->control = AXI_DMA_BD_CTRL_SOF | AXI_DMA_BD_CTRL_EOF | ( uint32_t ) pxNetworkBuffer->xDataLength;
+
+        gfeethBARRIER();
+        prvWriteDesc( AXI_DMA_MM2S, AXI_DMA_TAILDESC, pxBd );
+
+        uxTxHead = ( uxTxHead + 1 ) % configGFE_ETH_TX_RING;
+        uxTxFree--;
+        xStats.ulTxFrames++;
+        xReturn = pdPASS;
+
+        iptraceNETWORK_INTERFACE_TRANSMIT();
+    }
+
+    xSemaphoreGive( xTxLock );
+
+out:
+
+    if( xReleaseAfterSend != pdFALSE )
+    {
+        vReleaseNetworkBufferAndDescriptor( pxNetworkBuffer );
+    }
+
+    return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xGetPhyLinkStatus( void )
+{
+    return pdTRUE;
+}
+/*-----------------------------------------------------------*/
+
+void vGfeEthGetStats( GfeEthStats_t * pxStats )
+{
+    taskENTER_CRITICAL();
+    {
+        *pxStats = xStats;
+    }
+    taskEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,53 @@
+/**
+ * Ring-based AXI DMA/AXI Ethernet NetworkInterface for GFE (bsp/gfe_eth.c),
+ * and the software device model it can run against on QEMU
+ * (bsp/gfe_eth_sim.c, configGFE_ETH_SIM).
+ */
+#ifndef GFE_ETH_H
+#define GFE_ETH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "FreeRTOS.h"
+#include "plic_driver.h"
+
+typedef struct GFE_ETH_STATS
+{
+    uint32_t ulRxInterrupts;  /* S2MM interrupts taken */
+    uint32_t ulTxInterrupts;  /* MM2S interrupts taken (only armed when the TX ring is full) */
+    uint32_t ulBudgetPolls;   /* Poll rounds that used up the budget and stayed in polling mode */
+    uint32_t ulRxFrames;
+    uint32_t ulRxDropped;     /* DMA errors, truncated frames, no network buffer */
+    uint32_t ulTxFrames;
+    uint32_t ulTxReclaims;    /* Reclaim passes that freed at least one descriptor */
+    uint32_t ulTxRingFull;
+} GfeEthStats_t;
+
+void vGfeEthGetStats( GfeEthStats_t * pxStats );
+
+#if configGFE_ETH_SIM
+
+/*
+ * Device model: register accesses of the driver are routed here instead of
+ * to MMIO. There is no interrupt line to raise, so the model task calls these
+ * task-level counterparts of the driver's two DMA interrupt handlers instead,
+ * outside any critical section.
+ */
+    typedef void ( * GfeEthSimIrq_t )( void );
+
+    void vGfeEthSimInit( GfeEthSimIrq_t pxMm2sIrq,
+                         GfeEthSimIrq_t pxS2mmIrq );
+    uint32_t ulGfeEthSimRead( uint32_t ulOffset );
+    void vGfeEthSimWrite( uint32_t ulOffset,
+                          uint32_t ulValue );
+
+/*
+ * Queue a frame on the simulated wire. Returns pdFAIL when the model's RX
+ * FIFO is full and the frame is dropped, as a real MAC would.
+ */
+    BaseType_t xGfeEthSimInject( const uint8_t * pucFrame,
+                                 size_t uxLength );
+
+#endif /* configGFE_ETH_SIM */
+
+#endif /* GFE_ETH_H */
@@ -0,0 +1,625 @@
+/*
+ * Software model of the GFE AXI DMA + AXI Ethernet pair, for running the
+ * ring driver (gfe_eth.c) without an FPGA (configGFE_ETH_SIM).
+ *
+ * The model implements the parts of PG021 the driver relies on: per channel
+ * DMACR/DMASR with write 1 to clear interrupt bits, CURDESC/TAILDESC with the
+ * engine going idle after completing the tail descriptor, descriptor status
+ * write-back, and IOC threshold/delay interrupt coalescing. A model task plays
+ * the engine: it runs when the driver rings a TAILDESC doorbell and on every
+ * tick, consumes MM2S descriptors (the frames are counted and, optionally,
+ * looped back) and fills S2MM descriptors from a small wire FIFO that
+ * xGfeEthSimInject() and the load generator feed. Asserted interrupts are
+ * delivered by calling the driver's task-level entry points once the model
+ * state has been released.
+ *
+ * The load generator (--gfe-eth-sim-load=<bursts>, off by default) floods the
+ * stack with UDP datagrams in bursts and prints the driver statistics
+ * afterwards, which shows how many interrupts the NAPI scheme took for the
+ * frames it moved.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "FreeRTOS_IP.h"
+#include "FreeRTOS_IP_Private.h"
+
+#include "bsp.h"
+#include "axi_dma.h"
+#include "gfe_eth.h"
+
+#ifdef __CHERI_PURE_CAPABILITY__
+    #include <cheri/cheri-utility.h>
+#endif /* __CHERI_PURE_CAPABILITY__ */
+
+#ifndef configGFE_ETH_SIM_FIFO_DEPTH
+    #define configGFE_ETH_SIM_FIFO_DEPTH    64
+#endif
+
+/* Frames sent by the driver are fed back to it */
+#ifndef configGFE_ETH_SIM_LOOPBACK
+    #define configGFE_ETH_SIM_LOOPBACK    0
+#endif
+
+/* Load generator: configGFE_ETH_SIM_LOAD_BURSTS bursts of
+ * configGFE_ETH_SIM_LOAD_BURST datagrams, one burst per tick, 0 for none */
+#ifndef configGFE_ETH_SIM_LOAD_BURSTS
+    #define configGFE_ETH_SIM_LOAD_BURSTS    0
+#endif
+
+#ifndef configGFE_ETH_SIM_LOAD_BURST
+    #define configGFE_ETH_SIM_LOAD_BURST    32
+#endif
+
+#ifndef configGFE_ETH_SIM_LOAD_PORT
+    #define configGFE_ETH_SIM_LOAD_PORT    5001
+#endif
+
+#define gfesimFRAME_SIZE    ipTOTAL_ETHERNET_FRAME_SIZE
+#define gfesimLOAD_PAYLOAD  64
+
+typedef struct GFE_SIM_CHANNEL
+{
+    uint32_t ulCr;
+    uint32_t ulSr;
+    uint64_t ullCurDesc;
+    uint64_t ullTailDesc;
+    BaseType_t xIdle;         /* Completed the tail descriptor */
+    uint32_t ulCompletions;   /* Since the last IOC interrupt */
+    uint32_t ulIdleTicks;     /* Ticks with completions pending and no new ones */
+    GfeEthSimIrq_t pxIrq;
+} GfeSimChannel_t;
+
+typedef struct GFE_SIM_FRAME
+{
+    size_t uxLength;
+    uint8_t ucData[ gfesimFRAME_SIZE ];
+} GfeSimFrame_t;
+
+static GfeSimChannel_t xChannels[ 2 ]; /* MM2S, S2MM */
+static GfeSimFrame_t xFifo[ configGFE_ETH_SIM_FIFO_DEPTH ];
+static UBaseType_t uxFifoHead;
+static UBaseType_t uxFifoCount;
+static uint32_t ulWireTxFrames;
+static uint32_t ulWireRxDropped;
+static TaskHandle_t xSimTask = NULL;
+
+extern uint64_t get_cycle_count( void );
+/*-----------------------------------------------------------*/
+
+static GfeSimChannel_t * prvChannel( uint32_t ulOffset )
+{
+    return &xChannels[ ( ulOffset >= AXI_DMA_S2MM ) ? 1 : 0 ];
+}
+/*-----------------------------------------------------------*/
+
+static struct axi_dma_bd * prvBd( uint64_t ullAddress )
+{
+    #ifdef __CHERI_PURE_CAPABILITY__
+        return ( struct axi_dma_bd * ) cheri_build_data_cap( ( ptraddr_t ) ullAddress, sizeof( struct axi_dma_bd ),
+                                                             __CHERI_CAP_PERMISSION_PERMIT_LOAD__ |
+                                                             __CHERI_CAP_PERMISSION_PERMIT_STORE__ );
+    #else
+        return ( struct axi_dma_bd * ) ( uintptr_t ) ullAddress;
+    #endif
+}
+/*-----------------------------------------------------------*/
+
+static uint8_t * prvBuffer( const struct axi_dma_bd * pxBd,
+                            size_t uxLength )
+{
+    uint64_t ullAddress = ( ( uint64_t ) pxBd->buf_msb << 32 ) | pxBd->buf;
+
+    #ifdef __CHERI_PURE_CAPABILITY__
+        return ( uint8_t * ) cheri_build_data_cap( ( ptraddr_t ) ullAddress, uxLength,
+                                                   __CHERI_CAP_PERMISSION_PERMIT_LOAD__ |
+                                                   __CHERI_CAP_PERMISSION_PERMIT_STORE__ );
+    #else
+        ( void ) uxLength;
+        return ( uint8_t * ) ( uintptr_t ) ullAddress;
+    #endif
+}
+/*-----------------------------------------------------------*/
+
+static void prvReset( void )
+{
+    for( int i = 0; i < 2; i++ )
+    {
+        GfeEthSimIrq_t pxIrq = xChannels[ i ].pxIrq;
+
+        memset( &xChannels[ i ], 0, sizeof( xChannels[ i ] ) );
+        xChannels[ i ].pxIrq = pxIrq;
+        xChannels[ i ].ulSr = AXI_DMA_SR_HALTED;
+        xChannels[ i ].xIdle = pdTRUE; /* Nothing to fetch until TAILDESC is written */
+        xChannels[ i ].ulCr = 1U << AXI_DMA_CR_THRESHOLD_SHIFT;
+    }
+}
+/*-----------------------------------------------------------*/
+
+uint32_t ulGfeEthSimRead( uint32_t ulOffset )
+{
+    GfeSimChannel_t * pxChannel = prvChannel( ulOffset );
+    uint32_t ulValue = 0;
+
+    taskENTER_CRITICAL();
+    {
+        switch( ulOffset % AXI_DMA_S2MM )
+        {
+            case AXI_DMA_CR:
+                ulValue = pxChannel->ulCr;
+                break;
+
+            case AXI_DMA_SR:
+                ulValue = pxChannel->ulSr;
+                break;
+
+            case AXI_DMA_CURDESC:
+                ulValue = ( uint32_t ) pxChannel->ullCurDesc;
+                break;
+
+            case AXI_DMA_CURDESC_MSB:
+                ulValue = ( uint32_t ) ( pxChannel->ullCurDesc >> 32 );
+                break;
+
+            case AXI_DMA_TAILDESC:
+                ulValue = ( uint32_t ) pxChannel->ullTailDesc;
+                break;
+
+            case AXI_DMA_TAILDESC_MSB:
+                ulValue = ( uint32_t ) ( pxChannel->ullTailDesc >> 32 );
+                break;
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    return ulValue;
+}
+/*-----------------------------------------------------------*/
+
+void vGfeEthSimWrite( uint32_t ulOffset,
+                      uint32_t ulValue )
+{
+    GfeSimChannel_t * pxChannel = prvChannel( ulOffset );
+    BaseType_t xDoorbell = pdFALSE;
+
+    taskENTER_CRITICAL();
+    {
+        switch( ulOffset % AXI_DMA_S2MM )
+        {
+            case AXI_DMA_CR:
+
+                if( ulValue & AXI_DMA_CR_RESET )
+                {
+                    /* Completes immediately, RESET reads back as 0 */
+                    prvReset();
+                    break;
+                }
+
+                pxChannel->ulCr = ulValue;
+
+                if( ulValue & AXI_DMA_CR_RS )
+                {
+                    pxChannel->ulSr &= ~AXI_DMA_SR_HALTED;
+                }
+                else
+                {
+                    pxChannel->ulSr |= AXI_DMA_SR_HALTED;
+                }
+
+                break;
+
+            case AXI_DMA_SR:
+                pxChannel->ulSr &= ~( ulValue & AXI_DMA_SR_IRQ_MASK );
+                break;
+
+            case AXI_DMA_CURDESC:
+
+                /* Only writable while halted */
+                if( pxChannel->ulSr & AXI_DMA_SR_HALTED )
+                {
+                    pxChannel->ullCurDesc = ( pxChannel->ullCurDesc & ~0xffffffffULL ) | ulValue;
+                }
+
+                break;
+
+            case AXI_DMA_CURDESC_MSB:
+
+                if( pxChannel->ulSr & AXI_DMA_SR_HALTED )
+                {
+                    pxChannel->ullCurDesc = ( pxChannel->ullCurDesc & 0xffffffffULL ) | ( ( uint64_t ) ulValue << 32 );
+                }
+
+                break;
+
+            case AXI_DMA_TAILDESC:
+                pxChannel->ullTailDesc = ( pxChannel->ullTailDesc & ~0xffffffffULL ) | ulValue;
+                pxChannel->xIdle = pdFALSE;
+                pxChannel->ulSr &= ~AXI_DMA_SR_IDLE;
+                xDoorbell = pdTRUE;
+                break;
+
+            case AXI_DMA_TAILDESC_MSB:
+                pxChannel->ullTailDesc = ( pxChannel->ullTailDesc & 0xffffffffULL ) | ( ( uint64_t ) ulValue << 32 );
+                break;
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    if( ( xDoorbell != pdFALSE ) && ( xSimTask != NULL ) )
+    {
+        xTaskNotifyGive( xSimTask );
+    }
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xGfeEthSimInject( const uint8_t * pucFrame,
+                             size_t uxLength )
+{
+    BaseType_t xReturn = pdFAIL;
+
+    if( uxLength > gfesimFRAME_SIZE )
+    {
+        return pdFAIL;
+    }
+
+    taskENTER_CRITICAL();
+    {
+        if( uxFifoCount < configGFE_ETH_SIM_FIFO_DEPTH )
+        {
+            GfeSimFrame_t * pxFrame = &xFifo[ ( uxFifoHead + uxFifoCount ) % configGFE_ETH_SIM_FIFO_DEPTH ];
+
+            memcpy( pxFrame->ucData, pucFrame, uxLength );
+            pxFrame->uxLength = uxLength;
+            uxFifoCount++;
+            xReturn = pdPASS;
+        }
+        else
+        {
+            ulWireRxDropped++;
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    if( ( xReturn == pdPASS ) && ( xSimTask != NULL ) )
+    {
+        xTaskNotifyGive( xSimTask );
+    }
+
+    return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * The descriptor at CURDESC, or NULL when the channel is halted, idle, or the
+ * descriptor has not been handed back yet (still marked complete).
+ */
+static struct axi_dma_bd * prvNextBd( GfeSimChannel_t * pxChannel )
+{
+    struct axi_dma_bd * pxBd;
+
+    if( ( pxChannel->ulSr & AXI_DMA_SR_HALTED ) || ( pxChannel->xIdle != pdFALSE ) )
+    {
+        return NULL;
+    }
+
+    pxBd = prvBd( pxChannel->ullCurDesc );
+
+    if( pxBd->status & AXI_DMA_BD_STS_CMPLT )
+    {
+        return NULL;
+    }
+
+    return pxBd;
+}
+/*-----------------------------------------------------------*/
+
+static void prvAdvance( GfeSimChannel_t * pxChannel,
+                        struct axi_dma_bd * pxBd )
+{
+    if( pxChannel->ullCurDesc == pxChannel->ullTailDesc )
+    {
+        pxChannel->xIdle = pdTRUE;
+        pxChannel->ulSr |= AXI_DMA_SR_IDLE;
+    }
+
+    pxChannel->ullCurDesc = ( ( uint64_t ) pxBd->next_msb << 32 ) | pxBd->next;
+    pxChannel->ulCompletions++;
+    pxChannel->ulIdleTicks = 0;
+
+    if( pxChannel->ulCompletions >= ( ( pxChannel->ulCr >> AXI_DMA_CR_THRESHOLD_SHIFT ) & 0xff ) )
+    {
+        pxChannel->ulSr |= AXI_DMA_SR_IOC_IRQ;
+        pxChannel->ulCompletions = 0;
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void prvRunMm2s( void )
+{
+    GfeSimChannel_t * pxChannel = &xChannels[ 0 ];
+    struct axi_dma_bd * pxBd;
+
+    while( ( pxBd = prvNextBd( pxChannel ) ) != NULL )
+    {
+        size_t uxLength = pxBd->control & AXI_DMA_BD_LEN_MASK;
+
+        #if configGFE_ETH_SIM_LOOPBACK
+            if( uxFifoCount < configGFE_ETH_SIM_FIFO_DEPTH )
+            {
+                GfeSimFrame_t * pxFrame = &xFifo[ ( uxFifoHead + uxFifoCount ) % configGFE_ETH_SIM_FIFO_DEPTH ];
+
+                memcpy( pxFrame->ucData, prvBuffer( pxBd, uxLength ), uxLength );
+                pxFrame->uxLength = uxLength;
+                uxFifoCount++;
+            }
+        #endif
+
+        pxBd->status = AXI_DMA_BD_STS_CMPLT | ( uint32_t ) uxLength;
+        ulWireTxFrames++;
+        prvAdvance( pxChannel, pxBd );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void prvRunS2mm( void )
+{
+    GfeSimChannel_t * pxChannel = &xChannels[ 1 ];
+    struct axi_dma_bd * pxBd;
+
+    while( ( uxFifoCount > 0 ) && ( ( pxBd = prvNextBd( pxChannel ) ) != NULL ) )
+    {
+        GfeSimFrame_t * pxFrame = &xFifo[ uxFifoHead ];
+        size_t uxLength = pxFrame->uxLength;
+        uint32_t ulStatus = AXI_DMA_BD_STS_CMPLT | AXI_DMA_BD_STS_SOF | AXI_DMA_BD_STS_EOF;
+
+        if( uxLength > ( pxBd->control & AXI_DMA_BD_LEN_MASK ) )
+        {
+            /* A real engine would spill into the next descriptor; the driver
+             * only posts full size buffers, so treat it as an error */
+            ulStatus |= AXI_DMA_BD_STS_INT_ERR;
+            uxLength = 0;
+        }
+
+        memcpy( prvBuffer( pxBd, uxLength ), pxFrame->ucData, uxLength );
+        __sync_synchronize();
+        pxBd->status = ulStatus | ( uint32_t ) uxLength;
+
+        uxFifoHead = ( uxFifoHead + 1 ) % configGFE_ETH_SIM_FIFO_DEPTH;
+        uxFifoCount--;
+        prvAdvance( pxChannel, pxBd );
+    }
+}
+/*-----------------------------------------------------------*/
+
+/* Whether the channel's interrupt line is asserted */
+static BaseType_t prvRaise( GfeSimChannel_t * pxChannel,
+                            BaseType_t xTick )
+{
+    uint32_t ulDelay = ( pxChannel->ulCr >> AXI_DMA_CR_DELAY_SHIFT ) & 0xff;
+
+    /* Delay timer, one model tick per unit */
+    if( ( xTick != pdFALSE ) && ( ulDelay != 0 ) && ( pxChannel->ulCompletions != 0 ) )
+    {
+        if( ++pxChannel->ulIdleTicks >= ulDelay )
+        {
+            pxChannel->ulSr |= AXI_DMA_SR_DLY_IRQ;
+            pxChannel->ulCompletions = 0;
+            pxChannel->ulIdleTicks = 0;
+        }
+    }
+
+    if( ( pxChannel->pxIrq != NULL ) &&
+        ( pxChannel->ulSr & pxChannel->ulCr & AXI_DMA_SR_IRQ_MASK ) )
+    {
+        return pdTRUE;
+    }
+
+    return pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+static void prvGfeEthSimTask( void * pvParameters )
+{
+    ( void ) pvParameters;
+
+    for( ; ; )
+    {
+        BaseType_t xTick = ( ulTaskNotifyTake( pdTRUE, 1 ) == 0 ) ? pdTRUE : pdFALSE;
+        BaseType_t xRaised[ 2 ];
+
+        /* The model state is shared with the register accessors */
+        taskENTER_CRITICAL();
+        {
+            prvRunMm2s();
+            prvRunS2mm();
+            xRaised[ 0 ] = prvRaise( &xChannels[ 0 ], xTick );
+            xRaised[ 1 ] = prvRaise( &xChannels[ 1 ], xTick );
+        }
+        taskEXIT_CRITICAL();
+
+        /* The handlers go back through the register accessors to acknowledge */
+        for( int i = 0; i < 2; i++ )
+        {
+            if( xRaised[ i ] != pdFALSE )
+            {
+                xChannels[ i ].pxIrq();
+            }
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+#if configGFE_ETH_SIM_LOAD_BURSTS > 0
+    static uint16_t prvChecksum( uint32_t ulSum,
+                                 const uint8_t * pucData,
+                                 size_t uxLength )
+    {
+        for( size_t x = 0; x + 1 < uxLength; x += 2 )
+        {
+            ulSum += ( ( uint32_t ) pucData[ x ] << 8 ) | pucData[ x + 1 ];
+        }
+
+        if( uxLength & 1 )
+        {
+            ulSum += ( uint32_t ) pucData[ uxLength - 1 ] << 8;
+        }
+
+        while( ulSum >> 16 )
+        {
+            ulSum = ( ulSum & 0xffff ) + ( ulSum >> 16 );
+        }
+
+        return ( uint16_t ) ~ulSum;
+    }
+    /*-----------------------------------------------------------*/
+
+    static size_t prvBuildDatagram( uint8_t * pucFrame,
+                                    uint32_t ulSequence )
+    {
+        static const uint8_t ucPeerMac[ 6 ] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+        uint32_t ulLocal = FreeRTOS_ntohl( FreeRTOS_GetIPAddress() );
+        uint32_t ulPeer = ( ulLocal & 0xffffff00 ) | ( ( ( ulLocal & 0xff ) == 1 ) ? 2 : 1 );
+        uint8_t * pucIp = &pucFrame[ 14 ];
+        uint8_t * pucUdp = &pucIp[ 20 ];
+        size_t uxUdpLength = 8 + gfesimLOAD_PAYLOAD;
+        uint32_t ulSum;
+        uint16_t usCheck;
+
+        memset( pucFrame, 0, 14 + 20 + uxUdpLength );
+
+        /* Ethernet */
+        memcpy( &pucFrame[ 0 ], ipLOCAL_MAC_ADDRESS, 6 );
+        memcpy( &pucFrame[ 6 ], ucPeerMac, 6 );
+        pucFrame[ 12 ] = 0x08;
+
+        /* IPv4 */
+        pucIp[ 0 ] = 0x45;
+        pucIp[ 2 ] = ( uint8_t ) ( ( 20 + uxUdpLength ) >> 8 );
+        pucIp[ 3 ] = ( uint8_t ) ( 20 + uxUdpLength );
+        pucIp[ 4 ] = ( uint8_t ) ( ulSequence >> 8 );
+        pucIp[ 5 ] = ( uint8_t ) ulSequence;
+        pucIp[ 8 ] = 64;
+        pucIp[ 9 ] = ipPROTOCOL_UDP;
+
+        for( int i = 0; i < 4; i++ )
+        {
+            pucIp[ 12 + i ] = ( uint8_t ) ( ulPeer >> ( 24 - 8 * i ) );
+            pucIp[ 16 + i ] = ( uint8_t ) ( ulLocal >> ( 24 - 8 * i ) );
+        }
+
+        usCheck = prvChecksum( 0, pucIp, 20 );
+        pucIp[ 10 ] = ( uint8_t ) ( usCheck >> 8 );
+        pucIp[ 11 ] = ( uint8_t ) usCheck;
+
+        /* UDP */
+        pucUdp[ 0 ] = ( uint8_t ) ( configGFE_ETH_SIM_LOAD_PORT >> 8 );
+        pucUdp[ 1 ] = ( uint8_t ) configGFE_ETH_SIM_LOAD_PORT;
+        pucUdp[ 2 ] = ( uint8_t ) ( configGFE_ETH_SIM_LOAD_PORT >> 8 );
+        pucUdp[ 3 ] = ( uint8_t ) configGFE_ETH_SIM_LOAD_PORT;
+        pucUdp[ 4 ] = ( uint8_t ) ( uxUdpLength >> 8 );
+        pucUdp[ 5 ] = ( uint8_t ) uxUdpLength;
+        memcpy( &pucUdp[ 8 ], &ulSequence, sizeof( ulSequence ) );
+
+        ulSum = ( ulPeer >> 16 ) + ( ulPeer & 0xffff ) + ( ulLocal >> 16 ) + ( ulLocal & 0xffff ) +
+                ipPROTOCOL_UDP + ( uint32_t ) uxUdpLength;
+        usCheck = prvChecksum( ulSum, pucUdp, uxUdpLength );
+
+        if( usCheck == 0 )
+        {
+            usCheck = 0xffff;
+        }
+
+        pucUdp[ 6 ] = ( uint8_t ) ( usCheck >> 8 );
+        pucUdp[ 7 ] = ( uint8_t ) usCheck;
+
+        return 14 + 20 + uxUdpLength;
+    }
+    /*-----------------------------------------------------------*/
+
+    static void prvGfeEthLoadTask( void * pvParameters )
+    {
+        static uint8_t ucFrame[ gfesimFRAME_SIZE ];
+        GfeEthStats_t xStats;
+        uint32_t ulInjected = 0;
+        uint64_t ullStart;
+        uint64_t ullCycles;
+
+        ( void ) pvParameters;
+
+        while( FreeRTOS_IsNetworkUp() == pdFALSE )
+        {
+            vTaskDelay( pdMS_TO_TICKS( 100 ) );
+        }
+
+        /* Let DHCP/ARP traffic settle so it does not skew the counters */
+        vTaskDelay( pdMS_TO_TICKS( 1000 ) );
+
+        ullStart = get_cycle_count();
+
+        for( uint32_t ulBurst = 0; ulBurst < configGFE_ETH_SIM_LOAD_BURSTS; ulBurst++ )
+        {
+            for( uint32_t x = 0; x < configGFE_ETH_SIM_LOAD_BURST; x++ )
+            {
+                size_t uxLength = prvBuildDatagram( ucFrame, ulInjected );
+
+                if( xGfeEthSimInject( ucFrame, uxLength ) == pdPASS )
+                {
+                    ulInjected++;
+                }
+            }
+
+            vTaskDelay( 1 );
+        }
+
+        /* Give the driver time to drain the ring */
+        vTaskDelay( pdMS_TO_TICKS( 100 ) );
+        ullCycles = get_cycle_count() - ullStart;
+
+        vGfeEthGetStats( &xStats );
+
+        printf( "gfe-eth injected: %" PRIu32 "\n", ulInjected );
+        printf( "gfe-eth wire dropped: %" PRIu32 "\n", ulWireRxDropped );
+        printf( "gfe-eth rx frames: %" PRIu32 "\n", xStats.ulRxFrames );
+        printf( "gfe-eth rx dropped: %" PRIu32 "\n", xStats.ulRxDropped );
+        printf( "gfe-eth rx interrupts: %" PRIu32 "\n", xStats.ulRxInterrupts );
+        printf( "gfe-eth budget polls: %" PRIu32 "\n", xStats.ulBudgetPolls );
+        printf( "gfe-eth tx frames: %" PRIu32 " (wire %" PRIu32 ")\n", xStats.ulTxFrames, ulWireTxFrames );
+        printf( "gfe-eth tx reclaims: %" PRIu32 "\n", xStats.ulTxReclaims );
+        printf( "gfe-eth tx interrupts: %" PRIu32 "\n", xStats.ulTxInterrupts );
+        printf( "gfe-eth tx ring full: %" PRIu32 "\n", xStats.ulTxRingFull );
+        printf( "gfe-eth cycles: %" PRIu64 "\n", ullCycles );
+
+        vTaskDelete( NULL );
+    }
+#endif /* configGFE_ETH_SIM_LOAD_BURSTS > 0 */
+/*-----------------------------------------------------------*/
+
+void vGfeEthSimInit( GfeEthSimIrq_t pxMm2sIrq,
+                     GfeEthSimIrq_t pxS2mmIrq )
+{
+    BaseType_t xCreated;
+
+    prvReset();
+    xChannels[ 0 ].pxIrq = pxMm2sIrq;
+    xChannels[ 1 ].pxIrq = pxS2mmIrq;
+
+    /* Above the driver and IP tasks, like hardware would be */
+    xCreated = xTaskCreate( prvGfeEthSimTask, "GfeEthSim", configMINIMAL_STACK_SIZE * 2, NULL,
+                            configMAX_PRIORITIES - 1, &xSimTask );
+    configASSERT( xCreated == pdPASS );
+
+    #if configGFE_ETH_SIM_LOAD_BURSTS > 0
+        xCreated = xTaskCreate( prvGfeEthLoadTask, "GfeEthLoad", configMINIMAL_STACK_SIZE * 2, NULL,
+                                tskIDLE_PRIORITY + 1, NULL );
+        configASSERT( xCreated == pdPASS );
+    #endif
+
+    ( void ) xCreated;
+}
+/*-----------------------------------------------------------*/
@@ -1,6 +1,5 @@
 #include "iic.h"
 #include "xiic.h"
-#include "semphr.h"
 #include <stdio.h>
 
 /*****************************************************************************/
@@ -14,6 +13,10 @@ static void iic_stop(struct IicDriver *Iic, uint8_t plic_source_id);
 int iic_transmit(struct IicDriver *Iic, uint8_t addr, uint8_t *tx_data, uint8_t tx_len);
 int iic_receive(struct IicDriver *Iic, uint8_t addr, uint8_t *rx_data, uint8_t rx_len);
 
+static int iic_start(struct iic_bus *bus, struct iic_transaction *trans);
+static void iic_abort(struct iic_bus *bus);
+static BaseType_t iic_interrupt_handler(void *CallbackRef);
+
 static void RecvHandler(void *CallbackRef, int ByteCount);
 static void SendHandler(void *CallbackRef, int Status);
 static void StatusHandler(void *CallbackRef, int Status);
@@ -23,6 +26,10 @@ static void StatusHandler(void *CallbackRef, int Status);
 
 #define IIC_TRANSACTION_DELAY_MS 500
 
+/* Longest a transaction waits for the bus to be free before it starts,
+ * from interrupt context: a STOP condition at 100 kHz takes about 10 us */
+#define IIC_BUSY_WAIT_US 50
+
 /* Instance of IIC devices */
 #if BSP_USE_IIC0
 XIic XIic0;
@@ -42,7 +49,6 @@ struct IicDriver Iic1;
 __attribute__((unused)) static void iic_init(struct IicDriver *Iic, uint8_t device_id, uint8_t plic_source_id)
 {
     // Initialize struct
-    Iic->mutex = xSemaphoreCreateMutex();
     switch (device_id)
     {
 #if BSP_USE_IIC0
@@ -61,9 +67,9 @@ __attribute__((unused)) static void iic_init(struct IicDriver *Iic, uint8_t devi
         break;
     };
 
-    Iic->task_handle = NULL;
     Iic->TotalErrorCount = 0;
     Iic->Errors = 0;
+    Iic->result = IIC_PENDING;
 
     /* Initialize the XIic driver so that it's ready to use */
     configASSERT(XIic_Initialize(&Iic->Device, device_id) == XST_SUCCESS);
@@ -80,9 +86,10 @@ __attribute__((unused)) static void iic_init(struct IicDriver *Iic, uint8_t devi
     XIic_SetSendHandler(&Iic->Device, Iic, SendHandler);
     XIic_SetStatusHandler(&Iic->Device, Iic, StatusHandler);
 
-    /* Setup interrupt system */
+    /* Setup interrupt system, through iic_interrupt_handler so the next
+     * queued transaction is started once the Xilinx handler is done */
     configASSERT(PLIC_register_interrupt_handler(&Plic, plic_source_id,
-                                                 (XInterruptHandler)XIic_InterruptHandler, &Iic->Device) != 0);
+                                                 iic_interrupt_handler, Iic) != 0);
 
     /*
 	 * Start the IIC driver such that it is ready to send and
@@ -94,8 +101,6 @@ __attribute__((unused)) static void iic_init(struct IicDriver *Iic, uint8_t devi
 
 /**
  * Stop IIC peripheral.
- * TODO: handle mutex better, to avoid re-allocating new mutex every time
- * the peripheral is started
  * NOTE: iic_stop might not help with the BUY_IS_BUSY condition (se XIic_Stop documentation)
  */
 #pragma GCC diagnostic ignored "-Wunused-function"
@@ -106,74 +111,95 @@ static void iic_stop(struct IicDriver *Iic, uint8_t plic_source_id)
 }
 
 /**
- * Transmit data over IIC bus. Synchronous API, this function blocks until the transaction ends.
- * 
- * @param Iic is the device driver
- * @param addr is the address of the slave device
- * @param tx_data is the data buffer
- * @param tx_len is the length of tx_data (and the number of bytes to be sent)
- *
- * @return Either number of transmitted bytes (returnval >= 0), or IIC_ERROR
+ * Put a queued transaction on the bus. Called with interrupts disabled, from
+ * the submitting task or from iic_interrupt_handler.
  */
-int iic_transmit(struct IicDriver *Iic, uint8_t addr, uint8_t *tx_data, uint8_t tx_len)
+static int iic_start(struct iic_bus *bus, struct iic_transaction *trans)
 {
+    struct IicDriver *Iic = (struct IicDriver *)bus->priv;
+    uint64_t start = portGET_RUN_TIME_COUNTER_VALUE();
     int returnval;
-    configASSERT(Iic->mutex != NULL);
-    configASSERT(xSemaphoreTake(Iic->mutex, portMAX_DELAY) == pdTRUE);
-
-    if (XIic_IsIicBusy(&Iic->Device)) {
-        printf("(iic_transmit) Bus is busy!\n");
-        /* Release mutex and return */
-        xSemaphoreGive(Iic->mutex);
-        return IIC_BUS_IS_BUSY;   
+
+    /* Straight after the previous transaction the STOP condition may still be
+     * going out, wait for it rather than fail */
+    while (XIic_IsIicBusy(&Iic->Device)) {
+        if (portGET_RUN_TIME_COUNTER_VALUE() - start > IIC_BUSY_WAIT_US) {
+            return IIC_BUS_IS_BUSY;
+        }
     }
 
-    configASSERT(XIic_SetAddress(&Iic->Device, XII_ADDR_TO_SEND_TYPE, addr) == XST_SUCCESS);
+    if (XIic_SetAddress(&Iic->Device, XII_ADDR_TO_SEND_TYPE, trans->addr) != XST_SUCCESS) {
+        return (trans->direction == IIC_READ) ? IIC_MASTER_RECV_ERROR : IIC_MASTER_SEND_ERROR;
+    }
 
-    Iic->task_handle = xTaskGetCurrentTaskHandle();
-    Iic->trans_len = tx_len;
+    Iic->trans_len = trans->len;
+    Iic->result = IIC_PENDING;
 
-    returnval = XIic_MasterSend(&Iic->Device, tx_data, (int)tx_len);
-    if (returnval != XST_SUCCESS) {
-        printf("(XIic_MasterSend) Error occured: %i\n", returnval);
-        /* Release mutex and return */
-        xSemaphoreGive(Iic->mutex);
-        return IIC_MASTER_SEND_ERROR;
+    if (trans->direction == IIC_READ) {
+        returnval = XIic_MasterRecv(&Iic->Device, trans->data, (int)trans->len);
+        return (returnval == XST_SUCCESS) ? 0 : IIC_MASTER_RECV_ERROR;
     }
 
-    /* wait for notification */
-    if (xTaskNotifyWait(0, 0, NULL, pdMS_TO_TICKS(IIC_TRANSACTION_DELAY_MS)))
-    {
-        /* Check Error value */
-        if (Iic->Errors != 0)
-        {
-            // an error occured
-            printf("(iic_transmit) Error occured: %i\n", Iic->Errors);
-            /* We need to zero the error variable, this is not done in the driver itself */
-            Iic->Errors = 0;
-            returnval = IIC_SLAVE_NO_ACK;
-        }
-        else
-        {
-            /* Transaction succesfull, return number of transmitted bytes */
-            returnval = Iic->trans_len;
-        }
-    }
-    else
+    returnval = XIic_MasterSend(&Iic->Device, trans->data, (int)trans->len);
+    return (returnval == XST_SUCCESS) ? 0 : IIC_MASTER_SEND_ERROR;
+}
+
+/**
+ * A transaction timed out on the bus: reset the device, which also disables
+ * it, and start it again for the next one.
+ */
+static void iic_abort(struct iic_bus *bus)
+{
+    struct IicDriver *Iic = (struct IicDriver *)bus->priv;
+
+    XIic_Reset(&Iic->Device);
+    (void)XIic_Start(&Iic->Device);
+    Iic->Errors = 0;
+    Iic->result = IIC_PENDING;
+}
+
+/**
+ * PLIC handler. The Xilinx handler runs the Recv/Send/Status handlers below,
+ * which only record how the transaction ended; completing it (and so starting
+ * the next one) waits until the Xilinx driver is done with the device.
+ */
+static BaseType_t iic_interrupt_handler(void *CallbackRef)
+{
+    struct IicDriver *Iic = (struct IicDriver *)CallbackRef;
+    BaseType_t askForContextSwitch = pdFALSE;
+    int result;
+
+    XIic_InterruptHandler(&Iic->Device);
+
+    result = Iic->result;
+    if (result != IIC_PENDING)
     {
-        /* timeout occured */
-        printf("(iic_transmit) Resetting device.\n");
-        XIic_Reset(&Iic->Device);
-        returnval = IIC_TIMEOUT;
+        Iic->result = IIC_PENDING;
+        iic_bus_complete_from_isr(&Iic->bus, result, &askForContextSwitch);
     }
 
-    /* Release mutex and return */
-    xSemaphoreGive(Iic->mutex);
-    return returnval;
+    return askForContextSwitch;
+}
+
+/**
+ * Transmit data over IIC bus. Synchronous API, this function blocks until the transaction ends.
+ * Transactions from several tasks are queued, see iic_bus_submit() for the asynchronous API.
+ * 
+ * @param Iic is the device driver
+ * @param addr is the address of the slave device
+ * @param tx_data is the data buffer
+ * @param tx_len is the length of tx_data (and the number of bytes to be sent)
+ *
+ * @return Either number of transmitted bytes (returnval >= 0), or IIC_ERROR
+ */
+int iic_transmit(struct IicDriver *Iic, uint8_t addr, uint8_t *tx_data, uint8_t tx_len)
+{
+    return iic_bus_transfer(&Iic->bus, addr, IIC_WRITE, tx_data, tx_len, pdMS_TO_TICKS(IIC_TRANSACTION_DELAY_MS));
 }
 
 /**
  * Receive data over IIC bus. Synchronous API, this function blocks until the transaction ends.
+ * Transactions from several tasks are queued, see iic_bus_submit() for the asynchronous API.
  * 
  * @param Iic is the device driver
  * @param addr is the address of the slave device
@@ -184,59 +210,7 @@ int iic_transmit(struct IicDriver *Iic, uint8_t addr, uint8_t *tx_data, uint8_t
  */
 int iic_receive(struct IicDriver *Iic, uint8_t addr, uint8_t *rx_data, uint8_t rx_len)
 {
-    int returnval;
-    configASSERT(Iic->mutex != NULL);
-    configASSERT(xSemaphoreTake(Iic->mutex, portMAX_DELAY) == pdTRUE);
-
-    if (XIic_IsIicBusy(&Iic->Device)) {
-        printf("(iic_receive) Bus is busy!\n");
-        /* Release mutex and return */
-        xSemaphoreGive(Iic->mutex);
-        return IIC_BUS_IS_BUSY;   
-    }
-
-    configASSERT(XIic_SetAddress(&Iic->Device, XII_ADDR_TO_SEND_TYPE, addr) == XST_SUCCESS);
-
-    Iic->task_handle = xTaskGetCurrentTaskHandle();
-    Iic->trans_len = rx_len;
-
-    returnval = XIic_MasterRecv(&Iic->Device, rx_data, (int)rx_len);
-    if (returnval != XST_SUCCESS) {
-        printf("(XIic_MasterRecv) Error occured: %i\n", returnval);
-        /* Release mutex and return */
-        xSemaphoreGive(Iic->mutex);
-        return IIC_MASTER_RECV_ERROR;
-    }
-
-    /* wait for notification */
-    if (xTaskNotifyWait(0, 0, NULL, pdMS_TO_TICKS(IIC_TRANSACTION_DELAY_MS)))
-    {
-        /* Check Error value */
-        if (Iic->Errors != 0)
-        {
-            /* an error occured */
-            printf("(iic_receive) Error occured: %i\n", Iic->Errors);
-            /* We need to zero the error variable, this is not done in the driver itself */
-            Iic->Errors = 0;
-            returnval = IIC_SLAVE_NO_ACK;
-        }
-        else
-        {
-            /* Transaction succesfull, return number of transmitted bytes */
-            returnval = Iic->trans_len;
-        }
-    }
-    else
-    {
-        /* timeout occured */
-        printf("(iic_receive) Resetting device.\n");
-        XIic_Reset(&Iic->Device);
-        returnval = IIC_TIMEOUT;
-    }
-
-    /* Release mutex and return */
-    xSemaphoreGive(Iic->mutex);
-    return returnval;
+    return iic_bus_transfer(&Iic->bus, addr, IIC_READ, rx_data, rx_len, pdMS_TO_TICKS(IIC_TRANSACTION_DELAY_MS));
 }
 
 /*****************************************************************************/
@@ -266,9 +240,8 @@ static void RecvHandler(void *CallbackRef, int ByteCount)
         return;
     }
 
-    configASSERT(Iic->task_handle != NULL);
-    static BaseType_t askForContextSwitch = pdFALSE;
-    vTaskNotifyGiveFromISR(Iic->task_handle, &askForContextSwitch);
+    /* Transaction succesfull, completed by iic_interrupt_handler */
+    Iic->result = Iic->trans_len;
 }
 
 /****************************************************************************/
@@ -290,10 +263,8 @@ static void SendHandler(void *CallbackRef, int Status)
     // TODO: not much to do here?
     configASSERT(Status == 0);
 
-    // Notify the task
-    configASSERT(Iic->task_handle != NULL);
-    static BaseType_t askForContextSwitch = pdFALSE;
-    vTaskNotifyGiveFromISR(Iic->task_handle, &askForContextSwitch);
+    /* Transaction succesfull, completed by iic_interrupt_handler */
+    Iic->result = Iic->trans_len;
 }
 
 /*****************************************************************************/
@@ -317,10 +288,8 @@ static void StatusHandler(void *CallbackRef, int Status)
     Iic->TotalErrorCount++;
     Iic->Errors = Status;
 
-    // An error occured, notify the task
-    configASSERT(Iic->task_handle != NULL);
-    static BaseType_t askForContextSwitch = pdFALSE;
-    vTaskNotifyGiveFromISR(Iic->task_handle, &askForContextSwitch);
+    // An error occured, fail the transaction in iic_interrupt_handler
+    Iic->result = IIC_SLAVE_NO_ACK;
 }
 
 #if BSP_USE_IIC0
@@ -330,12 +299,15 @@ static void StatusHandler(void *CallbackRef, int Status)
 void iic0_master_reset(void)
 {
     iic_stop(&Iic0, PLIC_SOURCE_IIC0);
+    /* Nothing completes them any more */
+    iic_bus_flush(&Iic0.bus, IIC_ABORTED);
     vTaskDelay(pdMS_TO_TICKS(100));
     iic_init(&Iic0, XPAR_IIC_0_DEVICE_ID, PLIC_SOURCE_IIC0);
 }
 
 void iic0_init(void)
 {
+    iic_bus_init(&Iic0.bus, "iic0", iic_start, iic_abort, &Iic0);
     iic_init(&Iic0, XPAR_IIC_0_DEVICE_ID, PLIC_SOURCE_IIC0);
 }
 
@@ -353,6 +325,7 @@ int iic0_receive(uint8_t addr, uint8_t *rx_data, uint8_t rx_len)
 #if BSP_USE_IIC1
 void iic1_init(void)
 {
+    iic_bus_init(&Iic1.bus, "iic1", iic_start, iic_abort, &Iic1);
     iic_init(&Iic1, XPAR_IIC_1_DEVICE_ID, PLIC_SOURCE_IIC1);
 }
 
@@ -387,5 +360,6 @@ void iic0_print_stats(void)
     printf("(iic0stats.SendInterrupts) %u\r\n", iic0stats.SendInterrupts);   /**< Number of transmit interrupts */
     printf("(iic0stats.TxErrors) %u\r\n", iic0stats.TxErrors);   /**< Number of transmit errors (no ack) */
     printf("(iic0stats.IicInterrupts) %u\r\n", iic0stats.IicInterrupts);   /**< Number of IIC (device) interrupts */
+    iic_bus_print_stats(&Iic0.bus);
 }
 #endif
@@ -3,7 +3,7 @@
 
 #include <bsp.h>
 #include "xiic.h"
-#include "semphr.h"
+#include "iic_queue.h"
 
 #define IIC0_PRINT_STATS 0
 #define IIC_RESET_ERROR_THRESHOLD 3
@@ -12,20 +12,12 @@
 struct IicDriver
 {
     XIic Device; /* Xilinx IIC driver */
+    struct iic_bus bus; /* Transactions waiting for the device */
     /* Counters used to determine when buffer has been send and received */
     volatile int TotalErrorCount;
     volatile int Errors;
     int trans_len;            /* Length of the transaction */
-    SemaphoreHandle_t mutex;  /* Mutex for bus acquisition */
-    TaskHandle_t task_handle; /* handle for task that initiated a transaction */
-};
-
-enum iic_error {
-    IIC_TIMEOUT = -1,
-    IIC_SLAVE_NO_ACK = -2, /* Slave did not ACK (had error) 0x00000004 */
-    IIC_MASTER_SEND_ERROR = -3,
-    IIC_MASTER_RECV_ERROR = -4,
-    IIC_BUS_IS_BUSY = -5,
+    volatile int result;      /* Set by the handlers once the transaction is done */
 };
 
 int iic_transmit(struct IicDriver *Iic, uint8_t addr, uint8_t *tx_data, uint8_t tx_len);
@@ -0,0 +1,354 @@
+#include "iic_queue.h"
+#include <stdio.h>
+#include <string.h>
+
+/*****************************************************************************/
+/* Static functions, macros etc */
+
+static uint32_t iic_clamp(uint64_t us)
+{
+    return (us > UINT32_MAX) ? UINT32_MAX : (uint32_t)us;
+}
+
+/* Retired transactions whose owners are still to be told, in order */
+struct iic_retired
+{
+    struct iic_transaction *head;
+    struct iic_transaction *tail;
+};
+
+static void iic_defer(struct iic_retired *retired, struct iic_transaction *trans, int result)
+{
+    trans->retired = result;
+    trans->next = NULL;
+    if (retired->tail != NULL)
+    {
+        retired->tail->next = trans;
+    }
+    else
+    {
+        retired->head = trans;
+    }
+    retired->tail = trans;
+}
+
+/**
+ * Take the transaction on the bus off the queue, for iic_notify() to hand
+ * back to its owner. Interrupts disabled.
+ */
+static void iic_retire(struct iic_bus *bus, int result, struct iic_retired *retired)
+{
+    struct iic_transaction *trans = bus->head;
+
+    bus->head = trans->next;
+    if (bus->head == NULL)
+    {
+        bus->tail = NULL;
+    }
+    bus->depth--;
+
+    trans->completed_us = portGET_RUN_TIME_COUNTER_VALUE();
+
+    bus->stats.completed++;
+    if (result < 0)
+    {
+        bus->stats.errors++;
+    }
+
+    /* Transactions that never made it onto the bus only waited */
+    if (trans->started_us != 0)
+    {
+        uint32_t wait_us = iic_clamp(trans->started_us - trans->submitted_us);
+        uint32_t transfer_us = iic_clamp(trans->completed_us - trans->started_us);
+
+        bus->stats.started++;
+        bus->stats.total_wait_us += wait_us;
+        bus->stats.total_transfer_us += transfer_us;
+        if (wait_us > bus->stats.max_wait_us)
+        {
+            bus->stats.max_wait_us = wait_us;
+        }
+        if (transfer_us > bus->stats.max_transfer_us)
+        {
+            bus->stats.max_transfer_us = transfer_us;
+        }
+    }
+
+    iic_defer(retired, trans, result);
+}
+
+/**
+ * Start the transaction at the head of the queue, failing the ones the
+ * controller refuses. Interrupts disabled.
+ */
+static void iic_start_next(struct iic_bus *bus, struct iic_retired *retired)
+{
+    while (bus->head != NULL)
+    {
+        int err;
+
+        bus->head->started_us = portGET_RUN_TIME_COUNTER_VALUE();
+        err = bus->start(bus, bus->head);
+        if (err == 0)
+        {
+            return;
+        }
+        iic_retire(bus, err, retired);
+    }
+}
+
+/**
+ * Publish the results of retired transactions and tell their owners, with
+ * interrupts enabled unless called from an interrupt handler (woken set).
+ */
+static void iic_notify(struct iic_retired *retired, BaseType_t *woken)
+{
+    struct iic_transaction *trans = retired->head;
+
+    while (trans != NULL)
+    {
+        /* The owner may reuse trans once it has its result */
+        struct iic_transaction *next = trans->next;
+        iic_callback_t callback = trans->callback;
+        void *context = trans->context;
+        SemaphoreHandle_t done = trans->done;
+
+        trans->result = trans->retired;
+
+        if (callback != NULL)
+        {
+            callback(trans, context);
+        }
+
+        if (done != NULL)
+        {
+            if (woken != NULL)
+            {
+                (void)xSemaphoreGiveFromISR(done, woken);
+            }
+            else
+            {
+                (void)xSemaphoreGive(done);
+            }
+        }
+
+        trans = next;
+    }
+}
+
+/*****************************************************************************/
+
+void iic_bus_init(struct iic_bus *bus, const char *name, iic_start_t start, iic_abort_t abort, void *priv)
+{
+    memset(bus, 0, sizeof(*bus));
+    bus->name = name;
+    bus->start = start;
+    bus->abort = abort;
+    bus->priv = priv;
+}
+
+void iic_bus_submit(struct iic_bus *bus, struct iic_transaction *trans)
+{
+    struct iic_retired retired = {NULL, NULL};
+
+    trans->result = IIC_PENDING;
+    trans->next = NULL;
+    trans->started_us = 0;
+    trans->completed_us = 0;
+    trans->submitted_us = portGET_RUN_TIME_COUNTER_VALUE();
+
+    taskENTER_CRITICAL();
+    {
+        if (bus->tail != NULL)
+        {
+            bus->tail->next = trans;
+        }
+        else
+        {
+            bus->head = trans;
+        }
+        bus->tail = trans;
+
+        if (++bus->depth > bus->stats.max_depth)
+        {
+            bus->stats.max_depth = bus->depth;
+        }
+
+        /* Idle bus: start it here, otherwise the completion of the previous
+         * transaction does */
+        if (bus->head == trans)
+        {
+            iic_start_next(bus, &retired);
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    /* A transaction the controller refused */
+    iic_notify(&retired, NULL);
+}
+
+int iic_bus_wait(struct iic_bus *bus, struct iic_transaction *trans, TickType_t timeout)
+{
+    configASSERT(trans->done != NULL);
+
+    /* Given exactly once, by whoever retires the transaction */
+    if (xSemaphoreTake(trans->done, timeout) == pdFALSE)
+    {
+        iic_bus_cancel(bus, trans, IIC_TIMEOUT);
+        /* Retired by the cancellation, or by a completion that got there
+         * first and is telling us right now */
+        (void)xSemaphoreTake(trans->done, portMAX_DELAY);
+    }
+
+    return trans->result;
+}
+
+int iic_bus_transfer(struct iic_bus *bus, uint8_t addr, uint8_t direction, uint8_t *data, uint8_t len,
+                     TickType_t timeout)
+{
+    StaticSemaphore_t done_buffer;
+    struct iic_transaction trans = {
+        .addr = addr,
+        .direction = direction,
+        .len = len,
+        .data = data,
+        .done = xSemaphoreCreateBinaryStatic(&done_buffer),
+    };
+
+    iic_bus_submit(bus, &trans);
+    return iic_bus_wait(bus, &trans, timeout);
+}
+
+void iic_bus_cancel(struct iic_bus *bus, struct iic_transaction *trans, int result)
+{
+    struct iic_retired retired = {NULL, NULL};
+
+    taskENTER_CRITICAL();
+    if (bus->head == trans)
+    {
+        if (result == IIC_TIMEOUT)
+        {
+            bus->stats.timeouts++;
+        }
+
+        /* Stuck on the bus: reset the controller, then carry on */
+        if (bus->abort != NULL)
+        {
+            bus->abort(bus);
+        }
+        iic_retire(bus, result, &retired);
+        iic_start_next(bus, &retired);
+    }
+    else if (bus->head != NULL)
+    {
+        struct iic_transaction *prev = bus->head;
+
+        while ((prev->next != NULL) && (prev->next != trans))
+        {
+            prev = prev->next;
+        }
+
+        /* Not queued: it already completed, or its owner is being told */
+        if (prev->next == trans)
+        {
+            if (result == IIC_TIMEOUT)
+            {
+                bus->stats.timeouts++;
+            }
+
+            prev->next = trans->next;
+            if (bus->tail == trans)
+            {
+                bus->tail = prev;
+            }
+            bus->depth--;
+            bus->stats.completed++;
+            bus->stats.errors++;
+            trans->completed_us = portGET_RUN_TIME_COUNTER_VALUE();
+            iic_defer(&retired, trans, result);
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    iic_notify(&retired, NULL);
+}
+
+void iic_bus_complete_from_isr(struct iic_bus *bus, int result, BaseType_t *higher_priority_task_woken)
+{
+    struct iic_retired retired = {NULL, NULL};
+
+    configASSERT(higher_priority_task_woken != NULL);
+
+    /* A late interrupt for a cancelled transaction */
+    if (bus->head == NULL)
+    {
+        return;
+    }
+
+    iic_retire(bus, result, &retired);
+    iic_start_next(bus, &retired);
+    iic_notify(&retired, higher_priority_task_woken);
+}
+
+void iic_bus_complete(struct iic_bus *bus, struct iic_transaction *trans, int result)
+{
+    struct iic_retired retired = {NULL, NULL};
+
+    taskENTER_CRITICAL();
+    /* Still the transaction on the bus, unless it was cancelled meanwhile */
+    if (bus->head == trans)
+    {
+        iic_retire(bus, result, &retired);
+        iic_start_next(bus, &retired);
+    }
+    taskEXIT_CRITICAL();
+
+    iic_notify(&retired, NULL);
+}
+
+void iic_bus_flush(struct iic_bus *bus, int result)
+{
+    struct iic_retired retired = {NULL, NULL};
+
+    taskENTER_CRITICAL();
+    while (bus->head != NULL)
+    {
+        iic_retire(bus, result, &retired);
+    }
+    taskEXIT_CRITICAL();
+
+    iic_notify(&retired, NULL);
+}
+
+void iic_bus_get_stats(struct iic_bus *bus, struct iic_bus_stats *stats)
+{
+    taskENTER_CRITICAL();
+    *stats = bus->stats;
+    taskEXIT_CRITICAL();
+}
+
+void iic_bus_reset_stats(struct iic_bus *bus)
+{
+    taskENTER_CRITICAL();
+    memset(&bus->stats, 0, sizeof(bus->stats));
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * One line of per-transaction timing, in microseconds
+ */
+void iic_bus_print_stats(struct iic_bus *bus)
+{
+    struct iic_bus_stats stats;
+    uint32_t started;
+
+    iic_bus_get_stats(bus, &stats);
+    started = (stats.started != 0) ? stats.started : 1;
+
+    printf("(%s.queue) transactions %u, errors %u, timeouts %u, max depth %u, "
+           "wait mean %u max %u us, transfer mean %u max %u us\r\n",
+           bus->name, (unsigned)stats.completed, (unsigned)stats.errors, (unsigned)stats.timeouts,
+           (unsigned)stats.max_depth,
+           (unsigned)(stats.total_wait_us / started), (unsigned)stats.max_wait_us,
+           (unsigned)(stats.total_transfer_us / started), (unsigned)stats.max_transfer_us);
+}
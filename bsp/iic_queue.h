@@ -0,0 +1,140 @@
+#ifndef __IIC_QUEUE_H__
+#define __IIC_QUEUE_H__
+
+/**
+ * IIC transaction queue (bsp/iic_queue.c).
+ *
+ * Callers submit transaction descriptors to a bus and are told when each one
+ * completes, by a callback and/or a semaphore. The bus runs one
+ * transaction at a time: when the controller signals the end of one (from
+ * its interrupt handler), the next is started right there, without a round
+ * trip through a task. Controllers plug in with a start and an abort
+ * function: the Xilinx AXI IIC (bsp/iic.c) and a simulated bus
+ * (bsp/iic_sim.c).
+ */
+
+#include <stdint.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+enum iic_error {
+    IIC_TIMEOUT = -1,
+    IIC_SLAVE_NO_ACK = -2, /* Slave did not ACK (had error) 0x00000004 */
+    IIC_MASTER_SEND_ERROR = -3,
+    IIC_MASTER_RECV_ERROR = -4,
+    IIC_BUS_IS_BUSY = -5,
+    IIC_ABORTED = -6,      /* Dropped by a controller reset */
+};
+
+/* Result of a transaction that is queued or on the bus */
+#define IIC_PENDING 1
+
+enum iic_direction {
+    IIC_WRITE = 0,
+    IIC_READ = 1,
+};
+
+struct iic_transaction;
+struct iic_bus;
+
+/* Called when a transaction completes, from interrupt context for hardware
+ * controllers, otherwise from the task that retired it once it has left its
+ * critical section: must not block. The transaction may be reused from here. */
+typedef void (*iic_callback_t)(struct iic_transaction *trans, void *context);
+
+/* Put a transaction on the bus, interrupts disabled. Returns 0, or an
+ * iic_error to fail the transaction right away. */
+typedef int (*iic_start_t)(struct iic_bus *bus, struct iic_transaction *trans);
+
+/* Reset the controller after the transaction on the bus got stuck */
+typedef void (*iic_abort_t)(struct iic_bus *bus);
+
+struct iic_transaction
+{
+    /* Set by the caller */
+    uint8_t addr;            /* 7-bit slave address */
+    uint8_t direction;       /* IIC_READ into data, or IIC_WRITE from it */
+    uint8_t len;
+    uint8_t *data;
+    iic_callback_t callback; /* Optional */
+    void *context;
+    SemaphoreHandle_t done;  /* Optional binary semaphore, given once on completion */
+
+    /* Set by the bus */
+    volatile int result;     /* IIC_PENDING, then bytes transferred or an iic_error */
+    int retired;             /* The result, until the owner is told */
+    uint64_t submitted_us;   /* Run time counter at each step */
+    uint64_t started_us;
+    uint64_t completed_us;
+    struct iic_transaction *next;
+};
+
+struct iic_bus_stats
+{
+    uint32_t completed;      /* Transactions retired, failed ones included */
+    uint32_t started;        /* Of those, the ones that got onto the bus */
+    uint32_t errors;         /* Failed, timeouts included */
+    uint32_t timeouts;
+    uint32_t max_depth;      /* Most transactions queued at once */
+    uint32_t max_wait_us;    /* Longest from submission to start */
+    uint32_t max_transfer_us;/* Longest from start to completion */
+    uint64_t total_wait_us;
+    uint64_t total_transfer_us;
+};
+
+struct iic_bus
+{
+    const char *name;
+    iic_start_t start;
+    iic_abort_t abort;
+    void *priv;                    /* The controller's driver */
+    struct iic_transaction *head;  /* On the bus */
+    struct iic_transaction *tail;
+    uint32_t depth;
+    struct iic_bus_stats stats;
+};
+
+void iic_bus_init(struct iic_bus *bus, const char *name, iic_start_t start, iic_abort_t abort, void *priv);
+
+/**
+ * Queue a transaction. trans must stay valid until the callback has run or
+ * done has been given.
+ */
+void iic_bus_submit(struct iic_bus *bus, struct iic_transaction *trans);
+
+/**
+ * Wait for a transaction submitted with trans->done set. After timeout ticks
+ * the transaction is cancelled (and the controller reset if it was on the
+ * bus). Returns its result.
+ */
+int iic_bus_wait(struct iic_bus *bus, struct iic_transaction *trans, TickType_t timeout);
+
+/**
+ * Synchronous transfer: submit and wait. Returns the number of bytes
+ * transferred or an iic_error.
+ */
+int iic_bus_transfer(struct iic_bus *bus, uint8_t addr, uint8_t direction, uint8_t *data, uint8_t len,
+                     TickType_t timeout);
+
+/* Take a transaction off the queue, with result as its result, and tell its
+ * owner. Nothing happens if it already completed. */
+void iic_bus_cancel(struct iic_bus *bus, struct iic_transaction *trans, int result);
+
+/**
+ * Called by the controller when the transaction on the bus is done, result
+ * being the bytes transferred or an iic_error. Starts the next transaction.
+ * From a task, iic_bus_complete() does nothing unless trans is still the
+ * transaction on the bus.
+ */
+void iic_bus_complete_from_isr(struct iic_bus *bus, int result, BaseType_t *higher_priority_task_woken);
+void iic_bus_complete(struct iic_bus *bus, struct iic_transaction *trans, int result);
+
+/* Fail everything queued with result, once the controller has been stopped */
+void iic_bus_flush(struct iic_bus *bus, int result);
+
+void iic_bus_get_stats(struct iic_bus *bus, struct iic_bus_stats *stats);
+void iic_bus_reset_stats(struct iic_bus *bus);
+void iic_bus_print_stats(struct iic_bus *bus);
+
+#endif /* __IIC_QUEUE_H__ */
@@ -0,0 +1,127 @@
+#include "iic_sim.h"
+#include "timers.h"
+#include <stddef.h>
+
+/*****************************************************************************/
+/* Static functions, macros etc */
+
+/* Start, address and a byte per data byte, 9 clocks each */
+#define IIC_SIM_TRANSFER_US(len) ((((uint32_t)(len) + 1) * 9 * 1000000UL) / IIC_SIM_BUS_HZ)
+
+struct iic_sim_state
+{
+    const struct iic_sim_target *targets[IIC_SIM_MAX_TARGETS];
+    UBaseType_t num_targets;
+    TimerHandle_t timer;            /* Fires at the end of the transfer on the bus */
+    struct iic_transaction *trans;  /* On the bus */
+};
+
+struct iic_bus IicSim;
+static struct iic_sim_state sim;
+
+/*****************************************************************************/
+
+static const struct iic_sim_target *iic_sim_find(uint8_t addr)
+{
+    for (UBaseType_t i = 0; i < sim.num_targets; i++)
+    {
+        if (sim.targets[i]->addr == addr)
+        {
+            return sim.targets[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * The transfer time is up: let the target answer and complete the
+ * transaction, which starts the next one.
+ */
+static void iic_sim_timer_callback(TimerHandle_t timer)
+{
+    const struct iic_sim_target *target;
+    struct iic_transaction *trans;
+    int result = IIC_SLAVE_NO_ACK;
+
+    (void)timer;
+
+    taskENTER_CRITICAL();
+    trans = sim.trans;
+    sim.trans = NULL;
+    taskEXIT_CRITICAL();
+
+    /* Cancelled while on the bus */
+    if (trans == NULL)
+    {
+        return;
+    }
+
+    target = iic_sim_find(trans->addr);
+    if (target != NULL)
+    {
+        if (trans->direction == IIC_READ)
+        {
+            result = (target->read != NULL) ? target->read(target->context, trans->data, trans->len) : IIC_SLAVE_NO_ACK;
+        }
+        else
+        {
+            result = (target->write != NULL) ? target->write(target->context, trans->data, trans->len) : IIC_SLAVE_NO_ACK;
+        }
+    }
+
+    /* Unless it timed out meanwhile */
+    iic_bus_complete(&IicSim, trans, result);
+}
+
+static int iic_sim_start(struct iic_bus *bus, struct iic_transaction *trans)
+{
+    TickType_t ticks = pdMS_TO_TICKS((IIC_SIM_TRANSFER_US(trans->len) + 999) / 1000);
+
+    (void)bus;
+
+    sim.trans = trans;
+
+    /* Interrupts are disabled, so this must not block: the timer command
+     * queue only fills up if the timer task is starved */
+    if (xTimerChangePeriod(sim.timer, (ticks > 0) ? ticks : 1, 0) != pdPASS)
+    {
+        sim.trans = NULL;
+        return IIC_BUS_IS_BUSY;
+    }
+    return 0;
+}
+
+static void iic_sim_abort(struct iic_bus *bus)
+{
+    (void)bus;
+
+    /* The timer still fires, and finds nothing on the bus */
+    sim.trans = NULL;
+}
+
+void iic_sim_init(void)
+{
+    if (sim.timer != NULL)
+    {
+        return;
+    }
+
+    sim.timer = xTimerCreate("IicSim", 1, pdFALSE, NULL, iic_sim_timer_callback);
+    configASSERT(sim.timer != NULL);
+    iic_bus_init(&IicSim, "iicsim", iic_sim_start, iic_sim_abort, &sim);
+}
+
+int iic_sim_add_target(const struct iic_sim_target *target)
+{
+    int returnval = -1;
+
+    taskENTER_CRITICAL();
+    if ((sim.num_targets < IIC_SIM_MAX_TARGETS) && (iic_sim_find(target->addr) == NULL))
+    {
+        sim.targets[sim.num_targets++] = target;
+        returnval = 0;
+    }
+    taskEXIT_CRITICAL();
+
+    return returnval;
+}
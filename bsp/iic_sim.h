@@ -0,0 +1,42 @@
+#ifndef __IIC_SIM_H__
+#define __IIC_SIM_H__
+
+/**
+ * Simulated IIC bus (bsp/iic_sim.c), for platforms without an IIC controller
+ * (QEMU). Slaves are software targets answering reads and writes; each
+ * transaction completes after the time it would take on a real bus, from the
+ * timer task, through the same transaction queue as the hardware driver.
+ */
+
+#include <stdint.h>
+#include "iic_queue.h"
+
+/* Bus clock the transfer times are worked out from */
+#ifndef IIC_SIM_BUS_HZ
+#define IIC_SIM_BUS_HZ 100000
+#endif
+
+#ifndef IIC_SIM_MAX_TARGETS
+#define IIC_SIM_MAX_TARGETS 4
+#endif
+
+/* A simulated slave. read/write return the bytes transferred or an
+ * iic_error, and run in the timer task. */
+struct iic_sim_target
+{
+    uint8_t addr;
+    int (*read)(void *context, uint8_t *rx_data, uint8_t rx_len);
+    int (*write)(void *context, const uint8_t *tx_data, uint8_t tx_len);
+    void *context;
+};
+
+extern struct iic_bus IicSim;
+
+/* Set up IicSim, safe to call more than once */
+void iic_sim_init(void);
+
+/* Answer transactions to target->addr, which must stay valid. Returns 0,
+ * or -1 when there is no room or the address is taken. */
+int iic_sim_add_target(const struct iic_sim_target *target);
+
+#endif /* __IIC_SIM_H__ */
@@ -0,0 +1,516 @@
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "mpu_regions.h"
+
+#if configMPU_REGION_POLICY == 1
+
+#define mpuPMP_A_NAPOT      ( 3UL << 3 )
+#define mpuPMP_PERM_MASK    ( mpuREGION_READ | mpuREGION_WRITE | mpuREGION_EXEC )
+#define mpuNO_OWNER         ( -1 )
+
+#if ( configMPU_POLICY_FIRST_SLOT >= configMPU_PMP_ENTRIES )
+    #error "configMPU_POLICY_FIRST_SLOT leaves no PMP entries to the region policy"
+#endif
+
+#if ( configMPU_REGIONS_NUM > configMPU_POLICY_FIRST_SLOT )
+    #error "The port would program PMP entries that belong to the region policy"
+#endif
+
+#if ( configMPU_POLICY_REGIONS_PER_TASK > 32 )
+    #error "configMPU_POLICY_REGIONS_PER_TASK must fit the 32-bit working-set map"
+#endif
+
+extern uint64_t get_cycle_count( void );
+
+typedef struct MPU_POLICY_TASK
+{
+    TaskHandle_t xTask;
+    MpuPolicyRegion_t xRegions[ configMPU_POLICY_REGIONS_PER_TASK ];
+    UBaseType_t uxCount;
+    uint32_t ulTouched;    /* Regions faulted on during the current run */
+    uint32_t ulWorkingSet; /* Prediction for the next run */
+} MpuPolicyTask_t;
+
+typedef struct MPU_POLICY_SLOT
+{
+    BaseType_t xOwner;  /* Index in xPolicyTasks, or mpuNO_OWNER */
+    UBaseType_t uxRegion;
+    uint64_t ullLastUse;
+} MpuPolicySlot_t;
+
+static MpuPolicyTask_t xPolicyTasks[ configMPU_POLICY_TASKS ];
+static MpuPolicySlot_t xSlots[ configMPU_PMP_ENTRIES ];
+static MpuPolicyStats_t xStats;
+static BaseType_t xCurrent = mpuNO_OWNER;
+static uint64_t ullClock = 0;
+static BaseType_t xInitialised = pdFALSE;
+/*-----------------------------------------------------------*/
+
+#define mpuWRITE_PMPADDR( n, v )    case n: asm volatile ( "csrw pmpaddr" #n ", %0" :: "r" ( v ) ); break
+
+static void prvWritePmpAddr( UBaseType_t uxSlot,
+                             uintptr_t uxValue )
+{
+    switch( uxSlot )
+    {
+        mpuWRITE_PMPADDR( 0, uxValue );
+        mpuWRITE_PMPADDR( 1, uxValue );
+        mpuWRITE_PMPADDR( 2, uxValue );
+        mpuWRITE_PMPADDR( 3, uxValue );
+        mpuWRITE_PMPADDR( 4, uxValue );
+        mpuWRITE_PMPADDR( 5, uxValue );
+        mpuWRITE_PMPADDR( 6, uxValue );
+        mpuWRITE_PMPADDR( 7, uxValue );
+        mpuWRITE_PMPADDR( 8, uxValue );
+        mpuWRITE_PMPADDR( 9, uxValue );
+        mpuWRITE_PMPADDR( 10, uxValue );
+        mpuWRITE_PMPADDR( 11, uxValue );
+        mpuWRITE_PMPADDR( 12, uxValue );
+        mpuWRITE_PMPADDR( 13, uxValue );
+        mpuWRITE_PMPADDR( 14, uxValue );
+        mpuWRITE_PMPADDR( 15, uxValue );
+        default:
+            configASSERT( 0 );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void prvWritePmpCfg( UBaseType_t uxSlot,
+                            uint8_t ucCfg )
+{
+    uintptr_t uxMask, uxBits;
+
+    #if __riscv_xlen == 64
+        /* pmpcfg0 holds entries 0-7, pmpcfg2 entries 8-15 */
+        uxMask = ( uintptr_t ) 0xff << ( ( uxSlot % 8 ) * 8 );
+        uxBits = ( uintptr_t ) ucCfg << ( ( uxSlot % 8 ) * 8 );
+
+        if( uxSlot < 8 )
+        {
+            asm volatile ( "csrc pmpcfg0, %0\n\tcsrs pmpcfg0, %1" :: "r" ( uxMask ), "r" ( uxBits ) );
+        }
+        else
+        {
+            asm volatile ( "csrc pmpcfg2, %0\n\tcsrs pmpcfg2, %1" :: "r" ( uxMask ), "r" ( uxBits ) );
+        }
+    #else
+        uxMask = ( uintptr_t ) 0xff << ( ( uxSlot % 4 ) * 8 );
+        uxBits = ( uintptr_t ) ucCfg << ( ( uxSlot % 4 ) * 8 );
+
+        switch( uxSlot / 4 )
+        {
+            case 0: asm volatile ( "csrc pmpcfg0, %0\n\tcsrs pmpcfg0, %1" :: "r" ( uxMask ), "r" ( uxBits ) ); break;
+            case 1: asm volatile ( "csrc pmpcfg1, %0\n\tcsrs pmpcfg1, %1" :: "r" ( uxMask ), "r" ( uxBits ) ); break;
+            case 2: asm volatile ( "csrc pmpcfg2, %0\n\tcsrs pmpcfg2, %1" :: "r" ( uxMask ), "r" ( uxBits ) ); break;
+            case 3: asm volatile ( "csrc pmpcfg3, %0\n\tcsrs pmpcfg3, %1" :: "r" ( uxMask ), "r" ( uxBits ) ); break;
+            default: configASSERT( 0 );
+        }
+    #endif /* if __riscv_xlen == 64 */
+}
+/*-----------------------------------------------------------*/
+
+static void prvSlotLoad( UBaseType_t uxSlot,
+                         BaseType_t xOwner,
+                         UBaseType_t uxRegion )
+{
+    const MpuPolicyRegion_t * pxRegion = &xPolicyTasks[ xOwner ].xRegions[ uxRegion ];
+    uintptr_t uxBase = ( uintptr_t ) pxRegion->pvBase;
+
+    /* Disable first so the entry is never half-programmed */
+    prvWritePmpCfg( uxSlot, 0 );
+    prvWritePmpAddr( uxSlot, ( uxBase | ( ( pxRegion->xSize / 2 ) - 1 ) ) >> 2 );
+    prvWritePmpCfg( uxSlot, ( uint8_t ) ( mpuPMP_A_NAPOT | ( pxRegion->ulFlags & mpuPMP_PERM_MASK ) ) );
+
+    xSlots[ uxSlot ].xOwner = xOwner;
+    xSlots[ uxSlot ].uxRegion = uxRegion;
+    xSlots[ uxSlot ].ullLastUse = ++ullClock;
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * PMP hits never trap, so a region is only seen in use when its task is
+ * switched in and when it faults. Stamp the task's resident slots at those
+ * points, those in ulMask last so they are the last to be evicted.
+ */
+static void prvSlotsTouch( BaseType_t xOwner,
+                           uint32_t ulMask )
+{
+    UBaseType_t x;
+
+    for( x = configMPU_POLICY_FIRST_SLOT; x < configMPU_PMP_ENTRIES; x++ )
+    {
+        if( ( xSlots[ x ].xOwner == xOwner ) && ( ( ulMask & ( 1UL << xSlots[ x ].uxRegion ) ) == 0 ) )
+        {
+            xSlots[ x ].ullLastUse = ++ullClock;
+        }
+    }
+
+    for( x = configMPU_POLICY_FIRST_SLOT; x < configMPU_PMP_ENTRIES; x++ )
+    {
+        if( ( xSlots[ x ].xOwner == xOwner ) && ( ( ulMask & ( 1UL << xSlots[ x ].uxRegion ) ) != 0 ) )
+        {
+            xSlots[ x ].ullLastUse = ++ullClock;
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+static uint32_t prvSlotsResident( BaseType_t xOwner )
+{
+    UBaseType_t x;
+    uint32_t ulResident = 0;
+
+    for( x = configMPU_POLICY_FIRST_SLOT; x < configMPU_PMP_ENTRIES; x++ )
+    {
+        if( xSlots[ x ].xOwner == xOwner )
+        {
+            ulResident |= ( 1UL << xSlots[ x ].uxRegion );
+        }
+    }
+
+    return ulResident;
+}
+/*-----------------------------------------------------------*/
+
+static void prvSlotClear( UBaseType_t uxSlot )
+{
+    prvWritePmpCfg( uxSlot, 0 );
+    xSlots[ uxSlot ].xOwner = mpuNO_OWNER;
+}
+/*-----------------------------------------------------------*/
+
+static void prvInit( void )
+{
+    UBaseType_t x;
+
+    for( x = 0; x < configMPU_POLICY_TASKS; x++ )
+    {
+        xPolicyTasks[ x ].xTask = NULL;
+    }
+
+    for( x = 0; x < configMPU_PMP_ENTRIES; x++ )
+    {
+        xSlots[ x ].xOwner = mpuNO_OWNER;
+    }
+
+    xInitialised = pdTRUE;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvFindTask( TaskHandle_t xTask )
+{
+    BaseType_t x;
+
+    for( x = 0; x < configMPU_POLICY_TASKS; x++ )
+    {
+        if( ( xTask != NULL ) && ( xPolicyTasks[ x ].xTask == xTask ) )
+        {
+            return x;
+        }
+    }
+
+    return mpuNO_OWNER;
+}
+/*-----------------------------------------------------------*/
+
+/* Pick a free slot, else the least recently used unpinned one, else -1 */
+static BaseType_t prvFindVictim( void )
+{
+    UBaseType_t x;
+    BaseType_t xVictim = -1;
+    uint64_t ullOldest = UINT64_MAX;
+
+    for( x = configMPU_POLICY_FIRST_SLOT; x < configMPU_PMP_ENTRIES; x++ )
+    {
+        if( xSlots[ x ].xOwner == mpuNO_OWNER )
+        {
+            return ( BaseType_t ) x;
+        }
+
+        if( ( xPolicyTasks[ xSlots[ x ].xOwner ].xRegions[ xSlots[ x ].uxRegion ].ulFlags & mpuREGION_PINNED ) == 0 &&
+            ( xSlots[ x ].ullLastUse < ullOldest ) )
+        {
+            ullOldest = xSlots[ x ].ullLastUse;
+            xVictim = ( BaseType_t ) x;
+        }
+    }
+
+    return xVictim;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xMpuPolicyRegister( TaskHandle_t xTask,
+                               const MpuPolicyRegion_t * pxRegions,
+                               UBaseType_t uxCount )
+{
+    BaseType_t xEntry;
+    UBaseType_t x;
+
+    if( uxCount > configMPU_POLICY_REGIONS_PER_TASK )
+    {
+        return pdFAIL;
+    }
+
+    for( x = 0; x < uxCount; x++ )
+    {
+        /* NAPOT needs a power of 2 size >= 8 and a base aligned to it */
+        if( ( pxRegions[ x ].xSize < 8 ) ||
+            ( pxRegions[ x ].xSize & ( pxRegions[ x ].xSize - 1 ) ) ||
+            ( ( uintptr_t ) pxRegions[ x ].pvBase & ( pxRegions[ x ].xSize - 1 ) ) )
+        {
+            return pdFAIL;
+        }
+    }
+
+    taskENTER_CRITICAL();
+    {
+        if( xInitialised == pdFALSE )
+        {
+            prvInit();
+        }
+
+        xEntry = prvFindTask( xTask );
+
+        if( xEntry == mpuNO_OWNER )
+        {
+            for( x = 0; x < configMPU_POLICY_TASKS && xEntry == mpuNO_OWNER; x++ )
+            {
+                if( xPolicyTasks[ x ].xTask == NULL )
+                {
+                    xEntry = ( BaseType_t ) x;
+                }
+            }
+        }
+
+        if( xEntry != mpuNO_OWNER )
+        {
+            for( x = configMPU_POLICY_FIRST_SLOT; x < configMPU_PMP_ENTRIES; x++ )
+            {
+                if( xSlots[ x ].xOwner == xEntry )
+                {
+                    prvSlotClear( x );
+                }
+            }
+
+            xPolicyTasks[ xEntry ].xTask = xTask;
+            memcpy( xPolicyTasks[ xEntry ].xRegions, pxRegions, uxCount * sizeof( MpuPolicyRegion_t ) );
+            xPolicyTasks[ xEntry ].uxCount = uxCount;
+            xPolicyTasks[ xEntry ].ulTouched = 0;
+            xPolicyTasks[ xEntry ].ulWorkingSet = 0;
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    return ( xEntry != mpuNO_OWNER ) ? pdPASS : pdFAIL;
+}
+/*-----------------------------------------------------------*/
+
+void vMpuPolicyUnregister( TaskHandle_t xTask )
+{
+    BaseType_t xEntry;
+    UBaseType_t x;
+
+    taskENTER_CRITICAL();
+    {
+        xEntry = prvFindTask( xTask );
+
+        if( xEntry != mpuNO_OWNER )
+        {
+            for( x = configMPU_POLICY_FIRST_SLOT; x < configMPU_PMP_ENTRIES; x++ )
+            {
+                if( xSlots[ x ].xOwner == xEntry )
+                {
+                    prvSlotClear( x );
+                }
+            }
+
+            xPolicyTasks[ xEntry ].xTask = NULL;
+
+            if( xCurrent == xEntry )
+            {
+                xCurrent = mpuNO_OWNER;
+            }
+        }
+    }
+    taskEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xMpuPolicyHandleFault( uintptr_t uxAddress )
+{
+    uint64_t ullStart = get_cycle_count();
+    MpuPolicyTask_t * pxTask;
+    BaseType_t xVictim;
+    UBaseType_t x;
+
+    if( ( xInitialised == pdFALSE ) || ( xCurrent == mpuNO_OWNER ) )
+    {
+        xStats.ullMisses++;
+        return pdFALSE;
+    }
+
+    pxTask = &xPolicyTasks[ xCurrent ];
+
+    for( x = 0; x < pxTask->uxCount; x++ )
+    {
+        uintptr_t uxBase = ( uintptr_t ) pxTask->xRegions[ x ].pvBase;
+
+        if( ( uxAddress >= uxBase ) && ( uxAddress - uxBase < pxTask->xRegions[ x ].xSize ) )
+        {
+            break;
+        }
+    }
+
+    if( x == pxTask->uxCount )
+    {
+        /* Not ours to fix: a genuine protection fault */
+        xStats.ullMisses++;
+        return pdFALSE;
+    }
+
+    /* The predicted working set is still in use, keep it over one-offs */
+    prvSlotsTouch( xCurrent, pxTask->ulWorkingSet );
+
+    xVictim = prvFindVictim();
+
+    if( xVictim < 0 )
+    {
+        /* Every slot is pinned */
+        xStats.ullMisses++;
+        return pdFALSE;
+    }
+
+    if( xSlots[ xVictim ].xOwner != mpuNO_OWNER )
+    {
+        xStats.ullSwaps++;
+    }
+
+    prvSlotLoad( ( UBaseType_t ) xVictim, xCurrent, x );
+    pxTask->ulTouched |= ( 1UL << x );
+
+    xStats.ullFaults++;
+    xStats.ullFaultCycles += get_cycle_count() - ullStart;
+
+    return pdTRUE;
+}
+/*-----------------------------------------------------------*/
+
+void vMpuPolicyTaskSwitchedIn( void )
+{
+    uint64_t ullStart;
+    BaseType_t xNext, xVictim;
+    UBaseType_t x;
+    uint32_t ulPreload;
+
+    if( xInitialised == pdFALSE )
+    {
+        return;
+    }
+
+    xNext = prvFindTask( xTaskGetCurrentTaskHandle() );
+
+    if( xNext == xCurrent )
+    {
+        return;
+    }
+
+    ullStart = get_cycle_count();
+
+    /* The outgoing task's next working set is what it faulted on this run
+     * merged with the part of the old set that survived the run resident;
+     * predicted regions that got evicted along the way drop out. */
+    if( xCurrent != mpuNO_OWNER )
+    {
+        xPolicyTasks[ xCurrent ].ulWorkingSet = ( xPolicyTasks[ xCurrent ].ulWorkingSet & prvSlotsResident( xCurrent ) ) |
+                                                xPolicyTasks[ xCurrent ].ulTouched;
+        xPolicyTasks[ xCurrent ].ulTouched = 0;
+    }
+
+    /* Another task's regions must never stay visible */
+    for( x = configMPU_POLICY_FIRST_SLOT; x < configMPU_PMP_ENTRIES; x++ )
+    {
+        if( ( xSlots[ x ].xOwner != mpuNO_OWNER ) && ( xSlots[ x ].xOwner != xNext ) )
+        {
+            prvSlotClear( x );
+        }
+    }
+
+    xCurrent = xNext;
+
+    if( xNext != mpuNO_OWNER )
+    {
+        /* Pinned regions first, then the predicted working set */
+        ulPreload = xPolicyTasks[ xNext ].ulWorkingSet;
+
+        for( x = 0; x < xPolicyTasks[ xNext ].uxCount; x++ )
+        {
+            if( xPolicyTasks[ xNext ].xRegions[ x ].ulFlags & mpuREGION_PINNED )
+            {
+                ulPreload |= ( 1UL << x );
+            }
+        }
+
+        prvSlotsTouch( xNext, xPolicyTasks[ xNext ].ulWorkingSet );
+        ulPreload &= ~prvSlotsResident( xNext );
+
+        for( x = 0; x < xPolicyTasks[ xNext ].uxCount && ulPreload != 0; x++ )
+        {
+            if( ( ulPreload & ( 1UL << x ) ) == 0 )
+            {
+                continue;
+            }
+
+            xVictim = prvFindVictim();
+
+            if( ( xVictim < 0 ) || ( xSlots[ xVictim ].xOwner != mpuNO_OWNER ) )
+            {
+                /* Don't evict on a guess, keep the rest for demand faults */
+                break;
+            }
+
+            prvSlotLoad( ( UBaseType_t ) xVictim, xNext, x );
+            ulPreload &= ~( 1UL << x );
+            xStats.ullPreloads++;
+        }
+    }
+
+    xStats.ullSwitchCycles += get_cycle_count() - ullStart;
+}
+/*-----------------------------------------------------------*/
+
+void vMpuPolicyGetStats( MpuPolicyStats_t * pxStats )
+{
+    taskENTER_CRITICAL();
+    *pxStats = xStats;
+    taskEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
+
+void vMpuPolicyResetStats( void )
+{
+    taskENTER_CRITICAL();
+    memset( &xStats, 0, sizeof( xStats ) );
+    taskEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
+
+void vMpuPolicyPrintStats( void )
+{
+    MpuPolicyStats_t xSnapshot;
+
+    vMpuPolicyGetStats( &xSnapshot );
+
+    printf( "HPM mpu_region_faults: %" PRIu64 "\n", xSnapshot.ullFaults );
+    printf( "HPM mpu_region_swaps: %" PRIu64 "\n", xSnapshot.ullSwaps );
+    printf( "HPM mpu_region_preloads: %" PRIu64 "\n", xSnapshot.ullPreloads );
+    printf( "HPM mpu_region_misses: %" PRIu64 "\n", xSnapshot.ullMisses );
+    printf( "HPM mpu_fault_cycles: %" PRIu64 "\n", xSnapshot.ullFaultCycles );
+    printf( "HPM mpu_switch_cycles: %" PRIu64 "\n", xSnapshot.ullSwitchCycles );
+}
+/*-----------------------------------------------------------*/
+
+#endif /* configMPU_REGION_POLICY == 1 */
@@ -0,0 +1,99 @@
+/**
+ * Region replacement policy for emulated-unlimited MPU compartmentalization.
+ *
+ * Tasks register an unbounded list of regions; only the PMP entries from
+ * configMPU_POLICY_FIRST_SLOT up fit them at once. On an access fault inside a registered region a
+ * victim slot is chosen (least recently used, never a pinned one) and
+ * reprogrammed. Hits don't trap, so use is sampled at switch-in and on faults,
+ * where the predicted working set is stamped last. The working set is what a
+ * task faulted on during its previous run merged with what of the old set
+ * stayed resident, and it is preloaded on context switch-in, so a steady
+ * working set stops faulting after the first quantum.
+ */
+#ifndef MPU_REGIONS_H
+#define MPU_REGIONS_H
+
+#include <stdint.h>
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Region flags, the low bits map directly onto PMP R/W/X */
+#define mpuREGION_READ          ( 1UL << 0 )
+#define mpuREGION_WRITE         ( 1UL << 1 )
+#define mpuREGION_EXEC          ( 1UL << 2 )
+#define mpuREGION_READ_WRITE    ( mpuREGION_READ | mpuREGION_WRITE )
+#define mpuREGION_PINNED        ( 1UL << 8 ) /* Never chosen as a victim */
+
+/* First PMP entry managed by the policy; the ones below belong to the port
+ * (kernel, stack and the task's static xRegions), which must not program
+ * entries at or above this one. */
+#ifndef configMPU_POLICY_FIRST_SLOT
+    #define configMPU_POLICY_FIRST_SLOT    8
+#endif
+
+/* PMP entries the hart implements, the policy uses the ones from
+ * configMPU_POLICY_FIRST_SLOT up */
+#ifndef configMPU_PMP_ENTRIES
+    #define configMPU_PMP_ENTRIES          16
+#endif
+
+/* Number of tasks that can register regions with the policy */
+#ifndef configMPU_POLICY_TASKS
+    #define configMPU_POLICY_TASKS         8
+#endif
+
+/* Regions per task, must fit the working-set bitmap */
+#ifndef configMPU_POLICY_REGIONS_PER_TASK
+    #define configMPU_POLICY_REGIONS_PER_TASK    32
+#endif
+
+typedef struct MPU_POLICY_REGION
+{
+    void * pvBase;     /* NAPOT: power of 2 size, aligned to its size */
+    size_t xSize;
+    uint32_t ulFlags;  /* mpuREGION_* */
+} MpuPolicyRegion_t;
+
+typedef struct MPU_POLICY_STATS
+{
+    uint64_t ullFaults;       /* Access faults resolved by the policy */
+    uint64_t ullSwaps;        /* Faults that evicted a live region */
+    uint64_t ullPreloads;     /* Regions loaded ahead of use on switch-in */
+    uint64_t ullMisses;       /* Faults outside any registered region */
+    uint64_t ullFaultCycles;  /* Cycles spent resolving faults */
+    uint64_t ullSwitchCycles; /* Cycles spent preloading on switch-in */
+} MpuPolicyStats_t;
+
+/*
+ * Register xTask's regions with the policy (replaces any previous set).
+ */
+BaseType_t xMpuPolicyRegister( TaskHandle_t xTask,
+                               const MpuPolicyRegion_t * pxRegions,
+                               UBaseType_t uxCount );
+
+/*
+ * Forget xTask, releasing its slots.
+ */
+void vMpuPolicyUnregister( TaskHandle_t xTask );
+
+/*
+ * Called from the exception handler with the faulting address. Returns pdTRUE
+ * if a region was loaded and the instruction can be retried.
+ */
+BaseType_t xMpuPolicyHandleFault( uintptr_t uxAddress );
+
+/*
+ * Called on context switch-in (traceTASK_SWITCHED_IN) to preload the task's
+ * predicted working set.
+ */
+void vMpuPolicyTaskSwitchedIn( void );
+
+void vMpuPolicyGetStats( MpuPolicyStats_t * pxStats );
+void vMpuPolicyResetStats( void );
+
+/*
+ * Print the counters in the same "HPM name: value" format as the HPMs.
+ */
+void vMpuPolicyPrintStats( void );
+
+#endif /* MPU_REGIONS_H */
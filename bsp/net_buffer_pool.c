@@ -0,0 +1,283 @@
+/*
+ * Static network buffer pool, a drop-in replacement for FreeRTOS+TCP's
+ * BufferAllocation_2.c selected with --net-buffer-pool.
+ *
+ * All ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS buffers are MTU sized, cache-line
+ * aligned and allocated at link time in configNET_BUFFER_SECTION (cached SRAM
+ * on coherent virtio platforms, the uncached window on GFE where the AXI DMA is
+ * not coherent). Get/release pop/push a free list, so no frame ever goes
+ * through pvPortMalloc.
+ *
+ * Besides the usual iptraceNETWORK_BUFFER_* hooks, iptraceNETWORK_BUFFER_WAIT
+ * reports how many cycles a task blocked for a buffer when the pool was
+ * exhausted.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include "FreeRTOS_IP.h"
+#include "FreeRTOS_IP_Private.h"
+#include "NetworkInterface.h"
+#include "NetworkBufferManagement.h"
+
+#ifndef configNET_BUFFER_ALIGN
+    #define configNET_BUFFER_ALIGN    64
+#endif
+
+#ifndef configNET_BUFFER_SECTION
+    #define configNET_BUFFER_SECTION    ".netbufs"
+#endif
+
+#ifndef iptraceNETWORK_BUFFER_WAIT
+    #define iptraceNETWORK_BUFFER_WAIT( ulCycles )    ( void ) ( ulCycles )
+#endif
+
+/* Room for the descriptor back pointer (ipBUFFER_PADDING) and a full frame,
+ * rounded up so that every buffer starts on its own cache line. */
+#define netbufSLOT_SIZE                                                   \
+    ( ( ( ipBUFFER_PADDING + ipTOTAL_ETHERNET_FRAME_SIZE ) + configNET_BUFFER_ALIGN - 1 ) & \
+      ~( ( size_t ) configNET_BUFFER_ALIGN - 1 ) )
+
+#define netbufLOCK()      taskENTER_CRITICAL()
+#define netbufUNLOCK()    taskEXIT_CRITICAL()
+
+extern uint64_t get_cycle_count( void );
+
+static uint8_t ucNetworkPackets[ ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS ][ netbufSLOT_SIZE ]
+__attribute__( ( section( configNET_BUFFER_SECTION ), aligned( configNET_BUFFER_ALIGN ) ) );
+
+static NetworkBufferDescriptor_t xNetworkBuffers[ ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS ];
+static List_t xFreeBuffersList;
+
+/* Named as in BufferAllocation_x.c, the demo trace macros query it */
+static SemaphoreHandle_t xNetworkBufferSemaphore = NULL;
+
+static UBaseType_t uxMinimumFreeNetworkBuffers = ( UBaseType_t ) ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS;
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvIsValidNetworkDescriptor( const NetworkBufferDescriptor_t * pxDesc )
+{
+    uintptr_t uxOffset = ( uintptr_t ) pxDesc - ( uintptr_t ) xNetworkBuffers;
+
+    return ( ( uintptr_t ) pxDesc >= ( uintptr_t ) xNetworkBuffers ) &&
+           ( uxOffset < sizeof( xNetworkBuffers ) ) &&
+           ( ( uxOffset % sizeof( xNetworkBuffers[ 0 ] ) ) == 0 );
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xNetworkBuffersInitialise( void )
+{
+    if( xNetworkBufferSemaphore != NULL )
+    {
+        return pdPASS;
+    }
+
+    xNetworkBufferSemaphore = xSemaphoreCreateCounting( ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS,
+                                                        ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS );
+    configASSERT( xNetworkBufferSemaphore != NULL );
+
+    if( xNetworkBufferSemaphore == NULL )
+    {
+        return pdFAIL;
+    }
+
+    #if ( configQUEUE_REGISTRY_SIZE > 0 )
+        vQueueAddToRegistry( xNetworkBufferSemaphore, "NetBufSem" );
+    #endif
+
+    vListInitialise( &xFreeBuffersList );
+
+    for( UBaseType_t x = 0; x < ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS; x++ )
+    {
+        NetworkBufferDescriptor_t * pxDesc = &xNetworkBuffers[ x ];
+
+        vListInitialiseItem( &( pxDesc->xBufferListItem ) );
+        listSET_LIST_ITEM_OWNER( &( pxDesc->xBufferListItem ), pxDesc );
+
+        /* The stack finds the descriptor from the payload through the pointer
+         * stored in the padding in front of it. */
+        pxDesc->pucEthernetBuffer = &ucNetworkPackets[ x ][ ipBUFFER_PADDING ];
+        *( ( NetworkBufferDescriptor_t ** ) &ucNetworkPackets[ x ][ 0 ] ) = pxDesc;
+
+        vListInsertEnd( &xFreeBuffersList, &( pxDesc->xBufferListItem ) );
+    }
+
+    uxMinimumFreeNetworkBuffers = ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS;
+
+    return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+static NetworkBufferDescriptor_t * prvTakeFreeBuffer( size_t xRequestedSizeBytes )
+{
+    NetworkBufferDescriptor_t * pxReturn;
+    UBaseType_t uxCount;
+
+    pxReturn = ( NetworkBufferDescriptor_t * ) listGET_OWNER_OF_HEAD_ENTRY( &xFreeBuffersList );
+    configASSERT( prvIsValidNetworkDescriptor( pxReturn ) );
+    ( void ) uxListRemove( &( pxReturn->xBufferListItem ) );
+
+    uxCount = listCURRENT_LIST_LENGTH( &xFreeBuffersList );
+
+    if( uxMinimumFreeNetworkBuffers > uxCount )
+    {
+        uxMinimumFreeNetworkBuffers = uxCount;
+    }
+
+    pxReturn->xDataLength = xRequestedSizeBytes;
+
+    #if ( ipconfigUSE_LINKED_RX_MESSAGES != 0 )
+        pxReturn->pxNextBuffer = NULL;
+    #endif
+
+    return pxReturn;
+}
+/*-----------------------------------------------------------*/
+
+NetworkBufferDescriptor_t * pxGetNetworkBufferWithDescriptor( size_t xRequestedSizeBytes,
+                                                              TickType_t xBlockTimeTicks )
+{
+    NetworkBufferDescriptor_t * pxReturn = NULL;
+    BaseType_t xTaken;
+
+    if( ( xNetworkBufferSemaphore == NULL ) || ( xRequestedSizeBytes > ipTOTAL_ETHERNET_FRAME_SIZE ) )
+    {
+        iptraceFAILED_TO_OBTAIN_NETWORK_BUFFER();
+        return NULL;
+    }
+
+    /* Common case first: a buffer is free, no need to timestamp anything */
+    xTaken = xSemaphoreTake( xNetworkBufferSemaphore, 0 );
+
+    if( ( xTaken != pdPASS ) && ( xBlockTimeTicks != 0 ) )
+    {
+        uint64_t ullStart = get_cycle_count();
+
+        xTaken = xSemaphoreTake( xNetworkBufferSemaphore, xBlockTimeTicks );
+        iptraceNETWORK_BUFFER_WAIT( ( uint32_t ) ( get_cycle_count() - ullStart ) );
+    }
+
+    if( xTaken == pdPASS )
+    {
+        netbufLOCK();
+        {
+            pxReturn = prvTakeFreeBuffer( xRequestedSizeBytes );
+        }
+        netbufUNLOCK();
+
+        iptraceNETWORK_BUFFER_OBTAINED( pxReturn );
+    }
+    else
+    {
+        iptraceFAILED_TO_OBTAIN_NETWORK_BUFFER();
+    }
+
+    return pxReturn;
+}
+/*-----------------------------------------------------------*/
+
+NetworkBufferDescriptor_t * pxNetworkBufferGetFromISR( size_t xRequestedSizeBytes )
+{
+    NetworkBufferDescriptor_t * pxReturn = NULL;
+    UBaseType_t uxSavedInterruptStatus;
+
+    if( ( xNetworkBufferSemaphore != NULL ) &&
+        ( xRequestedSizeBytes <= ipTOTAL_ETHERNET_FRAME_SIZE ) &&
+        ( xSemaphoreTakeFromISR( xNetworkBufferSemaphore, NULL ) == pdPASS ) )
+    {
+        uxSavedInterruptStatus = portSET_INTERRUPT_MASK_FROM_ISR();
+        {
+            pxReturn = prvTakeFreeBuffer( xRequestedSizeBytes );
+        }
+        portCLEAR_INTERRUPT_MASK_FROM_ISR( uxSavedInterruptStatus );
+
+        iptraceNETWORK_BUFFER_OBTAINED_FROM_ISR( pxReturn );
+    }
+    else
+    {
+        iptraceFAILED_TO_OBTAIN_NETWORK_BUFFER_FROM_ISR();
+    }
+
+    return pxReturn;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t vNetworkBufferReleaseFromISR( NetworkBufferDescriptor_t * const pxNetworkBuffer )
+{
+    UBaseType_t uxSavedInterruptStatus;
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+    configASSERT( prvIsValidNetworkDescriptor( pxNetworkBuffer ) );
+
+    uxSavedInterruptStatus = portSET_INTERRUPT_MASK_FROM_ISR();
+    {
+        vListInsertEnd( &xFreeBuffersList, &( pxNetworkBuffer->xBufferListItem ) );
+    }
+    portCLEAR_INTERRUPT_MASK_FROM_ISR( uxSavedInterruptStatus );
+
+    ( void ) xSemaphoreGiveFromISR( xNetworkBufferSemaphore, &xHigherPriorityTaskWoken );
+    iptraceNETWORK_BUFFER_RELEASED( pxNetworkBuffer );
+
+    return xHigherPriorityTaskWoken;
+}
+/*-----------------------------------------------------------*/
+
+void vReleaseNetworkBufferAndDescriptor( NetworkBufferDescriptor_t * const pxNetworkBuffer )
+{
+    BaseType_t xListItemAlreadyInFreeList;
+
+    configASSERT( prvIsValidNetworkDescriptor( pxNetworkBuffer ) );
+
+    netbufLOCK();
+    {
+        xListItemAlreadyInFreeList = listIS_CONTAINED_WITHIN( &xFreeBuffersList, &( pxNetworkBuffer->xBufferListItem ) );
+
+        if( xListItemAlreadyInFreeList == pdFALSE )
+        {
+            vListInsertEnd( &xFreeBuffersList, &( pxNetworkBuffer->xBufferListItem ) );
+        }
+    }
+    netbufUNLOCK();
+
+    if( xListItemAlreadyInFreeList != pdFALSE )
+    {
+        FreeRTOS_debug_printf( ( "vReleaseNetworkBufferAndDescriptor: %p already released\n", pxNetworkBuffer ) );
+        return;
+    }
+
+    ( void ) xSemaphoreGive( xNetworkBufferSemaphore );
+    iptraceNETWORK_BUFFER_RELEASED( pxNetworkBuffer );
+}
+/*-----------------------------------------------------------*/
+
+NetworkBufferDescriptor_t * pxResizeNetworkBufferWithDescriptor( NetworkBufferDescriptor_t * pxNetworkBuffer,
+                                                                 size_t xNewSizeBytes )
+{
+    /* Every buffer already holds a full frame */
+    if( xNewSizeBytes > ipTOTAL_ETHERNET_FRAME_SIZE )
+    {
+        return NULL;
+    }
+
+    pxNetworkBuffer->xDataLength = xNewSizeBytes;
+
+    return pxNetworkBuffer;
+}
+/*-----------------------------------------------------------*/
+
+UBaseType_t uxGetMinimumFreeNetworkBuffers( void )
+{
+    return uxMinimumFreeNetworkBuffers;
+}
+/*-----------------------------------------------------------*/
+
+UBaseType_t uxGetNumberOfFreeNetworkBuffers( void )
+{
+    return listCURRENT_LIST_LENGTH( &xFreeBuffersList );
+}
+/*-----------------------------------------------------------*/
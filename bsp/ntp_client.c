@@ -0,0 +1,502 @@
+/*
+ * SNTP client (RFC 4330) feeding the clock discipline of bsp/clock.c.
+ *
+ * Every configNTP_CLIENT_POLL_S seconds the client sends a burst of
+ * configNTP_CLIENT_BURST requests, one at a time. Each reply gives the four
+ * timestamps of the exchange: T1 when the request left, T2 and T3 when the
+ * server received it and answered, T4 when the answer came back, so
+ *
+ *   offset = ( ( T2 - T1 ) + ( T3 - T4 ) ) / 2
+ *   delay  = ( T4 - T1 ) - ( T3 - T2 )
+ *
+ * The offset is exact when both directions take as long, and off by at most
+ * half the delay otherwise. Queueing mostly adds delay one way, so of the
+ * samples of a burst the one with the shortest round trip is the most
+ * trustworthy: that one alone goes to vClockUpdate(). Samples with a round
+ * trip over configNTP_CLIENT_MAX_DELAY_MS are not used at all.
+ *
+ * T1 goes out in the request's transmit timestamp, which the server echoes in
+ * the originate timestamp. A reply is only accepted when it matches the
+ * request outstanding, which rules out duplicates, late and forged replies.
+ * The round trip is measured on the monotonic clock, so it is not affected
+ * by the wall clock being steered meanwhile.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include "FreeRTOS_IP.h"
+#include "FreeRTOS_Sockets.h"
+
+#include "clock.h"
+#include "dns_resolver.h"
+#include "ntp_client.h"
+
+#define ntpclientPORT              123
+#define ntpclientPACKET_SIZE       48
+
+/* LI 0, version 4, mode 3 (client) */
+#define ntpclientREQUEST_FLAGS     0x23
+#define ntpclientMODE_SERVER       4
+#define ntpclientLI_UNSYNCHRONISED 3
+
+#define ntpclientORIGINATE         24
+#define ntpclientRECEIVE           32
+#define ntpclientTRANSMIT          40
+
+/* Seconds from 1900, the NTP epoch, to 1970 */
+#define ntpclientEPOCH_OFFSET      2208988800ULL
+
+/* How often the client task checks for requests to send or time out */
+#define ntpclientPOLL_PERIOD       pdMS_TO_TICKS( 50 )
+
+static TaskHandle_t xClientTask = NULL;
+static Socket_t xSocket = NULL;
+
+/* Everything below is protected by xLock */
+static SemaphoreHandle_t xLock = NULL;
+static NTPClientStats_t xStats;
+static NTPClientTransport_t pxTransport = NULL;
+static const char * const * ppcServerNames = NULL;
+static UBaseType_t uxServerCount = 0;
+static UBaseType_t uxServerIndex = 0;
+static uint32_t ulFixedAddress = 0;
+static uint16_t usFixedPort = 0;
+
+/* The burst in progress */
+static BaseType_t xBurstActive = pdFALSE;
+static TickType_t xIdleSince = 0;
+static TickType_t xIdlePeriod = 0; /* Before the next burst */
+static uint32_t ulBurstAddress = 0;
+static uint16_t usBurstPort = 0;
+static UBaseType_t uxBurstSent = 0;
+static BaseType_t xHaveSample = pdFALSE;
+static int64_t llBestOffsetNs = 0;
+static uint64_t ullBestDelayNs = 0;
+static uint64_t ullBestWhenNs = 0;
+
+/* The request outstanding */
+static BaseType_t xOutstanding = pdFALSE;
+static TickType_t xLastSent = 0;
+static uint64_t ullRequestStamp = 0;
+static int64_t llT1Ns = 0;
+static uint64_t ullT1MonoNs = 0;
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvExpired( TickType_t xStarted,
+                              TickType_t xPeriod,
+                              TickType_t xNow )
+{
+    /* Wrap-safe as long as xPeriod stays below half the tick range */
+    return ( ( TickType_t ) ( xNow - xStarted ) >= xPeriod ) ? pdTRUE : pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+static uint64_t prvRead64( const uint8_t * pucData )
+{
+    uint64_t ullValue = 0;
+
+    for( int i = 0; i < 8; i++ )
+    {
+        ullValue = ( ullValue << 8 ) | pucData[ i ];
+    }
+
+    return ullValue;
+}
+/*-----------------------------------------------------------*/
+
+static void prvWrite64( uint8_t * pucData,
+                        uint64_t ullValue )
+{
+    for( int i = 7; i >= 0; i-- )
+    {
+        pucData[ i ] = ( uint8_t ) ullValue;
+        ullValue >>= 8;
+    }
+}
+/*-----------------------------------------------------------*/
+
+/* Nanoseconds since 1970 to 32.32 fixed point seconds since 1900 */
+static uint64_t prvToTimestamp( int64_t llNs )
+{
+    uint64_t ullSeconds, ullFraction;
+
+    if( llNs < 0 )
+    {
+        llNs = 0;
+    }
+
+    ullSeconds = ( uint64_t ) ( llNs / clockNS_PER_SECOND ) + ntpclientEPOCH_OFFSET;
+    ullFraction = ( ( uint64_t ) ( llNs % clockNS_PER_SECOND ) << 32 ) / clockNS_PER_SECOND;
+
+    /* Only the low 32 bits of the seconds are sent, the era is implied */
+    return ( ullSeconds << 32 ) | ullFraction;
+}
+/*-----------------------------------------------------------*/
+
+static int64_t prvFromTimestamp( uint64_t ullTimestamp )
+{
+    uint64_t ullSeconds = ullTimestamp >> 32;
+    uint64_t ullFraction = ullTimestamp & 0xFFFFFFFFULL;
+
+    /* RFC 4330: with the top bit clear the time is in the era from 2036 */
+    if( ( ullSeconds & 0x80000000ULL ) == 0 )
+    {
+        ullSeconds += 0x100000000ULL;
+    }
+
+    return ( int64_t ) ( ullSeconds - ntpclientEPOCH_OFFSET ) * clockNS_PER_SECOND +
+           ( int64_t ) ( ( ullFraction * clockNS_PER_SECOND ) >> 32 );
+}
+/*-----------------------------------------------------------*/
+
+/* With the lock held; a failed send times out like a lost reply */
+static void prvSendRequest( void )
+{
+    uint8_t ucRequest[ ntpclientPACKET_SIZE ];
+
+    memset( ucRequest, 0, sizeof( ucRequest ) );
+    ucRequest[ 0 ] = ntpclientREQUEST_FLAGS;
+
+    xOutstanding = pdTRUE;
+    xLastSent = xTaskGetTickCount();
+    uxBurstSent++;
+    xStats.ulRequests++;
+
+    /* As late as possible, the time to build the request is not round trip */
+    ullT1MonoNs = ullClockMonotonicNs();
+    llT1Ns = llClockRealtimeNs();
+    ullRequestStamp = prvToTimestamp( llT1Ns );
+    prvWrite64( &ucRequest[ ntpclientTRANSMIT ], ullRequestStamp );
+
+    if( pxTransport != NULL )
+    {
+        ( void ) pxTransport( ucRequest, sizeof( ucRequest ) );
+    }
+    else if( ( xSocket != NULL ) && ( ulBurstAddress != 0 ) )
+    {
+        struct freertos_sockaddr xServer;
+
+        xServer.sin_addr = ulBurstAddress;
+        xServer.sin_port = usBurstPort;
+
+        ( void ) FreeRTOS_sendto( xSocket, ucRequest, sizeof( ucRequest ), 0, &xServer, sizeof( xServer ) );
+    }
+}
+/*-----------------------------------------------------------*/
+
+void vNTPClientInput( const uint8_t * pucReply,
+                      size_t uxLength )
+{
+    /* T4, before anything else */
+    uint64_t ullT4MonoNs = ullClockMonotonicNs();
+    int64_t llT4Ns = llClockRealtimeNs();
+    int64_t llT2Ns, llT3Ns, llOffsetNs, llDelayNs;
+
+    if( xLock == NULL )
+    {
+        return;
+    }
+
+    xSemaphoreTake( xLock, portMAX_DELAY );
+
+    if( ( xOutstanding == pdFALSE ) || ( uxLength < ntpclientPACKET_SIZE ) ||
+        ( prvRead64( &pucReply[ ntpclientORIGINATE ] ) != ullRequestStamp ) )
+    {
+        xStats.ulUnexpected++;
+        xSemaphoreGive( xLock );
+        return;
+    }
+
+    xOutstanding = pdFALSE;
+
+    /* Stratum 0 is a kiss-o'-death, a server that wants no more requests */
+    if( ( ( pucReply[ 0 ] & 0x07 ) != ntpclientMODE_SERVER ) ||
+        ( ( pucReply[ 0 ] >> 6 ) == ntpclientLI_UNSYNCHRONISED ) ||
+        ( pucReply[ 1 ] == 0 ) || ( pucReply[ 1 ] > 15 ) ||
+        ( prvRead64( &pucReply[ ntpclientTRANSMIT ] ) == 0 ) )
+    {
+        xStats.ulRejected++;
+        xSemaphoreGive( xLock );
+        return;
+    }
+
+    llT2Ns = prvFromTimestamp( prvRead64( &pucReply[ ntpclientRECEIVE ] ) );
+    llT3Ns = prvFromTimestamp( prvRead64( &pucReply[ ntpclientTRANSMIT ] ) );
+
+    llOffsetNs = ( ( llT2Ns - llT1Ns ) + ( llT3Ns - llT4Ns ) ) / 2;
+    llDelayNs = ( int64_t ) ( ullT4MonoNs - ullT1MonoNs ) - ( llT3Ns - llT2Ns );
+
+    if( llDelayNs < 0 )
+    {
+        llDelayNs = 0;
+    }
+
+    xStats.ulReplies++;
+
+    if( ( xStats.ullMinDelayNs == 0 ) || ( ( uint64_t ) llDelayNs < xStats.ullMinDelayNs ) )
+    {
+        xStats.ullMinDelayNs = ( uint64_t ) llDelayNs;
+    }
+
+    if( llDelayNs > configNTP_CLIENT_MAX_DELAY_MS * 1000000LL )
+    {
+        xStats.ulDiscarded++;
+    }
+    else if( ( xHaveSample == pdFALSE ) || ( ( uint64_t ) llDelayNs < ullBestDelayNs ) )
+    {
+        xHaveSample = pdTRUE;
+        llBestOffsetNs = llOffsetNs;
+        ullBestDelayNs = ( uint64_t ) llDelayNs;
+        ullBestWhenNs = ullT4MonoNs;
+    }
+
+    xSemaphoreGive( xLock );
+}
+/*-----------------------------------------------------------*/
+
+/* Address of the server to use for the next burst, 0 if there is none */
+static uint32_t prvResolveServer( uint16_t * pusPort )
+{
+    const char * pcName = NULL;
+    uint32_t ulAddress;
+
+    xSemaphoreTake( xLock, portMAX_DELAY );
+
+    ulAddress = ulFixedAddress;
+    *pusPort = ( usFixedPort != 0 ) ? usFixedPort : FreeRTOS_htons( ntpclientPORT );
+
+    /* A transport has no use for an address */
+    if( ( pxTransport == NULL ) && ( ulAddress == 0 ) && ( uxServerCount != 0 ) )
+    {
+        pcName = ppcServerNames[ uxServerIndex % uxServerCount ];
+    }
+
+    xSemaphoreGive( xLock );
+
+    /* Blocks, so without the lock */
+    if( pcName != NULL )
+    {
+        ulAddress = ulDNSResolverGetHostByName( pcName, pdMS_TO_TICKS( configNTP_CLIENT_TIMEOUT_MS ) );
+    }
+
+    return ulAddress;
+}
+/*-----------------------------------------------------------*/
+
+/* Time out the request outstanding, send the next one, close the burst */
+static void prvCheckBurst( void )
+{
+    TickType_t xNow = xTaskGetTickCount();
+    BaseType_t xUpdate = pdFALSE;
+    int64_t llOffsetNs = 0;
+    uint64_t ullDelayNs = 0, ullWhenNs = 0;
+
+    xSemaphoreTake( xLock, portMAX_DELAY );
+
+    if( ( xOutstanding != pdFALSE ) &&
+        ( prvExpired( xLastSent, pdMS_TO_TICKS( configNTP_CLIENT_TIMEOUT_MS ), xNow ) != pdFALSE ) )
+    {
+        xStats.ulTimeouts++;
+        xOutstanding = pdFALSE;
+    }
+
+    if( ( xBurstActive != pdFALSE ) && ( xOutstanding == pdFALSE ) )
+    {
+        if( uxBurstSent < configNTP_CLIENT_BURST )
+        {
+            if( prvExpired( xLastSent, pdMS_TO_TICKS( configNTP_CLIENT_BURST_SPACING_MS ), xNow ) != pdFALSE )
+            {
+                prvSendRequest();
+            }
+        }
+        else if( xHaveSample != pdFALSE )
+        {
+            xStats.ulBursts++;
+            xStats.llLastOffsetNs = llBestOffsetNs;
+            xStats.ullLastDelayNs = ullBestDelayNs;
+            xBurstActive = pdFALSE;
+            xIdleSince = xNow;
+            xIdlePeriod = pdMS_TO_TICKS( configNTP_CLIENT_POLL_S * 1000UL );
+
+            xUpdate = pdTRUE;
+            llOffsetNs = llBestOffsetNs;
+            ullDelayNs = ullBestDelayNs;
+            ullWhenNs = ullBestWhenNs;
+        }
+        else
+        {
+            xStats.ulEmptyBursts++;
+            uxServerIndex++;
+            xBurstActive = pdFALSE;
+            xIdleSince = xNow;
+            xIdlePeriod = pdMS_TO_TICKS( configNTP_CLIENT_RETRY_S * 1000UL );
+        }
+    }
+
+    xSemaphoreGive( xLock );
+
+    /* This task is the only one that updates the clock */
+    if( xUpdate != pdFALSE )
+    {
+        vClockUpdate( llOffsetNs, ullDelayNs, ullWhenNs );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void prvStartBurst( void )
+{
+    uint16_t usPort;
+    uint32_t ulAddress;
+
+    xSemaphoreTake( xLock, portMAX_DELAY );
+
+    if( ( xBurstActive != pdFALSE ) ||
+        ( prvExpired( xIdleSince, xIdlePeriod, xTaskGetTickCount() ) == pdFALSE ) )
+    {
+        xSemaphoreGive( xLock );
+        return;
+    }
+
+    xSemaphoreGive( xLock );
+
+    ulAddress = prvResolveServer( &usPort );
+
+    xSemaphoreTake( xLock, portMAX_DELAY );
+
+    xStats.ulServerAddress = ulAddress;
+    ulBurstAddress = ulAddress;
+    usBurstPort = usPort;
+    xHaveSample = pdFALSE;
+    xBurstActive = pdTRUE;
+
+    /* An unresolved server still makes a burst, which times out and moves on
+     * to the next one */
+    uxBurstSent = 0;
+    xLastSent = xTaskGetTickCount() - pdMS_TO_TICKS( configNTP_CLIENT_BURST_SPACING_MS );
+
+    xSemaphoreGive( xLock );
+}
+/*-----------------------------------------------------------*/
+
+static void prvClientTask( void * pvParameters )
+{
+    struct freertos_sockaddr xAddress;
+    const TickType_t xReceiveTimeout = ntpclientPOLL_PERIOD;
+    uint32_t ulAddressLength = sizeof( xAddress );
+    uint8_t * pucReply;
+    int32_t lBytes;
+    Socket_t xNewSocket;
+
+    ( void ) pvParameters;
+
+    xNewSocket = FreeRTOS_socket( FREERTOS_AF_INET, FREERTOS_SOCK_DGRAM, FREERTOS_IPPROTO_UDP );
+    configASSERT( xNewSocket != FREERTOS_INVALID_SOCKET );
+
+    FreeRTOS_setsockopt( xNewSocket, 0, FREERTOS_SO_RCVTIMEO, &xReceiveTimeout, sizeof( xReceiveTimeout ) );
+
+    /* Any local port */
+    xAddress.sin_addr = 0;
+    xAddress.sin_port = 0;
+    FreeRTOS_bind( xNewSocket, &xAddress, sizeof( xAddress ) );
+
+    xSocket = xNewSocket;
+
+    for( ; ; )
+    {
+        lBytes = FreeRTOS_recvfrom( xSocket, &pucReply, 0, FREERTOS_ZERO_COPY, &xAddress, &ulAddressLength );
+
+        if( lBytes > 0 )
+        {
+            vNTPClientInput( pucReply, ( size_t ) lBytes );
+            FreeRTOS_ReleaseUDPPayloadBuffer( pucReply );
+        }
+
+        prvStartBurst();
+        prvCheckBurst();
+    }
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xNTPClientStart( const char * const * ppcServers,
+                            UBaseType_t uxServers,
+                            uint16_t usStackSize,
+                            UBaseType_t uxPriority )
+{
+    BaseType_t xReturn = pdPASS;
+
+    vTaskSuspendAll();
+    {
+        if( xLock == NULL )
+        {
+            xLock = xSemaphoreCreateMutex();
+            xReturn = ( xLock != NULL ) ? pdPASS : pdFAIL;
+        }
+
+        if( ( xReturn == pdPASS ) && ( xClientTask == NULL ) )
+        {
+            /* The first burst goes out right away */
+            ppcServerNames = ppcServers;
+            uxServerCount = uxServers;
+
+            xReturn = xTaskCreate( prvClientTask, "NTPClient", usStackSize, NULL, uxPriority, &xClientTask );
+        }
+    }
+    ( void ) xTaskResumeAll();
+
+    return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+void vNTPClientSetServer( uint32_t ulIPAddress,
+                          uint16_t usPort )
+{
+    configASSERT( xLock != NULL );
+
+    xSemaphoreTake( xLock, portMAX_DELAY );
+    ulFixedAddress = ulIPAddress;
+    usFixedPort = usPort;
+    xSemaphoreGive( xLock );
+}
+/*-----------------------------------------------------------*/
+
+void vNTPClientSetTransport( NTPClientTransport_t pxNewTransport )
+{
+    configASSERT( xLock != NULL );
+
+    xSemaphoreTake( xLock, portMAX_DELAY );
+    pxTransport = pxNewTransport;
+    xSemaphoreGive( xLock );
+}
+/*-----------------------------------------------------------*/
+
+void vNTPClientPoll( void )
+{
+    if( xLock == NULL )
+    {
+        return;
+    }
+
+    xSemaphoreTake( xLock, portMAX_DELAY );
+    xIdlePeriod = 0;
+    xSemaphoreGive( xLock );
+}
+/*-----------------------------------------------------------*/
+
+void vNTPClientGetStats( NTPClientStats_t * pxStats )
+{
+    if( xLock == NULL )
+    {
+        memset( pxStats, 0, sizeof( *pxStats ) );
+        return;
+    }
+
+    xSemaphoreTake( xLock, portMAX_DELAY );
+    *pxStats = xStats;
+    xSemaphoreGive( xLock );
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,99 @@
+/**
+ * SNTP client disciplining the wall clock of bsp/clock.c (bsp/ntp_client.c).
+ */
+#ifndef NTP_CLIENT_H
+#define NTP_CLIENT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "FreeRTOS.h"
+
+/* Requests in one burst; the one with the shortest round trip is used */
+#ifndef configNTP_CLIENT_BURST
+    #define configNTP_CLIENT_BURST            4
+#endif
+
+/* Milliseconds between the requests of a burst */
+#ifndef configNTP_CLIENT_BURST_SPACING_MS
+    #define configNTP_CLIENT_BURST_SPACING_MS 2000
+#endif
+
+/* Seconds between bursts */
+#ifndef configNTP_CLIENT_POLL_S
+    #define configNTP_CLIENT_POLL_S           64
+#endif
+
+/* Seconds before trying again after a burst that got no usable reply */
+#ifndef configNTP_CLIENT_RETRY_S
+    #define configNTP_CLIENT_RETRY_S          8
+#endif
+
+/* Milliseconds a request waits for its reply */
+#ifndef configNTP_CLIENT_TIMEOUT_MS
+    #define configNTP_CLIENT_TIMEOUT_MS       1000
+#endif
+
+/* Replies that took longer than this round trip (milliseconds) are discarded,
+ * the offset error can be up to half of it */
+#ifndef configNTP_CLIENT_MAX_DELAY_MS
+    #define configNTP_CLIENT_MAX_DELAY_MS     500
+#endif
+
+/* Sends one request; replies are passed back with vNTPClientInput() */
+typedef BaseType_t (* NTPClientTransport_t)( const uint8_t * pucRequest,
+                                             size_t uxLength );
+
+typedef struct NTP_CLIENT_STATS
+{
+    uint32_t ulRequests;      /* Requests sent */
+    uint32_t ulReplies;       /* Replies that made a sample */
+    uint32_t ulRejected;      /* Malformed, unsynchronised or kiss-o'-death */
+    uint32_t ulUnexpected;    /* Not an answer to the outstanding request */
+    uint32_t ulTimeouts;      /* Requests that got no reply in time */
+    uint32_t ulDiscarded;     /* Samples over configNTP_CLIENT_MAX_DELAY_MS */
+    uint32_t ulBursts;        /* Bursts that updated the clock */
+    uint32_t ulEmptyBursts;   /* Bursts without a sample, each moves on to the next server */
+    int64_t llLastOffsetNs;   /* Of the sample last used */
+    uint64_t ullLastDelayNs;
+    uint64_t ullMinDelayNs;   /* Shortest round trip seen, 0 for none */
+    uint32_t ulServerAddress; /* Last server queried, network byte order */
+} NTPClientStats_t;
+
+/*
+ * Create the client task, which sends a burst of requests every
+ * configNTP_CLIENT_POLL_S seconds and steers the wall clock with the best
+ * sample of each. ppcServers (uxServers names, kept by the caller) are
+ * resolved with the resolver of bsp/dns_resolver.c and tried in turn, moving
+ * on whenever a burst gets no usable reply. Safe to call more than once.
+ */
+BaseType_t xNTPClientStart( const char * const * ppcServers,
+                            UBaseType_t uxServers,
+                            uint16_t usStackSize,
+                            UBaseType_t uxPriority );
+
+/*
+ * Query ulIPAddress:usPort (network byte order) instead of the server list,
+ * port 123 when usPort is 0. An address of 0 restores the list.
+ */
+void vNTPClientSetServer( uint32_t ulIPAddress,
+                          uint16_t usPort );
+
+/*
+ * Send requests with pxTransport instead of the client's socket, NULL
+ * restores it. Used by the stub responder (bsp/ntp_stub.c).
+ */
+void vNTPClientSetTransport( NTPClientTransport_t pxTransport );
+
+/* Start a burst now rather than at the end of the poll interval */
+void vNTPClientPoll( void );
+
+void vNTPClientGetStats( NTPClientStats_t * pxStats );
+
+/*
+ * Hand an NTP reply to the client, from any task, as soon as it arrives: the
+ * time of the call is taken as the time it was received.
+ */
+void vNTPClientInput( const uint8_t * pucReply,
+                      size_t uxLength );
+
+#endif /* NTP_CLIENT_H */
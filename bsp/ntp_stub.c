@@ -0,0 +1,159 @@
+/*
+ * Stub NTP server, so the client (bsp/ntp_client.c) and the clock discipline
+ * can be exercised without a network or an NTP server.
+ *
+ * xNTPStubStart() installs itself as the client's transport: requests are
+ * queued to the responder task, which waits a random delay to stand in for
+ * the way out, answers from its own clock and waits another random delay for
+ * the way back before handing the reply to vNTPClientInput(). The stub's
+ * clock is the monotonic clock plus configNTP_STUB_DRIFT_PPB, started at
+ * configNTP_STUB_EPOCH_S, so the client has an offset to step away, a drift
+ * to estimate and asymmetric round trips to filter.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+#include "clock.h"
+#include "rand.h"
+#include "ntp_client.h"
+#include "ntp_stub.h"
+
+#define ntpstubPACKET_SIZE     48
+#define ntpstubQUEUE_LENGTH    4
+
+/* Seconds from 1900, the NTP epoch, to 1970 */
+#define ntpstubEPOCH_OFFSET    2208988800ULL
+
+typedef struct NTP_STUB_REQUEST
+{
+    uint8_t ucRequest[ ntpstubPACKET_SIZE ];
+} NTPStubRequest_t;
+
+static QueueHandle_t xRequests = NULL;
+static volatile int64_t llAdjustNs = 0;
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvTransport( const uint8_t * pucRequest,
+                                size_t uxLength )
+{
+    NTPStubRequest_t xRequest;
+
+    if( uxLength != sizeof( xRequest.ucRequest ) )
+    {
+        return pdFAIL;
+    }
+
+    memcpy( xRequest.ucRequest, pucRequest, uxLength );
+
+    /* Called with the client's lock held, a full queue is a lost request */
+    return xQueueSend( xRequests, &xRequest, 0 );
+}
+/*-----------------------------------------------------------*/
+
+/* The stub's clock as an NTP timestamp */
+static uint64_t prvReferenceTime( void )
+{
+    uint64_t ullMonotonic = ullClockMonotonicNs();
+    int64_t llAdjust;
+    uint64_t ullNs;
+
+    taskENTER_CRITICAL();
+    {
+        llAdjust = llAdjustNs;
+    }
+    taskEXIT_CRITICAL();
+
+    ullNs = ullMonotonic +
+            ( ullMonotonic / clockNS_PER_SECOND ) * configNTP_STUB_DRIFT_PPB +
+            ( ullMonotonic % clockNS_PER_SECOND ) * configNTP_STUB_DRIFT_PPB / clockNS_PER_SECOND;
+    ullNs = ( uint64_t ) ( ( int64_t ) ullNs + llAdjust ) + configNTP_STUB_EPOCH_S * clockNS_PER_SECOND;
+
+    return ( ( ullNs / clockNS_PER_SECOND + ntpstubEPOCH_OFFSET ) << 32 ) |
+           ( ( ( ullNs % clockNS_PER_SECOND ) << 32 ) / clockNS_PER_SECOND );
+}
+/*-----------------------------------------------------------*/
+
+static void prvWrite64( uint8_t * pucData,
+                        uint64_t ullValue )
+{
+    for( int i = 7; i >= 0; i-- )
+    {
+        pucData[ i ] = ( uint8_t ) ullValue;
+        ullValue >>= 8;
+    }
+}
+/*-----------------------------------------------------------*/
+
+static TickType_t prvNetworkDelay( void )
+{
+    return pdMS_TO_TICKS( configNTP_STUB_DELAY_MIN_MS +
+                          uxRand() % ( configNTP_STUB_DELAY_MAX_MS - configNTP_STUB_DELAY_MIN_MS + 1 ) );
+}
+/*-----------------------------------------------------------*/
+
+static void prvStubTask( void * pvParameters )
+{
+    static NTPStubRequest_t xRequest;
+    static uint8_t ucReply[ ntpstubPACKET_SIZE ];
+
+    ( void ) pvParameters;
+
+    for( ; ; )
+    {
+        xQueueReceive( xRequests, &xRequest, portMAX_DELAY );
+        vTaskDelay( prvNetworkDelay() );
+
+        memset( ucReply, 0, sizeof( ucReply ) );
+        prvWrite64( &ucReply[ 32 ], prvReferenceTime() );    /* Receive */
+
+        ucReply[ 0 ] = 0x24;                                  /* LI 0, version 4, mode 4 (server) */
+        ucReply[ 1 ] = 1;                                     /* Stratum */
+        ucReply[ 2 ] = xRequest.ucRequest[ 2 ];               /* Poll */
+        ucReply[ 3 ] = ( uint8_t ) -20;                       /* Precision, about a microsecond */
+        memcpy( &ucReply[ 12 ], "STUB", 4 );                  /* Reference ID */
+        memcpy( &ucReply[ 24 ], &xRequest.ucRequest[ 40 ], 8 ); /* Originate */
+        prvWrite64( &ucReply[ 16 ], prvReferenceTime() );    /* Reference */
+        prvWrite64( &ucReply[ 40 ], prvReferenceTime() );    /* Transmit */
+
+        vTaskDelay( prvNetworkDelay() );
+        vNTPClientInput( ucReply, sizeof( ucReply ) );
+    }
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xNTPStubStart( uint16_t usStackSize,
+                          UBaseType_t uxPriority )
+{
+    if( xRequests != NULL )
+    {
+        return pdPASS;
+    }
+
+    xRequests = xQueueCreate( ntpstubQUEUE_LENGTH, sizeof( NTPStubRequest_t ) );
+
+    if( ( xRequests == NULL ) ||
+        ( xTaskCreate( prvStubTask, "NTPStub", usStackSize, NULL, uxPriority, NULL ) != pdPASS ) )
+    {
+        return pdFAIL;
+    }
+
+    vNTPClientSetTransport( prvTransport );
+
+    return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+void vNTPStubAdjust( int64_t llOffsetNs )
+{
+    taskENTER_CRITICAL();
+    {
+        llAdjustNs += llOffsetNs;
+    }
+    taskEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
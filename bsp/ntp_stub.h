@@ -0,0 +1,42 @@
+/**
+ * In-process stub NTP server for the client (bsp/ntp_stub.c).
+ */
+#ifndef NTP_STUB_H
+#define NTP_STUB_H
+
+#include <stdint.h>
+#include "FreeRTOS.h"
+
+/* The stub's time at boot, in seconds since 1970 */
+#ifndef configNTP_STUB_EPOCH_S
+    #define configNTP_STUB_EPOCH_S       1700000000LL
+#endif
+
+/* How much faster the stub's clock runs than the cycle counter, in parts per
+ * billion, for the client's frequency estimate to take up */
+#ifndef configNTP_STUB_DRIFT_PPB
+    #define configNTP_STUB_DRIFT_PPB     25000
+#endif
+
+/* Simulated network delay each way, drawn from this range (milliseconds) so
+ * that round trips vary and are not symmetric */
+#ifndef configNTP_STUB_DELAY_MIN_MS
+    #define configNTP_STUB_DELAY_MIN_MS  1
+#endif
+
+#ifndef configNTP_STUB_DELAY_MAX_MS
+    #define configNTP_STUB_DELAY_MAX_MS  12
+#endif
+
+/*
+ * Create the responder task and route the client's requests to it, so that
+ * the clock discipline works without a network or an NTP server. The client
+ * must have been started (xNTPClientStart()).
+ */
+BaseType_t xNTPStubStart( uint16_t usStackSize,
+                          UBaseType_t uxPriority );
+
+/* Move the stub's clock by llOffsetNs, to exercise slewing and stepping */
+void vNTPStubAdjust( int64_t llOffsetNs );
+
+#endif /* NTP_STUB_H */
@@ -0,0 +1,311 @@
+/*
+ * Statistical PC-sampling profiler, see pc_profiler.h.
+ *
+ * The ring has one producer, the sampling interrupt, and one consumer, the
+ * drain task, so it needs no lock: the interrupt only moves ulHead and the
+ * task only moves ulTail. The chunks, the sink and the drain task are a
+ * trace stream's (trace_stream.h).
+ *
+ * Tasks are recorded as an index into the stream's name table. An entry
+ * matches on both the handle and the name, so a task created where a deleted
+ * one's TCB was gets an entry of its own.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "pc_profiler.h"
+
+#if ( configCHERI_COMPARTMENTALIZATION == 1 ) || ( configMPU_COMPARTMENTALIZATION == 1 )
+    #include <rtl/rtl-freertos-compartments.h>
+#endif
+
+/* Record layout, see pc_profiler.h */
+#define pcprofSAMPLES_HEADER_SIZE  4
+#define pcprofSAMPLE_SIZE          16
+#define pcprofDROPPED_SIZE         8
+
+typedef struct PC_PROFILER_SAMPLE
+{
+    uint64_t ullPC;
+    uint32_t ulTick;
+    uint16_t usCompartment;
+    uint8_t ucTask;
+    uint8_t ucFlags;
+} PcProfilerSample_t;
+
+static BaseType_t prvDrain( void );
+
+static PcProfilerSample_t * pxRing = NULL;
+static volatile uint32_t ulHead = 0;
+static volatile uint32_t ulTail = 0;
+static volatile BaseType_t xRunning = pdFALSE;
+
+static uint8_t ucChunk[ configPC_PROFILER_CHUNK_SIZE ];
+static TraceStreamName_t xNames[ configPC_PROFILER_TASKS ];
+
+static TraceStream_t xStream =
+{
+    .ulMagic     = pcprofMAGIC,
+    .pucChunk    = ucChunk,
+    .uxChunkSize = sizeof( ucChunk ),
+    .pxNames     = xNames,
+    .uxMaxNames  = configPC_PROFILER_TASKS,
+    .uxRingSize  = configPC_PROFILER_SAMPLES * sizeof( PcProfilerSample_t ),
+    .xDrainTicks = pdMS_TO_TICKS( configPC_PROFILER_DRAIN_MS ),
+    .pxDrain     = prvDrain
+};
+
+/* Owned by the drain, under the stream's lock */
+static uint32_t ulDroppedSent = 0;
+
+static PcProfilerStats_t xStats;
+/*-----------------------------------------------------------*/
+
+/* Index of the running task in the name table, adding it if it is new */
+static uint8_t prvTaskIndex( void )
+{
+    TaskHandle_t xTask = xTaskGetCurrentTaskHandle();
+    UBaseType_t x = uxTraceStreamName( &xStream, xTask, pcTaskGetName( xTask ) );
+
+    return ( x < configPC_PROFILER_TASKS ) ? ( uint8_t ) x : pcprofNO_TASK;
+}
+/*-----------------------------------------------------------*/
+
+void vPcProfilerSampleFromISR( uint64_t ullPC )
+{
+    PcProfilerSample_t * pxSample;
+    uint32_t ulUsed;
+
+    if( xRunning == pdFALSE )
+    {
+        return;
+    }
+
+    ulUsed = ulHead - ulTail;
+
+    if( ulUsed >= configPC_PROFILER_SAMPLES )
+    {
+        xStats.ulDropped++;
+        return;
+    }
+
+    pxSample = &pxRing[ ulHead % configPC_PROFILER_SAMPLES ];
+    pxSample->ullPC = ullPC;
+    pxSample->ulTick = ( uint32_t ) xTaskGetTickCountFromISR();
+    pxSample->ucTask = prvTaskIndex();
+    pxSample->ucFlags = ( xTaskGetSchedulerState() == taskSCHEDULER_SUSPENDED ) ? pcprofFLAG_SCHEDULER_SUSPENDED : 0;
+    pxSample->usCompartment = pcprofNO_COMPARTMENT;
+
+    #if ( configCHERI_COMPARTMENTALIZATION == 1 ) || ( configMPU_COMPARTMENTALIZATION == 1 )
+        {
+            size_t xCompID = xPortGetCurrentCompartmentID();
+
+            if( xCompID < pcprofNO_COMPARTMENT )
+            {
+                pxSample->usCompartment = ( uint16_t ) xCompID;
+            }
+        }
+    #endif
+
+    __asm volatile ( "" ::: "memory" );
+    ulHead = ulHead + 1;
+    xStats.ulSamples++;
+
+    if( ( ulUsed + 1 == configPC_PROFILER_SAMPLES / 2 ) && ( xStream.xDrainTask != NULL ) )
+    {
+        /* The drain runs low, it does not need to preempt anything */
+        vTaskNotifyGiveFromISR( xStream.xDrainTask, NULL );
+    }
+}
+/*-----------------------------------------------------------*/
+
+void vPcProfilerTickHook( void )
+{
+    static UBaseType_t uxTicks = 0;
+    size_t uxPC;
+
+    if( xRunning == pdFALSE )
+    {
+        return;
+    }
+
+    if( ++uxTicks < configPC_PROFILER_EVERY_TICKS )
+    {
+        return;
+    }
+
+    uxTicks = 0;
+
+    /* The tick interrupt has not returned, mepc is where it came in */
+    __asm volatile ( "csrr %0, mepc" : "=r" ( uxPC ) );
+
+    vPcProfilerSampleFromISR( uxPC );
+}
+/*-----------------------------------------------------------*/
+
+static void prvPutNames( UBaseType_t uxFirst )
+{
+    UBaseType_t uxKnown = xStream.uxNames;
+
+    for( UBaseType_t x = uxFirst; x < uxKnown; x++ )
+    {
+        size_t uxName = strnlen( xNames[ x ].cName, configMAX_TASK_NAME_LEN );
+
+        if( uxTraceStreamRoom( &xStream ) < 3 + uxName )
+        {
+            /* The rest go in the next chunk */
+            return;
+        }
+
+        vTraceStreamPut( &xStream, pcprofRECORD_TASK, 1 );
+        vTraceStreamPut( &xStream, x, 1 );
+        vTraceStreamPut( &xStream, uxName, 1 );
+        vTraceStreamPutBytes( &xStream, xNames[ x ].cName, uxName );
+        xStream.usChunkRecords++;
+        xStream.uxNamesSent = x + 1;
+    }
+}
+/*-----------------------------------------------------------*/
+
+/* Write out everything in the ring, called with the stream's lock held. The
+ * profile is only closed by vPcProfilerStop(). */
+static BaseType_t prvDrain( void )
+{
+    uint32_t ulCount, ulDropped;
+
+    do
+    {
+        vTraceStreamChunkBegin( &xStream );
+
+        if( ( xStream.ulChunkSequence % configPC_PROFILER_NAMES_EVERY ) == 0 )
+        {
+            vTraceStreamPut( &xStream, pcprofRECORD_INFO, 1 );
+            vTraceStreamPut( &xStream, pcprofVERSION, 1 );
+            vTraceStreamPut( &xStream, 0, 2 );
+            vTraceStreamPut( &xStream, configTICK_RATE_HZ / configPC_PROFILER_EVERY_TICKS, 4 );
+            xStream.usChunkRecords++;
+            prvPutNames( 0 );
+        }
+        else
+        {
+            prvPutNames( xStream.uxNamesSent );
+        }
+
+        taskENTER_CRITICAL();
+        ulDropped = xStats.ulDropped;
+        taskEXIT_CRITICAL();
+
+        if( ( ulDropped != ulDroppedSent ) && ( uxTraceStreamRoom( &xStream ) >= pcprofDROPPED_SIZE ) )
+        {
+            vTraceStreamPut( &xStream, pcprofRECORD_DROPPED, 1 );
+            vTraceStreamPut( &xStream, 0, 1 );
+            vTraceStreamPut( &xStream, 0, 2 );
+            vTraceStreamPut( &xStream, ulDropped - ulDroppedSent, 4 );
+            xStream.usChunkRecords++;
+            ulDroppedSent = ulDropped;
+        }
+
+        ulCount = 0;
+
+        if( uxTraceStreamRoom( &xStream ) > pcprofSAMPLES_HEADER_SIZE )
+        {
+            uint32_t ulAvailable = ulHead - ulTail;
+
+            ulCount = ( uxTraceStreamRoom( &xStream ) - pcprofSAMPLES_HEADER_SIZE ) / pcprofSAMPLE_SIZE;
+            ulCount = ( ulCount < ulAvailable ) ? ulCount : ulAvailable;
+        }
+
+        if( ulCount > 0 )
+        {
+            vTraceStreamPut( &xStream, pcprofRECORD_SAMPLES, 1 );
+            vTraceStreamPut( &xStream, 0, 1 );
+            vTraceStreamPut( &xStream, ulCount, 2 );
+
+            for( uint32_t x = 0; x < ulCount; x++ )
+            {
+                const PcProfilerSample_t * pxSample = &pxRing[ ( ulTail + x ) % configPC_PROFILER_SAMPLES ];
+
+                vTraceStreamPut( &xStream, pxSample->ullPC, 8 );
+                vTraceStreamPut( &xStream, pxSample->ulTick, 4 );
+                vTraceStreamPut( &xStream, pxSample->usCompartment, 2 );
+                vTraceStreamPut( &xStream, pxSample->ucTask, 1 );
+                vTraceStreamPut( &xStream, pxSample->ucFlags, 1 );
+            }
+
+            /* Hand the slots back only once they are copied */
+            __asm volatile ( "" ::: "memory" );
+            ulTail = ulTail + ulCount;
+            xStream.usChunkRecords++;
+        }
+
+        if( xStream.usChunkRecords > 0 )
+        {
+            vTraceStreamChunkWrite( &xStream );
+        }
+        /* Until the ring is empty, or a chunk had nothing to say */
+    } while( ( xStream.usChunkRecords > 0 ) && ( ulHead != ulTail ) );
+
+    return pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xPcProfilerInit( uint16_t usStackSize,
+                            UBaseType_t uxPriority )
+{
+    BaseType_t xReturn = xTraceStreamInit( &xStream, "PCProfiler", usStackSize, uxPriority );
+
+    pxRing = xStream.pvRing;
+
+    return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+/* With the stream's lock held and no sample being taken */
+static void prvBegin( const void * pvArgument )
+{
+    ( void ) pvArgument;
+
+    ulHead = 0;
+    ulTail = 0;
+    ulDroppedSent = 0;
+    memset( &xStats, 0, sizeof( xStats ) );
+    xRunning = pdTRUE;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xPcProfilerStart( PcProfilerWrite_t pxWrite,
+                             void * pvContext )
+{
+    return xTraceStreamStart( &xStream, pxWrite, pvContext, prvBegin, NULL );
+}
+/*-----------------------------------------------------------*/
+
+static void prvHalt( void )
+{
+    xRunning = pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+void vPcProfilerStop( void )
+{
+    vTraceStreamStop( &xStream, prvHalt );
+}
+/*-----------------------------------------------------------*/
+
+void vPcProfilerGetStats( PcProfilerStats_t * pxStats )
+{
+    taskENTER_CRITICAL();
+    {
+        *pxStats = xStats;
+        pxStats->ulChunks = xStream.ulChunks;
+        pxStats->ulWriteErrors = xStream.ulWriteErrors;
+        pxStats->ulTasks = xStream.uxNames;
+        pxStats->xRunning = xRunning;
+    }
+    taskEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,125 @@
+/**
+ * Statistical PC-sampling profiler (bsp/pc_profiler.c).
+ *
+ * With configPC_PROFILER set, every configPC_PROFILER_EVERY_TICKS tick
+ * interrupts the tick hook records the interrupted pc (mepc), the task and,
+ * with compartments, the compartment it was running in, into a ring. A low
+ * priority task drains the ring into self-describing chunks and hands them to
+ * a sink: a file on FAT or UDP datagrams to the host, see "profile" in
+ * CLI-commands.c. demo/servers/scripts/pcprof.py symbolizes the samples
+ * against the ELF and writes flame graph input.
+ *
+ * The tick is the only periodic interrupt every platform has, QEMU included.
+ * A platform that can interrupt on an HPM counter overflow can call
+ * vPcProfilerSampleFromISR() from that handler instead. Sampling on the tick
+ * sees nothing while tickless idle has the tick stopped, so idle time is
+ * under-counted with configUSE_TICKLESS_IDLE.
+ *
+ * Everything in a chunk is little-endian:
+ *
+ *   uint32 magic ("PCP1")  uint32 sequence  uint16 length (header included)
+ *   uint16 records
+ *
+ * then records, each a uint8 type followed by:
+ *
+ *   INFO     uint8 version, uint16 pad, uint32 samples per second
+ *   TASK     uint8 task index, uint8 name length, the name
+ *   SAMPLES  uint8 pad, uint16 count, then per sample: uint64 pc, uint32 tick,
+ *            uint16 compartment (0xffff for none), uint8 task index,
+ *            uint8 flags
+ *   DROPPED  uint8 pad, uint16 pad, uint32 samples lost since the last one
+ *
+ * INFO and the names of every task seen so far start the first chunk and are
+ * repeated every configPC_PROFILER_NAMES_EVERY chunks, so that a stream joined
+ * late, or with datagrams lost, can still be decoded.
+ */
+#ifndef PC_PROFILER_H
+#define PC_PROFILER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "FreeRTOS.h"
+
+#include "trace_stream.h"
+
+#ifndef configPC_PROFILER
+    #define configPC_PROFILER                  0
+#endif
+
+/* Take a sample every this many ticks */
+#ifndef configPC_PROFILER_EVERY_TICKS
+    #define configPC_PROFILER_EVERY_TICKS      1
+#endif
+
+/* Samples the ring holds between drains */
+#ifndef configPC_PROFILER_SAMPLES
+    #define configPC_PROFILER_SAMPLES          2048
+#endif
+
+/* Distinct tasks that get a name, samples of any more have task index 0xff */
+#ifndef configPC_PROFILER_TASKS
+    #define configPC_PROFILER_TASKS            32
+#endif
+
+/* Largest chunk handed to the sink, small enough for one UDP datagram */
+#ifndef configPC_PROFILER_CHUNK_SIZE
+    #define configPC_PROFILER_CHUNK_SIZE       1024
+#endif
+
+/* The drain task wakes at least this often, and when the ring is half full */
+#ifndef configPC_PROFILER_DRAIN_MS
+    #define configPC_PROFILER_DRAIN_MS         100
+#endif
+
+/* Chunks between repeats of INFO and the task names */
+#ifndef configPC_PROFILER_NAMES_EVERY
+    #define configPC_PROFILER_NAMES_EVERY      64
+#endif
+
+#define pcprofMAGIC                    0x31504350UL /* "PCP1" */
+#define pcprofVERSION                  1
+
+#define pcprofRECORD_INFO              1
+#define pcprofRECORD_TASK              2
+#define pcprofRECORD_SAMPLES           3
+#define pcprofRECORD_DROPPED           4
+
+#define pcprofNO_COMPARTMENT           0xffff
+#define pcprofNO_TASK                  0xff
+
+/* Sample flags */
+#define pcprofFLAG_SCHEDULER_SUSPENDED 0x01
+
+/* Writes one chunk, see TraceStreamWrite_t */
+typedef TraceStreamWrite_t PcProfilerWrite_t;
+
+typedef struct PC_PROFILER_STATS
+{
+    uint32_t ulSamples;     /* Taken */
+    uint32_t ulDropped;     /* Lost to a full ring */
+    uint32_t ulChunks;      /* Handed to the sink */
+    uint32_t ulWriteErrors; /* Chunks the sink failed to write */
+    uint32_t ulTasks;       /* Distinct tasks seen */
+    BaseType_t xRunning;
+} PcProfilerStats_t;
+
+/* Create the drain task, once */
+BaseType_t xPcProfilerInit( uint16_t usStackSize,
+                            UBaseType_t uxPriority );
+
+/* Clear the ring and the task names and start sampling into pxWrite */
+BaseType_t xPcProfilerStart( PcProfilerWrite_t pxWrite,
+                             void * pvContext );
+
+/* Stop sampling, write what is left and close the sink */
+void vPcProfilerStop( void );
+
+/* From vApplicationTickHook(), samples mepc every configPC_PROFILER_EVERY_TICKS */
+void vPcProfilerTickHook( void );
+
+/* Record a sample of ullPC in the current task, from an interrupt handler */
+void vPcProfilerSampleFromISR( uint64_t ullPC );
+
+void vPcProfilerGetStats( PcProfilerStats_t * pxStats );
+
+#endif /* PC_PROFILER_H */
@@ -0,0 +1,319 @@
+/*
+ * Periodic tasks with release jitter, execution time and deadline metrics.
+ *
+ * A periodic task waits for its release with vTaskDelayUntil(), runs one
+ * cycle and times it with the run time counter (microseconds):
+ *
+ *  - execution time is from the start to the end of the cycle;
+ *  - response time adds how late, in ticks, the cycle started after its
+ *    release, and is what the deadline is checked against;
+ *  - release jitter compares the start of the cycle with the start of the
+ *    previous one. Comparing two readings of the same counter keeps it free of
+ *    the drift between the counter and the tick interrupt, which an absolute
+ *    schedule in microseconds would accumulate.
+ *
+ * The statistics are updated in a short critical section at the end of each
+ * cycle, so readers get a consistent copy from any task.
+ */
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "periodic_task.h"
+
+#define periodicUS_PER_TICK    ( 1000000UL / configTICK_RATE_HZ )
+
+typedef struct PERIODIC_TASK
+{
+    PeriodicTaskConfig_t xConfig;
+    PeriodicTaskStats_t xStats;
+    TickType_t xCreated;
+} PeriodicTask_t;
+
+static PeriodicTask_t xTasks[ configPERIODIC_TASK_MAX ];
+static volatile UBaseType_t uxTasks = 0;
+/*-----------------------------------------------------------*/
+
+static UBaseType_t prvBin( uint32_t ulMicroseconds )
+{
+    UBaseType_t uxBin;
+
+    if( ulMicroseconds == 0 )
+    {
+        return 0;
+    }
+
+    uxBin = 32 - ( UBaseType_t ) __builtin_clz( ulMicroseconds );
+
+    return ( uxBin < configPERIODIC_TASK_HISTOGRAM_BINS ) ? uxBin : configPERIODIC_TASK_HISTOGRAM_BINS - 1;
+}
+/*-----------------------------------------------------------*/
+
+/* Ticks since xTime, 0 if it is still to come */
+static TickType_t prvTicksSince( TickType_t xTime )
+{
+    TickType_t xElapsed = xTaskGetTickCount() - xTime;
+
+    return ( xElapsed > ( portMAX_DELAY >> 1 ) ) ? 0 : xElapsed;
+}
+/*-----------------------------------------------------------*/
+
+static uint32_t prvClamp( uint64_t ullMicroseconds )
+{
+    return ( ullMicroseconds > UINT32_MAX ) ? UINT32_MAX : ( uint32_t ) ullMicroseconds;
+}
+/*-----------------------------------------------------------*/
+
+static void prvPeriodicTask( void * pvParameters )
+{
+    PeriodicTask_t * pxTask = ( PeriodicTask_t * ) pvParameters;
+    const PeriodicTaskConfig_t * pxConfig = &pxTask->xConfig;
+    const uint64_t ullPeriodUs = ( uint64_t ) pxConfig->xPeriod * periodicUS_PER_TICK;
+    const uint64_t ullDeadlineUs = ( uint64_t ) pxConfig->xDeadline * periodicUS_PER_TICK;
+    TickType_t xRelease = pxTask->xCreated;
+    TickType_t xSince, xSkipped;
+    uint64_t ullStart, ullEnd, ullPreviousStart = 0, ullExpected, ullElapsed;
+    uint32_t ulLate, ulExec, ulResponse, ulJitter = 0;
+    uint32_t ulPeriods = 1;
+
+    if( pxConfig->xPhase != 0 )
+    {
+        vTaskDelayUntil( &xRelease, pxConfig->xPhase );
+    }
+
+    for( ; ; )
+    {
+        ullStart = portGET_RUN_TIME_COUNTER_VALUE();
+        ulLate = ( uint32_t ) prvTicksSince( xRelease ) * periodicUS_PER_TICK;
+
+        pxConfig->pxFunction( pxConfig->pvParameters );
+
+        ullEnd = portGET_RUN_TIME_COUNTER_VALUE();
+        ulExec = prvClamp( ullEnd - ullStart );
+        ulResponse = prvClamp( ( uint64_t ) ulLate + ulExec );
+
+        if( ullPreviousStart != 0 )
+        {
+            ullElapsed = ullStart - ullPreviousStart;
+            ullExpected = ullPeriodUs * ulPeriods;
+            ulJitter = prvClamp( ( ullElapsed > ullExpected ) ? ullElapsed - ullExpected : ullExpected - ullElapsed );
+        }
+
+        /* Releases that went by during the cycle are dropped */
+        xSince = prvTicksSince( xRelease );
+        xSkipped = ( xSince > pxConfig->xPeriod ) ? ( xSince - 1 ) / pxConfig->xPeriod : 0;
+        xRelease += xSkipped * pxConfig->xPeriod;
+
+        taskENTER_CRITICAL();
+        {
+            PeriodicTaskStats_t * pxStats = &pxTask->xStats;
+
+            if( ullPreviousStart != 0 )
+            {
+                pxStats->ulJitter[ prvBin( ulJitter ) ]++;
+
+                if( ulJitter > pxStats->ulMaxJitterUs )
+                {
+                    pxStats->ulMaxJitterUs = ulJitter;
+                }
+            }
+
+            pxStats->ulCycles++;
+            pxStats->ulSkipped += ( uint32_t ) xSkipped;
+            pxStats->ullTotalExecUs += ulExec;
+            pxStats->ulExec[ prvBin( ulExec ) ]++;
+            pxStats->ulResponse[ prvBin( ulResponse ) ]++;
+
+            if( ulResponse > ullDeadlineUs )
+            {
+                pxStats->ulDeadlineMisses++;
+            }
+
+            if( ulExec > pxStats->ulMaxExecUs )
+            {
+                pxStats->ulMaxExecUs = ulExec;
+            }
+
+            if( ulResponse > pxStats->ulMaxResponseUs )
+            {
+                pxStats->ulMaxResponseUs = ulResponse;
+            }
+        }
+        taskEXIT_CRITICAL();
+
+        ullPreviousStart = ullStart;
+        ulPeriods = ( uint32_t ) xSkipped + 1;
+
+        vTaskDelayUntil( &xRelease, pxConfig->xPeriod );
+    }
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xPeriodicTaskCreate( const PeriodicTaskConfig_t * pxConfig,
+                                TaskHandle_t * pxCreatedTask )
+{
+    PeriodicTask_t * pxTask;
+    BaseType_t xReturn = pdFAIL;
+
+    if( ( pxConfig->pxFunction == NULL ) || ( pxConfig->xPeriod == 0 ) )
+    {
+        return pdFAIL;
+    }
+
+    /* No reader runs before the entry is complete and counted */
+    vTaskSuspendAll();
+    {
+        if( uxTasks < configPERIODIC_TASK_MAX )
+        {
+            pxTask = &xTasks[ uxTasks ];
+            memset( pxTask, 0, sizeof( *pxTask ) );
+            pxTask->xConfig = *pxConfig;
+            pxTask->xCreated = xTaskGetTickCount();
+
+            if( pxTask->xConfig.xDeadline == 0 )
+            {
+                pxTask->xConfig.xDeadline = pxConfig->xPeriod;
+            }
+
+            if( xTaskCreate( prvPeriodicTask, pxConfig->pcName, pxConfig->usStackSize, pxTask,
+                             pxConfig->uxPriority, pxCreatedTask ) == pdPASS )
+            {
+                uxTasks++;
+                xReturn = pdPASS;
+            }
+        }
+    }
+    ( void ) xTaskResumeAll();
+
+    return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+UBaseType_t uxPeriodicTaskCount( void )
+{
+    return uxTasks;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xPeriodicTaskGetStats( UBaseType_t uxIndex,
+                                  PeriodicTaskStats_t * pxStats )
+{
+    if( uxIndex >= uxTasks )
+    {
+        return pdFAIL;
+    }
+
+    taskENTER_CRITICAL();
+    {
+        *pxStats = xTasks[ uxIndex ].xStats;
+    }
+    taskEXIT_CRITICAL();
+
+    return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+void vPeriodicTaskResetStats( void )
+{
+    for( UBaseType_t x = 0; x < uxTasks; x++ )
+    {
+        taskENTER_CRITICAL();
+        {
+            memset( &xTasks[ x ].xStats, 0, sizeof( xTasks[ x ].xStats ) );
+        }
+        taskEXIT_CRITICAL();
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void prvAppend( char * pcBuffer,
+                       size_t uxLength,
+                       size_t * puxOut,
+                       const char * pcFormat,
+                       ... )
+{
+    va_list xArgs;
+    int lWritten;
+
+    va_start( xArgs, pcFormat );
+    lWritten = vsnprintf( &pcBuffer[ *puxOut ], uxLength - *puxOut, pcFormat, xArgs );
+    va_end( xArgs );
+
+    /* Truncated output stays terminated and fills the buffer */
+    if( lWritten > 0 )
+    {
+        *puxOut += ( size_t ) lWritten;
+
+        if( *puxOut >= uxLength )
+        {
+            *puxOut = uxLength - 1;
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void prvAppendHistogram( char * pcBuffer,
+                                size_t uxLength,
+                                size_t * puxOut,
+                                const char * pcName,
+                                const uint32_t * pulBins )
+{
+    prvAppend( pcBuffer, uxLength, puxOut, "  %s", pcName );
+
+    for( UBaseType_t x = 0; x < configPERIODIC_TASK_HISTOGRAM_BINS - 1; x++ )
+    {
+        if( pulBins[ x ] != 0 )
+        {
+            prvAppend( pcBuffer, uxLength, puxOut, " <%lu:%lu", 1UL << x, ( unsigned long ) pulBins[ x ] );
+        }
+    }
+
+    if( pulBins[ configPERIODIC_TASK_HISTOGRAM_BINS - 1 ] != 0 )
+    {
+        prvAppend( pcBuffer, uxLength, puxOut, " >=%lu:%lu", 1UL << ( configPERIODIC_TASK_HISTOGRAM_BINS - 2 ),
+                   ( unsigned long ) pulBins[ configPERIODIC_TASK_HISTOGRAM_BINS - 1 ] );
+    }
+
+    prvAppend( pcBuffer, uxLength, puxOut, "\r\n" );
+}
+/*-----------------------------------------------------------*/
+
+size_t uxPeriodicTaskReport( UBaseType_t uxIndex,
+                             char * pcBuffer,
+                             size_t uxLength )
+{
+    PeriodicTaskStats_t xStats;
+    const PeriodicTaskConfig_t * pxConfig;
+    size_t uxOut = 0;
+
+    if( ( uxLength == 0 ) || ( xPeriodicTaskGetStats( uxIndex, &xStats ) != pdPASS ) )
+    {
+        return 0;
+    }
+
+    pxConfig = &xTasks[ uxIndex ].xConfig;
+    pcBuffer[ 0 ] = '\0';
+
+    prvAppend( pcBuffer, uxLength, &uxOut,
+               "%s: period %lu us, deadline %lu us, cycles %lu, deadline misses %lu, skipped %lu, "
+               "exec mean %lu max %lu us, response max %lu us, jitter max %lu us\r\n",
+               pxConfig->pcName,
+               ( unsigned long ) ( pxConfig->xPeriod * periodicUS_PER_TICK ),
+               ( unsigned long ) ( pxConfig->xDeadline * periodicUS_PER_TICK ),
+               ( unsigned long ) xStats.ulCycles, ( unsigned long ) xStats.ulDeadlineMisses,
+               ( unsigned long ) xStats.ulSkipped,
+               ( unsigned long ) ( ( xStats.ulCycles != 0 ) ? xStats.ullTotalExecUs / xStats.ulCycles : 0 ),
+               ( unsigned long ) xStats.ulMaxExecUs, ( unsigned long ) xStats.ulMaxResponseUs,
+               ( unsigned long ) xStats.ulMaxJitterUs );
+    prvAppendHistogram( pcBuffer, uxLength, &uxOut, "jitter us  ", xStats.ulJitter );
+    prvAppendHistogram( pcBuffer, uxLength, &uxOut, "exec us    ", xStats.ulExec );
+    prvAppendHistogram( pcBuffer, uxLength, &uxOut, "response us", xStats.ulResponse );
+
+    return uxOut;
+}
+/*-----------------------------------------------------------*/
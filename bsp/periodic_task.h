@@ -0,0 +1,92 @@
+/**
+ * Periodic tasks with release jitter, execution time and deadline metrics
+ * (bsp/periodic_task.c).
+ *
+ * The framework owns the release schedule: the cycle function runs once per
+ * period on vTaskDelayUntil(), so time spent in the cycle does not push the
+ * next release back. Every cycle is timed with portGET_RUN_TIME_COUNTER_VALUE()
+ * (microseconds) and accounted in log2 histograms.
+ */
+#ifndef PERIODIC_TASK_H
+#define PERIODIC_TASK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Periodic tasks that can be created */
+#ifndef configPERIODIC_TASK_MAX
+    #define configPERIODIC_TASK_MAX               4
+#endif
+
+/* Bin 0 counts 0 us, bin n (n > 0) counts [2^(n-1), 2^n) us and the last bin
+ * everything above */
+#ifndef configPERIODIC_TASK_HISTOGRAM_BINS
+    #define configPERIODIC_TASK_HISTOGRAM_BINS    18
+#endif
+
+/* One cycle of the task, returning ends the cycle */
+typedef void (* PeriodicTaskFunction_t)( void * pvParameters );
+
+typedef struct PERIODIC_TASK_CONFIG
+{
+    const char * pcName;
+    PeriodicTaskFunction_t pxFunction;
+    void * pvParameters;
+    TickType_t xPeriod;   /* Ticks between releases */
+    TickType_t xDeadline; /* Ticks from a release to the end of its cycle, 0 for the period */
+    TickType_t xPhase;    /* Ticks from creation to the first release */
+    uint16_t usStackSize;
+    UBaseType_t uxPriority;
+} PeriodicTaskConfig_t;
+
+typedef struct PERIODIC_TASK_STATS
+{
+    uint32_t ulCycles;         /* Cycles run */
+    uint32_t ulDeadlineMisses; /* Cycles that ended after their deadline */
+    uint32_t ulSkipped;        /* Releases dropped because a cycle overran them */
+    uint32_t ulMaxJitterUs;    /* Largest release jitter */
+    uint32_t ulMaxExecUs;      /* Longest cycle */
+    uint32_t ulMaxResponseUs;  /* Longest release to end of cycle */
+    uint64_t ullTotalExecUs;   /* For the mean cycle length */
+
+    /* Release jitter: how far the start of a cycle is from one period (or a
+     * whole number of periods, after skipped releases) after the start of the
+     * previous one */
+    uint32_t ulJitter[ configPERIODIC_TASK_HISTOGRAM_BINS ];
+    uint32_t ulExec[ configPERIODIC_TASK_HISTOGRAM_BINS ];
+    uint32_t ulResponse[ configPERIODIC_TASK_HISTOGRAM_BINS ];
+} PeriodicTaskStats_t;
+
+/*
+ * Create a task that runs pxConfig->pxFunction every pxConfig->xPeriod ticks.
+ * When a cycle overruns one or more releases they are skipped, rather than
+ * run back to back, and the next cycle starts at the following release.
+ * pxConfig is copied. Returns pdFAIL when configPERIODIC_TASK_MAX tasks
+ * already exist or the task cannot be created.
+ */
+BaseType_t xPeriodicTaskCreate( const PeriodicTaskConfig_t * pxConfig,
+                                TaskHandle_t * pxCreatedTask );
+
+/* Periodic tasks created so far, which are indexed from 0 */
+UBaseType_t uxPeriodicTaskCount( void );
+
+/* Copy the statistics of the uxIndex'th task, pdFAIL if there is none */
+BaseType_t xPeriodicTaskGetStats( UBaseType_t uxIndex,
+                                  PeriodicTaskStats_t * pxStats );
+
+/* Clear the statistics of every periodic task */
+void vPeriodicTaskResetStats( void );
+
+/*
+ * Print the statistics of the uxIndex'th task to pcBuffer as text: a summary
+ * line, then one line per histogram with the non-empty bins as
+ * "<upper bound in us>:<count>". Returns the length of the text, 0 if there
+ * is no such task.
+ */
+size_t uxPeriodicTaskReport( UBaseType_t uxIndex,
+                             char * pcBuffer,
+                             size_t uxLength );
+
+#endif /* PERIODIC_TASK_H */
@@ -0,0 +1,109 @@
+/*
+ * Lock-free publication of a shared value, see seqlock.h.
+ *
+ * With a single slot a reader that preempted the writer mid-copy would have
+ * to wait for it, which on one core means spinning until a lower priority
+ * task runs again. With two slots the current one is never written: the
+ * writer fills the other and only then moves the sequence number on. A reader
+ * that sees the same sequence number before and after its copy therefore has
+ * a consistent value; a different one means the writer may since have
+ * started on the slot being copied, and the copy is done again.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+
+#include "seqlock.h"
+
+#define seqlockBARRIER()    __sync_synchronize()
+
+static uint8_t * prvSlot( SeqLock_t * pxLock,
+                          uint32_t ulSequence )
+{
+    return &pxLock->pucStorage[ ( ulSequence & 1 ) * seqlockSLOT_SIZE( pxLock->uxSize ) ];
+}
+/*-----------------------------------------------------------*/
+
+void vSeqLockInit( SeqLock_t * pxLock,
+                   void * pvStorage,
+                   size_t uxSize,
+                   const void * pvInitial )
+{
+    configASSERT( ( ( uintptr_t ) pvStorage & ( sizeof( void * ) - 1 ) ) == 0 );
+
+    memset( pxLock, 0, sizeof( *pxLock ) );
+    pxLock->pucStorage = ( uint8_t * ) pvStorage;
+    pxLock->uxSize = uxSize;
+
+    memset( pvStorage, 0, seqlockSTORAGE_SIZE( uxSize ) );
+
+    if( pvInitial != NULL )
+    {
+        memcpy( prvSlot( pxLock, 0 ), pvInitial, uxSize );
+    }
+}
+/*-----------------------------------------------------------*/
+
+void vSeqLockPublish( SeqLock_t * pxLock,
+                      const void * pvValue )
+{
+    uint32_t ulNext = pxLock->ulSequence + 1;
+
+    memcpy( prvSlot( pxLock, ulNext ), pvValue, pxLock->uxSize );
+
+    /* The value is complete before readers are pointed at it */
+    seqlockBARRIER();
+    pxLock->ulSequence = ulNext;
+}
+/*-----------------------------------------------------------*/
+
+uint32_t ulSeqLockRead( SeqLock_t * pxLock,
+                        void * pvValue )
+{
+    uint32_t ulSequence, ulRetries = 0;
+
+    for( ; ; )
+    {
+        ulSequence = pxLock->ulSequence;
+        seqlockBARRIER();
+
+        memcpy( pvValue, prvSlot( pxLock, ulSequence ), pxLock->uxSize );
+
+        seqlockBARRIER();
+
+        if( pxLock->ulSequence == ulSequence )
+        {
+            break;
+        }
+
+        ulRetries++;
+    }
+
+    ( void ) __sync_fetch_and_add( &pxLock->ulReads, 1 );
+
+    if( ulRetries != 0 )
+    {
+        ( void ) __sync_fetch_and_add( &pxLock->ulRetries, ulRetries );
+
+        /* Racing readers may lose an update, the maximum is indicative */
+        if( ulRetries > pxLock->ulMaxRetries )
+        {
+            pxLock->ulMaxRetries = ulRetries;
+        }
+    }
+
+    return ulSequence;
+}
+/*-----------------------------------------------------------*/
+
+void vSeqLockGetStats( SeqLock_t * pxLock,
+                       SeqLockStats_t * pxStats )
+{
+    pxStats->ulPublished = pxLock->ulSequence;
+    pxStats->ulReads = pxLock->ulReads;
+    pxStats->ulRetries = pxLock->ulRetries;
+    pxStats->ulMaxRetries = pxLock->ulMaxRetries;
+}
+/*-----------------------------------------------------------*/
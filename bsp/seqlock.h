@@ -0,0 +1,68 @@
+/**
+ * Lock-free publication of a shared value (bsp/seqlock.c).
+ *
+ * One writer publishes snapshots of a value of fixed size, any number of
+ * readers copy the latest one. The value is double buffered: a publication
+ * fills the slot readers are not pointed at and then bumps the sequence
+ * number, which also switches the current slot. The writer never waits, and
+ * a reader only retries when a publication completed while it was copying,
+ * so neither side can be held up by the other being preempted.
+ */
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "FreeRTOS.h"
+
+/* Slots are kept pointer aligned, so values may hold (capability) pointers */
+#define seqlockSLOT_SIZE( uxSize )       ( ( ( uxSize ) + sizeof( void * ) - 1 ) & ~( sizeof( void * ) - 1 ) )
+
+/* Bytes of storage a value of uxSize bytes needs, both slots */
+#define seqlockSTORAGE_SIZE( uxSize )    ( 2 * seqlockSLOT_SIZE( uxSize ) )
+
+typedef struct SEQ_LOCK
+{
+    volatile uint32_t ulSequence; /* Publications so far, slot ulSequence & 1 is current */
+    uint8_t * pucStorage;
+    size_t uxSize;
+    volatile uint32_t ulReads;
+    volatile uint32_t ulRetries;
+    volatile uint32_t ulMaxRetries;
+} SeqLock_t;
+
+typedef struct SEQ_LOCK_STATS
+{
+    uint32_t ulPublished;
+    uint32_t ulReads;
+    uint32_t ulRetries;    /* Copies torn by a publication, and done again */
+    uint32_t ulMaxRetries; /* Most retries of a single read */
+} SeqLockStats_t;
+
+/*
+ * pvStorage is seqlockSTORAGE_SIZE( uxSize ) bytes, pointer aligned, and
+ * pvInitial the value readers get until the first publication.
+ */
+void vSeqLockInit( SeqLock_t * pxLock,
+                   void * pvStorage,
+                   size_t uxSize,
+                   const void * pvInitial );
+
+/*
+ * Publish a new value. Never blocks; there must be a single writer, or the
+ * writers must be serialised by the caller.
+ */
+void vSeqLockPublish( SeqLock_t * pxLock,
+                      const void * pvValue );
+
+/*
+ * Copy the latest value to pvValue, from any task. Returns the number of the
+ * publication that was copied, 0 for the initial value.
+ */
+uint32_t ulSeqLockRead( SeqLock_t * pxLock,
+                        void * pvValue );
+
+void vSeqLockGetStats( SeqLock_t * pxLock,
+                       SeqLockStats_t * pxStats );
+
+#endif /* SEQLOCK_H */
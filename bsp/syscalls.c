@@ -4,12 +4,14 @@
 
 #include <sys/stat.h>
 #include <errno.h>
+#include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/times.h>
 #include <sys/time.h>
 #include "bsp.h"
 #include "htif.h"
+#include "clock.h"
 
 #if ipconfigUSE_FAT_LIBDL
     #include <FreeRTOSFATConfig.h>
@@ -56,13 +58,55 @@ int _gettimeofday( struct timeval * tv,
 #define configFF_FDS_TABLE_SIZE 1024
 static int free_fd = 3;
 
+#ifndef configLIBDL_EMBEDDED_XIP
+    #define configLIBDL_EMBEDDED_XIP 0
+#endif
+
 typedef struct fileMap {
     FF_FILE*       ff_file;
     const char*    name;
+#if configLIBDL_EMBEDDED_XIP
+    /* Embedded archives are read straight out of .rom, see libs_fat_embedded.c */
+    const uint8_t* rom_data;
+    size_t         rom_size;
+    size_t         rom_offset;
+#endif
 } fileMap_t;
 
 static fileMap_t ff_map[configFF_FDS_TABLE_SIZE];
 
+#if configLIBDL_EMBEDDED_XIP
+    #include "libs_fat_embed.h"
+
+    #define FD_IS_ROM( fd )    ( ff_map[fd].rom_data != NULL )
+
+    static const void * prvMapRom( const char * name,
+                                   size_t * size )
+    {
+        /* Only the archives under the libs path are kept out of FAT */
+        if( strncmp( name, configLIBDL_LIB_PATH, sizeof( configLIBDL_LIB_PATH ) - 1 ) != 0 )
+        {
+            return NULL;
+        }
+
+        return pvFatEmbedLibMap( name, size );
+    }
+#else
+    #define FD_IS_ROM( fd )    0
+#endif
+
+#if configLIBDL_PHASES
+    #include "libdl_phases.h"
+    #define LIBDL_READ_BEGIN()    vLibdlPhaseBegin( eLibdlPhaseRead )
+    #define LIBDL_READ_END()      vLibdlPhaseEnd( eLibdlPhaseRead )
+#else
+    #define LIBDL_READ_BEGIN()
+    #define LIBDL_READ_END()
+#endif
+
+#define FD_IS_OPEN( fd )    ( ( fd ) >= 0 && ( fd ) < configFF_FDS_TABLE_SIZE && \
+                              ( ff_map[fd].ff_file != NULL || FD_IS_ROM( fd ) ) )
+
 int _write( int file,
             char * ptr,
             int len )
@@ -94,9 +138,9 @@ int _write( int file,
     }
 }
 
-int _open( const char * name,
-           int flags,
-           int mode )
+static int prvOpen( const char * name,
+                    int flags,
+                    int mode )
 {
     FF_FILE* ff_file = NULL;
     char ff_strMode[3] = {0};
@@ -124,6 +168,19 @@ int _open( const char * name,
         return i;
     }
 
+#if configLIBDL_EMBEDDED_XIP
+    if (flags == O_RDONLY) {
+        const void* rom_data = prvMapRom(name, &ff_map[free_fd].rom_size);
+
+        if (rom_data != NULL) {
+            ff_map[free_fd].rom_data = rom_data;
+            ff_map[free_fd].rom_offset = 0;
+            ff_map[free_fd].name = name;
+            return free_fd++;
+        }
+    }
+#endif
+
     ff_file = ff_fopen(name, (const char *) &ff_strMode);
 
     if (ff_file == NULL) {
@@ -138,11 +195,19 @@ int _open( const char * name,
 
 int _close( int fd )
 {
-    if (fd >= configFF_FDS_TABLE_SIZE || ff_map[fd].ff_file == NULL) {
+    if (!FD_IS_OPEN(fd)) {
         errno = EBADF;
         return -1;
     }
 
+#if configLIBDL_EMBEDDED_XIP
+    if (FD_IS_ROM(fd)) {
+        ff_map[fd].rom_data = NULL;
+        ff_map[fd].name = NULL;
+        return 0;
+    }
+#endif
+
     if (ff_fclose(ff_map[fd].ff_file) != 0) {
         errno = stdioGET_ERRNO();
         return -1;
@@ -153,15 +218,35 @@ int _close( int fd )
     return 0;
 }
 
-long _lseek( int fd,
-             long offset,
-             int origin )
+static long prvLseek( int fd,
+                      long offset,
+                      int origin )
 {
-    if (fd >= configFF_FDS_TABLE_SIZE || ff_map[fd].ff_file == NULL) {
+    if (!FD_IS_OPEN(fd)) {
         errno = EBADF;
         return -1;
     }
 
+#if configLIBDL_EMBEDDED_XIP
+    if (FD_IS_ROM(fd)) {
+        long base = 0;
+
+        if (origin == SEEK_CUR) {
+            base = (long) ff_map[fd].rom_offset;
+        } else if (origin == SEEK_END) {
+            base = (long) ff_map[fd].rom_size;
+        }
+
+        if (base + offset < 0 || (size_t) (base + offset) > ff_map[fd].rom_size) {
+            errno = EINVAL;
+            return -1;
+        }
+
+        ff_map[fd].rom_offset = (size_t) (base + offset);
+        return (long) ff_map[fd].rom_offset;
+    }
+#endif
+
     if (ff_fseek(ff_map[fd].ff_file, (int) offset, origin) != 0) {
         errno = stdioGET_ERRNO();
         return -1;
@@ -170,16 +255,30 @@ long _lseek( int fd,
     return 0;
 }
 
-int _read( int fd,
-           void * buffer,
-           unsigned int count )
+static int prvRead( int fd,
+                   void * buffer,
+                   unsigned int count )
 {
     int read = 0;
-    if (fd >= configFF_FDS_TABLE_SIZE || ff_map[fd].ff_file == NULL) {
+    if (!FD_IS_OPEN(fd)) {
         errno = EBADF;
         return -1;
     }
 
+#if configLIBDL_EMBEDDED_XIP
+    if (FD_IS_ROM(fd)) {
+        size_t left = ff_map[fd].rom_size - ff_map[fd].rom_offset;
+
+        if (count > left) {
+            count = left;
+        }
+
+        memcpy(buffer, ff_map[fd].rom_data + ff_map[fd].rom_offset, count);
+        ff_map[fd].rom_offset += count;
+        return (int) count;
+    }
+#endif
+
     read = ff_fread(buffer, 1, count, ff_map[fd].ff_file);
     if (read < count) {
         errno = stdioGET_ERRNO();
@@ -194,6 +293,17 @@ int _stat( const char * name,
     struct stat* sb = (struct stat*) buffer;
     FF_Stat_t ff_sb;
 
+#if configLIBDL_EMBEDDED_XIP
+    size_t rom_size;
+
+    if (prvMapRom(name, &rom_size) != NULL) {
+        memset(sb, 0, sizeof(*sb));
+        sb->st_mode = S_IFREG | S_IRUSR | S_IRGRP | S_IROTH;
+        sb->st_size = rom_size;
+        return 0;
+    }
+#endif
+
     if (ff_stat(name, &ff_sb) != 0) {
         errno = stdioGET_ERRNO();
         return -1;
@@ -227,13 +337,50 @@ int _stat( const char * name,
 int _fstat( int fd,
             void * buffer )
 {
-    if (fd >= configFF_FDS_TABLE_SIZE || ff_map[fd].ff_file == NULL) {
+    if (!FD_IS_OPEN(fd)) {
         errno = EBADF;
         return -1;
     }
 
     return _stat(ff_map[fd].name, buffer);
 }
+
+/* Reads done by the dynamic loader are timed as its read phase */
+int _open( const char * name,
+           int flags,
+           int mode )
+{
+    int ret;
+
+    LIBDL_READ_BEGIN();
+    ret = prvOpen(name, flags, mode);
+    LIBDL_READ_END();
+    return ret;
+}
+
+long _lseek( int fd,
+             long offset,
+             int origin )
+{
+    long ret;
+
+    LIBDL_READ_BEGIN();
+    ret = prvLseek(fd, offset, origin);
+    LIBDL_READ_END();
+    return ret;
+}
+
+int _read( int fd,
+           void * buffer,
+           unsigned int count )
+{
+    int ret;
+
+    LIBDL_READ_BEGIN();
+    ret = prvRead(fd, buffer, count);
+    LIBDL_READ_END();
+    return ret;
+}
 #else
 
 int _write( int file,
@@ -345,10 +492,11 @@ int _getpid( int n )
 int _gettimeofday( struct timeval * tv,
                    struct timezone * tz )
 {
-    uint64_t us = portGET_RUN_TIME_COUNTER_VALUE();
+    uint32_t ns;
 
-    tv->tv_sec = us / 1000000;
-    tv->tv_usec = ( us % 1000000 );
+    /* Time since boot until the wall clock is set, by NTP for instance */
+    tv->tv_sec = ulClockRealtime( &ns );
+    tv->tv_usec = ns / 1000;
     return 0;
 }
 
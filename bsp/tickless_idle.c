@@ -0,0 +1,221 @@
+/*
+ * Tickless idle for the RISC-V port, see tickless_idle.h.
+ *
+ * The port drives the tick from mtimecmp: the compare register holds the time
+ * of the next tick, and ullNextTime (port.c) the time of the one after, which
+ * the tick interrupt copies to mtimecmp before advancing it by a tick period.
+ * A sleep moves mtimecmp out to the last tick of the expected idle time and
+ * waits in wfi with interrupts masked, which still wakes on any interrupt the
+ * hart has enabled. Then, before interrupts are unmasked:
+ *
+ * - if the timer expired, the kernel is stepped by the ticks before the last
+ *   one and ullNextTime set up as if they had run, so the pending timer
+ *   interrupt counts the last tick and carries on with the usual period;
+ * - if another interrupt came first, the kernel is stepped by the tick
+ *   periods that have passed and mtimecmp put back on the next tick boundary,
+ *   so the tick stays in phase with the one before the sleep.
+ *
+ * Either way the kernel's tick count never runs ahead of mtime, and the tick
+ * boundaries do not drift however long the sleep.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "tickless_idle.h"
+
+#ifdef __CHERI_PURE_CAPABILITY__
+    #include <cheri/cheri-utility.h>
+#endif /* __CHERI_PURE_CAPABILITY__ */
+
+/* mtime counts at configCPU_CLOCK_HZ unless the platform says otherwise (P3
+ * runs it at 250 kHz) */
+#ifdef configMTIME_HZ
+    #define ticklessMTIME_HZ    ( ( uint64_t ) configMTIME_HZ )
+#else
+    #define ticklessMTIME_HZ    ( ( uint64_t ) configCPU_CLOCK_HZ )
+#endif
+
+#define ticklessTICK_PERIOD     ( ticklessMTIME_HZ / configTICK_RATE_HZ )
+
+static TicklessIdleStats_t xStats;
+static uint64_t ullIdleTime = 0;
+static uint64_t ullTotalLatencyTime = 0;
+
+#if ( configUSE_TICKLESS_IDLE != 0 )
+
+/* From the port (port.c) */
+    extern uint64_t ullNextTime;
+    extern volatile uint64_t * pullMachineTimerCompareRegister;
+
+    static volatile uint32_t * pulMachineTime = NULL;
+
+    static uint64_t prvReadTime( void )
+    {
+        #if __riscv_xlen == 64
+            return *( volatile uint64_t * ) pulMachineTime;
+        #else
+            uint32_t ulHigh, ulLow;
+
+            do
+            {
+                ulHigh = pulMachineTime[ 1 ];
+                ulLow = pulMachineTime[ 0 ];
+            } while( ulHigh != pulMachineTime[ 1 ] );
+
+            return ( ( uint64_t ) ulHigh << 32 ) | ulLow;
+        #endif
+    }
+/*-----------------------------------------------------------*/
+
+    static void prvSetCompare( uint64_t ullCompare )
+    {
+        #if __riscv_xlen == 64
+            *pullMachineTimerCompareRegister = ullCompare;
+        #else
+            volatile uint32_t * pulCompare = ( volatile uint32_t * ) pullMachineTimerCompareRegister;
+
+            /* Never below the new value while the halves are written */
+            pulCompare[ 0 ] = UINT32_MAX;
+            pulCompare[ 1 ] = ( uint32_t ) ( ullCompare >> 32 );
+            pulCompare[ 0 ] = ( uint32_t ) ullCompare;
+        #endif
+    }
+/*-----------------------------------------------------------*/
+
+    static uint32_t prvTimeToNs( uint64_t ullTime )
+    {
+        uint64_t ullNs = ullTime * 1000000000ULL / ticklessMTIME_HZ;
+
+        return ( ullNs > UINT32_MAX ) ? UINT32_MAX : ( uint32_t ) ullNs;
+    }
+/*-----------------------------------------------------------*/
+
+    void vTicklessIdleSleep( TickType_t xExpectedIdleTime )
+    {
+        uint64_t ullPending, ullWake, ullStart, ullNow;
+        TickType_t xCompleted;
+
+        if( pulMachineTime == NULL )
+        {
+            #ifdef __CHERI_PURE_CAPABILITY__
+                pulMachineTime = ( volatile uint32_t * ) cheri_build_data_cap( ( ptraddr_t ) configMTIME_BASE_ADDRESS,
+                                                                                sizeof( uint64_t ),
+                                                                                __CHERI_CAP_PERMISSION_PERMIT_LOAD__ );
+            #else
+                pulMachineTime = ( volatile uint32_t * ) ( uintptr_t ) configMTIME_BASE_ADDRESS;
+            #endif
+        }
+
+        if( xExpectedIdleTime > configTICKLESS_MAX_IDLE_TICKS )
+        {
+            xExpectedIdleTime = configTICKLESS_MAX_IDLE_TICKS;
+        }
+
+        portDISABLE_INTERRUPTS();
+
+        /* An interrupt since the idle task decided to sleep may have readied a
+         * task, or be pending */
+        if( eTaskConfirmSleepModeStatus() == eAbortSleep )
+        {
+            xStats.ulAborted++;
+            portENABLE_INTERRUPTS();
+            return;
+        }
+
+        /* The tick in mtimecmp counts as the first of the expected ones */
+        ullPending = ullNextTime - ticklessTICK_PERIOD;
+        ullWake = ullPending + ( uint64_t ) ( xExpectedIdleTime - 1 ) * ticklessTICK_PERIOD;
+
+        ullStart = prvReadTime();
+        prvSetCompare( ullWake );
+        xStats.ulSleeps++;
+
+        __asm volatile ( "wfi" );
+
+        ullNow = prvReadTime();
+        ullIdleTime += ullNow - ullStart;
+
+        if( ullNow >= ullWake )
+        {
+            uint64_t ullLatency = ullNow - ullWake;
+            uint32_t ulLatencyNs = prvTimeToNs( ullLatency );
+
+            /* The pending timer interrupt counts the last tick */
+            xCompleted = xExpectedIdleTime - 1;
+            ullNextTime = ullWake + ticklessTICK_PERIOD;
+
+            xStats.ulTimerWakes++;
+            ullTotalLatencyTime += ullLatency;
+
+            if( ( xStats.ulTimerWakes == 1 ) || ( ulLatencyNs < xStats.ulMinLatencyNs ) )
+            {
+                xStats.ulMinLatencyNs = ulLatencyNs;
+            }
+
+            if( ulLatencyNs > xStats.ulMaxLatencyNs )
+            {
+                xStats.ulMaxLatencyNs = ulLatencyNs;
+            }
+        }
+        else
+        {
+            /* Fewer than xExpectedIdleTime - 1 tick boundaries went by, so
+             * stepping by them cannot take the kernel past its next unblock
+             * time */
+            xCompleted = ( ullNow >= ullPending ) ? ( TickType_t ) ( ( ullNow - ullPending ) / ticklessTICK_PERIOD ) + 1 : 0;
+            ullPending += ( uint64_t ) xCompleted * ticklessTICK_PERIOD;
+
+            prvSetCompare( ullPending );
+            ullNextTime = ullPending + ticklessTICK_PERIOD;
+
+            xStats.ulEarlyWakes++;
+        }
+
+        if( xCompleted > 0 )
+        {
+            vTaskStepTick( xCompleted );
+            xStats.ullSuppressedTicks += xCompleted;
+        }
+
+        /* The interrupt that woke the hart runs now */
+        portENABLE_INTERRUPTS();
+    }
+/*-----------------------------------------------------------*/
+
+#endif /* configUSE_TICKLESS_IDLE != 0 */
+
+void vTicklessIdleGetStats( TicklessIdleStats_t * pxStats )
+{
+    uint64_t ullIdle, ullLatency;
+
+    taskENTER_CRITICAL();
+    {
+        *pxStats = xStats;
+        ullIdle = ullIdleTime;
+        ullLatency = ullTotalLatencyTime;
+    }
+    taskEXIT_CRITICAL();
+
+    /* In two parts, mtime * 10^9 would overflow after a few seconds */
+    pxStats->ullIdleNs = ( ullIdle / ticklessMTIME_HZ ) * 1000000000ULL +
+                         ( ullIdle % ticklessMTIME_HZ ) * 1000000000ULL / ticklessMTIME_HZ;
+    pxStats->ullTotalLatencyNs = ( ullLatency / ticklessMTIME_HZ ) * 1000000000ULL +
+                                 ( ullLatency % ticklessMTIME_HZ ) * 1000000000ULL / ticklessMTIME_HZ;
+}
+/*-----------------------------------------------------------*/
+
+void vTicklessIdleResetStats( void )
+{
+    taskENTER_CRITICAL();
+    {
+        memset( &xStats, 0, sizeof( xStats ) );
+        ullIdleTime = 0;
+        ullTotalLatencyTime = 0;
+    }
+    taskEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,45 @@
+/**
+ * Tickless idle on the CLINT machine timer (bsp/tickless_idle.c).
+ *
+ * With configUSE_TICKLESS_IDLE set, FreeRTOSConfig.h routes the kernel's
+ * portSUPPRESS_TICKS_AND_SLEEP() here: when every task is blocked for a while
+ * the tick interrupt is pushed out to the next unblock time, the hart waits
+ * in wfi, and on waking the tick count is stepped by the ticks that went by.
+ */
+#ifndef TICKLESS_IDLE_H
+#define TICKLESS_IDLE_H
+
+#include <stdint.h>
+#include "FreeRTOS.h"
+
+/* Longest single sleep in ticks, whatever the kernel expects. Bounds how long
+ * a lost wakeup can go unnoticed. */
+#ifndef configTICKLESS_MAX_IDLE_TICKS
+    #define configTICKLESS_MAX_IDLE_TICKS    ( ( TickType_t ) configTICK_RATE_HZ * 60 )
+#endif
+
+typedef struct TICKLESS_IDLE_STATS
+{
+    uint32_t ulSleeps;           /* Times the timer was reprogrammed for a sleep */
+    uint32_t ulAborted;          /* Sleeps called off, a task became ready first */
+    uint32_t ulTimerWakes;       /* Sleeps that lasted until the timer */
+    uint32_t ulEarlyWakes;       /* Sleeps cut short by another interrupt */
+    uint64_t ullSuppressedTicks; /* Tick interrupts that did not happen */
+    uint64_t ullIdleNs;          /* Time spent in wfi */
+    uint32_t ulMinLatencyNs;     /* Timer wakes: from the programmed time to */
+    uint32_t ulMaxLatencyNs;     /* running again, with interrupts masked */
+    uint64_t ullTotalLatencyNs;  /* For the mean over ulTimerWakes */
+} TicklessIdleStats_t;
+
+/*
+ * The kernel's portSUPPRESS_TICKS_AND_SLEEP(), called by the idle task with
+ * the scheduler suspended.
+ */
+void vTicklessIdleSleep( TickType_t xExpectedIdleTime );
+
+/* All zero when built without configUSE_TICKLESS_IDLE */
+void vTicklessIdleGetStats( TicklessIdleStats_t * pxStats );
+
+void vTicklessIdleResetStats( void );
+
+#endif /* TICKLESS_IDLE_H */
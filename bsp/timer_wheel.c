@@ -0,0 +1,529 @@
+/*
+ * Hierarchical timer wheel, see timer_wheel.h.
+ *
+ * Level n has 64 slots of 64^n microseconds. ullWheelUs is the last
+ * microsecond the wheel has been run up to: every timer due by then has been
+ * taken off it. A timer due at E goes into the finest level n whose slot for E
+ * is at most 64 slots ahead of the current one, so a slot never holds timers
+ * from two turns of its level. Slots are only looked at when the wheel reaches
+ * them: a level 0 slot holds timers due at exactly that microsecond, and a
+ * coarser one is emptied into the finer levels (cascaded) when the wheel
+ * reaches the start of its span. A bitmap of the occupied slots per level
+ * gives the next slot that needs attention, so the wheel skips straight to it
+ * however long the service task has slept.
+ *
+ * Timers that come due are moved to the expired list, in the order they were
+ * due, and the service task runs their callbacks together. Everything, the
+ * callbacks included, runs with xLock held: it is recursive so that callbacks
+ * can start and stop timers, and means that a timer stopped from another task
+ * is neither waiting on the expired list nor halfway through its callback.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include "clock.h"
+#include "timer_wheel.h"
+
+#define timerwheelSLOT_BITS      6
+#define timerwheelSLOTS          ( 1U << timerwheelSLOT_BITS )
+#define timerwheelSLOT_MASK      ( timerwheelSLOTS - 1U )
+
+#define timerwheelUS_PER_TICK    ( 1000000ULL / configTICK_RATE_HZ )
+
+/* Timer states */
+#define timerwheelIDLE           0
+#define timerwheelARMED          1 /* In a slot */
+#define timerwheelEXPIRED        2 /* On the expired list */
+#define timerwheelFIRING         3 /* Its callback is running */
+
+static TaskHandle_t xServiceTask = NULL;
+
+/* Everything below is protected by xLock */
+static SemaphoreHandle_t xLock = NULL;
+static TimerWheelTimer_t * pxSlots[ configTIMER_WHEEL_LEVELS ][ timerwheelSLOTS ];
+static uint64_t ullOccupied[ configTIMER_WHEEL_LEVELS ];
+static TimerWheelTimer_t * pxExpired = NULL;
+static TimerWheelTimer_t ** ppxExpiredTail = &pxExpired;
+static uint64_t ullWheelUs = 0;
+static uint64_t ullWakeUs = UINT64_MAX; /* When the service task wakes up, 0 while it runs */
+static TimerWheelStats_t xStats;
+/*-----------------------------------------------------------*/
+
+static UBaseType_t prvBin( uint32_t ulMicroseconds )
+{
+    UBaseType_t uxBin;
+
+    if( ulMicroseconds == 0 )
+    {
+        return 0;
+    }
+
+    uxBin = 32 - ( UBaseType_t ) __builtin_clz( ulMicroseconds );
+
+    return ( uxBin < configTIMER_WHEEL_HISTOGRAM_BINS ) ? uxBin : configTIMER_WHEEL_HISTOGRAM_BINS - 1;
+}
+/*-----------------------------------------------------------*/
+
+static void prvLink( TimerWheelTimer_t ** ppxHead,
+                     TimerWheelTimer_t * pxTimer )
+{
+    pxTimer->pxNext = *ppxHead;
+    pxTimer->ppxPrev = ppxHead;
+
+    if( *ppxHead != NULL )
+    {
+        ( *ppxHead )->ppxPrev = &pxTimer->pxNext;
+    }
+
+    *ppxHead = pxTimer;
+}
+/*-----------------------------------------------------------*/
+
+static void prvUnlink( TimerWheelTimer_t * pxTimer )
+{
+    *pxTimer->ppxPrev = pxTimer->pxNext;
+
+    if( pxTimer->pxNext != NULL )
+    {
+        pxTimer->pxNext->ppxPrev = pxTimer->ppxPrev;
+    }
+
+    if( pxTimer->ucState == timerwheelEXPIRED )
+    {
+        if( ppxExpiredTail == &pxTimer->pxNext )
+        {
+            ppxExpiredTail = pxTimer->ppxPrev;
+        }
+    }
+    else if( pxSlots[ pxTimer->ucLevel ][ pxTimer->ucSlot ] == NULL )
+    {
+        ullOccupied[ pxTimer->ucLevel ] &= ~( 1ULL << pxTimer->ucSlot );
+    }
+
+    pxTimer->pxNext = NULL;
+    pxTimer->ppxPrev = NULL;
+}
+/*-----------------------------------------------------------*/
+
+/* Put a timer that is in no list where it belongs for its due time */
+static void prvInsert( TimerWheelTimer_t * pxTimer )
+{
+    UBaseType_t uxLevel;
+    uint64_t ullSpan;
+
+    if( pxTimer->ullDueUs <= ullWheelUs )
+    {
+        pxTimer->ucState = timerwheelEXPIRED;
+        prvLink( ppxExpiredTail, pxTimer );
+        ppxExpiredTail = &pxTimer->pxNext;
+        return;
+    }
+
+    for( uxLevel = 0; uxLevel < configTIMER_WHEEL_LEVELS - 1; uxLevel++ )
+    {
+        ullSpan = ( pxTimer->ullDueUs >> ( uxLevel * timerwheelSLOT_BITS ) ) -
+                  ( ullWheelUs >> ( uxLevel * timerwheelSLOT_BITS ) );
+
+        if( ullSpan <= timerwheelSLOTS )
+        {
+            break;
+        }
+    }
+
+    ullSpan = pxTimer->ullDueUs >> ( uxLevel * timerwheelSLOT_BITS );
+
+    if( ullSpan - ( ullWheelUs >> ( uxLevel * timerwheelSLOT_BITS ) ) > timerwheelSLOTS )
+    {
+        /* Beyond the last level: park it in the slot the wheel reaches last
+         * and place it again from there */
+        ullSpan = ( ullWheelUs >> ( uxLevel * timerwheelSLOT_BITS ) ) + timerwheelSLOTS;
+    }
+
+    pxTimer->ucState = timerwheelARMED;
+    pxTimer->ucLevel = ( uint8_t ) uxLevel;
+    pxTimer->ucSlot = ( uint8_t ) ( ullSpan & timerwheelSLOT_MASK );
+    prvLink( &pxSlots[ uxLevel ][ pxTimer->ucSlot ], pxTimer );
+    ullOccupied[ uxLevel ] |= 1ULL << pxTimer->ucSlot;
+}
+/*-----------------------------------------------------------*/
+
+/* The first time after ullWheelUs at which an occupied slot is reached,
+ * UINT64_MAX when the wheel is empty */
+static uint64_t prvNextEvent( void )
+{
+    uint64_t ullNext = UINT64_MAX;
+
+    for( UBaseType_t uxLevel = 0; uxLevel < configTIMER_WHEEL_LEVELS; uxLevel++ )
+    {
+        UBaseType_t uxShift = uxLevel * timerwheelSLOT_BITS;
+        uint64_t ullBits = ullOccupied[ uxLevel ];
+        uint64_t ullSlot, ullEvent;
+        UBaseType_t uxRotate;
+
+        if( ullBits == 0 )
+        {
+            continue;
+        }
+
+        /* Slots in the order the wheel reaches them, from the one after the
+         * current one */
+        ullSlot = ( ullWheelUs >> uxShift ) + 1;
+        uxRotate = ( UBaseType_t ) ( ullSlot & timerwheelSLOT_MASK );
+
+        if( uxRotate != 0 )
+        {
+            ullBits = ( ullBits >> uxRotate ) | ( ullBits << ( timerwheelSLOTS - uxRotate ) );
+        }
+
+        ullEvent = ( ullSlot + ( uint64_t ) __builtin_ctzll( ullBits ) ) << uxShift;
+
+        if( ullEvent < ullNext )
+        {
+            ullNext = ullEvent;
+        }
+    }
+
+    return ullNext;
+}
+/*-----------------------------------------------------------*/
+
+/* Run the wheel up to ullNowUs, moving the timers due by then to the expired
+ * list */
+static void prvAdvance( uint64_t ullNowUs )
+{
+    while( ullWheelUs < ullNowUs )
+    {
+        uint64_t ullEvent = prvNextEvent();
+
+        if( ullEvent > ullNowUs )
+        {
+            ullWheelUs = ullNowUs;
+            break;
+        }
+
+        ullWheelUs = ullEvent;
+
+        /* Coarsest first, so that a timer cascaded from a level can still be
+         * cascaded on from the next one down */
+        for( UBaseType_t uxLevel = configTIMER_WHEEL_LEVELS; uxLevel-- > 0; )
+        {
+            UBaseType_t uxShift = uxLevel * timerwheelSLOT_BITS;
+            UBaseType_t uxSlot = ( UBaseType_t ) ( ( ullWheelUs >> uxShift ) & timerwheelSLOT_MASK );
+            TimerWheelTimer_t * pxTimer;
+
+            if( ( ( ullWheelUs & ( ( 1ULL << uxShift ) - 1 ) ) != 0 ) ||
+                ( ( ullOccupied[ uxLevel ] & ( 1ULL << uxSlot ) ) == 0 ) )
+            {
+                continue;
+            }
+
+            /* Detach the whole slot, a parked timer may go back into it */
+            pxTimer = pxSlots[ uxLevel ][ uxSlot ];
+            pxSlots[ uxLevel ][ uxSlot ] = NULL;
+            ullOccupied[ uxLevel ] &= ~( 1ULL << uxSlot );
+
+            while( pxTimer != NULL )
+            {
+                TimerWheelTimer_t * pxNext = pxTimer->pxNext;
+
+                pxTimer->pxNext = NULL;
+                pxTimer->ppxPrev = NULL;
+                prvInsert( pxTimer );
+
+                if( uxLevel > 0 )
+                {
+                    xStats.ulCascades++;
+                }
+
+                pxTimer = pxNext;
+            }
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+/* Run the callbacks of the expired timers, returning how many ran */
+static uint32_t prvRunExpired( void )
+{
+    uint32_t ulRun = 0;
+
+    while( pxExpired != NULL )
+    {
+        TimerWheelTimer_t * pxTimer = pxExpired;
+        uint64_t ullNowUs = ullTimerWheelNowUs();
+        uint32_t ulLateUs;
+
+        prvUnlink( pxTimer );
+        pxTimer->ucState = timerwheelFIRING;
+        xStats.ulActive--;
+
+        ulLateUs = ( ullNowUs - pxTimer->ullDueUs > UINT32_MAX ) ? UINT32_MAX : ( uint32_t ) ( ullNowUs - pxTimer->ullDueUs );
+        xStats.ulFired++;
+        xStats.ullTotalLateUs += ulLateUs;
+        xStats.ulLate[ prvBin( ulLateUs ) ]++;
+
+        if( ulLateUs > xStats.ulMaxLateUs )
+        {
+            xStats.ulMaxLateUs = ulLateUs;
+        }
+
+        pxTimer->pxCallback( pxTimer, pxTimer->pvContext );
+        ulRun++;
+
+        /* Neither stopped nor started again by the callback */
+        if( pxTimer->ucState == timerwheelFIRING )
+        {
+            if( pxTimer->ulPeriodUs != 0 )
+            {
+                pxTimer->ullDueUs += pxTimer->ulPeriodUs;
+
+                /* Skip the periods the callbacks ran past rather than fire
+                 * back to back */
+                if( pxTimer->ullDueUs <= ullWheelUs )
+                {
+                    uint64_t ullMissed = ( ullWheelUs - pxTimer->ullDueUs ) / pxTimer->ulPeriodUs + 1;
+
+                    pxTimer->ullDueUs += ullMissed * pxTimer->ulPeriodUs;
+                    xStats.ulOverruns += ( uint32_t ) ullMissed;
+                }
+
+                prvInsert( pxTimer );
+                xStats.ulActive++;
+            }
+            else
+            {
+                pxTimer->ucState = timerwheelIDLE;
+            }
+        }
+    }
+
+    return ulRun;
+}
+/*-----------------------------------------------------------*/
+
+static void prvServiceTask( void * pvParameters )
+{
+    uint64_t ullNextUs, ullNowUs;
+    uint32_t ulRun;
+
+    ( void ) pvParameters;
+
+    for( ; ; )
+    {
+        xSemaphoreTakeRecursive( xLock, portMAX_DELAY );
+        {
+            ullWakeUs = 0;
+            prvAdvance( ullTimerWheelNowUs() );
+            ulRun = prvRunExpired();
+
+            if( ulRun > 0 )
+            {
+                xStats.ulBatches++;
+
+                if( ulRun > xStats.ulMaxBatch )
+                {
+                    xStats.ulMaxBatch = ulRun;
+                }
+            }
+
+            ullNextUs = prvNextEvent();
+            ullWakeUs = ullNextUs;
+        }
+        xSemaphoreGiveRecursive( xLock );
+
+        /* A timer started from now on that is due before ullWakeUs notifies */
+        ullNowUs = ullTimerWheelNowUs();
+
+        if( ullNextUs == UINT64_MAX )
+        {
+            ( void ) ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+        }
+        else if( ullNextUs <= ullNowUs )
+        {
+            continue;
+        }
+        else if( ullNextUs - ullNowUs <= configTIMER_WHEEL_SPIN_US )
+        {
+            taskYIELD();
+        }
+        else
+        {
+            /* A wait of n ticks ends between n - 1 and n tick periods from now,
+             * so one more for it not to end early */
+            uint64_t ullTicks = ( ullNextUs - ullNowUs ) / timerwheelUS_PER_TICK + 1;
+
+            ( void ) ulTaskNotifyTake( pdTRUE, ( ullTicks < portMAX_DELAY ) ? ( TickType_t ) ullTicks : portMAX_DELAY - 1 );
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+uint64_t ullTimerWheelNowUs( void )
+{
+    return ullClockMonotonicNs() / 1000;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xTimerWheelInit( uint16_t usStackSize,
+                            UBaseType_t uxPriority )
+{
+    BaseType_t xReturn = pdPASS;
+
+    vTaskSuspendAll();
+    {
+        if( xLock == NULL )
+        {
+            xLock = xSemaphoreCreateRecursiveMutex();
+            xReturn = ( xLock != NULL ) ? pdPASS : pdFAIL;
+            ullWheelUs = ullTimerWheelNowUs();
+        }
+
+        if( ( xReturn == pdPASS ) && ( xServiceTask == NULL ) )
+        {
+            xReturn = xTaskCreate( prvServiceTask, "TimerWheel", usStackSize, NULL, uxPriority, &xServiceTask );
+        }
+    }
+    ( void ) xTaskResumeAll();
+
+    return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+void vTimerWheelInitTimer( TimerWheelTimer_t * pxTimer,
+                           TimerWheelCallback_t pxCallback,
+                           void * pvContext )
+{
+    memset( pxTimer, 0, sizeof( *pxTimer ) );
+    pxTimer->ucState = timerwheelIDLE;
+    pxTimer->pxCallback = pxCallback;
+    pxTimer->pvContext = pvContext;
+}
+/*-----------------------------------------------------------*/
+
+void vTimerWheelStart( TimerWheelTimer_t * pxTimer,
+                       uint32_t ulDelayUs,
+                       uint32_t ulPeriodUs )
+{
+    uint64_t ullNowUs = ullTimerWheelNowUs();
+    BaseType_t xWake = pdFALSE;
+
+    configASSERT( xLock != NULL );
+
+    xSemaphoreTakeRecursive( xLock, portMAX_DELAY );
+    {
+        if( pxTimer->ppxPrev != NULL )
+        {
+            prvUnlink( pxTimer );
+        }
+        else
+        {
+            xStats.ulActive++;
+
+            if( xStats.ulActive > xStats.ulMaxActive )
+            {
+                xStats.ulMaxActive = xStats.ulActive;
+            }
+        }
+
+        /* Nothing to run up to in an empty wheel, so let it catch up rather
+         * than place the timer from a time long past */
+        if( ullWheelUs < ullNowUs )
+        {
+            BaseType_t xEmpty = pdTRUE;
+
+            for( UBaseType_t uxLevel = 0; uxLevel < configTIMER_WHEEL_LEVELS; uxLevel++ )
+            {
+                if( ullOccupied[ uxLevel ] != 0 )
+                {
+                    xEmpty = pdFALSE;
+                }
+            }
+
+            if( xEmpty != pdFALSE )
+            {
+                ullWheelUs = ullNowUs;
+            }
+        }
+
+        pxTimer->ullDueUs = ullNowUs + ulDelayUs;
+        pxTimer->ulPeriodUs = ulPeriodUs;
+        prvInsert( pxTimer );
+        xStats.ulStarts++;
+
+        xWake = ( pxTimer->ullDueUs < ullWakeUs ) ? pdTRUE : pdFALSE;
+    }
+    xSemaphoreGiveRecursive( xLock );
+
+    if( ( xWake != pdFALSE ) && ( xTaskGetCurrentTaskHandle() != xServiceTask ) )
+    {
+        xTaskNotifyGive( xServiceTask );
+    }
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xTimerWheelStop( TimerWheelTimer_t * pxTimer )
+{
+    BaseType_t xWasActive = pdFALSE;
+
+    configASSERT( xLock != NULL );
+
+    xSemaphoreTakeRecursive( xLock, portMAX_DELAY );
+    {
+        if( pxTimer->ppxPrev != NULL )
+        {
+            prvUnlink( pxTimer );
+            xStats.ulActive--;
+            xStats.ulStops++;
+            xWasActive = pdTRUE;
+        }
+
+        pxTimer->ucState = timerwheelIDLE;
+    }
+    xSemaphoreGiveRecursive( xLock );
+
+    return xWasActive;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xTimerWheelIsActive( const TimerWheelTimer_t * pxTimer )
+{
+    return ( ( pxTimer->ucState == timerwheelARMED ) || ( pxTimer->ucState == timerwheelEXPIRED ) ) ? pdTRUE : pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+void vTimerWheelGetStats( TimerWheelStats_t * pxStats )
+{
+    if( xLock == NULL )
+    {
+        memset( pxStats, 0, sizeof( *pxStats ) );
+        return;
+    }
+
+    xSemaphoreTakeRecursive( xLock, portMAX_DELAY );
+    *pxStats = xStats;
+    xSemaphoreGiveRecursive( xLock );
+}
+/*-----------------------------------------------------------*/
+
+void vTimerWheelResetStats( void )
+{
+    uint32_t ulActive;
+
+    if( xLock == NULL )
+    {
+        return;
+    }
+
+    xSemaphoreTakeRecursive( xLock, portMAX_DELAY );
+    ulActive = xStats.ulActive;
+    memset( &xStats, 0, sizeof( xStats ) );
+    xStats.ulActive = ulActive;
+    xStats.ulMaxActive = ulActive;
+    xSemaphoreGiveRecursive( xLock );
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,117 @@
+/**
+ * Hierarchical timer wheel with microsecond resolution (bsp/timer_wheel.c).
+ *
+ * FreeRTOS software timers are kept in a sorted list, so starting one costs
+ * O(n) in the daemon task and every command goes through a queue of
+ * configTIMER_QUEUE_LENGTH. The wheel is for users with many timers, one per
+ * connection or per retransmission: starting and stopping a timer is O(1),
+ * done in the caller's context, and the timers are caller-allocated, so there
+ * is no limit on how many run at once.
+ *
+ * Time is the monotonic clock (bsp/clock.c) in microseconds. The service task
+ * sleeps until the earliest timer is due, then runs the callbacks of every
+ * timer due by then in one batch. How late each timer fired is counted.
+ */
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdint.h>
+#include "FreeRTOS.h"
+
+/* Levels of 64 slots, level n covers 64^(n+1) microseconds: six reach past
+ * the longest delay vTimerWheelStart() takes. With fewer, timers further out
+ * than the last level are parked in it and placed again when it comes round. */
+#ifndef configTIMER_WHEEL_LEVELS
+    #define configTIMER_WHEEL_LEVELS             6
+#endif
+
+/* The service task waits in whole ticks. Timers due within this many
+ * microseconds are waited for by yielding instead, which trades CPU time for
+ * lateness below a tick. 0 to never spin. */
+#ifndef configTIMER_WHEEL_SPIN_US
+    #define configTIMER_WHEEL_SPIN_US            0
+#endif
+
+/* Bin 0 counts 0 us late, bin n (n > 0) counts [2^(n-1), 2^n) us and the last
+ * bin everything above */
+#ifndef configTIMER_WHEEL_HISTOGRAM_BINS
+    #define configTIMER_WHEEL_HISTOGRAM_BINS     18
+#endif
+
+typedef struct TIMER_WHEEL_TIMER TimerWheelTimer_t;
+
+/*
+ * Runs in the service task with the wheel locked, so it can start and stop
+ * timers, this one included, but must not block. A periodic timer that is not
+ * stopped or started again from its callback is re-armed one period after the
+ * time it was due.
+ */
+typedef void (* TimerWheelCallback_t)( TimerWheelTimer_t * pxTimer,
+                                       void * pvContext );
+
+/* Private, allocated by the caller and set up with vTimerWheelInitTimer() */
+struct TIMER_WHEEL_TIMER
+{
+    TimerWheelTimer_t * pxNext;
+    TimerWheelTimer_t ** ppxPrev; /* The pointer that points here, NULL when idle */
+    uint64_t ullDueUs;            /* When it was asked to fire */
+    uint32_t ulPeriodUs;          /* 0 for a one-shot timer */
+    uint8_t ucState;
+    uint8_t ucLevel;              /* Slot it is in, while in the wheel */
+    uint8_t ucSlot;
+    TimerWheelCallback_t pxCallback;
+    void * pvContext;
+};
+
+typedef struct TIMER_WHEEL_STATS
+{
+    uint32_t ulStarts;         /* vTimerWheelStart() calls */
+    uint32_t ulStops;          /* xTimerWheelStop() calls that stopped a timer */
+    uint32_t ulFired;          /* Callbacks run */
+    uint32_t ulOverruns;       /* Periods a periodic timer skipped, already past when re-armed */
+    uint32_t ulCascades;       /* Timers moved to a finer level */
+    uint32_t ulBatches;        /* Service task passes that ran callbacks */
+    uint32_t ulMaxBatch;       /* Most callbacks run in one pass */
+    uint32_t ulActive;         /* Timers running now */
+    uint32_t ulMaxActive;
+    uint32_t ulMaxLateUs;      /* Largest time from due to its callback */
+    uint64_t ullTotalLateUs;   /* For the mean over ulFired */
+    uint32_t ulLate[ configTIMER_WHEEL_HISTOGRAM_BINS ];
+} TimerWheelStats_t;
+
+/* Create the service task, once. The wheel can be used once this returns. */
+BaseType_t xTimerWheelInit( uint16_t usStackSize,
+                            UBaseType_t uxPriority );
+
+/* Set up a timer before its first start */
+void vTimerWheelInitTimer( TimerWheelTimer_t * pxTimer,
+                           TimerWheelCallback_t pxCallback,
+                           void * pvContext );
+
+/*
+ * (Re)start pxTimer to fire ulDelayUs from now and then every ulPeriodUs, or
+ * once if ulPeriodUs is 0. A timer already running is moved.
+ */
+void vTimerWheelStart( TimerWheelTimer_t * pxTimer,
+                       uint32_t ulDelayUs,
+                       uint32_t ulPeriodUs );
+
+/*
+ * Stop pxTimer. Once this returns its callback is not running, unless this is
+ * called from that callback, and will not run. pdTRUE if the timer was waiting
+ * to fire.
+ */
+BaseType_t xTimerWheelStop( TimerWheelTimer_t * pxTimer );
+
+/* pdTRUE while pxTimer is waiting to fire */
+BaseType_t xTimerWheelIsActive( const TimerWheelTimer_t * pxTimer );
+
+/* Microseconds on the wheel's clock */
+uint64_t ullTimerWheelNowUs( void );
+
+void vTimerWheelGetStats( TimerWheelStats_t * pxStats );
+
+/* Clear the counters, not ulActive */
+void vTimerWheelResetStats( void );
+
+#endif /* TIMER_WHEEL_H */
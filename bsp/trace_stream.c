@@ -0,0 +1,218 @@
+/*
+ * Chunked record streams to a sink, see trace_stream.h.
+ *
+ * The drain task holds xLock while it writes, which is what
+ * vTraceStreamStop() waits on before the last drain and the close. An entry
+ * of the name table is published by bumping uxNames only once it is filled
+ * in, so the drain can read the table while a writer adds to it.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include "trace_stream.h"
+
+/* Called with xLock held */
+static void prvClose( TraceStream_t * pxStream )
+{
+    ( void ) pxStream->pxSinkWrite( NULL, 0, pxStream->pvSinkContext );
+    pxStream->pxSinkWrite = NULL;
+    pxStream->pvSinkContext = NULL;
+}
+/*-----------------------------------------------------------*/
+
+static void prvDrainTask( void * pvParameters )
+{
+    TraceStream_t * pxStream = pvParameters;
+
+    for( ; ; )
+    {
+        ( void ) ulTaskNotifyTake( pdTRUE, pxStream->xDrainTicks );
+
+        xSemaphoreTake( pxStream->xLock, portMAX_DELAY );
+
+        if( ( pxStream->pxSinkWrite != NULL ) && ( pxStream->pxDrain() != pdFALSE ) )
+        {
+            prvClose( pxStream );
+        }
+
+        xSemaphoreGive( pxStream->xLock );
+    }
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xTraceStreamInit( TraceStream_t * pxStream,
+                             const char * pcTaskName,
+                             uint16_t usStackSize,
+                             UBaseType_t uxPriority )
+{
+    BaseType_t xReturn = pdPASS;
+
+    vTaskSuspendAll();
+    {
+        if( pxStream->pvRing == NULL )
+        {
+            pxStream->pvRing = pvPortMalloc( pxStream->uxRingSize );
+            xReturn = ( pxStream->pvRing != NULL ) ? pdPASS : pdFAIL;
+        }
+
+        if( ( xReturn == pdPASS ) && ( pxStream->xLock == NULL ) )
+        {
+            pxStream->xLock = xSemaphoreCreateMutex();
+            xReturn = ( pxStream->xLock != NULL ) ? pdPASS : pdFAIL;
+        }
+
+        if( ( xReturn == pdPASS ) && ( pxStream->xDrainTask == NULL ) )
+        {
+            xReturn = xTaskCreate( prvDrainTask, pcTaskName, usStackSize, pxStream, uxPriority, &pxStream->xDrainTask );
+        }
+    }
+    ( void ) xTaskResumeAll();
+
+    return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xTraceStreamStart( TraceStream_t * pxStream,
+                              TraceStreamWrite_t pxWrite,
+                              void * pvContext,
+                              void ( * pxBegin )( const void * pvArgument ),
+                              const void * pvBeginArgument )
+{
+    BaseType_t xReturn = pdFAIL;
+
+    configASSERT( pxStream->xLock != NULL );
+    configASSERT( pxWrite != NULL );
+
+    xSemaphoreTake( pxStream->xLock, portMAX_DELAY );
+
+    if( pxStream->pxSinkWrite == NULL )
+    {
+        /* Nothing records while there is no sink, the ring is ours */
+        pxStream->uxNames = 0;
+        pxStream->ulChunkSequence = 0;
+        pxStream->uxNamesSent = 0;
+        pxStream->ulChunks = 0;
+        pxStream->ulWriteErrors = 0;
+
+        pxStream->pxSinkWrite = pxWrite;
+        pxStream->pvSinkContext = pvContext;
+        pxBegin( pvBeginArgument );
+        xReturn = pdPASS;
+    }
+
+    xSemaphoreGive( pxStream->xLock );
+
+    return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+void vTraceStreamStop( TraceStream_t * pxStream,
+                       void ( * pxHalt )( void ) )
+{
+    configASSERT( pxStream->xLock != NULL );
+
+    xSemaphoreTake( pxStream->xLock, portMAX_DELAY );
+
+    if( pxStream->pxSinkWrite != NULL )
+    {
+        pxHalt();
+        ( void ) pxStream->pxDrain();
+        prvClose( pxStream );
+    }
+
+    xSemaphoreGive( pxStream->xLock );
+}
+/*-----------------------------------------------------------*/
+
+UBaseType_t uxTraceStreamName( TraceStream_t * pxStream,
+                               const void * pvTask,
+                               const char * pcName )
+{
+    UBaseType_t x;
+
+    for( x = 0; x < pxStream->uxNames; x++ )
+    {
+        if( ( pxStream->pxNames[ x ].pvTask == pvTask ) &&
+            ( strncmp( pxStream->pxNames[ x ].cName, pcName, configMAX_TASK_NAME_LEN ) == 0 ) )
+        {
+            return x;
+        }
+    }
+
+    if( x >= pxStream->uxMaxNames )
+    {
+        return pxStream->uxMaxNames;
+    }
+
+    pxStream->pxNames[ x ].pvTask = pvTask;
+    strncpy( pxStream->pxNames[ x ].cName, pcName, configMAX_TASK_NAME_LEN );
+
+    /* Publish the entry only once the name is in place */
+    __asm volatile ( "" ::: "memory" );
+    pxStream->uxNames = x + 1;
+
+    return x;
+}
+/*-----------------------------------------------------------*/
+
+void vTraceStreamPut( TraceStream_t * pxStream,
+                      uint64_t ullValue,
+                      size_t uxBytes )
+{
+    configASSERT( pxStream->uxChunkLength + uxBytes <= pxStream->uxChunkSize );
+
+    while( uxBytes-- > 0 )
+    {
+        pxStream->pucChunk[ pxStream->uxChunkLength++ ] = ( uint8_t ) ullValue;
+        ullValue >>= 8;
+    }
+}
+/*-----------------------------------------------------------*/
+
+void vTraceStreamPutBytes( TraceStream_t * pxStream,
+                           const void * pvData,
+                           size_t uxLength )
+{
+    configASSERT( pxStream->uxChunkLength + uxLength <= pxStream->uxChunkSize );
+
+    memcpy( &pxStream->pucChunk[ pxStream->uxChunkLength ], pvData, uxLength );
+    pxStream->uxChunkLength += uxLength;
+}
+/*-----------------------------------------------------------*/
+
+size_t uxTraceStreamRoom( const TraceStream_t * pxStream )
+{
+    return pxStream->uxChunkSize - pxStream->uxChunkLength;
+}
+/*-----------------------------------------------------------*/
+
+void vTraceStreamChunkBegin( TraceStream_t * pxStream )
+{
+    pxStream->uxChunkLength = traceSTREAM_CHUNK_HEADER_SIZE;
+    pxStream->usChunkRecords = 0;
+}
+/*-----------------------------------------------------------*/
+
+void vTraceStreamChunkWrite( TraceStream_t * pxStream )
+{
+    size_t uxLength = pxStream->uxChunkLength;
+
+    pxStream->uxChunkLength = 0;
+    vTraceStreamPut( pxStream, pxStream->ulMagic, 4 );
+    vTraceStreamPut( pxStream, pxStream->ulChunkSequence++, 4 );
+    vTraceStreamPut( pxStream, uxLength, 2 );
+    vTraceStreamPut( pxStream, pxStream->usChunkRecords, 2 );
+
+    if( pxStream->pxSinkWrite( pxStream->pucChunk, uxLength, pxStream->pvSinkContext ) != pdPASS )
+    {
+        pxStream->ulWriteErrors++;
+    }
+
+    pxStream->ulChunks++;
+}
+/*-----------------------------------------------------------*/
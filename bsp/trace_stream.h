@@ -0,0 +1,127 @@
+/**
+ * Chunked record streams to a sink (bsp/trace_stream.c).
+ *
+ * What the PC profiler (pc_profiler.h) and the event trace (event_trace.h)
+ * have in common: a ring filled by interrupts or the kernel is drained by a
+ * low priority task into self-describing chunks, which are handed to a sink,
+ * a file on FAT or UDP datagrams to the host, until the recording stops and
+ * the sink is closed. Every chunk starts with the same header, little-endian:
+ *
+ *   uint32 magic  uint32 sequence  uint16 length (header included)
+ *   uint16 records
+ *
+ * and the tasks seen so far are kept in a name table that the records refer
+ * to. The rings and the records are the user's own; a stream only builds the
+ * chunks, owns the sink and runs the drain task.
+ *
+ * A stream is a static TraceStream_t with its first fields set, see
+ * pc_profiler.c.
+ */
+#ifndef TRACE_STREAM_H
+#define TRACE_STREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#define traceSTREAM_CHUNK_HEADER_SIZE    12
+
+/*
+ * Writes one chunk. Called with pucData NULL and uxLength 0 once the recording
+ * is stopped and everything has been written, for the sink to close.
+ */
+typedef BaseType_t (* TraceStreamWrite_t)( const uint8_t * pucData,
+                                           size_t uxLength,
+                                           void * pvContext );
+
+typedef struct TRACE_STREAM_NAME
+{
+    const void * pvTask;
+    char cName[ configMAX_TASK_NAME_LEN ];
+} TraceStreamName_t;
+
+typedef struct TRACE_STREAM
+{
+    /* Set by the user */
+    uint32_t ulMagic;
+    uint8_t * pucChunk;
+    size_t uxChunkSize;
+    TraceStreamName_t * pxNames;
+    UBaseType_t uxMaxNames;
+    size_t uxRingSize;               /* Bytes of ring xTraceStreamInit() allocates */
+    TickType_t xDrainTicks;          /* The drain task wakes at least this often */
+
+    /* Writes out the ring, called with xLock held. Returns pdTRUE once the
+     * recording has stopped and all of it is written, for the sink to close */
+    BaseType_t ( * pxDrain )( void );
+
+    /* Set by xTraceStreamInit() */
+    void * pvRing;
+    SemaphoreHandle_t xLock;
+    TaskHandle_t xDrainTask;
+
+    /* Added to by one writer at a time */
+    volatile UBaseType_t uxNames;
+
+    /* Owned by the drain, under xLock */
+    TraceStreamWrite_t pxSinkWrite;
+    void * pvSinkContext;
+    size_t uxChunkLength;
+    uint16_t usChunkRecords;
+    uint32_t ulChunkSequence;
+    UBaseType_t uxNamesSent;
+    uint32_t ulChunks;               /* Handed to the sink */
+    uint32_t ulWriteErrors;          /* Chunks the sink failed to write */
+} TraceStream_t;
+
+/* Allocate the ring and create the lock and the drain task, once */
+BaseType_t xTraceStreamInit( TraceStream_t * pxStream,
+                             const char * pcTaskName,
+                             uint16_t usStackSize,
+                             UBaseType_t uxPriority );
+
+/*
+ * Reset the stream and start writing to pxWrite, unless it already has a sink.
+ * pxBegin( pvBeginArgument ) is called with xLock held once the sink is in
+ * place, to clear the ring and start recording.
+ */
+BaseType_t xTraceStreamStart( TraceStream_t * pxStream,
+                              TraceStreamWrite_t pxWrite,
+                              void * pvContext,
+                              void ( * pxBegin )( const void * pvArgument ),
+                              const void * pvBeginArgument );
+
+/*
+ * pxHalt is called with xLock held to stop recording, then what is left is
+ * written out and the sink closed.
+ */
+void vTraceStreamStop( TraceStream_t * pxStream,
+                       void ( * pxHalt )( void ) );
+
+/*
+ * Index of the task's entry in the name table, matching both the handle and the
+ * name, added if there is none; uxMaxNames once the table is full. One writer
+ * at a time, never calls into the kernel.
+ */
+UBaseType_t uxTraceStreamName( TraceStream_t * pxStream,
+                               const void * pvTask,
+                               const char * pcName );
+
+/* Building a chunk, from pxDrain */
+void vTraceStreamChunkBegin( TraceStream_t * pxStream );
+
+void vTraceStreamChunkWrite( TraceStream_t * pxStream );
+
+void vTraceStreamPut( TraceStream_t * pxStream,
+                      uint64_t ullValue,
+                      size_t uxBytes );
+
+void vTraceStreamPutBytes( TraceStream_t * pxStream,
+                           const void * pvData,
+                           size_t uxLength );
+
+size_t uxTraceStreamRoom( const TraceStream_t * pxStream );
+
+#endif /* TRACE_STREAM_H */
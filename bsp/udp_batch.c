@@ -0,0 +1,149 @@
+/*
+ * Batched, zero-copy UDP send/receive.
+ *
+ * Every FreeRTOS_sendto() posts one eStackTxEvent to the IP task, which runs
+ * at a higher priority than application tasks and so preempts the sender for
+ * each datagram. xUDPBatchSendTo() raises the caller to the IP task's priority
+ * while it posts the batch: the events queue up without a context switch, and
+ * restoring the priority lets the IP task drain them all in one wake-up.
+ * Payloads are zero-copy buffers from FreeRTOS_GetUDPPayloadBuffer(). With
+ * --udp-fast-tx, datagrams to resolved peers skip the IP task altogether
+ * (bsp/udp_fast_tx.c).
+ *
+ * Reception already bypasses the IP task; xUDPBatchRecvFrom() takes every
+ * datagram waiting on the socket after a single (optionally blocking) wait,
+ * again without copying.
+ */
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "FreeRTOS_IP.h"
+#include "FreeRTOS_Sockets.h"
+
+#include "udp_batch.h"
+
+#if ( configUDP_FAST_TX == 1 )
+    #include "udp_fast_tx.h"
+#endif
+/*-----------------------------------------------------------*/
+
+BaseType_t xUDPBatchGetBuffers( UDPBatchItem_t * pxItems,
+                                BaseType_t xCount,
+                                size_t uxLength,
+                                TickType_t xBlockTime )
+{
+    BaseType_t x;
+
+    for( x = 0; x < xCount; x++ )
+    {
+        pxItems[ x ].pvPayload = FreeRTOS_GetUDPPayloadBuffer( uxLength, ( x == 0 ) ? xBlockTime : 0 );
+
+        if( pxItems[ x ].pvPayload == NULL )
+        {
+            break;
+        }
+
+        pxItems[ x ].uxLength = uxLength;
+    }
+
+    return x;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xUDPBatchSendTo( Socket_t xSocket,
+                            UDPBatchItem_t * pxItems,
+                            BaseType_t xCount )
+{
+    TaskStatus_t xStatus;
+    UBaseType_t uxPriority;
+    BaseType_t x;
+
+    /* The base priority, not an inherited one: vTaskPrioritySet() below
+     * restores the base, and restoring an inherited priority there would
+     * keep it after the mutex holding it up is given back */
+    vTaskGetInfo( NULL, &xStatus, pdFALSE, eRunning );
+    uxPriority = xStatus.uxBasePriority;
+
+    if( xCount > configUDP_BATCH_MAX )
+    {
+        xCount = configUDP_BATCH_MAX;
+    }
+
+    /* Same priority as the IP task: posting to its queue no longer preempts
+     * this task. Blocking (a full event queue, an implicit bind) still works. */
+    if( uxPriority < ipconfigIP_TASK_PRIORITY )
+    {
+        vTaskPrioritySet( NULL, ipconfigIP_TASK_PRIORITY );
+    }
+
+    for( x = 0; x < xCount; x++ )
+    {
+        #if ( configUDP_FAST_TX == 1 )
+            if( lUDPFastSendTo( xSocket, pxItems[ x ].pvPayload, pxItems[ x ].uxLength, &pxItems[ x ].xAddress ) == 0 )
+        #else
+            if( FreeRTOS_sendto( xSocket, pxItems[ x ].pvPayload, pxItems[ x ].uxLength,
+                                 FREERTOS_ZERO_COPY, &pxItems[ x ].xAddress, sizeof( pxItems[ x ].xAddress ) ) == 0 )
+        #endif
+        {
+            break;
+        }
+
+        /* Owned by the stack now */
+        pxItems[ x ].pvPayload = NULL;
+    }
+
+    /* The IP task runs here, once for the whole batch */
+    if( uxPriority < ipconfigIP_TASK_PRIORITY )
+    {
+        vTaskPrioritySet( NULL, uxPriority );
+    }
+
+    return x;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xUDPBatchRecvFrom( Socket_t xSocket,
+                              UDPBatchItem_t * pxItems,
+                              BaseType_t xCount,
+                              BaseType_t xFlags )
+{
+    BaseType_t x;
+
+    for( x = 0; x < xCount; x++ )
+    {
+        uint32_t ulAddressLength = sizeof( pxItems[ x ].xAddress );
+        int32_t lBytes;
+
+        /* Only the first receive may block */
+        lBytes = FreeRTOS_recvfrom( xSocket, &pxItems[ x ].pvPayload, 0,
+                                    FREERTOS_ZERO_COPY | ( ( x == 0 ) ? xFlags : FREERTOS_MSG_DONTWAIT ),
+                                    &pxItems[ x ].xAddress, &ulAddressLength );
+
+        if( lBytes <= 0 )
+        {
+            break;
+        }
+
+        pxItems[ x ].uxLength = ( size_t ) lBytes;
+    }
+
+    return x;
+}
+/*-----------------------------------------------------------*/
+
+void vUDPBatchRelease( UDPBatchItem_t * pxItems,
+                       BaseType_t xCount )
+{
+    for( BaseType_t x = 0; x < xCount; x++ )
+    {
+        if( pxItems[ x ].pvPayload != NULL )
+        {
+            FreeRTOS_ReleaseUDPPayloadBuffer( pxItems[ x ].pvPayload );
+            pxItems[ x ].pvPayload = NULL;
+        }
+    }
+}
+/*-----------------------------------------------------------*/
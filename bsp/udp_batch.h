@@ -0,0 +1,60 @@
+/**
+ * Batched, zero-copy UDP send/receive on top of FreeRTOS+TCP sockets
+ * (bsp/udp_batch.c).
+ */
+#ifndef UDP_BATCH_H
+#define UDP_BATCH_H
+
+#include <stddef.h>
+#include "FreeRTOS.h"
+#include "FreeRTOS_IP.h"
+#include "FreeRTOS_Sockets.h"
+
+/* Upper bound on the datagrams handled by one call */
+#ifndef configUDP_BATCH_MAX
+    #define configUDP_BATCH_MAX    32
+#endif
+
+typedef struct UDP_BATCH_ITEM
+{
+    void * pvPayload;                  /* Zero-copy UDP payload buffer */
+    size_t uxLength;                   /* Payload bytes */
+    struct freertos_sockaddr xAddress; /* Destination (send) or source (receive) */
+} UDPBatchItem_t;
+
+/*
+ * Fill in pvPayload of up to xCount items with UDP payload buffers of
+ * uxLength bytes each, waiting up to xBlockTime for the first one only.
+ * Returns the number of items that got a buffer.
+ */
+BaseType_t xUDPBatchGetBuffers( UDPBatchItem_t * pxItems,
+                                BaseType_t xCount,
+                                size_t uxLength,
+                                TickType_t xBlockTime );
+
+/*
+ * Send up to xCount datagrams, handing their payload buffers to the stack
+ * (FREERTOS_ZERO_COPY). The whole batch is queued before the IP task gets to
+ * run, so it is processed in one wake-up rather than one per datagram.
+ * Returns the number of datagrams queued; the buffers of the rest still belong
+ * to the caller (release or retry them).
+ */
+BaseType_t xUDPBatchSendTo( Socket_t xSocket,
+                            UDPBatchItem_t * pxItems,
+                            BaseType_t xCount );
+
+/*
+ * Receive up to xCount datagrams already queued on the socket, zero-copy.
+ * Blocks for the socket's receive timeout for the first one, unless xFlags
+ * has FREERTOS_MSG_DONTWAIT. Returns the number of items filled in; their
+ * buffers must be released with vUDPBatchRelease().
+ */
+BaseType_t xUDPBatchRecvFrom( Socket_t xSocket,
+                              UDPBatchItem_t * pxItems,
+                              BaseType_t xCount,
+                              BaseType_t xFlags );
+
+void vUDPBatchRelease( UDPBatchItem_t * pxItems,
+                       BaseType_t xCount );
+
+#endif /* UDP_BATCH_H */
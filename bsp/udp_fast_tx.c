@@ -0,0 +1,272 @@
+/*
+ * Direct UDP transmit path, selected with --udp-fast-tx.
+ *
+ * FreeRTOS_sendto() posts every datagram to the IP task, which builds the
+ * headers, resolves the destination and calls xNetworkInterfaceOutput(): a
+ * queue operation and two context switches per datagram, all funnelled
+ * through a single event queue. lUDPFastSendTo() does that work in the
+ * sender's own context when it can do so without the stack's help, that is
+ * for a bound socket sending to an on-link peer that the hashed ARP cache
+ * (bsp/arp_cache.c, always built alongside) already resolved. Everything
+ * else, including the first datagram to a new peer, goes through
+ * FreeRTOS_sendto(), which also gets the peer hashed for the next one.
+ *
+ * Drivers expect to be called by the IP task only, so the build links with
+ * --wrap=xNetworkInterfaceOutput and every transmit, from the IP task or from
+ * here, is serialised on one mutex held for just the driver call.
+ *
+ * iptraceUDP_FAST_TX and iptraceUDP_FAST_TX_FALLBACK count datagrams sent
+ * directly and datagrams handed to the stack; vUDPFastTxGetStats() returns
+ * the same counts.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+/* Counters show up in ip-debug-stats when the demo provides DemoIPTrace.
+ * Included ahead of the stack, whose trace macro defaults are #ifndef'd. */
+#if ( configINCLUDE_DEMO_DEBUG_STATS == 1 ) && __has_include( "DemoIPTrace.h" )
+    #include "DemoIPTrace.h"
+#endif
+
+#include "FreeRTOS_IP.h"
+#include "FreeRTOS_IP_Private.h"
+#include "FreeRTOS_Sockets.h"
+#include "NetworkInterface.h"
+#include "NetworkBufferManagement.h"
+
+#include "arp_cache.h"
+#include "udp_fast_tx.h"
+
+#ifndef iptraceUDP_FAST_TX
+    #define iptraceUDP_FAST_TX( ulIPAddress )
+#endif
+
+#ifndef iptraceUDP_FAST_TX_FALLBACK
+    #define iptraceUDP_FAST_TX_FALLBACK( ulIPAddress )
+#endif
+
+#define udpfastIP_UDP_HEADERS    ( ipSIZE_OF_IPv4_HEADER + ipSIZE_OF_UDP_HEADER )
+
+/* Frames built here are never fragmented */
+#define udpfastMAX_PAYLOAD       ( ipconfigNETWORK_MTU - udpfastIP_UDP_HEADERS )
+
+static SemaphoreHandle_t xTxLock = NULL;
+
+/* Protected by xTxLock. Datagrams sent here are never fragmented, so their
+ * identification does not have to be unique against the stack's own. */
+static uint16_t usIdentification = 0;
+static UDPFastTxStats_t xStats;
+
+/* The driver's transmit function, see --wrap in the wscript */
+BaseType_t __real_xNetworkInterfaceOutput( NetworkBufferDescriptor_t * const pxNetworkBuffer,
+                                           BaseType_t xReleaseAfterSend );
+BaseType_t __wrap_xNetworkInterfaceOutput( NetworkBufferDescriptor_t * const pxNetworkBuffer,
+                                           BaseType_t xReleaseAfterSend );
+/*-----------------------------------------------------------*/
+
+static SemaphoreHandle_t prvTxLock( void )
+{
+    /* The first transmit may race a direct send from an application task */
+    if( xTxLock == NULL )
+    {
+        vTaskSuspendAll();
+        {
+            if( xTxLock == NULL )
+            {
+                xTxLock = xSemaphoreCreateMutex();
+            }
+        }
+        ( void ) xTaskResumeAll();
+
+        configASSERT( xTxLock != NULL );
+    }
+
+    return xTxLock;
+}
+/*-----------------------------------------------------------*/
+
+#if ( ipconfigDRIVER_INCLUDED_TX_IP_CHECKSUM == 0 )
+
+    static uint32_t prvOnesSum( uint32_t ulSum,
+                                const uint8_t * pucData,
+                                size_t uxLength )
+    {
+        for( ; uxLength > 1; uxLength -= 2, pucData += 2 )
+        {
+            ulSum += ( ( uint32_t ) pucData[ 0 ] << 8 ) | pucData[ 1 ];
+        }
+
+        if( uxLength != 0 )
+        {
+            ulSum += ( uint32_t ) pucData[ 0 ] << 8;
+        }
+
+        return ulSum;
+    }
+/*-----------------------------------------------------------*/
+
+    static uint16_t prvFold( uint32_t ulSum )
+    {
+        while( ( ulSum >> 16 ) != 0 )
+        {
+            ulSum = ( ulSum & 0xffffU ) + ( ulSum >> 16 );
+        }
+
+        return ( uint16_t ) ulSum;
+    }
+/*-----------------------------------------------------------*/
+
+#endif /* ipconfigDRIVER_INCLUDED_TX_IP_CHECKSUM */
+
+static int32_t prvFallback( Socket_t xSocket,
+                            void * pvPayload,
+                            size_t uxLength,
+                            const struct freertos_sockaddr * pxDestination )
+{
+    taskENTER_CRITICAL();
+    {
+        xStats.ulFallback++;
+    }
+    taskEXIT_CRITICAL();
+
+    iptraceUDP_FAST_TX_FALLBACK( pxDestination->sin_addr );
+
+    return FreeRTOS_sendto( xSocket, pvPayload, uxLength, FREERTOS_ZERO_COPY,
+                            pxDestination, sizeof( *pxDestination ) );
+}
+/*-----------------------------------------------------------*/
+
+int32_t lUDPFastSendTo( Socket_t xSocket,
+                        void * pvPayload,
+                        size_t uxLength,
+                        const struct freertos_sockaddr * pxDestination )
+{
+    struct freertos_sockaddr xLocal;
+    NetworkBufferDescriptor_t * pxNetworkBuffer;
+    UDPPacket_t * pxPacket;
+    MACAddress_t xMACAddress;
+    uint32_t ulDestination = pxDestination->sin_addr;
+
+    if( ( uxLength > udpfastMAX_PAYLOAD ) ||
+        ( FreeRTOS_IsNetworkUp() == pdFALSE ) ||
+        ( ulDestination == *ipLOCAL_IP_ADDRESS_POINTER ) )
+    {
+        return prvFallback( xSocket, pvPayload, uxLength, pxDestination );
+    }
+
+    /* Unbound sockets are bound implicitly by the stack */
+    FreeRTOS_GetLocalAddress( xSocket, &xLocal );
+
+    if( ( xLocal.sin_port == 0 ) || ( xARPHashLookup( ulDestination, &xMACAddress ) == pdFALSE ) )
+    {
+        return prvFallback( xSocket, pvPayload, uxLength, pxDestination );
+    }
+
+    pxNetworkBuffer = pxUDPPayloadBuffer_to_NetworkBuffer( pvPayload );
+
+    if( pxNetworkBuffer == NULL )
+    {
+        return prvFallback( xSocket, pvPayload, uxLength, pxDestination );
+    }
+
+    pxPacket = ( UDPPacket_t * ) pxNetworkBuffer->pucEthernetBuffer;
+
+    pxPacket->xEthernetHeader.xDestinationAddress = xMACAddress;
+    memcpy( pxPacket->xEthernetHeader.xSourceAddress.ucBytes, ipLOCAL_MAC_ADDRESS, ipMAC_ADDRESS_LENGTH_BYTES );
+    pxPacket->xEthernetHeader.usFrameType = ipIPv4_FRAME_TYPE;
+
+    pxPacket->xIPHeader.ucVersionHeaderLength = ipIPV4_VERSION_HEADER_LENGTH_MIN;
+    pxPacket->xIPHeader.ucDifferentiatedServicesCode = 0;
+    pxPacket->xIPHeader.usLength = FreeRTOS_htons( ( uint16_t ) ( udpfastIP_UDP_HEADERS + uxLength ) );
+    pxPacket->xIPHeader.usFragmentOffset = 0;
+    pxPacket->xIPHeader.ucTimeToLive = ipconfigUDP_TIME_TO_LIVE;
+    pxPacket->xIPHeader.ucProtocol = ipPROTOCOL_UDP;
+    pxPacket->xIPHeader.usHeaderChecksum = 0;
+    pxPacket->xIPHeader.ulSourceIPAddress = *ipLOCAL_IP_ADDRESS_POINTER;
+    pxPacket->xIPHeader.ulDestinationIPAddress = ulDestination;
+
+    pxPacket->xUDPHeader.usSourcePort = xLocal.sin_port;
+    pxPacket->xUDPHeader.usDestinationPort = pxDestination->sin_port;
+    pxPacket->xUDPHeader.usLength = FreeRTOS_htons( ( uint16_t ) ( ipSIZE_OF_UDP_HEADER + uxLength ) );
+    pxPacket->xUDPHeader.usChecksum = 0;
+
+    #if ( ipconfigDRIVER_INCLUDED_TX_IP_CHECKSUM == 0 )
+        {
+            /* Pseudo-header: the adjacent source and destination addresses,
+             * the protocol and the UDP length */
+            uint32_t ulSum = ( uint32_t ) ipPROTOCOL_UDP + ( uint32_t ) ( ipSIZE_OF_UDP_HEADER + uxLength );
+            uint16_t usChecksum;
+
+            ulSum = prvOnesSum( ulSum, ( const uint8_t * ) &pxPacket->xIPHeader.ulSourceIPAddress, 8 );
+            ulSum = prvOnesSum( ulSum, ( const uint8_t * ) &pxPacket->xUDPHeader, ipSIZE_OF_UDP_HEADER + uxLength );
+            usChecksum = ( uint16_t ) ~prvFold( ulSum );
+
+            /* A computed checksum of zero is sent as all ones */
+            pxPacket->xUDPHeader.usChecksum = FreeRTOS_htons( ( usChecksum == 0 ) ? 0xffffU : usChecksum );
+        }
+    #endif
+
+    pxNetworkBuffer->xDataLength = ipSIZE_OF_ETH_HEADER + udpfastIP_UDP_HEADERS + uxLength;
+    pxNetworkBuffer->ulIPAddress = ulDestination;
+    pxNetworkBuffer->usPort = pxDestination->sin_port;
+    pxNetworkBuffer->usBoundPort = xLocal.sin_port;
+
+    #if ( ipconfigETHERNET_MINIMUM_PACKET_BYTES > 0 )
+        if( pxNetworkBuffer->xDataLength < ( size_t ) ipconfigETHERNET_MINIMUM_PACKET_BYTES )
+        {
+            memset( &pxNetworkBuffer->pucEthernetBuffer[ pxNetworkBuffer->xDataLength ], 0,
+                    ipconfigETHERNET_MINIMUM_PACKET_BYTES - pxNetworkBuffer->xDataLength );
+            pxNetworkBuffer->xDataLength = ipconfigETHERNET_MINIMUM_PACKET_BYTES;
+        }
+    #endif
+
+    xSemaphoreTake( prvTxLock(), portMAX_DELAY );
+    {
+        pxPacket->xIPHeader.usIdentification = FreeRTOS_htons( usIdentification );
+        usIdentification++;
+
+        #if ( ipconfigDRIVER_INCLUDED_TX_IP_CHECKSUM == 0 )
+            pxPacket->xIPHeader.usHeaderChecksum =
+                FreeRTOS_htons( ( uint16_t ) ~prvFold( prvOnesSum( 0, ( const uint8_t * ) &pxPacket->xIPHeader, ipSIZE_OF_IPv4_HEADER ) ) );
+        #endif
+
+        /* The driver releases the buffer, whether it got sent or not */
+        ( void ) __real_xNetworkInterfaceOutput( pxNetworkBuffer, pdTRUE );
+        xStats.ulDirect++;
+    }
+    xSemaphoreGive( xTxLock );
+
+    iptraceUDP_FAST_TX( ulDestination );
+
+    return ( int32_t ) uxLength;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t __wrap_xNetworkInterfaceOutput( NetworkBufferDescriptor_t * const pxNetworkBuffer,
+                                           BaseType_t xReleaseAfterSend )
+{
+    SemaphoreHandle_t xLock = prvTxLock();
+    BaseType_t xReturn;
+
+    xSemaphoreTake( xLock, portMAX_DELAY );
+    xReturn = __real_xNetworkInterfaceOutput( pxNetworkBuffer, xReleaseAfterSend );
+    xSemaphoreGive( xLock );
+
+    return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+void vUDPFastTxGetStats( UDPFastTxStats_t * pxStats )
+{
+    taskENTER_CRITICAL();
+    {
+        *pxStats = xStats;
+    }
+    taskEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
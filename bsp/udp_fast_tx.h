@@ -0,0 +1,35 @@
+/**
+ * Direct UDP transmit path that bypasses the IP task (bsp/udp_fast_tx.c),
+ * built with --udp-fast-tx.
+ */
+#ifndef UDP_FAST_TX_H
+#define UDP_FAST_TX_H
+
+#include <stddef.h>
+#include "FreeRTOS.h"
+#include "FreeRTOS_IP.h"
+#include "FreeRTOS_Sockets.h"
+
+typedef struct UDP_FAST_TX_STATS
+{
+    uint32_t ulDirect;   /* Datagrams handed straight to the driver */
+    uint32_t ulFallback; /* Datagrams that went through FreeRTOS_sendto() */
+} UDPFastTxStats_t;
+
+/*
+ * Drop-in for FreeRTOS_sendto( xSocket, pvPayload, uxLength,
+ * FREERTOS_ZERO_COPY, pxDestination, ... ): pvPayload comes from
+ * FreeRTOS_GetUDPPayloadBuffer() and belongs to the stack once this returns
+ * non-zero. When the socket is bound and the destination is an on-link peer
+ * the hashed ARP cache has resolved, the headers are built here and the frame
+ * goes to the driver from the calling task; anything else falls back to
+ * FreeRTOS_sendto(). Returns uxLength, or 0 if the datagram was not sent.
+ */
+int32_t lUDPFastSendTo( Socket_t xSocket,
+                        void * pvPayload,
+                        size_t uxLength,
+                        const struct freertos_sockaddr * pxDestination );
+
+void vUDPFastTxGetStats( UDPFastTxStats_t * pxStats );
+
+#endif /* UDP_FAST_TX_H */
@@ -0,0 +1,123 @@
+/**
+ * Minimal virtio-mmio transport definitions (legacy v1 and modern v2 register
+ * layouts) and split virtqueue structures, as laid out in the virtio 1.1 spec.
+ */
+#ifndef VIRTIO_MMIO_H
+#define VIRTIO_MMIO_H
+
+#include <stdint.h>
+
+/* MMIO registers */
+#define VIRTIO_MMIO_MAGIC_VALUE            0x000
+#define VIRTIO_MMIO_VERSION                0x004
+#define VIRTIO_MMIO_DEVICE_ID              0x008
+#define VIRTIO_MMIO_VENDOR_ID              0x00c
+#define VIRTIO_MMIO_DEVICE_FEATURES        0x010
+#define VIRTIO_MMIO_DEVICE_FEATURES_SEL    0x014
+#define VIRTIO_MMIO_DRIVER_FEATURES        0x020
+#define VIRTIO_MMIO_DRIVER_FEATURES_SEL    0x024
+#define VIRTIO_MMIO_GUEST_PAGE_SIZE        0x028 /* Legacy only */
+#define VIRTIO_MMIO_QUEUE_SEL              0x030
+#define VIRTIO_MMIO_QUEUE_NUM_MAX          0x034
+#define VIRTIO_MMIO_QUEUE_NUM              0x038
+#define VIRTIO_MMIO_QUEUE_ALIGN            0x03c /* Legacy only */
+#define VIRTIO_MMIO_QUEUE_PFN              0x040 /* Legacy only */
+#define VIRTIO_MMIO_QUEUE_READY            0x044
+#define VIRTIO_MMIO_QUEUE_NOTIFY           0x050
+#define VIRTIO_MMIO_INTERRUPT_STATUS       0x060
+#define VIRTIO_MMIO_INTERRUPT_ACK          0x064
+#define VIRTIO_MMIO_STATUS                 0x070
+#define VIRTIO_MMIO_QUEUE_DESC_LOW         0x080
+#define VIRTIO_MMIO_QUEUE_DESC_HIGH        0x084
+#define VIRTIO_MMIO_QUEUE_AVAIL_LOW        0x090
+#define VIRTIO_MMIO_QUEUE_AVAIL_HIGH       0x094
+#define VIRTIO_MMIO_QUEUE_USED_LOW         0x0a0
+#define VIRTIO_MMIO_QUEUE_USED_HIGH        0x0a4
+#define VIRTIO_MMIO_CONFIG                 0x100
+
+#define VIRTIO_MMIO_MAGIC                  0x74726976 /* "virt" */
+#define VIRTIO_MMIO_LEGACY_PAGE_SIZE       4096
+
+/* Device status */
+#define VIRTIO_STATUS_ACKNOWLEDGE          1
+#define VIRTIO_STATUS_DRIVER               2
+#define VIRTIO_STATUS_DRIVER_OK            4
+#define VIRTIO_STATUS_FEATURES_OK          8
+#define VIRTIO_STATUS_FAILED               128
+
+#define VIRTIO_DEVICE_ID_NET               1
+
+/* Feature bits */
+#define VIRTIO_F_VERSION_1                 32
+#define VIRTIO_NET_F_CSUM                  0
+#define VIRTIO_NET_F_GUEST_CSUM            1
+#define VIRTIO_NET_F_MAC                   5
+
+/* Interrupt status */
+#define VIRTIO_MMIO_INT_VRING              ( 1 << 0 )
+#define VIRTIO_MMIO_INT_CONFIG             ( 1 << 1 )
+
+/* Virtqueue */
+#define VIRTQ_DESC_F_NEXT                  1
+#define VIRTQ_DESC_F_WRITE                 2
+#define VIRTQ_AVAIL_F_NO_INTERRUPT         1
+#define VIRTQ_USED_F_NO_NOTIFY             1
+
+struct virtq_desc
+{
+    uint64_t addr;
+    uint32_t len;
+    uint16_t flags;
+    uint16_t next;
+};
+
+struct virtq_avail
+{
+    uint16_t flags;
+    uint16_t idx;
+    uint16_t ring[];
+};
+
+struct virtq_used_elem
+{
+    uint32_t id;
+    uint32_t len;
+};
+
+struct virtq_used
+{
+    uint16_t flags;
+    uint16_t idx;
+    struct virtq_used_elem ring[];
+};
+
+/* Legacy layout: descriptors and available ring, then the used ring on the
+ * next page boundary. Modern devices take the three addresses separately but
+ * the same layout works for both. */
+#define VIRTQ_AVAIL_OFFSET( num )    ( 16 * ( num ) )
+#define VIRTQ_USED_OFFSET( num )                                                  \
+    ( ( VIRTQ_AVAIL_OFFSET( num ) + 6 + 2 * ( num ) + VIRTIO_MMIO_LEGACY_PAGE_SIZE - 1 ) & \
+      ~( VIRTIO_MMIO_LEGACY_PAGE_SIZE - 1 ) )
+#define VIRTQ_SIZE( num )            ( VIRTQ_USED_OFFSET( num ) + 6 + 8 * ( num ) )
+
+/* virtio-net header in front of every frame; num_buffers only exists with
+ * VIRTIO_F_VERSION_1 (or VIRTIO_NET_F_MRG_RXBUF) */
+struct virtio_net_hdr
+{
+    uint8_t flags;
+    uint8_t gso_type;
+    uint16_t hdr_len;
+    uint16_t gso_size;
+    uint16_t csum_start;
+    uint16_t csum_offset;
+    uint16_t num_buffers;
+};
+
+#define VIRTIO_NET_HDR_F_NEEDS_CSUM    1
+#define VIRTIO_NET_HDR_F_DATA_VALID    2
+#define VIRTIO_NET_HDR_GSO_NONE        0
+
+#define VIRTIO_NET_HDR_LEN_LEGACY    10
+#define VIRTIO_NET_HDR_LEN           12
+
+#endif /* VIRTIO_MMIO_H */
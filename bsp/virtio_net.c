@@ -0,0 +1,793 @@
+/*
+ * Zero-copy virtio-net NetworkInterface for the qemu_virt and fett platforms,
+ * selected with --virtio-net-zero-copy in place of FreeRTOS+TCP's
+ * portable/NetworkInterface/virtio driver and libvirtio's virtio-net.c.
+ *
+ * Every virtqueue slot is a two descriptor chain: a virtio_net_hdr owned by
+ * the driver followed by the payload of a network buffer descriptor. Received
+ * frames are handed to the IP task in the very buffer the device wrote to and
+ * the slot is re-armed with a fresh buffer; transmitted buffers are posted as
+ * is and released once the device returns them in the used ring.
+ *
+ * RX interrupts are masked while the driver task drains the used ring and all
+ * re-armed slots are published with a single index update and notify. TX
+ * completions never interrupt, they are reclaimed on the next transmit or
+ * driver task wake-up. The driver task only wakes up by itself while the
+ * device holds TX buffers, an idle interface leaves it blocked.
+ *
+ * The stack is built with ipconfigDRIVER_INCLUDED_RX/TX_IP_CHECKSUM, so this
+ * driver owns checksumming. With VIRTIO_NET_F_CSUM the device fills in the
+ * TCP/UDP checksum from the pseudo-header sum left in the frame; with
+ * VIRTIO_NET_F_GUEST_CSUM frames flagged DATA_VALID skip verification. The
+ * IPv4 header checksum (never offloaded by virtio) and anything the device
+ * did not negotiate are done here in software.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include "FreeRTOS_IP.h"
+#include "FreeRTOS_IP_Private.h"
+#include "NetworkInterface.h"
+#include "NetworkBufferManagement.h"
+
+#include "bsp.h"
+#include "virtio_mmio.h"
+
+#ifdef __CHERI_PURE_CAPABILITY__
+    #include <cheri/cheri-utility.h>
+#endif /* __CHERI_PURE_CAPABILITY__ */
+
+#if ( ipconfigZERO_COPY_RX_DRIVER == 0 ) || ( ipconfigZERO_COPY_TX_DRIVER == 0 )
+    #error "virtio_net.c requires ipconfigZERO_COPY_RX_DRIVER and ipconfigZERO_COPY_TX_DRIVER"
+#endif
+
+#if ( ipconfigDRIVER_INCLUDED_RX_IP_CHECKSUM == 0 ) || ( ipconfigDRIVER_INCLUDED_TX_IP_CHECKSUM == 0 )
+    #error "virtio_net.c requires ipconfigDRIVER_INCLUDED_RX_IP_CHECKSUM and ipconfigDRIVER_INCLUDED_TX_IP_CHECKSUM"
+#endif
+
+/* Descriptors per virtqueue, two per frame */
+#ifndef configVIRTIO_NET_QUEUE_SIZE
+    #define configVIRTIO_NET_QUEUE_SIZE    32
+#endif
+
+#if ( configVIRTIO_NET_QUEUE_SIZE & ( configVIRTIO_NET_QUEUE_SIZE - 1 ) ) != 0
+    #error "configVIRTIO_NET_QUEUE_SIZE must be a power of two"
+#endif
+
+#ifndef configVIRTIO_NET_TASK_PRIORITY
+    #define configVIRTIO_NET_TASK_PRIORITY    ( configMAX_PRIORITIES - 1 )
+#endif
+
+/* Upper bound on how long completed TX buffers stay in the ring when there is
+ * no other traffic to wake the driver task. Only polled while the device
+ * holds TX buffers. */
+#ifndef configVIRTIO_NET_TX_RECLAIM_MS
+    #define configVIRTIO_NET_TX_RECLAIM_MS    10
+#endif
+
+#define virtioRX_QUEUE           0
+#define virtioTX_QUEUE           1
+#define virtioSLOTS              ( configVIRTIO_NET_QUEUE_SIZE / 2 )
+#define virtioRING_MASK          ( configVIRTIO_NET_QUEUE_SIZE - 1 )
+#define virtioTX_WAIT_MS         50
+
+#define virtioETH_HDR_LEN        14
+#define virtioIPV4_FRAME_TYPE    0x0800
+#define virtioPROTOCOL_ICMP      1
+#define virtioPROTOCOL_TCP       6
+#define virtioPROTOCOL_UDP       17
+
+#define virtioBARRIER()          __sync_synchronize()
+#define virtioDMA_ADDR( p )      ( ( uint64_t ) ( uintptr_t ) ( p ) )
+
+typedef struct VIRTIO_NET_QUEUE
+{
+    volatile struct virtq_desc * pxDesc;
+    volatile struct virtq_avail * pxAvail;
+    volatile struct virtq_used * pxUsed;
+    uint16_t usLastUsed;
+    NetworkBufferDescriptor_t * pxBuffers[ virtioSLOTS ];
+    struct virtio_net_hdr xHeaders[ virtioSLOTS ];
+} VirtioNetQueue_t;
+
+static uint8_t ucQueueMem[ 2 ][ VIRTQ_SIZE( configVIRTIO_NET_QUEUE_SIZE ) ]
+__attribute__( ( aligned( VIRTIO_MMIO_LEGACY_PAGE_SIZE ) ) );
+
+static VirtioNetQueue_t xQueues[ 2 ];
+
+/* Stack of TX slots not owned by the device */
+static uint16_t usTxFree[ virtioSLOTS ];
+static UBaseType_t uxTxFreeCount;
+
+static volatile uint32_t * pulVirtioNet;
+static uint32_t ulVersion;
+static size_t xHeaderLength;
+static BaseType_t xTxChecksumOffload = pdFALSE;
+static BaseType_t xRxChecksumOffload = pdFALSE;
+
+static TaskHandle_t xDriverTask = NULL;
+static SemaphoreHandle_t xTxLock = NULL;
+static BaseType_t xInitialised = pdFALSE;
+/*-----------------------------------------------------------*/
+
+static inline uint32_t prvRead( uint32_t ulOffset )
+{
+    return pulVirtioNet[ ulOffset / sizeof( uint32_t ) ];
+}
+
+static inline void prvWrite( uint32_t ulOffset,
+                             uint32_t ulValue )
+{
+    pulVirtioNet[ ulOffset / sizeof( uint32_t ) ] = ulValue;
+}
+/*-----------------------------------------------------------*/
+
+static void prvNotify( uint32_t ulQueue )
+{
+    VirtioNetQueue_t * pxQueue = &xQueues[ ulQueue ];
+
+    /* Order the ring updates before the idx/flags reads and the doorbell */
+    virtioBARRIER();
+
+    if( ( pxQueue->pxUsed->flags & VIRTQ_USED_F_NO_NOTIFY ) == 0 )
+    {
+        prvWrite( VIRTIO_MMIO_QUEUE_NOTIFY, ulQueue );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void prvPostSlot( VirtioNetQueue_t * pxQueue,
+                         uint16_t usSlot )
+{
+    uint16_t usIdx = pxQueue->pxAvail->idx;
+
+    pxQueue->pxAvail->ring[ usIdx & virtioRING_MASK ] = ( uint16_t ) ( 2 * usSlot );
+    virtioBARRIER();
+    pxQueue->pxAvail->idx = ( uint16_t ) ( usIdx + 1 );
+}
+/*-----------------------------------------------------------*/
+
+static void prvArmRxSlot( uint16_t usSlot,
+                          NetworkBufferDescriptor_t * pxBuffer )
+{
+    VirtioNetQueue_t * pxQueue = &xQueues[ virtioRX_QUEUE ];
+    volatile struct virtq_desc * pxPayload = &pxQueue->pxDesc[ 2 * usSlot + 1 ];
+
+    pxQueue->pxBuffers[ usSlot ] = pxBuffer;
+    pxPayload->addr = virtioDMA_ADDR( pxBuffer->pucEthernetBuffer );
+    pxPayload->len = ipTOTAL_ETHERNET_FRAME_SIZE;
+    pxPayload->flags = VIRTQ_DESC_F_WRITE;
+    pxPayload->next = 0;
+}
+/*-----------------------------------------------------------*/
+
+static uint32_t prvOnesSum( uint32_t ulSum,
+                           const uint8_t * pucData,
+                           size_t uxLength )
+{
+    for( ; uxLength > 1; uxLength -= 2, pucData += 2 )
+    {
+        ulSum += ( ( uint32_t ) pucData[ 0 ] << 8 ) | pucData[ 1 ];
+    }
+
+    if( uxLength != 0 )
+    {
+        ulSum += ( uint32_t ) pucData[ 0 ] << 8;
+    }
+
+    return ulSum;
+}
+/*-----------------------------------------------------------*/
+
+static uint16_t prvFold( uint32_t ulSum )
+{
+    while( ( ulSum >> 16 ) != 0 )
+    {
+        ulSum = ( ulSum & 0xffff ) + ( ulSum >> 16 );
+    }
+
+    return ( uint16_t ) ulSum;
+}
+/*-----------------------------------------------------------*/
+
+static void prvStore16( uint8_t * pucField,
+                        uint16_t usValue )
+{
+    pucField[ 0 ] = ( uint8_t ) ( usValue >> 8 );
+    pucField[ 1 ] = ( uint8_t ) usValue;
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Locate the L4 header of an unfragmented IPv4 frame. Returns the IP protocol,
+ * or 0 if the frame is not IPv4 (*puxIPHeaderLength is then 0) or carries no
+ * checksummable L4 payload.
+ */
+static uint8_t prvParseIPv4( const uint8_t * pucFrame,
+                             size_t uxLength,
+                             size_t * puxIPHeaderLength,
+                             size_t * puxL4Length,
+                             size_t * puxChecksumOffset )
+{
+    size_t uxIPHeaderLength, uxTotalLength;
+    uint8_t ucProtocol;
+
+    *puxIPHeaderLength = 0;
+
+    if( ( uxLength < virtioETH_HDR_LEN + 20 ) ||
+        ( ( ( pucFrame[ 12 ] << 8 ) | pucFrame[ 13 ] ) != virtioIPV4_FRAME_TYPE ) )
+    {
+        return 0;
+    }
+
+    uxIPHeaderLength = ( size_t ) ( pucFrame[ virtioETH_HDR_LEN ] & 0x0f ) * 4;
+    uxTotalLength = ( size_t ) ( ( pucFrame[ virtioETH_HDR_LEN + 2 ] << 8 ) | pucFrame[ virtioETH_HDR_LEN + 3 ] );
+
+    if( ( uxIPHeaderLength < 20 ) || ( uxTotalLength < uxIPHeaderLength ) ||
+        ( virtioETH_HDR_LEN + uxTotalLength > uxLength ) )
+    {
+        return 0;
+    }
+
+    *puxIPHeaderLength = uxIPHeaderLength;
+
+    /* More-fragments or a fragment offset: no complete L4 header to sum */
+    if( ( ( ( pucFrame[ virtioETH_HDR_LEN + 6 ] << 8 ) | pucFrame[ virtioETH_HDR_LEN + 7 ] ) & 0x3fff ) != 0 )
+    {
+        return 0;
+    }
+
+    ucProtocol = pucFrame[ virtioETH_HDR_LEN + 9 ];
+    *puxL4Length = uxTotalLength - uxIPHeaderLength;
+
+    switch( ucProtocol )
+    {
+        case virtioPROTOCOL_TCP:
+            *puxChecksumOffset = 16;
+            break;
+
+        case virtioPROTOCOL_UDP:
+            *puxChecksumOffset = 6;
+            break;
+
+        case virtioPROTOCOL_ICMP:
+            *puxChecksumOffset = 2;
+            break;
+
+        default:
+            return 0;
+    }
+
+    return ( *puxL4Length >= *puxChecksumOffset + 2 ) ? ucProtocol : 0;
+}
+/*-----------------------------------------------------------*/
+
+static uint32_t prvPseudoHeaderSum( const uint8_t * pucFrame,
+                                    uint8_t ucProtocol,
+                                    size_t uxL4Length )
+{
+    /* Source and destination addresses are adjacent in the IPv4 header */
+    return prvOnesSum( ( uint32_t ) ucProtocol + ( uint32_t ) uxL4Length,
+                       &pucFrame[ virtioETH_HDR_LEN + 12 ], 8 );
+}
+/*-----------------------------------------------------------*/
+
+static void prvTxChecksum( uint8_t * pucFrame,
+                           size_t uxLength,
+                           struct virtio_net_hdr * pxHeader )
+{
+    size_t uxIPHeaderLength, uxL4Length = 0, uxChecksumOffset = 0;
+    uint8_t ucProtocol = prvParseIPv4( pucFrame, uxLength, &uxIPHeaderLength, &uxL4Length, &uxChecksumOffset );
+    uint8_t * pucIPHeader = &pucFrame[ virtioETH_HDR_LEN ];
+    uint8_t * pucL4 = pucIPHeader + uxIPHeaderLength;
+    uint32_t ulSum = 0;
+    uint16_t usChecksum;
+
+    memset( pxHeader, 0, sizeof( *pxHeader ) );
+
+    if( uxIPHeaderLength == 0 )
+    {
+        return;
+    }
+
+    prvStore16( &pucIPHeader[ 10 ], 0 );
+    prvStore16( &pucIPHeader[ 10 ], ( uint16_t ) ~prvFold( prvOnesSum( 0, pucIPHeader, uxIPHeaderLength ) ) );
+
+    if( ucProtocol == 0 )
+    {
+        return;
+    }
+
+    if( ucProtocol != virtioPROTOCOL_ICMP )
+    {
+        ulSum = prvPseudoHeaderSum( pucFrame, ucProtocol, uxL4Length );
+
+        if( xTxChecksumOffload != pdFALSE )
+        {
+            /* The device sums from csum_start to the end of the frame and
+             * adds the result to the value already in the checksum field */
+            prvStore16( &pucL4[ uxChecksumOffset ], prvFold( ulSum ) );
+            pxHeader->flags = VIRTIO_NET_HDR_F_NEEDS_CSUM;
+            pxHeader->gso_type = VIRTIO_NET_HDR_GSO_NONE;
+            pxHeader->csum_start = ( uint16_t ) ( virtioETH_HDR_LEN + uxIPHeaderLength );
+            pxHeader->csum_offset = ( uint16_t ) uxChecksumOffset;
+            return;
+        }
+    }
+
+    prvStore16( &pucL4[ uxChecksumOffset ], 0 );
+    usChecksum = ( uint16_t ) ~prvFold( prvOnesSum( ulSum, pucL4, uxL4Length ) );
+
+    /* A computed UDP checksum of zero is sent as all ones */
+    if( ( ucProtocol == virtioPROTOCOL_UDP ) && ( usChecksum == 0 ) )
+    {
+        usChecksum = 0xffff;
+    }
+
+    prvStore16( &pucL4[ uxChecksumOffset ], usChecksum );
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvRxChecksumValid( const uint8_t * pucFrame,
+                                      size_t uxLength,
+                                      uint8_t ucHeaderFlags )
+{
+    size_t uxIPHeaderLength, uxL4Length = 0, uxChecksumOffset = 0;
+    uint8_t ucProtocol = prvParseIPv4( pucFrame, uxLength, &uxIPHeaderLength, &uxL4Length, &uxChecksumOffset );
+    const uint8_t * pucL4 = &pucFrame[ virtioETH_HDR_LEN + uxIPHeaderLength ];
+    uint32_t ulSum = 0;
+
+    if( uxIPHeaderLength == 0 )
+    {
+        /* Not IPv4 (ARP), or malformed and left for the stack to reject */
+        return pdTRUE;
+    }
+
+    if( prvFold( prvOnesSum( 0, &pucFrame[ virtioETH_HDR_LEN ], uxIPHeaderLength ) ) != 0xffff )
+    {
+        return pdFALSE;
+    }
+
+    /* DATA_VALID: the device checked it. NEEDS_CSUM: a partially checksummed
+     * frame from the host, which is trusted. */
+    if( ( ucProtocol == 0 ) ||
+        ( ( xRxChecksumOffload != pdFALSE ) &&
+          ( ( ucHeaderFlags & ( VIRTIO_NET_HDR_F_DATA_VALID | VIRTIO_NET_HDR_F_NEEDS_CSUM ) ) != 0 ) ) )
+    {
+        return pdTRUE;
+    }
+
+    if( ucProtocol != virtioPROTOCOL_ICMP )
+    {
+        /* UDP checksum is optional */
+        if( ( ucProtocol == virtioPROTOCOL_UDP ) &&
+            ( pucL4[ uxChecksumOffset ] == 0 ) && ( pucL4[ uxChecksumOffset + 1 ] == 0 ) )
+        {
+            return pdTRUE;
+        }
+
+        ulSum = prvPseudoHeaderSum( pucFrame, ucProtocol, uxL4Length );
+    }
+
+    return ( prvFold( prvOnesSum( ulSum, pucL4, uxL4Length ) ) == 0xffff ) ? pdTRUE : pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvSetupQueue( uint32_t ulQueue )
+{
+    VirtioNetQueue_t * pxQueue = &xQueues[ ulQueue ];
+    uint8_t * pucMem = ucQueueMem[ ulQueue ];
+    uint16_t usHeaderFlags = ( ulQueue == virtioRX_QUEUE ) ? ( VIRTQ_DESC_F_NEXT | VIRTQ_DESC_F_WRITE ) : VIRTQ_DESC_F_NEXT;
+
+    memset( pucMem, 0, sizeof( ucQueueMem[ ulQueue ] ) );
+    memset( pxQueue->xHeaders, 0, sizeof( pxQueue->xHeaders ) );
+
+    pxQueue->pxDesc = ( volatile struct virtq_desc * ) pucMem;
+    pxQueue->pxAvail = ( volatile struct virtq_avail * ) ( pucMem + VIRTQ_AVAIL_OFFSET( configVIRTIO_NET_QUEUE_SIZE ) );
+    pxQueue->pxUsed = ( volatile struct virtq_used * ) ( pucMem + VIRTQ_USED_OFFSET( configVIRTIO_NET_QUEUE_SIZE ) );
+    pxQueue->usLastUsed = 0;
+
+    /* The header half of every chain never changes */
+    for( uint16_t usSlot = 0; usSlot < virtioSLOTS; usSlot++ )
+    {
+        volatile struct virtq_desc * pxHeader = &pxQueue->pxDesc[ 2 * usSlot ];
+
+        pxHeader->addr = virtioDMA_ADDR( &pxQueue->xHeaders[ usSlot ] );
+        pxHeader->len = ( uint32_t ) xHeaderLength;
+        pxHeader->flags = usHeaderFlags;
+        pxHeader->next = ( uint16_t ) ( 2 * usSlot + 1 );
+        pxQueue->pxBuffers[ usSlot ] = NULL;
+    }
+
+    prvWrite( VIRTIO_MMIO_QUEUE_SEL, ulQueue );
+
+    if( prvRead( VIRTIO_MMIO_QUEUE_NUM_MAX ) < configVIRTIO_NET_QUEUE_SIZE )
+    {
+        return pdFAIL;
+    }
+
+    prvWrite( VIRTIO_MMIO_QUEUE_NUM, configVIRTIO_NET_QUEUE_SIZE );
+
+    if( ulVersion == 1 )
+    {
+        prvWrite( VIRTIO_MMIO_QUEUE_ALIGN, VIRTIO_MMIO_LEGACY_PAGE_SIZE );
+        prvWrite( VIRTIO_MMIO_QUEUE_PFN, ( uint32_t ) ( virtioDMA_ADDR( pucMem ) / VIRTIO_MMIO_LEGACY_PAGE_SIZE ) );
+    }
+    else
+    {
+        prvWrite( VIRTIO_MMIO_QUEUE_DESC_LOW, ( uint32_t ) virtioDMA_ADDR( pxQueue->pxDesc ) );
+        prvWrite( VIRTIO_MMIO_QUEUE_DESC_HIGH, ( uint32_t ) ( virtioDMA_ADDR( pxQueue->pxDesc ) >> 32 ) );
+        prvWrite( VIRTIO_MMIO_QUEUE_AVAIL_LOW, ( uint32_t ) virtioDMA_ADDR( pxQueue->pxAvail ) );
+        prvWrite( VIRTIO_MMIO_QUEUE_AVAIL_HIGH, ( uint32_t ) ( virtioDMA_ADDR( pxQueue->pxAvail ) >> 32 ) );
+        prvWrite( VIRTIO_MMIO_QUEUE_USED_LOW, ( uint32_t ) virtioDMA_ADDR( pxQueue->pxUsed ) );
+        prvWrite( VIRTIO_MMIO_QUEUE_USED_HIGH, ( uint32_t ) ( virtioDMA_ADDR( pxQueue->pxUsed ) >> 32 ) );
+        prvWrite( VIRTIO_MMIO_QUEUE_READY, 1 );
+    }
+
+    return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+static void prvReclaimTx( void )
+{
+    VirtioNetQueue_t * pxQueue = &xQueues[ virtioTX_QUEUE ];
+
+    while( pxQueue->usLastUsed != pxQueue->pxUsed->idx )
+    {
+        virtioBARRIER();
+
+        uint16_t usSlot = ( uint16_t ) ( pxQueue->pxUsed->ring[ pxQueue->usLastUsed & virtioRING_MASK ].id / 2 );
+
+        vReleaseNetworkBufferAndDescriptor( pxQueue->pxBuffers[ usSlot ] );
+        pxQueue->pxBuffers[ usSlot ] = NULL;
+        usTxFree[ uxTxFreeCount++ ] = usSlot;
+        pxQueue->usLastUsed++;
+    }
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvProcessRx( void )
+{
+    VirtioNetQueue_t * pxQueue = &xQueues[ virtioRX_QUEUE ];
+    BaseType_t xRearmed = pdFALSE;
+
+    while( pxQueue->usLastUsed != pxQueue->pxUsed->idx )
+    {
+        virtioBARRIER();
+
+        volatile struct virtq_used_elem * pxElem = &pxQueue->pxUsed->ring[ pxQueue->usLastUsed & virtioRING_MASK ];
+        uint16_t usSlot = ( uint16_t ) ( pxElem->id / 2 );
+        uint32_t ulLength = pxElem->len;
+        NetworkBufferDescriptor_t * pxReceived = pxQueue->pxBuffers[ usSlot ];
+        NetworkBufferDescriptor_t * pxFresh = NULL;
+
+        /* Read before the slot, and so its header, goes back to the device */
+        uint8_t ucHeaderFlags = pxQueue->xHeaders[ usSlot ].flags;
+
+        pxQueue->usLastUsed++;
+
+        if( ulLength > xHeaderLength )
+        {
+            pxFresh = pxGetNetworkBufferWithDescriptor( ipTOTAL_ETHERNET_FRAME_SIZE, 0 );
+        }
+
+        if( pxFresh == NULL )
+        {
+            /* Out of buffers (or a runt): drop the frame, re-arm the slot
+             * with the buffer it already holds */
+            iptraceETHERNET_RX_EVENT_LOST();
+            prvPostSlot( pxQueue, usSlot );
+            xRearmed = pdTRUE;
+            continue;
+        }
+
+        prvArmRxSlot( usSlot, pxFresh );
+        prvPostSlot( pxQueue, usSlot );
+        xRearmed = pdTRUE;
+
+        pxReceived->xDataLength = ulLength - xHeaderLength;
+
+        if( prvRxChecksumValid( pxReceived->pucEthernetBuffer, pxReceived->xDataLength, ucHeaderFlags ) == pdFALSE )
+        {
+            FreeRTOS_debug_printf( ( "virtio-net: dropped frame with bad checksum\n" ) );
+            vReleaseNetworkBufferAndDescriptor( pxReceived );
+        }
+        else if( eConsiderFrameForProcessing( pxReceived->pucEthernetBuffer ) == eProcessBuffer )
+        {
+            IPStackEvent_t xRxEvent = { eNetworkRxEvent, pxReceived };
+
+            if( xSendEventStructToIPTask( &xRxEvent, 0 ) == pdFAIL )
+            {
+                vReleaseNetworkBufferAndDescriptor( pxReceived );
+                iptraceETHERNET_RX_EVENT_LOST();
+            }
+            else
+            {
+                iptraceNETWORK_INTERFACE_RECEIVE();
+            }
+        }
+        else
+        {
+            vReleaseNetworkBufferAndDescriptor( pxReceived );
+        }
+    }
+
+    return xRearmed;
+}
+/*-----------------------------------------------------------*/
+
+static void prvVirtioNetTask( void * pvParameters )
+{
+    VirtioNetQueue_t * pxRx = &xQueues[ virtioRX_QUEUE ];
+    TickType_t xWait = portMAX_DELAY;
+
+    ( void ) pvParameters;
+
+    for( ; ; )
+    {
+        ( void ) ulTaskNotifyTake( pdTRUE, xWait );
+
+        /* Coalesce: no RX interrupts while the used ring is being drained */
+        pxRx->pxAvail->flags = VIRTQ_AVAIL_F_NO_INTERRUPT;
+
+        for( ; ; )
+        {
+            if( prvProcessRx() != pdFALSE )
+            {
+                prvNotify( virtioRX_QUEUE );
+            }
+
+            pxRx->pxAvail->flags = 0;
+            virtioBARRIER();
+
+            /* A frame may have landed after the last check but before
+             * interrupts were re-enabled */
+            if( pxRx->usLastUsed == pxRx->pxUsed->idx )
+            {
+                break;
+            }
+
+            pxRx->pxAvail->flags = VIRTQ_AVAIL_F_NO_INTERRUPT;
+        }
+
+        if( xSemaphoreTake( xTxLock, 0 ) == pdPASS )
+        {
+            prvReclaimTx();
+            xSemaphoreGive( xTxLock );
+        }
+
+        /* Poll for TX completions only while some are outstanding, the
+         * transmit that hands the device its first buffer wakes the task */
+        xWait = ( uxTxFreeCount < virtioSLOTS ) ? pdMS_TO_TICKS( configVIRTIO_NET_TX_RECLAIM_MS ) : portMAX_DELAY;
+    }
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvVirtioNetInterruptHandler( void * pvRef )
+{
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+    uint32_t ulStatus = prvRead( VIRTIO_MMIO_INTERRUPT_STATUS );
+
+    ( void ) pvRef;
+
+    prvWrite( VIRTIO_MMIO_INTERRUPT_ACK, ulStatus );
+
+    if( ( ulStatus & VIRTIO_MMIO_INT_VRING ) && ( xDriverTask != NULL ) )
+    {
+        vTaskNotifyGiveFromISR( xDriverTask, &xHigherPriorityTaskWoken );
+    }
+
+    return xHigherPriorityTaskWoken;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xNetworkInterfaceInitialise( void )
+{
+    uint32_t ulStatus, ulFeatures;
+
+    if( xInitialised != pdFALSE )
+    {
+        return pdPASS;
+    }
+
+    #ifdef __CHERI_PURE_CAPABILITY__
+        pulVirtioNet = ( volatile uint32_t * ) cheri_build_data_cap( ( ptraddr_t ) VIRTIO_NET_MMIO_ADDRESS,
+                                                                     VIRTIO_NET_MMIO_SIZE,
+                                                                     __CHERI_CAP_PERMISSION_PERMIT_LOAD__ |
+                                                                     __CHERI_CAP_PERMISSION_PERMIT_STORE__ );
+    #else
+        pulVirtioNet = ( volatile uint32_t * ) VIRTIO_NET_MMIO_ADDRESS;
+    #endif /* __CHERI_PURE_CAPABILITY__ */
+
+    ulVersion = prvRead( VIRTIO_MMIO_VERSION );
+
+    if( ( prvRead( VIRTIO_MMIO_MAGIC_VALUE ) != VIRTIO_MMIO_MAGIC ) ||
+        ( ( ulVersion != 1 ) && ( ulVersion != 2 ) ) ||
+        ( prvRead( VIRTIO_MMIO_DEVICE_ID ) != VIRTIO_DEVICE_ID_NET ) )
+    {
+        FreeRTOS_printf( ( "virtio-net: no device at %p\n", ( void * ) pulVirtioNet ) );
+        return pdFAIL;
+    }
+
+    /* Legacy devices prepend the 10 byte header, VIRTIO_F_VERSION_1 adds
+     * num_buffers */
+    xHeaderLength = ( ulVersion == 1 ) ? VIRTIO_NET_HDR_LEN_LEGACY : VIRTIO_NET_HDR_LEN;
+
+    prvWrite( VIRTIO_MMIO_STATUS, 0 );
+    ulStatus = VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER;
+    prvWrite( VIRTIO_MMIO_STATUS, ulStatus );
+
+    /* Checksum offload where offered. The stack keeps the MAC address it was
+     * configured with. */
+    prvWrite( VIRTIO_MMIO_DEVICE_FEATURES_SEL, 0 );
+    ulFeatures = prvRead( VIRTIO_MMIO_DEVICE_FEATURES ) &
+                 ( ( 1U << VIRTIO_NET_F_CSUM ) | ( 1U << VIRTIO_NET_F_GUEST_CSUM ) );
+    xTxChecksumOffload = ( ulFeatures & ( 1U << VIRTIO_NET_F_CSUM ) ) ? pdTRUE : pdFALSE;
+    xRxChecksumOffload = ( ulFeatures & ( 1U << VIRTIO_NET_F_GUEST_CSUM ) ) ? pdTRUE : pdFALSE;
+
+    prvWrite( VIRTIO_MMIO_DRIVER_FEATURES_SEL, 0 );
+    prvWrite( VIRTIO_MMIO_DRIVER_FEATURES, ulFeatures );
+
+    if( ulVersion == 1 )
+    {
+        prvWrite( VIRTIO_MMIO_GUEST_PAGE_SIZE, VIRTIO_MMIO_LEGACY_PAGE_SIZE );
+    }
+    else
+    {
+        prvWrite( VIRTIO_MMIO_DRIVER_FEATURES_SEL, 1 );
+        prvWrite( VIRTIO_MMIO_DRIVER_FEATURES, 1 << ( VIRTIO_F_VERSION_1 - 32 ) );
+
+        ulStatus |= VIRTIO_STATUS_FEATURES_OK;
+        prvWrite( VIRTIO_MMIO_STATUS, ulStatus );
+
+        if( ( prvRead( VIRTIO_MMIO_STATUS ) & VIRTIO_STATUS_FEATURES_OK ) == 0 )
+        {
+            prvWrite( VIRTIO_MMIO_STATUS, VIRTIO_STATUS_FAILED );
+            return pdFAIL;
+        }
+    }
+
+    if( ( prvSetupQueue( virtioRX_QUEUE ) != pdPASS ) || ( prvSetupQueue( virtioTX_QUEUE ) != pdPASS ) )
+    {
+        FreeRTOS_printf( ( "virtio-net: queues smaller than %d\n", configVIRTIO_NET_QUEUE_SIZE ) );
+        prvWrite( VIRTIO_MMIO_STATUS, VIRTIO_STATUS_FAILED );
+        return pdFAIL;
+    }
+
+    /* TX completions are reaped lazily */
+    xQueues[ virtioTX_QUEUE ].pxAvail->flags = VIRTQ_AVAIL_F_NO_INTERRUPT;
+
+    for( uint16_t usSlot = 0; usSlot < virtioSLOTS; usSlot++ )
+    {
+        NetworkBufferDescriptor_t * pxBuffer = pxGetNetworkBufferWithDescriptor( ipTOTAL_ETHERNET_FRAME_SIZE, 0 );
+
+        configASSERT( pxBuffer != NULL );
+
+        if( pxBuffer == NULL )
+        {
+            return pdFAIL;
+        }
+
+        prvArmRxSlot( usSlot, pxBuffer );
+        prvPostSlot( &xQueues[ virtioRX_QUEUE ], usSlot );
+        usTxFree[ usSlot ] = usSlot;
+    }
+
+    uxTxFreeCount = virtioSLOTS;
+
+    xTxLock = xSemaphoreCreateMutex();
+    configASSERT( xTxLock != NULL );
+
+    if( xTaskCreate( prvVirtioNetTask, "VirtioNet", configMINIMAL_STACK_SIZE * 4, NULL,
+                     configVIRTIO_NET_TASK_PRIORITY, &xDriverTask ) != pdPASS )
+    {
+        return pdFAIL;
+    }
+
+    PLIC_set_priority( &Plic, VIRTIO_NET_PLIC_INTERRUPT_ID, VIRTIO_NET_PLIC_INTERRUPT_PRIO );
+    configASSERT( PLIC_register_interrupt_handler( &Plic, VIRTIO_NET_PLIC_INTERRUPT_ID,
+                                                  prvVirtioNetInterruptHandler, NULL ) != 0 );
+
+    ulStatus |= VIRTIO_STATUS_DRIVER_OK;
+    prvWrite( VIRTIO_MMIO_STATUS, ulStatus );
+
+    prvNotify( virtioRX_QUEUE );
+
+    xInitialised = pdTRUE;
+
+    return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xNetworkInterfaceOutput( NetworkBufferDescriptor_t * const pxNetworkBuffer,
+                                    BaseType_t xReleaseAfterSend )
+{
+    VirtioNetQueue_t * pxQueue = &xQueues[ virtioTX_QUEUE ];
+    NetworkBufferDescriptor_t * pxBuffer = pxNetworkBuffer;
+    volatile struct virtq_desc * pxPayload;
+    TickType_t xWaited = 0;
+    BaseType_t xWasIdle;
+    uint16_t usSlot;
+
+    if( xInitialised == pdFALSE )
+    {
+        if( xReleaseAfterSend != pdFALSE )
+        {
+            vReleaseNetworkBufferAndDescriptor( pxNetworkBuffer );
+        }
+
+        return pdFAIL;
+    }
+
+    /* The device owns the buffer until it shows up in the used ring, so
+     * a caller that keeps its buffer gets a copy sent instead */
+    if( xReleaseAfterSend == pdFALSE )
+    {
+        pxBuffer = pxDuplicateNetworkBufferWithDescriptor( pxNetworkBuffer, pxNetworkBuffer->xDataLength );
+
+        if( pxBuffer == NULL )
+        {
+            return pdFAIL;
+        }
+    }
+
+    xSemaphoreTake( xTxLock, portMAX_DELAY );
+
+    prvReclaimTx();
+
+    while( uxTxFreeCount == 0 )
+    {
+        if( xWaited >= pdMS_TO_TICKS( virtioTX_WAIT_MS ) )
+        {
+            xSemaphoreGive( xTxLock );
+            vReleaseNetworkBufferAndDescriptor( pxBuffer );
+            return pdFAIL;
+        }
+
+        iptraceWAITING_FOR_TX_DMA_DESCRIPTOR();
+        xSemaphoreGive( xTxLock );
+        vTaskDelay( 1 );
+        xWaited++;
+        xSemaphoreTake( xTxLock, portMAX_DELAY );
+        prvReclaimTx();
+    }
+
+    xWasIdle = ( uxTxFreeCount == virtioSLOTS ) ? pdTRUE : pdFALSE;
+    usSlot = usTxFree[ --uxTxFreeCount ];
+
+    prvTxChecksum( pxBuffer->pucEthernetBuffer, pxBuffer->xDataLength, &pxQueue->xHeaders[ usSlot ] );
+
+    pxPayload = &pxQueue->pxDesc[ 2 * usSlot + 1 ];
+    pxPayload->addr = virtioDMA_ADDR( pxBuffer->pucEthernetBuffer );
+    pxPayload->len = ( uint32_t ) pxBuffer->xDataLength;
+    pxPayload->flags = 0;
+    pxPayload->next = 0;
+    pxQueue->pxBuffers[ usSlot ] = pxBuffer;
+
+    prvPostSlot( pxQueue, usSlot );
+    prvNotify( virtioTX_QUEUE );
+
+    xSemaphoreGive( xTxLock );
+
+    if( xWasIdle != pdFALSE )
+    {
+        /* The driver task may be blocked without a timeout */
+        xTaskNotifyGive( xDriverTask );
+    }
+
+    iptraceNETWORK_INTERFACE_TRANSMIT();
+
+    return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xGetPhyLinkStatus( void )
+{
+    return pdTRUE;
+}
+/*-----------------------------------------------------------*/
@@ -35,6 +35,7 @@
 import yaml
 import os
 import subprocess
+import argparse
 import logging, sys
 
 from pathlib import Path
@@ -42,13 +43,24 @@ from pathlib import Path
 class Compartmentalize:
   yml_files = []
 
-  def __init__(self, ymlfile, linkerscript, makefile):
+  # Defaults for the optional per-compartment "placement" entry in system.yml,
+  # e.g. "placement: {hotness: hot, memory: fast, align: 64}". hot implies fast
+  # unless memory is given, and --profile overrides hotness from call counts.
+  default_placement = {"hotness": "cold", "memory": "slow", "align": 16}
+
+  # Linker regions (in link.ld.in) for each memory class
+  memory_regions = {"fast": "fastmem", "slow": "dmem"}
+
+  def __init__(self, ymlfile, linkerscript, makefile, profile=None, fast_mem_size=None):
     self.ymlfile = ymlfile
     self.linkerscript = linkerscript
     self.makefile = makefile
+    self.profile = profile
+    self.fast_mem_size = fast_mem_size
     self.CFLAGS = ""
     self.num_comps = 0
     self.max_comp_namelen = 32
+    self.placement = {}
 
   def open_yml(self):
     with open(self.ymlfile, "r") as file:
@@ -97,12 +109,68 @@ class Compartmentalize:
     with open(compartment + ".S", "w") as file:
       file.write(assembly_string)
 
+  def comp_get_placement(self, comp_name, comp_desc):
+    placement = dict(self.default_placement)
+    placement.update(comp_desc.get("placement") or {})
+
+    # A hot compartment that doesn't say otherwise wants fast memory
+    if "memory" not in (comp_desc.get("placement") or {}) and placement["hotness"] == "hot":
+      placement["memory"] = "fast"
+
+    if placement["hotness"] not in ("hot", "cold"):
+      raise ValueError(comp_name + ": placement hotness must be hot or cold")
+    if placement["memory"] not in self.memory_regions:
+      raise ValueError(comp_name + ": placement memory must be fast or slow")
+    if placement["align"] & (placement["align"] - 1):
+      raise ValueError(comp_name + ": placement align must be a power of 2")
+
+    logging.debug("comp %s -> placement: %s", comp_name, placement)
+    return placement
+
+  def profile_read(self):
+    # Lines of "COMP_CALLS <compartment> <count>" as printed by
+    # main_compartment_test when it exits (the rest of the log is ignored so a
+    # raw console capture can be passed in)
+    calls = {}
+    with open(self.profile, "r") as file:
+      for line in file:
+        fields = line.split()
+        if len(fields) == 3 and fields[0] == "COMP_CALLS":
+          calls[fields[1]] = calls.get(fields[1], 0) + int(fields[2])
+    logging.debug("profile -> %s", calls)
+    return calls
+
+  def profile_apply(self, compartments):
+    # Profile-guided mode: the most frequently called compartments become hot
+    # and go into fast memory until the fast memory budget is used up.
+    calls = self.profile_read()
+    budget = self.fast_mem_size
+    for compartment in sorted(compartments, key=lambda c: calls.get(c, 0), reverse=True):
+      placement = self.placement[compartment]
+      size = os.path.getsize(compartment + ".wrapped.o") if os.path.exists(compartment + ".wrapped.o") else 0
+      if calls.get(compartment, 0) > 0 and (budget is None or size + placement["align"] <= budget):
+        placement["hotness"] = "hot"
+        placement["memory"] = "fast"
+        if budget is not None:
+          budget -= size + placement["align"]
+      else:
+        placement["hotness"] = "cold"
+        placement["memory"] = "slow"
+      logging.debug("profile comp %s (%d calls) -> %s", compartment, calls.get(compartment, 0), placement)
+
+  def comps_order(self, compartments):
+    # Pack hot compartments next to each other (and first in their region) so
+    # they share cache lines/pages; otherwise keep system.yml order.
+    return sorted(compartments, key=lambda c: 0 if self.placement[c]["hotness"] == "hot" else 1)
+
   def linkcmd_add_comp_sections(self, compartments):
     section_string = ""
-    for compartment in compartments:
-      section_string += '.' + compartment + ' : ALIGN(16) {\n' \
+    for compartment in self.comps_order(compartments):
+      placement = self.placement.get(compartment, self.default_placement)
+      region = self.memory_regions[placement["memory"]]
+      section_string += '.' + compartment + ' : ALIGN(' + str(placement["align"]) + ') {\n' \
                        "\t" + compartment + "*\n" \
-                       "\t} > dmem :" + compartment + "\n"
+                       "\t} > " + region + " :" + compartment + "\n"
       #section_string += '.' + compartment+".symtab" + ' : {\n' \
       #                 "\t. = ALIGN(16);\n" \
       #                 "\t(" + compartment + ".symtab)\n" \
@@ -284,6 +352,7 @@ class Compartmentalize:
         logging.debug(comp_name)
         #logging.debug("Comp %s sources -> {}", comp_name, compartment[comp_name]["input"])
         comp_list.append(comp_name)
+        self.placement[comp_name] = self.comp_get_placement(comp_name, compartment[comp_name])
 
         interface_type = compartment[comp_name]["interface"]["type"]
         logging.debug("comp %s -> interface_type: %s", comp_name, interface_type)
@@ -303,6 +372,9 @@ class Compartmentalize:
         self.llvm_create_obj_from_sources(comp_name, source_files)
         self.llvm_wrap_obj_in_elf(comp_name)
 
+    if self.profile:
+      self.profile_apply(comp_list)
+
     #self.linkcmd_add_compartments_libs(comp_list);
     self.linkcmd_add_compartments_objs(comp_list);
 
@@ -317,5 +389,12 @@ class Compartmentalize:
     sys_desc = self.open_yml()
     self.process(sys_desc)
 
-c = Compartmentalize("system.yml", "link.ld.in", "Makefile.in")
+parser = argparse.ArgumentParser(description="Build the compartments in system.yml and place them in link.ld.generated")
+parser.add_argument("--profile", metavar="LOG",
+                    help="console log with COMP_CALLS lines; the most called compartments go into fast memory")
+parser.add_argument("--fast-mem-size", metavar="BYTES", type=lambda x: int(x, 0),
+                    help="fast memory budget for --profile (default: unlimited)")
+args = parser.parse_args()
+
+c = Compartmentalize("system.yml", "link.ld.in", "Makefile.in", args.profile, args.fast_mem_size)
 c.main()
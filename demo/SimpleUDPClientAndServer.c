@@ -30,6 +30,13 @@
  * tasks send values that are received by the receiving tasks.  One set of tasks
  * uses the standard API.  The other set of tasks uses the zero copy API.
  *
+ * vStartUDPPingPongTask() measures UDP round-trip latency against the echo
+ * server at configECHO_SERVER_ADDR0..3: one small zero-copy datagram at a
+ * time, timed with the cycle counter from just before it is sent until its
+ * echo is received.  The round trips go through FreeRTOS_sendto() and, when
+ * built with --udp-fast-tx, also through the direct transmit path
+ * (udp_fast_tx.h), so the two can be compared.
+ *
  * See the following web page for essential demo usage and configuration
  * details:
  * http://www.FreeRTOS.org/FreeRTOS-Plus/FreeRTOS_Plus_TCP/examples_FreeRTOS_simulator.html
@@ -38,6 +45,8 @@
 /* Standard includes. */
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 /* FreeRTOS includes. */
 #include "FreeRTOS.h"
@@ -49,6 +58,20 @@
 
 #include "SimpleUDPClientAndServer.h"
 
+#if ( configUDP_FAST_TX == 1 )
+    #include "udp_fast_tx.h"
+#endif
+
+/* Round trips timed per mode by the ping-pong task, after udpPING_PONG_WARM_UP
+ * untimed ones that get the echo server resolved (and hashed, for the direct
+ * path). */
+#define udpPING_PONG_ROUNDS     ( 1000 )
+#define udpPING_PONG_WARM_UP    ( 16 )
+#define udpPING_PONG_PAYLOAD    ( 32 )
+#define udpPING_PONG_TIMEOUT    pdMS_TO_TICKS( 100 )
+
+extern uint64_t get_cycle_count( void );
+
 /*
  * Uses a socket to send data using the zero copy option.
  * prvSimpleZeroCopyServerTask() will receive the data.
@@ -61,6 +84,11 @@ static void prvSimpleZeroCopyUDPClientTask( void * pvParameters );
  */
 static void prvSimpleZeroCopyServerTask( void * pvParameters );
 
+/*
+ * Times round trips to the echo server, see vStartUDPPingPongTask().
+ */
+static void prvUDPPingPongTask( void * pvParameters );
+
 /*-----------------------------------------------------------*/
 
 #if __riscv_xlen == 64
@@ -277,3 +305,178 @@ static void prvSimpleZeroCopyServerTask( void * pvParameters )
         }
     }
 }
+/*-----------------------------------------------------------*/
+
+void vStartUDPPingPongTask( uint16_t usStackSize,
+                            uint32_t ulEchoPort,
+                            UBaseType_t uxPriority )
+{
+    xTaskCreate( prvUDPPingPongTask, "UDPPingPong", usStackSize, ( void * ) ( uintptr_t ) ulEchoPort, uxPriority, NULL );
+}
+/*-----------------------------------------------------------*/
+
+/* One round trip. Returns pdFALSE if the datagram could not be sent or no
+ * echo came back in time. */
+static BaseType_t prvPingPongRound( Socket_t xSocket,
+                                    const struct freertos_sockaddr * pxServer,
+                                    uint32_t ulSequence,
+                                    BaseType_t xDirect,
+                                    uint32_t * pulCycles )
+{
+    struct freertos_sockaddr xFrom;
+    uint32_t ulFromLength = sizeof( xFrom );
+    uint8_t * pucPayload;
+    uint64_t ullStart, ullEnd;
+    int32_t lBytes;
+    BaseType_t xMatched = pdFALSE;
+
+    pucPayload = ( uint8_t * ) FreeRTOS_GetUDPPayloadBuffer( udpPING_PONG_PAYLOAD, portMAX_DELAY );
+
+    if( pucPayload == NULL )
+    {
+        return pdFALSE;
+    }
+
+    memset( pucPayload, 0, udpPING_PONG_PAYLOAD );
+    memcpy( pucPayload, &ulSequence, sizeof( ulSequence ) );
+
+    ullStart = get_cycle_count();
+
+    #if ( configUDP_FAST_TX == 1 )
+        if( xDirect != pdFALSE )
+        {
+            lBytes = lUDPFastSendTo( xSocket, pucPayload, udpPING_PONG_PAYLOAD, pxServer );
+        }
+        else
+    #else
+        ( void ) xDirect;
+    #endif
+    {
+        lBytes = FreeRTOS_sendto( xSocket, pucPayload, udpPING_PONG_PAYLOAD, FREERTOS_ZERO_COPY,
+                                  pxServer, sizeof( *pxServer ) );
+    }
+
+    if( lBytes == 0 )
+    {
+        FreeRTOS_ReleaseUDPPayloadBuffer( pucPayload );
+        return pdFALSE;
+    }
+
+    /* Late echoes of rounds that already timed out are skipped */
+    do
+    {
+        lBytes = FreeRTOS_recvfrom( xSocket, &pucPayload, 0, FREERTOS_ZERO_COPY, &xFrom, &ulFromLength );
+        ullEnd = get_cycle_count();
+
+        if( lBytes <= 0 )
+        {
+            return pdFALSE;
+        }
+
+        xMatched = ( lBytes == udpPING_PONG_PAYLOAD ) && ( memcmp( pucPayload, &ulSequence, sizeof( ulSequence ) ) == 0 );
+        FreeRTOS_ReleaseUDPPayloadBuffer( pucPayload );
+    } while( xMatched == pdFALSE );
+
+    *pulCycles = ( uint32_t ) ( ullEnd - ullStart );
+
+    return pdTRUE;
+}
+/*-----------------------------------------------------------*/
+
+static int prvCompareCycles( const void * pvA,
+                             const void * pvB )
+{
+    uint32_t ulA = *( const uint32_t * ) pvA, ulB = *( const uint32_t * ) pvB;
+
+    return ( ulA > ulB ) - ( ulA < ulB );
+}
+/*-----------------------------------------------------------*/
+
+/* Tenths of a microsecond */
+static uint32_t prvCyclesToUs10( uint32_t ulCycles )
+{
+    return ( uint32_t ) ( ( ( uint64_t ) ulCycles * 10000000ULL ) / configCPU_CLOCK_HZ );
+}
+/*-----------------------------------------------------------*/
+
+static void prvUDPPingPongTask( void * pvParameters )
+{
+    static uint32_t ulSamples[ udpPING_PONG_ROUNDS ];
+    const char * pcModes[] = { "stack", "direct" };
+    const TickType_t xTimeout = udpPING_PONG_TIMEOUT;
+    struct freertos_sockaddr xServer;
+    Socket_t xSocket;
+    uint32_t ulSequence = 0, ulCount, ulLost, ulCycles, x;
+    BaseType_t xMode, xModes = 1;
+
+    #if ( configUDP_FAST_TX == 1 )
+        UDPFastTxStats_t xBefore, xAfter;
+
+        xModes = 2;
+    #endif
+
+    xServer.sin_addr = FreeRTOS_inet_addr_quick( configECHO_SERVER_ADDR0,
+                                                 configECHO_SERVER_ADDR1,
+                                                 configECHO_SERVER_ADDR2,
+                                                 configECHO_SERVER_ADDR3 );
+    xServer.sin_port = FreeRTOS_htons( ( uint16_t ) ( uintptr_t ) pvParameters );
+
+    /* Bound up front, the direct path does not bind implicitly */
+    xSocket = FreeRTOS_socket( FREERTOS_AF_INET, FREERTOS_SOCK_DGRAM, FREERTOS_IPPROTO_UDP );
+    configASSERT( xSocket != FREERTOS_INVALID_SOCKET );
+    FreeRTOS_bind( xSocket, NULL, sizeof( struct freertos_sockaddr ) );
+    FreeRTOS_setsockopt( xSocket, 0, FREERTOS_SO_RCVTIMEO, &xTimeout, sizeof( xTimeout ) );
+
+    for( xMode = 0; xMode < xModes; xMode++ )
+    {
+        for( x = 0; x < udpPING_PONG_WARM_UP; x++ )
+        {
+            ( void ) prvPingPongRound( xSocket, &xServer, ulSequence++, xMode, &ulCycles );
+        }
+
+        #if ( configUDP_FAST_TX == 1 )
+            vUDPFastTxGetStats( &xBefore );
+        #endif
+
+        ulCount = 0;
+        ulLost = 0;
+
+        for( x = 0; x < udpPING_PONG_ROUNDS; x++ )
+        {
+            if( prvPingPongRound( xSocket, &xServer, ulSequence++, xMode, &ulCycles ) != pdFALSE )
+            {
+                ulSamples[ ulCount++ ] = ulCycles;
+            }
+            else
+            {
+                ulLost++;
+            }
+        }
+
+        if( ulCount == 0 )
+        {
+            FreeRTOS_printf( ( "UDP ping-pong %s: no echoes from the echo server\n", pcModes[ xMode ] ) );
+            continue;
+        }
+
+        qsort( ulSamples, ulCount, sizeof( ulSamples[ 0 ] ), prvCompareCycles );
+
+        FreeRTOS_printf( ( "UDP ping-pong %s: %u round trips, %u lost, min %u.%u us, median %u.%u us, p99 %u.%u us, max %u.%u us\n",
+                           pcModes[ xMode ], ( unsigned ) ulCount, ( unsigned ) ulLost,
+                           ( unsigned ) ( prvCyclesToUs10( ulSamples[ 0 ] ) / 10 ), ( unsigned ) ( prvCyclesToUs10( ulSamples[ 0 ] ) % 10 ),
+                           ( unsigned ) ( prvCyclesToUs10( ulSamples[ ulCount / 2 ] ) / 10 ), ( unsigned ) ( prvCyclesToUs10( ulSamples[ ulCount / 2 ] ) % 10 ),
+                           ( unsigned ) ( prvCyclesToUs10( ulSamples[ ( ulCount * 99 ) / 100 ] ) / 10 ), ( unsigned ) ( prvCyclesToUs10( ulSamples[ ( ulCount * 99 ) / 100 ] ) % 10 ),
+                           ( unsigned ) ( prvCyclesToUs10( ulSamples[ ulCount - 1 ] ) / 10 ), ( unsigned ) ( prvCyclesToUs10( ulSamples[ ulCount - 1 ] ) % 10 ) ) );
+
+        #if ( configUDP_FAST_TX == 1 )
+            vUDPFastTxGetStats( &xAfter );
+            FreeRTOS_printf( ( "UDP ping-pong %s: %u sent directly, %u through the IP task\n",
+                               pcModes[ xMode ], ( unsigned ) ( xAfter.ulDirect - xBefore.ulDirect ),
+                               ( unsigned ) ( xAfter.ulFallback - xBefore.ulFallback ) ) );
+        #endif
+    }
+
+    FreeRTOS_closesocket( xSocket );
+
+    vTaskDelete( NULL );
+}
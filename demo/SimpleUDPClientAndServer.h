@@ -38,4 +38,8 @@
                                            UBaseType_t uxPriority );
 #endif
 
+void vStartUDPPingPongTask( uint16_t usStackSize,
+                            uint32_t ulEchoPort,
+                            UBaseType_t uxPriority );
+
 #endif /* SIMPLE_UDPCLIENT_AND_SERVER_H */
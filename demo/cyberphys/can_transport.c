@@ -0,0 +1,330 @@
+/**
+ * Batched CAN-over-UDP transport and J1939 BAM reassembly for the
+ * cyber-physical demo, see can_transport.h for the datagram format.
+ *
+ * A batch is built in a network buffer from FreeRTOS_GetUDPPayloadBuffer()
+ * and handed to the stack with FREERTOS_ZERO_COPY, and received datagrams
+ * are borrowed from the stack the same way, so frame data is never copied
+ * between the application and the stack.
+ */
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "can_transport.h"
+
+/*****************************************************************************/
+/* Static functions, macros etc */
+
+static void put_be32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static uint32_t get_be32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+/**
+ * Walk the frames of a received datagram. With handler NULL this only checks
+ * that every frame lies within the datagram.
+ */
+static int can_batch_parse(const uint8_t *payload, size_t len, can_frame_handler_t handler, void *context)
+{
+    size_t offset = CAN_BATCH_HEADER_LEN;
+    uint8_t count;
+
+    if (len < CAN_BATCH_HEADER_LEN || payload[0] != CAN_BATCH_MAGIC || payload[1] != CAN_BATCH_VERSION)
+    {
+        return CAN_MALFORMED;
+    }
+
+    count = payload[2];
+    for (uint8_t i = 0; i < count; i++)
+    {
+        uint8_t dlc;
+
+        if (offset + CAN_BATCH_FRAME_HEADER_LEN > len)
+        {
+            return CAN_MALFORMED;
+        }
+
+        dlc = payload[offset + 4];
+        if (dlc > CAN_BATCH_MAX_DLC || offset + CAN_BATCH_FRAME_HEADER_LEN + dlc > len)
+        {
+            return CAN_MALFORMED;
+        }
+
+        if (handler != NULL)
+        {
+            handler(get_be32(&payload[offset]), &payload[offset + CAN_BATCH_FRAME_HEADER_LEN], dlc, context);
+        }
+        offset += CAN_BATCH_FRAME_HEADER_LEN + dlc;
+    }
+
+    return count;
+}
+
+/*****************************************************************************/
+
+void can_batch_init(struct can_batch *batch, Socket_t socket, const struct freertos_sockaddr *dest)
+{
+    memset(batch, 0, sizeof(*batch));
+    batch->socket = socket;
+    batch->dest = *dest;
+}
+
+int can_batch_add(struct can_batch *batch, uint32_t can_id, const void *data, uint8_t len)
+{
+    uint8_t *frame;
+
+    if (len > CAN_BATCH_MAX_DLC)
+    {
+        return CAN_BAD_FRAME;
+    }
+
+    if (batch->payload == NULL)
+    {
+        /* Don't wait for a buffer: the frame is stale by the time one frees up */
+        batch->payload = (uint8_t *)FreeRTOS_GetUDPPayloadBuffer(CAN_BATCH_MAX_LEN, 0);
+        if (batch->payload == NULL)
+        {
+            batch->stats.tx_errors++;
+            return CAN_NO_BUFFER;
+        }
+        batch->payload[0] = CAN_BATCH_MAGIC;
+        batch->payload[1] = CAN_BATCH_VERSION;
+        batch->len = CAN_BATCH_HEADER_LEN;
+        batch->count = 0;
+    }
+
+    frame = &batch->payload[batch->len];
+    put_be32(frame, can_id);
+    frame[4] = len;
+    memcpy(&frame[CAN_BATCH_FRAME_HEADER_LEN], data, len);
+    batch->len += CAN_BATCH_FRAME_HEADER_LEN + len;
+    batch->count++;
+
+    if (batch->count == CAN_BATCH_MAX_FRAMES)
+    {
+        return can_batch_flush(batch);
+    }
+
+    return 0;
+}
+
+int can_batch_flush(struct can_batch *batch)
+{
+    int32_t sent;
+
+    if (batch->payload == NULL)
+    {
+        return 0;
+    }
+
+    batch->payload[2] = batch->count;
+    batch->payload[3] = batch->seq++;
+
+    /* The stack owns the buffer once it is accepted */
+    sent = FreeRTOS_sendto(batch->socket, batch->payload, batch->len, FREERTOS_ZERO_COPY, &batch->dest,
+                           sizeof(batch->dest));
+    if (sent == 0)
+    {
+        FreeRTOS_ReleaseUDPPayloadBuffer(batch->payload);
+        batch->stats.tx_errors += batch->count;
+    }
+    else
+    {
+        batch->stats.tx_datagrams++;
+        batch->stats.tx_frames += batch->count;
+    }
+
+    batch->payload = NULL;
+    batch->len = 0;
+    batch->count = 0;
+
+    return (sent == 0) ? CAN_SEND_ERROR : 0;
+}
+
+int can_batch_receive(Socket_t socket, struct freertos_sockaddr *from, can_frame_handler_t handler, void *context,
+                      struct can_transport_stats *stats)
+{
+    uint32_t from_len = sizeof(*from);
+    uint8_t *payload;
+    int32_t received;
+    int frames;
+
+    received = FreeRTOS_recvfrom(socket, &payload, 0, FREERTOS_ZERO_COPY, from, &from_len);
+    if (received <= 0)
+    {
+        return CAN_TIMEOUT;
+    }
+
+    /* Check the whole datagram first, so a truncated one delivers nothing */
+    frames = can_batch_parse(payload, (size_t)received, NULL, NULL);
+    if (frames >= 0)
+    {
+        (void)can_batch_parse(payload, (size_t)received, handler, context);
+    }
+
+    FreeRTOS_ReleaseUDPPayloadBuffer(payload);
+
+    if (stats != NULL)
+    {
+        stats->rx_datagrams++;
+        if (frames >= 0)
+        {
+            stats->rx_frames += (uint32_t)frames;
+        }
+        else
+        {
+            stats->rx_malformed++;
+        }
+    }
+
+    return frames;
+}
+
+/*****************************************************************************/
+/* J1939 BAM reassembly */
+
+void j1939_bam_init(struct j1939_bam *bam, uint8_t *buf, size_t size)
+{
+    memset(bam, 0, sizeof(*bam));
+    bam->buf = buf;
+    bam->size = size;
+}
+
+/**
+ * TP.CM with the BAM control byte: size (LE16), packets, reserved and the
+ * PGN of the message (LE24)
+ */
+static enum j1939_bam_result j1939_bam_announce(struct j1939_bam *bam, uint8_t source, const uint8_t *data,
+                                                uint8_t len)
+{
+    uint16_t total;
+    uint8_t packets;
+
+    if (len < 8 || data[0] != J1939_TP_CM_BAM)
+    {
+        /* RTS/CTS and the other connection management messages */
+        return J1939_BAM_IGNORED;
+    }
+
+    if (bam->active && bam->source == source)
+    {
+        bam->stats.aborted++;
+    }
+    bam->active = false;
+
+    total = (uint16_t)(data[1] | (data[2] << 8));
+    packets = data[3];
+
+    if (total == 0 || total > J1939_TP_MAX_LEN ||
+        packets != (total + J1939_TP_DT_DATA_LEN - 1) / J1939_TP_DT_DATA_LEN)
+    {
+        bam->stats.malformed++;
+        return J1939_BAM_DROPPED;
+    }
+
+    if (total > bam->size)
+    {
+        bam->stats.too_long++;
+        return J1939_BAM_DROPPED;
+    }
+
+    bam->active = true;
+    bam->source = source;
+    bam->total = total;
+    bam->packets = packets;
+    bam->next_seq = 1;
+    bam->pgn = (uint32_t)data[5] | ((uint32_t)data[6] << 8) | ((uint32_t)data[7] << 16);
+    bam->last = xTaskGetTickCount();
+
+    return J1939_BAM_CONSUMED;
+}
+
+/**
+ * TP.DT: sequence number, then 7 bytes of the message
+ */
+static enum j1939_bam_result j1939_bam_data(struct j1939_bam *bam, uint8_t source, const uint8_t *data,
+                                            uint8_t len)
+{
+    TickType_t now = xTaskGetTickCount();
+    size_t offset, chunk;
+
+    /* One transfer at a time, packets of any other are dropped */
+    if (!bam->active || bam->source != source)
+    {
+        return J1939_BAM_DROPPED;
+    }
+
+    if (now - bam->last > pdMS_TO_TICKS(J1939_TP_T1_MS))
+    {
+        bam->stats.timeouts++;
+        bam->active = false;
+        return J1939_BAM_DROPPED;
+    }
+
+    if (len < 1 + J1939_TP_DT_DATA_LEN)
+    {
+        bam->stats.malformed++;
+        bam->active = false;
+        return J1939_BAM_DROPPED;
+    }
+
+    if (data[0] != bam->next_seq)
+    {
+        bam->stats.out_of_sequence++;
+        bam->active = false;
+        return J1939_BAM_DROPPED;
+    }
+
+    /* next_seq <= packets, which covers total <= size bytes */
+    offset = (size_t)(bam->next_seq - 1) * J1939_TP_DT_DATA_LEN;
+    chunk = bam->total - offset;
+    if (chunk > J1939_TP_DT_DATA_LEN)
+    {
+        chunk = J1939_TP_DT_DATA_LEN;
+    }
+    memcpy(&bam->buf[offset], &data[1], chunk);
+
+    if (bam->next_seq == bam->packets)
+    {
+        bam->stats.completed++;
+        bam->active = false;
+        return J1939_BAM_COMPLETE;
+    }
+
+    bam->next_seq++;
+    bam->last = now;
+
+    return J1939_BAM_CONSUMED;
+}
+
+/**
+ * 29-bit identifier: priority (3), extended data page and data page (2), PDU
+ * format (8), PDU specific (8) and source address (8). Flags above bit 28,
+ * such as SocketCAN's CAN_EFF_FLAG, are ignored.
+ */
+enum j1939_bam_result j1939_bam_input(struct j1939_bam *bam, uint32_t can_id, const uint8_t *data, uint8_t len)
+{
+    /* Transport protocol frames are on data page 0 */
+    uint16_t pf = (uint16_t)((can_id >> 16) & 0x3FF);
+    uint8_t source = (uint8_t)can_id;
+
+    switch (pf)
+    {
+    case J1939_PF_TP_CM:
+        return j1939_bam_announce(bam, source, data, len);
+    case J1939_PF_TP_DT:
+        return j1939_bam_data(bam, source, data, len);
+    default:
+        return J1939_BAM_IGNORED;
+    }
+}
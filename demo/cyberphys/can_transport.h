@@ -0,0 +1,147 @@
+#ifndef __CAN_TRANSPORT_H__
+#define __CAN_TRANSPORT_H__
+
+/**
+ * Batched CAN-over-UDP transport for the cyber-physical demo
+ * (can_transport.c).
+ *
+ * Several CAN frames travel in one UDP datagram:
+ *
+ *   header: magic (0xCB), version (1), frame count, sequence number
+ *   frame:  CAN id (32 bit, big endian), length (0-8), data[length]
+ *
+ * so a frame costs 5 bytes plus its data, instead of a datagram of its own.
+ * Batches are built directly in a network buffer and sent zero-copy, and
+ * received batches are parsed in place, each frame being handed to a callback
+ * that points into the network buffer.
+ *
+ * J1939 BAM transfers (TP.CM with the BAM control byte, then TP.DT packets)
+ * arriving as frames are reassembled by j1939_bam_input().
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "FreeRTOS_IP.h"
+#include "FreeRTOS_Sockets.h"
+
+#define CAN_BATCH_MAGIC 0xCB
+#define CAN_BATCH_VERSION 1
+#define CAN_BATCH_HEADER_LEN 4
+#define CAN_BATCH_FRAME_HEADER_LEN 5
+#define CAN_BATCH_MAX_DLC 8
+
+/* Frames per datagram, a full batch is sent straight away */
+#ifndef CAN_BATCH_MAX_FRAMES
+#define CAN_BATCH_MAX_FRAMES 32
+#endif
+
+#define CAN_BATCH_MAX_LEN \
+    (CAN_BATCH_HEADER_LEN + CAN_BATCH_MAX_FRAMES * (CAN_BATCH_FRAME_HEADER_LEN + CAN_BATCH_MAX_DLC))
+
+enum can_transport_error {
+    CAN_NO_BUFFER = -1,   /* No network buffer to build a batch in */
+    CAN_SEND_ERROR = -2,
+    CAN_BAD_FRAME = -3,   /* Longer than CAN_BATCH_MAX_DLC */
+    CAN_TIMEOUT = -4,     /* Nothing received */
+    CAN_MALFORMED = -5,   /* Not a batch, or a truncated one */
+};
+
+struct can_transport_stats
+{
+    uint32_t tx_datagrams;
+    uint32_t tx_frames;
+    uint32_t tx_errors;   /* Frames lost to CAN_NO_BUFFER or CAN_SEND_ERROR */
+    uint32_t rx_datagrams;
+    uint32_t rx_frames;
+    uint32_t rx_malformed;
+};
+
+/* Outgoing batch, owned by one task */
+struct can_batch
+{
+    Socket_t socket;
+    struct freertos_sockaddr dest;
+    uint8_t *payload;     /* Network buffer being filled, NULL when empty */
+    size_t len;
+    uint8_t count;
+    uint8_t seq;
+    struct can_transport_stats stats;
+};
+
+/* Called for each received frame, data points into the network buffer and is
+ * only valid during the call */
+typedef void (*can_frame_handler_t)(uint32_t can_id, const uint8_t *data, uint8_t len, void *context);
+
+void can_batch_init(struct can_batch *batch, Socket_t socket, const struct freertos_sockaddr *dest);
+
+/**
+ * Append a frame to the batch, sending it first when it is full. Returns 0
+ * or a can_transport_error.
+ */
+int can_batch_add(struct can_batch *batch, uint32_t can_id, const void *data, uint8_t len);
+
+/* Send the frames added so far, if any. Returns 0 or a can_transport_error. */
+int can_batch_flush(struct can_batch *batch);
+
+/**
+ * Receive one datagram on socket (blocking for the socket's receive timeout)
+ * and call handler for each of its frames. Returns the number of frames, or a
+ * can_transport_error. stats may be NULL.
+ */
+int can_batch_receive(Socket_t socket, struct freertos_sockaddr *from, can_frame_handler_t handler, void *context,
+                      struct can_transport_stats *stats);
+
+/*****************************************************************************/
+/* J1939 BAM reassembly */
+
+#define J1939_PF_TP_CM 0xEC
+#define J1939_PF_TP_DT 0xEB
+#define J1939_TP_CM_BAM 0x20
+#define J1939_TP_DT_DATA_LEN 7
+#define J1939_TP_MAX_LEN 1785    /* 255 packets of 7 bytes */
+#define J1939_TP_T1_MS 750       /* Longest gap between two packets */
+
+enum j1939_bam_result {
+    J1939_BAM_IGNORED = 0,       /* Not a BAM frame */
+    J1939_BAM_CONSUMED = 1,      /* Part of a transfer in progress */
+    J1939_BAM_COMPLETE = 2,      /* The message is in the buffer */
+    J1939_BAM_DROPPED = 3,       /* Malformed, out of sequence or too long */
+};
+
+struct j1939_bam_stats
+{
+    uint32_t completed;
+    uint32_t too_long;           /* Announced more than the buffer holds */
+    uint32_t malformed;          /* Bad TP.CM, or packet count not matching the size */
+    uint32_t out_of_sequence;
+    uint32_t timeouts;
+    uint32_t aborted;            /* Replaced by a new announcement */
+};
+
+struct j1939_bam
+{
+    uint8_t *buf;
+    size_t size;
+    bool active;
+    uint8_t source;              /* Source address of the transfer */
+    uint8_t packets;
+    uint8_t next_seq;
+    uint16_t total;
+    uint32_t pgn;                /* Of the message being transferred */
+    TickType_t last;             /* When the last packet arrived */
+    struct j1939_bam_stats stats;
+};
+
+/* Reassemble into buf, messages longer than size are dropped */
+void j1939_bam_init(struct j1939_bam *bam, uint8_t *buf, size_t size);
+
+/**
+ * Feed a received frame. On J1939_BAM_COMPLETE the message is bam->total bytes
+ * of bam->buf, with PGN bam->pgn, until the next call.
+ */
+enum j1939_bam_result j1939_bam_input(struct j1939_bam *bam, uint32_t can_id, const uint8_t *data, uint8_t len);
+
+#endif /* __CAN_TRANSPORT_H__ */
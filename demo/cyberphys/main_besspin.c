@@ -6,7 +6,6 @@
 /* Kernel includes. */
 #include "FreeRTOS.h"
 #include "task.h"
-#include "semphr.h"
 
 /* IP stack includes. */
 #include "FreeRTOS_IP.h"
@@ -14,10 +13,14 @@
 
 /* Drivers */
 #include "bsp.h"
+#include "periodic_task.h"
+#include "seqlock.h"
 
 #if BSP_USE_IIC0
     #include "iic.h"
 #else
+    #include "iic_sim.h"
+    #include "sensor_sim.h"
     #define TRUE  1
     #define FALSE 0
 #endif
@@ -26,6 +29,11 @@
 #include "canspecs.h"
 #include "canlib.h"
 #include "j1939.h"
+#include "can_transport.h"
+
+#if configEVENT_TRACE
+    #include "event_trace.h"
+#endif
 
 /* FETT config */
 
@@ -52,7 +60,10 @@
 #define CAN_RX_TASK_PRIORITY tskIDLE_PRIORITY + 3
 #define INFOTASK_PRIORITY tskIDLE_PRIORITY + 1
 
-#define SENSOR_LOOP_DELAY_MS pdMS_TO_TICKS(50)
+/* Sensor loop: released every period, each cycle must be done within the
+ * deadline after its release */
+#define SENSOR_PERIOD_MS pdMS_TO_TICKS(50)
+#define SENSOR_DEADLINE_MS pdMS_TO_TICKS(10)
 
 #define SENSOR_POWER_UP_DELAY_MS pdMS_TO_TICKS(100)
 #define BROADCAST_LOOP_DELAY_MS pdMS_TO_TICKS(50)
@@ -70,12 +81,48 @@
 
 #define NOTIFY_SUCCESS_NTK  0x00000001
 
-static void prvSensorTask(void *pvParameters);
+/* Send and receive CAN frames in batches (can_transport.h), rather than one
+ * frame per datagram with canlib. Off by default: the gateway has to speak
+ * the same format, and a batching build drops single-frame datagrams.
+ * J1939 BAM transfers are reassembled either way. */
+#ifndef CAN_BATCH
+#define CAN_BATCH 0
+#endif
+
+/* With --event-trace, kernel events are recorded from just before the app
+ * tasks are created and sent to EVENT_TRACE_PORT on the gateway, for
+ * etrace2perfetto.py --listen. Recording can wait for EVENT_TRACE_TRIGGER
+ * (an eventtrace id from event_trace_hooks.h), keep only the events in
+ * EVENT_TRACE_MASK (0 for all) and end after EVENT_TRACE_STOP_AFTER records
+ * (0 for no limit). */
+#if configEVENT_TRACE
+#ifndef EVENT_TRACE_PORT
+#define EVENT_TRACE_PORT 5021
+#endif
+#ifndef EVENT_TRACE_TRIGGER
+#define EVENT_TRACE_TRIGGER eventtraceNONE
+#endif
+#ifndef EVENT_TRACE_MASK
+#define EVENT_TRACE_MASK 0
+#endif
+#ifndef EVENT_TRACE_STOP_AFTER
+#define EVENT_TRACE_STOP_AFTER 0
+#endif
+#define EVENT_TRACE_STACK_SIZE configMINIMAL_STACK_SIZE * 2U
+#define EVENT_TRACE_PRIORITY tskIDLE_PRIORITY + 1
+#endif
+
+static void prvSensorInit(void);
+static void prvSensorCycle(void *pvParameters);
+static void prvSensorSend(canid_t can_id, void *data, uint8_t len, const char *name);
 static void prvCanRxTask(void *pvParameters);
 static void prvInfoTask(void *pvParameters);
 static void prvIPRestartHandlerTask(void *pvParameters);
 static void prvSocketCreateSensorIP();
 static void prvSocketCreateCanRx();
+#if configEVENT_TRACE
+static void prvEventTraceStart(void);
+#endif
 
 void main_besspin(void);
 void prvMainTask (void *pvParameters);
@@ -88,7 +135,6 @@ int16_t max(int16_t a, int16_t b);
 uint32_t ulApplicationGetNextSequenceNumber(uint32_t ulSourceAddress, uint16_t usSourcePort,
                                             uint32_t ulDestinationAddress, uint16_t usDestinationPort);
 
-SemaphoreHandle_t data_mutex;
 TaskHandle_t xMainTask = NULL;
 TaskHandle_t xIPRestartHandlerTask = NULL;
 TaskHandle_t xSensorTask = NULL;
@@ -99,8 +145,20 @@ static volatile Socket_t xCanRxClientSocket;
 static volatile struct freertos_sockaddr xDestinationAddress;
 static volatile Socket_t xSensorClientSocket;
 
+/* Sensor loop state, kept across cycles */
+static struct freertos_sockaddr xSensorDestinationAddress;
+static struct iic_bus *sensor_bus;
+#if CAN_BATCH
+static struct can_batch sensor_batch;
+#endif
+
 /* CAN rx buffer */
 uint8_t j1939_rx_buf[0x100] __attribute__((aligned(64)));
+static struct j1939_bam can_rx_bam;
+#if CAN_BATCH
+static struct can_batch can_rx_batch;
+static struct can_transport_stats can_rx_stats;
+#endif
 
 /* Stereing assist config */
 bool camera_ok;
@@ -122,10 +180,18 @@ int16_t brake_raw;
 /* Transmission status */
 bool transmission_ok;
 
-/* Final values */
-uint8_t throttle;
-uint8_t brake;
-uint8_t gear;
+/* Final values, published by the sensor loop once per cycle */
+struct sensor_state
+{
+    int16_t throttle_raw;
+    int16_t brake_raw;
+    uint8_t throttle;
+    uint8_t brake;
+    uint8_t gear;
+};
+static SeqLock_t sensor_state;
+static uint8_t sensor_state_storage[seqlockSTORAGE_SIZE(sizeof(struct sensor_state))]
+    __attribute__((aligned(sizeof(void *))));
 
 /* Debug info */
 uint32_t hz_sensor_task;
@@ -317,6 +383,10 @@ void prvIPRestartHandlerTask(void *pvParameters) {
         ulTaskNotifyTake( pdFALSE, portMAX_DELAY );
         prvSocketCreateCanRx();
         prvSocketCreateSensorIP();
+#if CAN_BATCH
+        sensor_batch.socket = xSensorClientSocket;
+        can_rx_batch.socket = xCanRxClientSocket;
+#endif
         vTaskResume(xCanTask);
         vTaskResume(xSensorTask);
     }
@@ -347,9 +417,9 @@ void prvMainTask (void *pvParameters) {
         FreeRTOS_printf(("<NTK-READY>\r\n"));
     }
     
-    /* Initialize mutex */
-    data_mutex = xSemaphoreCreateMutex();
-    configASSERT(data_mutex != NULL);
+    /* Sensor state, neutral until the first cycle */
+    struct sensor_state initial_state = {.gear = 'N'};
+    vSeqLockInit(&sensor_state, sensor_state_storage, sizeof(struct sensor_state), &initial_state);
 
     /* Camera is not connected, don't use */
     camera_ok = FALSE;
@@ -358,8 +428,24 @@ void prvMainTask (void *pvParameters) {
     transmission_ok = TRUE;
 
     /* Create the tasks */
+    prvSensorInit();
+    PeriodicTaskConfig_t sensor_config = {
+        .pcName = "prvSensorTask",
+        .pxFunction = prvSensorCycle,
+        .pvParameters = NULL,
+        .xPeriod = SENSOR_PERIOD_MS,
+        .xDeadline = SENSOR_DEADLINE_MS,
+        .xPhase = 0,
+        .usStackSize = SENSORTASK_STACK_SIZE,
+        .uxPriority = SENSORTASK_PRIORITY
+    };
+
+#if configEVENT_TRACE
+    prvEventTraceStart();
+#endif
+
     funcReturn = xTaskCreate(prvInfoTask, "prvInfoTask", INFOTASK_STACK_SIZE, NULL, INFOTASK_PRIORITY, NULL);
-    funcReturn &= xTaskCreate(prvSensorTask, "prvSensorTask", SENSORTASK_STACK_SIZE, NULL, SENSORTASK_PRIORITY, &xSensorTask);
+    funcReturn &= xPeriodicTaskCreate(&sensor_config, &xSensorTask);
     funcReturn &= xTaskCreate(prvCanRxTask, "prvCanRxTask", CAN_RX_STACK_SIZE, NULL, CAN_RX_TASK_PRIORITY, &xCanTask);
     funcReturn &= xTaskCreate(prvIPRestartHandlerTask, "prvIPRestartTask", IP_RESTART_STACK_SIZE, NULL, IP_RESTART_TASK_PRIORITY, &xIPRestartHandlerTask);
     if (funcReturn == pdPASS) {
@@ -371,38 +457,102 @@ void prvMainTask (void *pvParameters) {
     vTaskDelete(NULL);
 }
 
+#if configEVENT_TRACE
+static Socket_t xEventTraceSocket = FREERTOS_INVALID_SOCKET;
+static struct freertos_sockaddr xEventTraceAddress;
+
+static BaseType_t prvEventTraceWrite(const uint8_t *data, size_t len, void *context)
+{
+    (void)context;
+
+    /* The trace stopped by itself and has been written out */
+    if (data == NULL)
+    {
+        FreeRTOS_closesocket(xEventTraceSocket);
+        xEventTraceSocket = FREERTOS_INVALID_SOCKET;
+        return pdPASS;
+    }
+
+    return (FreeRTOS_sendto(xEventTraceSocket, data, len, 0, &xEventTraceAddress, sizeof(xEventTraceAddress)) > 0) ? pdPASS : pdFAIL;
+}
+
+static void prvEventTraceStart(void)
+{
+    EventTraceConditions_t conditions = {
+        .ulEventMask = EVENT_TRACE_MASK,
+        .ulTriggerEvent = EVENT_TRACE_TRIGGER,
+        .ulStopEvent = eventtraceNONE,
+        .ulStopAfter = EVENT_TRACE_STOP_AFTER,
+    };
+
+    xEventTraceAddress.sin_addr = FreeRTOS_inet_addr_quick(configGATEWAY_ADDR0, configGATEWAY_ADDR1,
+                                                           configGATEWAY_ADDR2, configGATEWAY_ADDR3);
+    xEventTraceAddress.sin_port = FreeRTOS_htons((uint16_t)EVENT_TRACE_PORT);
+    xEventTraceSocket = FreeRTOS_socket(FREERTOS_AF_INET, FREERTOS_SOCK_DGRAM, FREERTOS_IPPROTO_UDP);
+
+    if ((xEventTraceSocket == FREERTOS_INVALID_SOCKET) ||
+        (xEventTraceInit(EVENT_TRACE_STACK_SIZE, EVENT_TRACE_PRIORITY) != pdPASS) ||
+        (xEventTraceStart(&conditions, prvEventTraceWrite, NULL) != pdPASS))
+    {
+        FreeRTOS_printf(("%s (Error)~  prvEventTraceStart: Failed to start the event trace.\r\n", getCurrTime()));
+        return;
+    }
+
+    FreeRTOS_printf(("%s (Info)~  prvEventTraceStart: Tracing to port %u on the gateway.\r\n", getCurrTime(),
+                     (unsigned)EVENT_TRACE_PORT));
+}
+#endif /* configEVENT_TRACE */
+
 static void prvInfoTask(void *pvParameters)
 {
     (void)pvParameters;
-    int16_t local_throttle, local_brake;
-    int16_t local_throttle_raw, local_brake_raw;
-    uint8_t local_gear;
+    struct sensor_state local;
+    SeqLockStats_t state_stats;
     uint32_t hz_sensor_task_old = 0;
+    static char report[1024];
 
     FreeRTOS_printf(("%s Starting prvInfoTask\r\n", getCurrTime()));
 
     for (;;)
     {
-        /* Copy data over */
-        if (xSemaphoreTake(data_mutex, pdMS_TO_TICKS(100)) == pdTRUE)
-        {
-            local_throttle_raw = throttle_raw;
-            local_brake_raw = brake_raw;
-            local_throttle = throttle;
-            local_brake = brake;
-            local_gear = gear;
-            xSemaphoreGive(data_mutex);
-        }
+        /* Copy data over, without holding up the sensor loop */
+        (void)ulSeqLockRead(&sensor_state, &local);
+        vSeqLockGetStats(&sensor_state, &state_stats);
+
         /* Sensor info */
-        FreeRTOS_printf(("%s (prvInfoTask:raw) throttle: %d, brake: %d\r\n", getCurrTime(), local_throttle_raw, local_brake_raw));
-        FreeRTOS_printf(("%s (prvInfoTask:scaled) Gear: %c, throttle: %u, brake: %u\r\n", getCurrTime(), local_gear, local_throttle, local_brake));
+        FreeRTOS_printf(("%s (prvInfoTask:raw) throttle: %d, brake: %d\r\n", getCurrTime(), local.throttle_raw, local.brake_raw));
+        FreeRTOS_printf(("%s (prvInfoTask:scaled) Gear: %c, throttle: %u, brake: %u\r\n", getCurrTime(), local.gear, local.throttle, local.brake));
+        FreeRTOS_printf(("%s (prvInfoTask:state) published: %u, reads: %u, retries: %u (max %u)\r\n", getCurrTime(),
+                         state_stats.ulPublished, state_stats.ulReads, state_stats.ulRetries, state_stats.ulMaxRetries));
         FreeRTOS_printf(("%s (prvInfoTask:hz) prvSensorTask: %u[Hz]\r\n", getCurrTime(), hz_sensor_task - hz_sensor_task_old));
         hz_sensor_task_old = hz_sensor_task;
 
+        /* Period, deadline and jitter of the sensor loop */
+        for (UBaseType_t i = 0; uxPeriodicTaskReport(i, report, sizeof(report)) > 0; i++)
+        {
+            FreeRTOS_printf(("%s (prvInfoTask:timing) %s", getCurrTime(), report));
+        }
+
         /* IIC bus info */
 #if IIC0_PRINT_STATS && BSP_USE_IIC0
         iic0_print_stats();
+#else
+        iic_bus_print_stats(sensor_bus);
+#endif
+
+#if CAN_BATCH
+        /* CAN transport info */
+        FreeRTOS_printf(("%s (prvInfoTask:can) tx %u frames in %u datagrams, %u lost, "
+                         "rx %u frames in %u datagrams, %u malformed\r\n",
+                         getCurrTime(), sensor_batch.stats.tx_frames, sensor_batch.stats.tx_datagrams,
+                         sensor_batch.stats.tx_errors, can_rx_stats.rx_frames, can_rx_stats.rx_datagrams,
+                         can_rx_stats.rx_malformed));
 #endif
+        FreeRTOS_printf(("%s (prvInfoTask:bam) %u complete, %u aborted, %u timeouts, %u out of sequence, "
+                         "%u malformed, %u too long\r\n",
+                         getCurrTime(), can_rx_bam.stats.completed, can_rx_bam.stats.aborted,
+                         can_rx_bam.stats.timeouts, can_rx_bam.stats.out_of_sequence,
+                         can_rx_bam.stats.malformed, can_rx_bam.stats.too_long));
 
         if (camera_ok)
         {
@@ -422,155 +572,169 @@ static void prvSocketCreateSensorIP() {
 }
 
 /**
- * Read and update gear values
+ * Set up the sensor loop, before its first cycle
  */
-static void prvSensorTask(void *pvParameters)
+static void prvSensorInit(void)
 {
-    (void)pvParameters;
-
-    int returnval;
-    struct freertos_sockaddr xDestinationAddress;
-
     // Broadcast address
-    xDestinationAddress.sin_addr = FreeRTOS_inet_addr(CYBERPHYS_BROADCAST_ADDR);
-    xDestinationAddress.sin_port = FreeRTOS_htons((uint16_t)CAN_PORT);
+    xSensorDestinationAddress.sin_addr = FreeRTOS_inet_addr(CYBERPHYS_BROADCAST_ADDR);
+    xSensorDestinationAddress.sin_port = FreeRTOS_htons((uint16_t)CAN_PORT);
 
     FreeRTOS_printf(("%s Starting prvSensorTask\r\n", getCurrTime()));
 
     // Create a socket for the sensor
     prvSocketCreateSensorIP();
+#if CAN_BATCH
+    can_batch_init(&sensor_batch, xSensorClientSocket, &xSensorDestinationAddress);
+#endif
 
     hz_sensor_task = 0;
-    uint8_t data[5];
-    uint8_t tmp_var;
-
-    // Gear variables
-    uint8_t tmp_gear;
 
     // Throttle variables
-    int16_t tmp_throttle;
     hz_sensor_throttle_task = 0;
     throttle_gain = THROTTLE_GAIN;
     throttle_min = THROTTLE_MIN;
     throttle_max = THROTTLE_MAX;
 
     // Brake variables
-    int16_t tmp_brake;
     brake_gain = BRAKE_GAIN;
     brake_min = BRAKE_MIN;
     brake_max = BRAKE_MAX;
 
-    int err_cnt = 0;
+    // The Teensy, or its simulation
+    #if BSP_USE_IIC0
+        sensor_bus = &Iic0.bus;
+    #else
+        sensor_sim_init(TEENSY_I2C_ADDRESS);
+        sensor_bus = &IicSim;
+    #endif
+}
 
-    for (;;)
+/**
+ * Send a frame to the gateway. When batching, the cycle's frames go out
+ * together at its end.
+ */
+static void prvSensorSend(canid_t can_id, void *data, uint8_t len, const char *name)
+{
+#if CAN_BATCH
+    if (can_batch_add(&sensor_batch, can_id, data, len) != 0)
+#else
+    if (send_can_message(xSensorClientSocket, &xSensorDestinationAddress, can_id, data, len) != SUCCESS)
+#endif
     {
-        #if BSP_USE_IIC0
-            returnval = iic_receive(&Iic0, TEENSY_I2C_ADDRESS, data, 5);
-        #else
-            /* Default to neutral */
-            tmp_gear = 'N';
-            returnval = 1;
-        #endif
-
-        vTaskDelay(pdMS_TO_TICKS(1));
-        if (returnval < 1) {
-            FreeRTOS_printf(("%s (prvSensorTask) iic_receive error: %i\r\n", getCurrTime(), returnval));
-            vTaskDelay(pdMS_TO_TICKS(100));
-            err_cnt++;
-            #if BSP_USE_IIC0
-            if (err_cnt >= IIC_RESET_ERROR_THRESHOLD) {
-                FreeRTOS_printf(("%s (prvSensorTask) err_cnt == %i, resetting!\r\n", getCurrTime(), err_cnt));
-                iic0_master_reset();
-                err_cnt = 0;
-            }
-            #endif
-            continue;
-        }
+        FreeRTOS_printf(("%s (prvSensorTask) send %s failed\r\n", getCurrTime(), name));
+    }
+}
 
-        /* Is transmission OK? */
-        if (transmission_ok)
-        {
-            // data[4] = gear
-            switch (data[4])
-            {
-            case 0x28:
-                tmp_gear = 'P';
-                break;
-            case 0x27:
-                tmp_gear = 'R';
-                break;
-            case 0x26:
-                tmp_gear = 'N';
-                break;
-            case 0x25:
-                tmp_gear = 'D';
-                break;
-            default:
-                FreeRTOS_printf(("%s (prvSensorTask) unknown gear value: %c\r\n", getCurrTime(), data[4]));
-                break;
-            }
-        } else {
-            /* Default to neutral */
-            tmp_gear = 'N';
-        }
+/**
+ * Read and update gear values, one cycle of the sensor loop
+ */
+static void prvSensorCycle(void *pvParameters)
+{
+    (void)pvParameters;
 
-        /* Send gear */
-        if (send_can_message(xSensorClientSocket, &xDestinationAddress, CAN_ID_GEAR, (void *)&tmp_gear, sizeof(tmp_gear)) != SUCCESS)
-        {
-            FreeRTOS_printf(("%s (prvSensorTask) send gear failed\r\n", getCurrTime()));
-        }
+    int returnval;
+    uint8_t data[5];
+    uint8_t tmp_var;
+    struct sensor_state state;
 
-        /* Process throttle */
-        // data[0,1] = throttle_raw
-        throttle_raw = (int16_t)(data[1] << 8 | data[0]);
-        tmp_throttle = max(throttle_raw - throttle_min, 0); // remove offset
-        tmp_throttle = tmp_throttle * throttle_gain / (throttle_max - throttle_min);
-        tmp_throttle = min(max(tmp_throttle, 0), 100);
-        tmp_var = (uint8_t)tmp_throttle;
+    // Gear variables, an unknown reading keeps the last gear
+    static uint8_t tmp_gear = 'N';
 
-        /* Send throttle */
-        if (send_can_message(xSensorClientSocket, &xDestinationAddress, CAN_ID_THROTTLE_INPUT, (void *)&tmp_var, sizeof(tmp_var)) != SUCCESS)
-        {
-            FreeRTOS_printf(("%s (prvSensorTask) send throttle failed\r\n", getCurrTime()));
-        }
+    // Throttle variables
+    int16_t tmp_throttle;
 
-        /* Request brake */
-        // data[2,3] = brake_raw
-        brake_raw = (int16_t)(data[3] << 8 | data[2]);
-        tmp_brake = max(brake_max - brake_raw, 0); // reverse brake
-        tmp_brake = tmp_brake * brake_gain / (brake_max - brake_min);
-        tmp_brake = min(max(tmp_brake, 0), 100);
-        tmp_var = (uint8_t)tmp_brake;
+    // Brake variables
+    int16_t tmp_brake;
 
-        /* Send brake */
-        if (send_can_message(xSensorClientSocket, &xDestinationAddress, CAN_ID_BRAKE_INPUT, (void *)&tmp_var, sizeof(tmp_var)) != SUCCESS)
-        {
-            FreeRTOS_printf(("%s (prvSensorTask) send brake failed\r\n", getCurrTime()));
-        }
+    /* Queued behind any other IIC traffic; the task sleeps until the
+     * controller's interrupt completes the read. A read stuck on the bus is
+     * given up at the deadline, which also resets the controller. */
+    returnval = iic_bus_transfer(sensor_bus, TEENSY_I2C_ADDRESS, IIC_READ, data, 5, SENSOR_DEADLINE_MS);
 
-        if (xSemaphoreTake(data_mutex, pdMS_TO_TICKS(100)) == pdTRUE)
-        {
-            gear = (uint8_t)tmp_gear;
-            throttle = (uint8_t)tmp_throttle;
-            brake = (uint8_t)tmp_brake;
-            xSemaphoreGive(data_mutex);
-        }
+    if (returnval < 1) {
+        /* Retried at the next release */
+        FreeRTOS_printf(("%s (prvSensorTask) iic_receive error: %i\r\n", getCurrTime(), returnval));
+        return;
+    }
 
-        if (camera_ok)
+    /* Is transmission OK? */
+    if (transmission_ok)
+    {
+        // data[4] = gear
+        switch (data[4])
         {
-            /* Steering assist */
-            if (send_can_message(xSensorClientSocket, &xDestinationAddress, CAN_ID_STEERING_INPUT, (void *)&steering_assist, sizeof(steering_assist)) != SUCCESS)
-            {
-                FreeRTOS_printf(("%s (prvSensorTask) send steering_assist failed\r\n", getCurrTime()));
-            }
+        case 0x28:
+            tmp_gear = 'P';
+            break;
+        case 0x27:
+            tmp_gear = 'R';
+            break;
+        case 0x26:
+            tmp_gear = 'N';
+            break;
+        case 0x25:
+            tmp_gear = 'D';
+            break;
+        default:
+            FreeRTOS_printf(("%s (prvSensorTask) unknown gear value: %c\r\n", getCurrTime(), data[4]));
+            break;
         }
+    } else {
+        /* Default to neutral */
+        tmp_gear = 'N';
+    }
 
-        /* Increment only *after* a successful run */
-        hz_sensor_task++;
-        vTaskDelay(SENSOR_LOOP_DELAY_MS);
+    /* Send gear */
+    prvSensorSend(CAN_ID_GEAR, (void *)&tmp_gear, sizeof(tmp_gear), "gear");
+
+    /* Process throttle */
+    // data[0,1] = throttle_raw
+    throttle_raw = (int16_t)(data[1] << 8 | data[0]);
+    tmp_throttle = max(throttle_raw - throttle_min, 0); // remove offset
+    tmp_throttle = tmp_throttle * throttle_gain / (throttle_max - throttle_min);
+    tmp_throttle = min(max(tmp_throttle, 0), 100);
+    tmp_var = (uint8_t)tmp_throttle;
+
+    /* Send throttle */
+    prvSensorSend(CAN_ID_THROTTLE_INPUT, (void *)&tmp_var, sizeof(tmp_var), "throttle");
+
+    /* Request brake */
+    // data[2,3] = brake_raw
+    brake_raw = (int16_t)(data[3] << 8 | data[2]);
+    tmp_brake = max(brake_max - brake_raw, 0); // reverse brake
+    tmp_brake = tmp_brake * brake_gain / (brake_max - brake_min);
+    tmp_brake = min(max(tmp_brake, 0), 100);
+    tmp_var = (uint8_t)tmp_brake;
+
+    /* Send brake */
+    prvSensorSend(CAN_ID_BRAKE_INPUT, (void *)&tmp_var, sizeof(tmp_var), "brake");
+
+    /* Readers copy the state on their own, the loop never waits for them */
+    state.throttle_raw = throttle_raw;
+    state.brake_raw = brake_raw;
+    state.throttle = (uint8_t)tmp_throttle;
+    state.brake = (uint8_t)tmp_brake;
+    state.gear = (uint8_t)tmp_gear;
+    vSeqLockPublish(&sensor_state, &state);
+
+    if (camera_ok)
+    {
+        /* Steering assist */
+        prvSensorSend(CAN_ID_STEERING_INPUT, (void *)&steering_assist, sizeof(steering_assist), "steering_assist");
     }
-}
 
+#if CAN_BATCH
+    /* All of the cycle's frames in one datagram */
+    if (can_batch_flush(&sensor_batch) != 0)
+    {
+        FreeRTOS_printf(("%s (prvSensorTask) send batch failed\r\n", getCurrTime()));
+    }
+#endif
+
+    /* Increment only *after* a successful run */
+    hz_sensor_task++;
+}
 
 static void prvSocketCreateCanRx(void) {
     uint32_t ulIPAddress;
@@ -655,6 +819,100 @@ void vApplicationIPNetworkEventHook(eIPCallbackEvent_t eNetworkEvent)
 }
 /*-----------------------------------------------------------*/
 
+/**
+ * Feed a received frame to the BAM reassembly, whichever way it arrived.
+ * Returns true when the frame belongs to a BAM transfer and so is not for the
+ * caller.
+ */
+static bool prvCanRxBam(uint32_t can_id, const uint8_t *data, uint8_t len)
+{
+    switch (j1939_bam_input(&can_rx_bam, can_id, data, len))
+    {
+    case J1939_BAM_IGNORED:
+        return false;
+    case J1939_BAM_COMPLETE:
+        /* The message is in j1939_rx_buf */
+        FreeRTOS_printf(("%s (prvCanRxTask) BAM PGN 0x%05x, %u bytes\r\n", getCurrTime(),
+                         (unsigned)can_rx_bam.pgn, can_rx_bam.total));
+        return true;
+    default:
+        return true;
+    }
+}
+
+#if CAN_BATCH
+/**
+ * Handle one frame of a received batch, data points into the network buffer.
+ * Replies are batched into can_rx_batch, sent once the whole batch is handled.
+ */
+static void prvCanRxFrame(uint32_t can_id, const uint8_t *data, uint8_t len, void *context)
+{
+    uint32_t target_id = *(uint32_t *)context;
+    uint32_t request_id;
+    char cBuffer[BYTE_LENGTH_HEARTBEAT_ACK];
+
+    if (prvCanRxBam(can_id, data, len))
+    {
+        return;
+    }
+
+    switch (can_id)
+    {
+    case CAN_ID_HEARTBEAT_REQ:
+        if (len < sizeof(request_id))
+        {
+            break;
+        }
+        /* received data are in network endian, simply copy over as we do not need to process them */
+        memcpy(&request_id, data, sizeof(request_id));
+        FreeRTOS_printf(("%s (prvCanRxTask) Replying to heartbeat #%u\r\n", getCurrTime(), FreeRTOS_ntohl(request_id)));
+        /* Copy target ID (stored in network byte order) */
+        memcpy(&cBuffer[0], &target_id, sizeof(uint32_t));
+        /* Copy request ID (already in network byte order) */
+        memcpy(&cBuffer[4], &request_id, sizeof(uint32_t));
+        if (can_batch_add(&can_rx_batch, CAN_ID_HEARTBEAT_ACK, cBuffer, BYTE_LENGTH_HEARTBEAT_ACK) != 0)
+        {
+            FreeRTOS_printf(("%s (prvCanRxTask) Replying to heartbeat failed\r\n", getCurrTime()));
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void prvCanRxTask(void *pvParameters)
+{
+    (void)pvParameters;
+    struct freertos_sockaddr xClient;
+    uint32_t target_id;
+    int frames;
+
+    FreeRTOS_printf(("%s Starting prvCanRxTask\r\n", getCurrTime()));
+
+    /* Create socket for responding to requests */
+    prvSocketCreateCanRx();
+    can_batch_init(&can_rx_batch, xCanRxClientSocket, (const struct freertos_sockaddr *)&xDestinationAddress);
+
+    /* BAM messages are reassembled into the persistent buffer */
+    j1939_bam_init(&can_rx_bam, j1939_rx_buf, sizeof(j1939_rx_buf));
+
+    /* Set target ID */
+    target_id = FreeRTOS_htonl(FreeRTOS_GetIPAddress());
+
+    for (;;)
+    {
+        frames = can_batch_receive(xCanRxListeningSocket, &xClient, prvCanRxFrame, &target_id, &can_rx_stats);
+        if (frames == CAN_MALFORMED)
+        {
+            FreeRTOS_printf(("%s (prvCanRxTask) dropped a malformed batch\r\n", getCurrTime()));
+        }
+        else if (frames > 0 && can_batch_flush(&can_rx_batch) != 0)
+        {
+            FreeRTOS_printf(("%s (prvCanRxTask) sending replies failed\r\n", getCurrTime()));
+        }
+    }
+}
+#else
 static void prvCanRxTask(void *pvParameters)
 {
     (void)pvParameters;
@@ -671,6 +929,9 @@ static void prvCanRxTask(void *pvParameters)
     prvSocketCreateCanRx();
     /*  End of the socket for respondnig to requests */
 
+    /* BAM messages are reassembled into the persistent buffer */
+    j1939_bam_init(&can_rx_bam, j1939_rx_buf, sizeof(j1939_rx_buf));
+
     /* Set target ID */
     target_id = FreeRTOS_htonl(FreeRTOS_GetIPAddress());
 
@@ -705,6 +966,7 @@ static void prvCanRxTask(void *pvParameters)
         }
     }
 }
+#endif /* CAN_BATCH */
 
 uint8_t process_j1939(Socket_t xListeningSocket, struct freertos_sockaddr *xClient, size_t *msg_len, canid_t *can_id, uint8_t *msg_buf)
 {
@@ -713,11 +975,16 @@ uint8_t process_j1939(Socket_t xListeningSocket, struct freertos_sockaddr *xClie
     /* Receive a message that can overflow the msg buffer */
     uint8_t res = recv_can_message(xListeningSocket, xClient, can_id, msg, msg_len);
     if (res == SUCCESS) {
-        /* Check CAN ID */
-        if (*can_id == PGN_BAM)
+        if (*msg_len > sizeof(msg))
+        {
+            /* Never read past what msg holds */
+            *msg_len = sizeof(msg);
+        }
+
+        /* BAM transfers are reassembled into the persistent buffer */
+        if (prvCanRxBam(*can_id, (const uint8_t *)msg, (uint8_t)*msg_len))
         {
-            /* Copy message over to a persistent buffer */
-            memcpy(j1939_rx_buf, msg, *msg_len);
+            *msg_len = 0;
         } else {
             /* All other messages are pass-through */
             memcpy(msg_buf, msg, min(sizeof(uint32_t), *msg_len));
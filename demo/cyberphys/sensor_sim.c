@@ -0,0 +1,84 @@
+/**
+ * Simulated Teensy sensor for the cyber-physical demo, so the sensor loop
+ * runs unchanged on platforms without an IIC controller: the same
+ * transactions go through the simulated IIC bus instead.
+ *
+ * The throttle pedal ramps up and down over THROTTLE_SWEEP_MS, the brake
+ * pedal over BRAKE_SWEEP_MS (so the two drift in and out of phase) and the
+ * gear lever steps P, R, N, D every GEAR_STEP_MS. The raw ranges are the ones
+ * the real sensor reports.
+ */
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "iic_sim.h"
+#include "sensor_sim.h"
+
+#define THROTTLE_RAW_MIN 64
+#define THROTTLE_RAW_MAX 926
+#define THROTTLE_SWEEP_MS 4000
+
+#define BRAKE_RAW_MIN 50
+#define BRAKE_RAW_MAX 270
+#define BRAKE_SWEEP_MS 7000
+
+#define GEAR_STEP_MS 5000
+
+#define SENSOR_FRAME_LEN 5
+
+/* Gear codes as sent by the sensor: P, R, N, D */
+static const uint8_t gear_codes[] = {0x28, 0x27, 0x26, 0x25};
+
+/* Triangle wave between lo and hi, period_ms long */
+static int16_t triangle(uint32_t t_ms, uint32_t period_ms, int16_t lo, int16_t hi)
+{
+    uint32_t half = period_ms / 2;
+    uint32_t pos = t_ms % period_ms;
+
+    if (pos > half)
+    {
+        pos = period_ms - pos;
+    }
+
+    return (int16_t)(lo + (int32_t)(hi - lo) * (int32_t)pos / (int32_t)half);
+}
+
+static int sensor_sim_read(void *context, uint8_t *rx_data, uint8_t rx_len)
+{
+    uint8_t frame[SENSOR_FRAME_LEN];
+    uint32_t t_ms = (uint32_t)(xTaskGetTickCount() * portTICK_PERIOD_MS);
+    int16_t throttle_raw, brake_raw;
+
+    (void)context;
+
+    throttle_raw = triangle(t_ms, THROTTLE_SWEEP_MS, THROTTLE_RAW_MIN, THROTTLE_RAW_MAX);
+    /* Released at BRAKE_RAW_MAX, fully pressed at BRAKE_RAW_MIN */
+    brake_raw = triangle(t_ms, BRAKE_SWEEP_MS, BRAKE_RAW_MAX, BRAKE_RAW_MIN);
+
+    frame[0] = (uint8_t)throttle_raw;
+    frame[1] = (uint8_t)(throttle_raw >> 8);
+    frame[2] = (uint8_t)brake_raw;
+    frame[3] = (uint8_t)(brake_raw >> 8);
+    frame[4] = gear_codes[(t_ms / GEAR_STEP_MS) % sizeof(gear_codes)];
+
+    if (rx_len > SENSOR_FRAME_LEN)
+    {
+        rx_len = SENSOR_FRAME_LEN;
+    }
+    memcpy(rx_data, frame, rx_len);
+
+    return rx_len;
+}
+
+static struct iic_sim_target sensor_target = {
+    .read = sensor_sim_read,
+};
+
+void sensor_sim_init(uint8_t addr)
+{
+    iic_sim_init();
+    sensor_target.addr = addr;
+    configASSERT(iic_sim_add_target(&sensor_target) == 0);
+}
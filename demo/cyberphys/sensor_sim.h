@@ -0,0 +1,14 @@
+#ifndef __SENSOR_SIM_H__
+#define __SENSOR_SIM_H__
+
+#include <stdint.h>
+
+/**
+ * Put a simulated Teensy pedal/gear sensor at addr on the simulated IIC bus
+ * (IicSim, bsp/iic_sim.c), for platforms without an IIC controller (QEMU).
+ * Reads return the sensor's 5 byte frame: throttle (LE16), brake (LE16) and
+ * gear, following slow synthetic pedal and gear-lever movements.
+ */
+void sensor_sim_init(uint8_t addr);
+
+#endif /* __SENSOR_SIM_H__ */
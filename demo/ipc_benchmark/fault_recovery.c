@@ -0,0 +1,158 @@
+/*-
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Fault-recovery latency of a compartment (bsp/compartment_recovery.c).
+ *
+ * The receiver compartment is made to fault FAULT_RUNS times. For every fault
+ * the following are recorded, in cycles from the faulting instruction:
+ *  - handler:  the trap handler is entered
+ *  - restored: the compartment's globals are reset (fast restart only)
+ *  - resume:   the caller compartment gets its error return
+ *  - restart:  the faulted compartment serves the next call
+ * and printed as min/percentiles/max. Without --compartment-fast-restart the
+ * same run measures the generic fault handler for comparison; the wscript
+ * sets configCOMPARTMENT_FAULT_TIMES so the handler timestamps faults either
+ * way.
+ */
+
+/* Standard includes. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include "logging.h"
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "portstatcounters.h"
+
+#if ( configCHERI_COMPARTMENTALIZATION && configCHERI_COMPARTMENTALIZATION_MODE == 1 ) || \
+    ( configMPU_COMPARTMENTALIZATION && configMPU_COMPARTMENTALIZATION_MODE == 1 )
+
+#include "compartment_recovery.h"
+
+#ifndef FAULT_RUNS
+    #define FAULT_RUNS    256
+#endif
+
+extern cheri_riscv_hpms start_hpms;
+extern cheri_riscv_hpms end_hpms;
+
+extern uint64_t get_cycle_count( void );
+
+void externFunc( void * pvParameters );
+void externFault( void * pvParameters );
+void vFaultRecoveryBench( void * pvParameters );
+
+typedef enum
+{
+    eFaultHandler,
+    eFaultRestored,
+    eFaultResume,
+    eFaultRestart,
+    eFaultMetrics
+} FaultMetric_t;
+
+static const char * const pcFaultMetrics[ eFaultMetrics ] =
+{
+    "fault-to-handler",
+    "fault-to-restored",
+    "fault-to-resume",
+    "fault-to-restart"
+};
+
+static uint64_t ullSamples[ eFaultMetrics ][ FAULT_RUNS ];
+/*-----------------------------------------------------------*/
+
+static int prvCompareCycles( const void * pvA,
+                             const void * pvB )
+{
+    uint64_t a = *( const uint64_t * ) pvA;
+    uint64_t b = *( const uint64_t * ) pvB;
+
+    return ( a > b ) - ( a < b );
+}
+/*-----------------------------------------------------------*/
+
+static void prvPrintDistribution( FaultMetric_t xMetric )
+{
+    uint64_t * pullSamples = ullSamples[ xMetric ];
+
+    qsort( pullSamples, FAULT_RUNS, sizeof( uint64_t ), prvCompareCycles );
+
+    log( "%s cycles: min %" PRIu64 " p50 %" PRIu64 " p90 %" PRIu64 " p99 %" PRIu64 " max %" PRIu64 "\n",
+         pcFaultMetrics[ xMetric ],
+         pullSamples[ 0 ],
+         pullSamples[ FAULT_RUNS / 2 ],
+         pullSamples[ ( FAULT_RUNS * 90 ) / 100 ],
+         pullSamples[ ( FAULT_RUNS * 99 ) / 100 ],
+         pullSamples[ FAULT_RUNS - 1 ] );
+}
+/*-----------------------------------------------------------*/
+
+void vFaultRecoveryBench( void * pvParameters )
+{
+    CompartmentFaultTimes_t xTimes;
+    BaseType_t xRestarted = pdTRUE;
+    uint64_t ullFault, ullResume;
+
+    for( int i = 0; i < DISCARD_RUNS + FAULT_RUNS; i++ )
+    {
+        /* externFault samples start_hpms right before the faulting ecall */
+        externFault( pvParameters );
+        ullResume = get_cycle_count();
+
+        /* First call into the compartment once it has been recovered */
+        externFunc( pvParameters );
+
+        if( i < DISCARD_RUNS )
+        {
+            continue;
+        }
+
+        vCompartmentRecoveryLastFault( &xTimes );
+        ullFault = start_hpms.counters[ COUNTER_CYCLE ];
+        xRestarted &= xTimes.xRestarted;
+
+        ullSamples[ eFaultHandler ][ i - DISCARD_RUNS ] = xTimes.ullEntry - ullFault;
+        ullSamples[ eFaultRestored ][ i - DISCARD_RUNS ] = xTimes.ullRestored - ullFault;
+        ullSamples[ eFaultResume ][ i - DISCARD_RUNS ] = ullResume - ullFault;
+        ullSamples[ eFaultRestart ][ i - DISCARD_RUNS ] = end_hpms.counters[ COUNTER_CYCLE ] - ullFault;
+    }
+
+    log( "IPC Performance Results for: compartment fault recovery (%s, %d faults)\n",
+         xRestarted ? "fast restart" : "fault handler", FAULT_RUNS );
+
+    for( int m = 0; m < eFaultMetrics; m++ )
+    {
+        prvPrintDistribution( ( FaultMetric_t ) m );
+    }
+}
+/*-----------------------------------------------------------*/
+
+#endif /* Compartmentalization in objs mode */
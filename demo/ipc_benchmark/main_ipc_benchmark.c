@@ -65,6 +65,10 @@ void queueReceiveTask( void * pvParameters );
 void queueSendTask( void * pvParameters );
 void main_ipc_benchmark( int argc,
                          char ** argv );
+
+#if ( configENABLE_MPU == 1 ) && ( configMPU_REGION_POLICY == 1 )
+    void vMpuRegionSweep( void );
+#endif
 /*-----------------------------------------------------------*/
 
 cheri_riscv_hpms start_hpms;
@@ -225,6 +229,11 @@ void main_ipc_benchmark( int argc,
         }
     }
 
+#if ( configENABLE_MPU == 1 ) && ( configMPU_REGION_POLICY == 1 )
+    /* Emulated-region thrashing as the working set outgrows the PMP */
+    vMpuRegionSweep();
+#endif
+
     log( "Ended main_ipc_benchmark\n" );
     exit( 0 );
 
@@ -0,0 +1,160 @@
+/*-
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Working-set sweep for the emulated MPU region policy (bsp/mpu_regions.c).
+ *
+ * An unprivileged task touches N separate NAPOT regions round-robin, yielding
+ * between rounds so every round starts with a context switch-in. N is swept
+ * past the number of PMP entries the policy owns, so the output shows the
+ * point where the working set stops fitting and the policy starts swapping.
+ */
+
+/* Standard includes. */
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "logging.h"
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "mpu_regions.h"
+
+#if ( configENABLE_MPU == 1 ) && ( configMPU_REGION_POLICY == 1 )
+
+#ifndef MPU_SWEEP_MAX_REGIONS
+    #define MPU_SWEEP_MAX_REGIONS    configMPU_POLICY_REGIONS_PER_TASK
+#endif
+
+#ifndef MPU_SWEEP_ROUNDS
+    #define MPU_SWEEP_ROUNDS         64
+#endif
+
+#define mpusweepREGION_SIZE          64
+
+extern uint64_t get_cycle_count( void );
+
+typedef struct MPU_SWEEP_PARAMS
+{
+    TaskHandle_t xMainTask;
+    UBaseType_t uxRegions;
+    uint64_t ullCycles;
+} MpuSweepParams_t;
+
+static volatile uint8_t ucSweepBuffers[ MPU_SWEEP_MAX_REGIONS ][ mpusweepREGION_SIZE ] __attribute__( ( aligned( mpusweepREGION_SIZE ) ) );
+static MpuSweepParams_t xSweepParams __attribute__( ( aligned( 64 ) ) );
+/*-----------------------------------------------------------*/
+
+static void prvSweepTask( void * pvParameters )
+{
+    MpuSweepParams_t * pxParams = ( MpuSweepParams_t * ) pvParameters;
+    uint64_t ullStart;
+    UBaseType_t uxRound, x;
+
+    for( ; ; )
+    {
+        ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+
+        ullStart = get_cycle_count();
+
+        for( uxRound = 0; uxRound < MPU_SWEEP_ROUNDS; uxRound++ )
+        {
+            for( x = 0; x < pxParams->uxRegions; x++ )
+            {
+                ucSweepBuffers[ x ][ uxRound % mpusweepREGION_SIZE ]++;
+            }
+
+            /* Force a switch-out/in so preloading is exercised */
+            taskYIELD();
+        }
+
+        pxParams->ullCycles = get_cycle_count() - ullStart;
+        xTaskNotifyGive( pxParams->xMainTask );
+    }
+}
+/*-----------------------------------------------------------*/
+
+void vMpuRegionSweep( void )
+{
+    static portSTACK_TYPE xSweepStack[ configMINIMAL_STACK_SIZE * 2U ] __attribute__( ( aligned( configMINIMAL_STACK_SIZE * 2U * sizeof( size_t ) ) ) );
+    static const TaskParameters_t xSweepDefinition =
+    {
+        prvSweepTask,
+        "MPUSweep",
+        configMINIMAL_STACK_SIZE * 2U,
+        &xSweepParams,
+        tskIDLE_PRIORITY + 1,
+        xSweepStack,
+        {
+            /* Base address   Length                  Parameters */
+            { &xSweepParams, sizeof( xSweepParams ), portMPU_REGION_READ_WRITE },
+            { 0,             0,                      0                         },
+            { 0,             0,                      0                         },
+        }
+    };
+    MpuPolicyRegion_t xRegions[ MPU_SWEEP_MAX_REGIONS ];
+    TaskHandle_t xSweepTask = NULL;
+    UBaseType_t uxRegions, x;
+
+    xSweepParams.xMainTask = xTaskGetCurrentTaskHandle();
+
+    if( xTaskCreateRestricted( &xSweepDefinition, &xSweepTask ) != pdPASS )
+    {
+        log( "MPU sweep: failed to create task\n" );
+        return;
+    }
+
+    for( x = 0; x < MPU_SWEEP_MAX_REGIONS; x++ )
+    {
+        xRegions[ x ].pvBase = ( void * ) ucSweepBuffers[ x ];
+        xRegions[ x ].xSize = mpusweepREGION_SIZE;
+        xRegions[ x ].ulFlags = mpuREGION_READ_WRITE;
+    }
+
+    log( "MPU sweep: %d policy slots, %d rounds\n",
+         ( int ) ( configMPU_PMP_ENTRIES - configMPU_POLICY_FIRST_SLOT ), MPU_SWEEP_ROUNDS );
+
+    for( uxRegions = 1; uxRegions <= MPU_SWEEP_MAX_REGIONS; uxRegions++ )
+    {
+        configASSERT( xMpuPolicyRegister( xSweepTask, xRegions, uxRegions ) == pdPASS );
+        vMpuPolicyResetStats();
+
+        xSweepParams.uxRegions = uxRegions;
+        xTaskNotifyGive( xSweepTask );
+        ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+
+        log( "MPU sweep: working set %d regions\n", ( int ) uxRegions );
+        log( "HPM cycles: %" PRIu64 "\n", xSweepParams.ullCycles );
+        vMpuPolicyPrintStats();
+    }
+
+    vMpuPolicyUnregister( xSweepTask );
+    vTaskDelete( xSweepTask );
+}
+/*-----------------------------------------------------------*/
+
+#endif /* ( configENABLE_MPU == 1 ) && ( configMPU_REGION_POLICY == 1 ) */
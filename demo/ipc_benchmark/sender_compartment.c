@@ -60,6 +60,7 @@ void callLocal( void * pvParameters );
 void callFault( void * pvParameters );
 void callSameCompartment( void * pvParameters );
 void callExternalCompartment( void * pvParameters );
+void vFaultRecoveryBench( void * pvParameters );
 
 static void local( void * pvParameters ) {
     end_hpms.counters[COUNTER_INSTRET] = portCounterGet(COUNTER_INSTRET);
@@ -191,6 +192,7 @@ void queueSendTask( void * pvParameters )
     #if (configCHERI_COMPARTMENTALIZATION && configCHERI_COMPARTMENTALIZATION_MODE == 1) || \
         (configMPU_COMPARTMENTALIZATION && configMPU_COMPARTMENTALIZATION_MODE == 1)
         callFault(pvParameters);
+        vFaultRecoveryBench(pvParameters);
     #endif
     callLocal(pvParameters);
     callSameCompartment(pvParameters);
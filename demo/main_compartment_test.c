@@ -52,6 +52,13 @@
 
 void vCompartmentsLoad( void );
 
+#ifdef __CHERI_PURE_CAPABILITY__
+    /* Inter-compartment calls per callee, printed as "COMP_CALLS <name> <count>"
+     * for compartmentalize.py --profile */
+    static uint32_t ulCompCalls[ configCOMPARTMENTS_NUM ];
+    static void prvCompCallsPrint( void );
+#endif
+
 static void vTaskCompartment( void * pvParameters );
 static UBaseType_t cheri_exception_handler();
 static UBaseType_t default_exception_handler( uintptr_t * exception_frame );
@@ -94,6 +101,10 @@ static void vTaskCompartment( void * pvParameters )
 
     vCompartmentsLoad();
 
+    #ifdef __CHERI_PURE_CAPABILITY__
+        prvCompCallsPrint();
+    #endif
+
     _exit( 0 );
 
     while( 1 )
@@ -122,6 +133,11 @@ static void vTaskCompartment( void * pvParameters )
         /* Get the callee CompID (its otype) */
         size_t otype = __builtin_cheri_type_get( *( exception_frame + code_reg_num ) );
 
+        if( otype < configCOMPARTMENTS_NUM )
+        {
+            ulCompCalls[ otype ]++;
+        }
+
         xCOMPARTMENT_RET ret = xTaskRunCompartment( cheri_unseal_cap( *( exception_frame + code_reg_num ) ),
                                                     cheri_unseal_cap( *( exception_frame + data_reg_num ) ),
                                                     exception_frame + 10,
@@ -133,6 +149,18 @@ static void vTaskCompartment( void * pvParameters )
         *( exception_frame + 10 ) = ret.a0;
         *( exception_frame + 11 ) = ret.a1;
     }
+/*-----------------------------------------------------------*/
+
+    static void prvCompCallsPrint( void )
+    {
+        for( size_t i = 0; i < configCOMPARTMENTS_NUM; i++ )
+        {
+            if( ulCompCalls[ i ] != 0 )
+            {
+                printf( "COMP_CALLS %s %" PRIu32 "\n", comp_strtab[ i ], ulCompCalls[ i ] );
+            }
+        }
+    }
 
 #endif /* ifdef __CHERI_PURE_CAPABILITY__ */
 
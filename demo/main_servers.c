@@ -93,6 +93,7 @@
 #include "FreeRTOS_Sockets.h"
 #include "FreeRTOS_TCP_server.h"
 #include "FreeRTOS_DHCP.h"
+#include "NetworkBufferManagement.h"
 
 /* FreeRTOS+FAT includes. */
 #include "ff_headers.h"
@@ -114,8 +115,16 @@
 #include "UDPCommandConsole.h"
 #include "TCPCommandConsole.h"
 #include "UDPSelectServer.h"
+#include "TimerWheelBenchmark.h"
 #include "SimpleTCPEchoServer.h"
 #include "TFTPServer.h"
+#include "dns_resolver.h"
+#include "dns_stub.h"
+#include "ntp_client.h"
+#include "ntp_stub.h"
+#include "telemetry.h"
+#include "pc_profiler.h"
+#include "event_trace.h"
 /*#include "demo_logging.h" */
 
 #ifdef __CHERI_PURE_CAPABILITY__
@@ -138,6 +147,39 @@
 /* Select UDP server task parameters. */
 #define mainUDP_SELECT_SERVER_TASK_PRIORITY           ( tskIDLE_PRIORITY )
 #define mainUDP_SELECT_SERVER_PORT                    ( 30001UL )
+#define mainUDP_PPS_BENCHMARK_PORT                    ( 30101UL )
+#define mainUDP_PPS_BENCHMARK_ECHO_PORT               ( 7UL )
+
+/* UDP ping-pong latency task parameters.  Just below the IP task, so that
+ * other demo tasks do not show up in the round-trip times. */
+#define mainUDP_PING_PONG_TASK_PRIORITY               ( configMAX_PRIORITIES - 3 )
+#define mainUDP_PING_PONG_ECHO_PORT                   ( 7UL )
+
+/* DNS resolver (used by the ping command) and stub responder parameters. */
+#define mainDNS_RESOLVER_TASK_PRIORITY                ( tskIDLE_PRIORITY + 2 )
+#define mainDNS_RESOLVER_STACK_SIZE                   ( configMINIMAL_STACK_SIZE * 2 )
+
+/* NTP client and stub server parameters.  Above the other demo tasks, so that
+ * replies are time stamped as soon as they arrive. */
+#define mainNTP_CLIENT_TASK_PRIORITY                  ( tskIDLE_PRIORITY + 3 )
+#define mainNTP_CLIENT_STACK_SIZE                     ( configMINIMAL_STACK_SIZE * 2 )
+
+/* Timer wheel benchmark parameters.  The wheel's service task runs one above. */
+#define mainTIMER_WHEEL_BENCHMARK_TASK_PRIORITY       ( tskIDLE_PRIORITY + 3 )
+#define mainTIMER_WHEEL_BENCHMARK_STACK_SIZE          ( configMINIMAL_STACK_SIZE * 4 )
+
+/* Binary telemetry parameters, see demo/servers/scripts/telemetry.py. */
+#define mainTELEMETRY_PORT                            ( 5010UL )
+#define mainTELEMETRY_TASK_PRIORITY                   ( tskIDLE_PRIORITY + 1 )
+#define mainTELEMETRY_STACK_SIZE                      ( configMINIMAL_STACK_SIZE * 2 )
+
+/* The PC profiler's drain task, below anything worth profiling. */
+#define mainPC_PROFILER_TASK_PRIORITY                 ( tskIDLE_PRIORITY + 1 )
+#define mainPC_PROFILER_STACK_SIZE                    ( configMINIMAL_STACK_SIZE * 2 )
+
+/* The event trace's drain task, likewise out of the way of what it records. */
+#define mainEVENT_TRACE_TASK_PRIORITY                 ( tskIDLE_PRIORITY + 1 )
+#define mainEVENT_TRACE_STACK_SIZE                    ( configMINIMAL_STACK_SIZE * 2 )
 
 /* Echo client task parameters - used for both TCP and UDP echo clients. */
 #define mainECHO_CLIENT_TASK_STACK_SIZE               ( configMINIMAL_STACK_SIZE * 2 )
@@ -206,6 +248,46 @@
  * mainCREATE_SELECT_UDP_SERVER_TASKS: Uses two tasks to demonstrate the use of the
  * FreeRTOS_select() function.
  *
+ * mainCREATE_UDP_PPS_BENCHMARK:  When set to 1 a task measures how many small
+ * datagrams per second make the round trip to the UDP echo server (port 7) at
+ * configECHO_SERVER_ADDR0 to 3, with one FreeRTOS_sendto()/FreeRTOS_recvfrom()
+ * per datagram and with the batch API (udp_batch.h), prints the results and
+ * exits.
+ *
+ * mainCREATE_UDP_PING_PONG_BENCHMARK:  When set to 1 a task measures UDP round
+ * trip times against the UDP echo server (port 7) at configECHO_SERVER_ADDR0 to
+ * configECHO_SERVER_ADDR3, through FreeRTOS_sendto() and, when built with
+ * --udp-fast-tx, through the direct transmit path, prints the latency
+ * percentiles and exits.  Any UDP echo service on the host will do, for
+ * example "socat UDP4-RECVFROM:7,fork EXEC:cat".
+ *
+ * mainCREATE_TIMER_WHEEL_BENCHMARK:  When set to 1 a task measures the cost of
+ * starting and stopping thousands of timers on the timer wheel (timer_wheel.h)
+ * and as FreeRTOS software timers, then how late thousands of wheel timers
+ * fire, prints the results and exits.
+ *
+ * mainCREATE_TELEMETRY_SERVER:  When set to 1 a task sends binary snapshots of
+ * the task, heap, HPM and IP trace counters (telemetry.h) over UDP to whoever
+ * subscribes on port mainTELEMETRY_PORT, at the interval they ask for, without
+ * formatting any text on the target.  demo/servers/scripts/telemetry.py
+ * subscribes and writes the snapshots out as CSV.
+ *
+ * mainDNS_USE_STUB_RESPONDER:  When set to 1 the DNS resolver's queries are
+ * answered by an in-process stub (dns_stub.h) instead of the DNS server, so
+ * that caching can be tried without a network: "ping echo.stub" resolves to
+ * configECHO_SERVER_ADDR0 to configECHO_SERVER_ADDR3, "ping drop.stub" times
+ * out, any other name does not exist.  "dns-cache" shows the counters.
+ *
+ * mainCREATE_NTP_CLIENT:  When set to 1 the NTP client (ntp_client.h) keeps
+ * the wall clock, and so time() and gettimeofday(), in time with
+ * pool.ntp.org, slewing it rather than stepping it once it is close.
+ * "ntp-stats" shows the clock and the client's counters.
+ *
+ * mainNTP_USE_STUB_RESPONDER:  When set to 1 (with mainCREATE_NTP_CLIENT) the
+ * client's requests are answered by an in-process stub (ntp_stub.h) instead,
+ * whose clock runs configNTP_STUB_DRIFT_PPB fast over a jittery simulated
+ * network, so that the discipline can be watched converging without one.
+ *
  * mainCREATE_UDP_ECHO_TASKS:  When set to 1 a two tasks are created that send
  * UDP echo requests to the standard echo port (port 7).  One task uses the
  * standard socket interface, the other the zero copy socket interface.  The IP
@@ -243,6 +325,27 @@
 #define mainCREATE_TCP_CLI_TASKS                      1
 #define mainCREATE_SIMPLE_UDP_CLIENT_SERVER_TASKS     0
 #define mainCREATE_SELECT_UDP_SERVER_TASKS            0 /* _RB_ Requires retest. */
+#ifndef mainCREATE_UDP_PPS_BENCHMARK
+    #define mainCREATE_UDP_PPS_BENCHMARK              0
+#endif
+#ifndef mainCREATE_UDP_PING_PONG_BENCHMARK
+    #define mainCREATE_UDP_PING_PONG_BENCHMARK        0
+#endif
+#ifndef mainCREATE_TIMER_WHEEL_BENCHMARK
+    #define mainCREATE_TIMER_WHEEL_BENCHMARK          0
+#endif
+#ifndef mainCREATE_TELEMETRY_SERVER
+    #define mainCREATE_TELEMETRY_SERVER               0
+#endif
+#ifndef mainDNS_USE_STUB_RESPONDER
+    #define mainDNS_USE_STUB_RESPONDER                0
+#endif
+#ifndef mainCREATE_NTP_CLIENT
+    #define mainCREATE_NTP_CLIENT                     0
+#endif
+#ifndef mainNTP_USE_STUB_RESPONDER
+    #define mainNTP_USE_STUB_RESPONDER                0
+#endif
 #define mainCREATE_UDP_ECHO_TASKS                     0
 #define mainCREATE_TCP_ECHO_TASKS_SINGLE              0
 #define mainCREATE_TCP_ECHO_TASKS_SEPARATE            0
@@ -432,6 +535,11 @@ int main_servers( void )
     FreeRTOS_debug_printf( ( "FreeRTOS_IPInit\n" ) );
     FreeRTOS_IPInit( ucIPAddress, ucNetMask, ucGatewayAddress, ucDNSServerAddress, ucMACAddress );
 
+    /* Parsed by scripts/tcp_profile_bench.py */
+    FreeRTOS_printf( ( "TCP profile %d: MTU %d, %d network buffers, %d window segments, %d/%d byte RX/TX stream buffers\n",
+                       configTCP_PROFILE, ipconfigNETWORK_MTU, ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS,
+                       ipconfigTCP_WIN_SEG_COUNT, ipconfigTCP_RX_BUFFER_LENGTH, ipconfigTCP_TX_BUFFER_LENGTH ) );
+
     /* A timer is used to periodically check the example tasks are functioning
      * as expected.  First create the software timer ... */
     xCheckTimer = xTimerCreate( "Check",                 /* Text name used for debugging only. */
@@ -624,6 +732,48 @@ void vApplicationIPNetworkEventHook( eIPCallbackEvent_t eNetworkEvent )
             /* See the comments above the definitions of these pre-processor
              * macros at the top of this file for a description of the individual
              * demo tasks. */
+
+            /* Not optional: the CLI's "ping" and "dns-cache" commands are
+             * always registered and both go through the resolver, as does
+             * the NTP client when it is created. */
+            xDNSResolverInit( mainDNS_RESOLVER_STACK_SIZE, mainDNS_RESOLVER_TASK_PRIORITY );
+
+            #if ( configPC_PROFILER == 1 )
+                {
+                    xPcProfilerInit( mainPC_PROFILER_STACK_SIZE, mainPC_PROFILER_TASK_PRIORITY );
+                }
+            #endif
+
+            #if ( configEVENT_TRACE == 1 )
+                {
+                    xEventTraceInit( mainEVENT_TRACE_STACK_SIZE, mainEVENT_TRACE_TASK_PRIORITY );
+                }
+            #endif
+
+            #if ( mainDNS_USE_STUB_RESPONDER == 1 )
+                {
+                    xDNSStubAddRecord( "echo.stub", FreeRTOS_inet_addr_quick( configECHO_SERVER_ADDR0, configECHO_SERVER_ADDR1,
+                                                                              configECHO_SERVER_ADDR2, configECHO_SERVER_ADDR3 ), 60 );
+                    xDNSStubAddRecord( "drop.stub", 0, 0 );
+                    xDNSStubStart( mainDNS_RESOLVER_STACK_SIZE, mainDNS_RESOLVER_TASK_PRIORITY );
+                }
+            #endif /* mainDNS_USE_STUB_RESPONDER */
+
+            #if ( mainCREATE_NTP_CLIENT == 1 )
+                {
+                    static const char * const pcNTPServers[] = { "pool.ntp.org", "time.google.com" };
+
+                    xNTPClientStart( pcNTPServers, sizeof( pcNTPServers ) / sizeof( pcNTPServers[ 0 ] ),
+                                     mainNTP_CLIENT_STACK_SIZE, mainNTP_CLIENT_TASK_PRIORITY );
+
+                    #if ( mainNTP_USE_STUB_RESPONDER == 1 )
+                        {
+                            xNTPStubStart( mainNTP_CLIENT_STACK_SIZE, mainNTP_CLIENT_TASK_PRIORITY );
+                        }
+                    #endif
+                }
+            #endif /* mainCREATE_NTP_CLIENT */
+
             #if ( mainCREATE_SIMPLE_UDP_CLIENT_SERVER_TASKS == 1 )
                 {
                     vStartSimpleUDPClientServerTasks( configMINIMAL_STACK_SIZE, mainSIMPLE_UDP_CLIENT_SERVER_PORT, mainSIMPLE_UDP_CLIENT_SERVER_TASK_PRIORITY );
@@ -636,6 +786,30 @@ void vApplicationIPNetworkEventHook( eIPCallbackEvent_t eNetworkEvent )
                 }
             #endif /* mainCREATE_SIMPLE_UDP_CLIENT_SERVER_TASKS */
 
+            #if ( mainCREATE_UDP_PPS_BENCHMARK == 1 )
+                {
+                    vStartUDPPpsBenchmarkTask( configMINIMAL_STACK_SIZE * 4, mainUDP_PPS_BENCHMARK_PORT, mainUDP_PPS_BENCHMARK_ECHO_PORT, mainUDP_SELECT_SERVER_TASK_PRIORITY + 1 );
+                }
+            #endif /* mainCREATE_UDP_PPS_BENCHMARK */
+
+            #if ( mainCREATE_UDP_PING_PONG_BENCHMARK == 1 )
+                {
+                    vStartUDPPingPongTask( configMINIMAL_STACK_SIZE * 4, mainUDP_PING_PONG_ECHO_PORT, mainUDP_PING_PONG_TASK_PRIORITY );
+                }
+            #endif /* mainCREATE_UDP_PING_PONG_BENCHMARK */
+
+            #if ( mainCREATE_TIMER_WHEEL_BENCHMARK == 1 )
+                {
+                    vStartTimerWheelBenchmarkTask( mainTIMER_WHEEL_BENCHMARK_STACK_SIZE, mainTIMER_WHEEL_BENCHMARK_TASK_PRIORITY );
+                }
+            #endif /* mainCREATE_TIMER_WHEEL_BENCHMARK */
+
+            #if ( mainCREATE_TELEMETRY_SERVER == 1 )
+                {
+                    xTelemetryStart( mainTELEMETRY_PORT, mainTELEMETRY_STACK_SIZE, mainTELEMETRY_TASK_PRIORITY );
+                }
+            #endif /* mainCREATE_TELEMETRY_SERVER */
+
             #if ( mainCREATE_UDP_ECHO_TASKS == 1 )
                 {
                     vStartUDPEchoClientTasks( mainECHO_CLIENT_TASK_STACK_SIZE, mainECHO_CLIENT_TASK_PRIORITY );
@@ -800,6 +974,22 @@ static void prvCheckTimerCallback( TimerHandle_t xTimer )
             }
         }
     #endif
+
+    /* Low water marks for the TCP profile benchmark, printed when they move */
+    {
+        static size_t xLastHeapMinFree = 0;
+        static UBaseType_t uxLastBuffersMinFree = 0;
+        size_t xHeapMinFree = xPortGetMinimumEverFreeHeapSize();
+        UBaseType_t uxBuffersMinFree = uxGetMinimumFreeNetworkBuffers();
+
+        if( ( xHeapMinFree != xLastHeapMinFree ) || ( uxBuffersMinFree != uxLastBuffersMinFree ) )
+        {
+            FreeRTOS_printf( ( "TCP profile %d: heap min free %u, network buffers min free %u\n",
+                               configTCP_PROFILE, ( unsigned ) xHeapMinFree, ( unsigned ) uxBuffersMinFree ) );
+            xLastHeapMinFree = xHeapMinFree;
+            uxLastBuffersMinFree = uxBuffersMinFree;
+        }
+    }
 }
 /*-----------------------------------------------------------*/
 
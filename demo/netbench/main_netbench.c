@@ -0,0 +1,489 @@
+/*-
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Network benchmark target, driven from the host by scripts/netbench.py.
+ *
+ * The firmware only serves; all timing is done by the host, so the numbers do
+ * not depend on the target's notion of time (QEMU's in particular). Services:
+ *  - UDP echo      (NETBENCH_UDP_ECHO_PORT):    RTT
+ *  - TCP echo      (NETBENCH_TCP_ECHO_PORT):    RTT and connection setup rate
+ *  - TCP discard   (NETBENCH_TCP_DISCARD_PORT): bulk upload
+ *  - TCP source    (NETBENCH_TCP_SOURCE_PORT):  bulk download, the client
+ *    sends the byte count as a 32-bit big-endian value first
+ *  - UDP control   (NETBENCH_CONTROL_PORT):     "start" snapshots the HPM
+ *    counters (PortStatCounters_ReadAll) and zeroes the service counters,
+ *    "stop" replies with both, as JSON, for the window since "start". The
+ *    reply is a single datagram: HPM counters that do not fit are left out
+ *    and counted in "hpm_dropped"
+ *
+ * TCP services handle one connection at a time, which is all the driver uses
+ * and keeps the per-test HPM deltas free of unrelated work.
+ */
+
+/* Standard includes. */
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* IP stack includes. */
+#include "FreeRTOS_IP.h"
+#include "FreeRTOS_Sockets.h"
+
+#include "portstatcounters.h"
+#include "rand.h"
+
+#ifndef NETBENCH_UDP_ECHO_PORT
+    #define NETBENCH_UDP_ECHO_PORT       7
+#endif
+
+#ifndef NETBENCH_TCP_ECHO_PORT
+    #define NETBENCH_TCP_ECHO_PORT       7
+#endif
+
+#ifndef NETBENCH_TCP_DISCARD_PORT
+    #define NETBENCH_TCP_DISCARD_PORT    9
+#endif
+
+#ifndef NETBENCH_TCP_SOURCE_PORT
+    #define NETBENCH_TCP_SOURCE_PORT     19
+#endif
+
+#ifndef NETBENCH_CONTROL_PORT
+    #define NETBENCH_CONTROL_PORT        5201
+#endif
+
+#define netbenchSTACK_SIZE            ( configMINIMAL_STACK_SIZE * 4U )
+
+/* Servers run above everything but the IP task, the control task below them
+ * so that a report never preempts a measurement */
+#define netbenchSERVER_PRIORITY       ( configMAX_PRIORITIES - 3 )
+#define netbenchCONTROL_PRIORITY      ( tskIDLE_PRIORITY + 1 )
+
+#define netbenchSHUTDOWN_DELAY        pdMS_TO_TICKS( 5000 )
+#define netbenchCONNECTION_TIMEOUT    pdMS_TO_TICKS( 10000 )
+/* Control replies fit one datagram, the stack does not fragment */
+#define netbenchREPORT_SIZE           ( ipconfigNETWORK_MTU - ipSIZE_OF_IPv4_HEADER - ipSIZE_OF_UDP_HEADER )
+
+/* Kept free for the end of a report: "}, \"hpm_dropped\": <count>}" */
+#define netbenchREPORT_TAIL           32
+/*-----------------------------------------------------------*/
+
+typedef enum
+{
+    eNetbenchEcho = 0,
+    eNetbenchDiscard,
+    eNetbenchSource
+} NetbenchService_t;
+
+/* Service counters, each written by a single task */
+typedef struct NETBENCH_COUNTERS
+{
+    uint32_t ulUDPDatagrams;
+    uint64_t ullUDPBytes;
+    uint32_t ulTCPConnections;
+    uint64_t ullTCPRxBytes;
+    uint64_t ullTCPTxBytes;
+} NetbenchCounters_t;
+
+void main_netbench( void );
+uint32_t ulApplicationGetNextSequenceNumber( uint32_t ulSourceAddress,
+                                             uint16_t usSourcePort,
+                                             uint32_t ulDestinationAddress,
+                                             uint16_t usDestinationPort );
+
+static void prvUDPEchoTask( void * pvParameters );
+static void prvTCPServerTask( void * pvParameters );
+static void prvControlTask( void * pvParameters );
+/*-----------------------------------------------------------*/
+
+static cheri_riscv_hpms xStartHPMs;
+static cheri_riscv_hpms xEndHPMs;
+static NetbenchCounters_t xCounters;
+
+/* Payload buffers for the TCP services, one per task */
+static uint8_t ucTCPBuffers[ 3 ][ ipconfigTCP_MSS ];
+
+/* Network config variables */
+static const uint8_t ucIPAddress[ 4 ] = { configIP_ADDR0, configIP_ADDR1, configIP_ADDR2, configIP_ADDR3 };
+static const uint8_t ucNetMask[ 4 ] = { configNET_MASK0, configNET_MASK1, configNET_MASK2, configNET_MASK3 };
+static const uint8_t ucGatewayAddress[ 4 ] = { configGATEWAY_ADDR0, configGATEWAY_ADDR1, configGATEWAY_ADDR2, configGATEWAY_ADDR3 };
+static const uint8_t ucDNSServerAddress[ 4 ] = { configDNS_SERVER_ADDR0, configDNS_SERVER_ADDR1, configDNS_SERVER_ADDR2, configDNS_SERVER_ADDR3 };
+const uint8_t ucMACAddress[ 6 ] = { configMAC_ADDR0, configMAC_ADDR1, configMAC_ADDR2, configMAC_ADDR3, configMAC_ADDR4, configMAC_ADDR5 };
+/*-----------------------------------------------------------*/
+
+void main_netbench( void )
+{
+    if( FreeRTOS_IPInit( ucIPAddress, ucNetMask, ucGatewayAddress, ucDNSServerAddress, ucMACAddress ) != pdPASS )
+    {
+        FreeRTOS_printf( ( "netbench: failed to initialise the network\n" ) );
+    }
+
+    /* The tasks are created by the network event hook. Returning ends this
+     * task (configTASK_RETURN_ADDRESS) or goes back to the loader. */
+}
+/*-----------------------------------------------------------*/
+
+void vApplicationIPNetworkEventHook( eIPCallbackEvent_t eNetworkEvent )
+{
+    static BaseType_t xTasksAlreadyCreated = pdFALSE;
+    char cBuffer[ 16 ];
+
+    if( ( eNetworkEvent != eNetworkUp ) || ( xTasksAlreadyCreated != pdFALSE ) )
+    {
+        return;
+    }
+
+    xTasksAlreadyCreated = pdTRUE;
+
+    xTaskCreate( prvUDPEchoTask, "nbUDPEcho", netbenchSTACK_SIZE, NULL, netbenchSERVER_PRIORITY, NULL );
+    xTaskCreate( prvTCPServerTask, "nbTCPEcho", netbenchSTACK_SIZE, ( void * ) eNetbenchEcho, netbenchSERVER_PRIORITY, NULL );
+    xTaskCreate( prvTCPServerTask, "nbDiscard", netbenchSTACK_SIZE, ( void * ) eNetbenchDiscard, netbenchSERVER_PRIORITY, NULL );
+    xTaskCreate( prvTCPServerTask, "nbSource", netbenchSTACK_SIZE, ( void * ) eNetbenchSource, netbenchSERVER_PRIORITY, NULL );
+    xTaskCreate( prvControlTask, "nbControl", netbenchSTACK_SIZE, NULL, netbenchCONTROL_PRIORITY, NULL );
+
+    FreeRTOS_inet_ntoa( FreeRTOS_GetIPAddress(), cBuffer );
+    FreeRTOS_printf( ( "netbench: ready on %s, udp echo %u, tcp echo %u, discard %u, source %u, control %u\n",
+                       cBuffer, NETBENCH_UDP_ECHO_PORT, NETBENCH_TCP_ECHO_PORT, NETBENCH_TCP_DISCARD_PORT,
+                       NETBENCH_TCP_SOURCE_PORT, NETBENCH_CONTROL_PORT ) );
+}
+/*-----------------------------------------------------------*/
+
+static Socket_t prvBoundUDPSocket( uint16_t usPort )
+{
+    struct freertos_sockaddr xBindAddress;
+    Socket_t xSocket;
+
+    xSocket = FreeRTOS_socket( FREERTOS_AF_INET, FREERTOS_SOCK_DGRAM, FREERTOS_IPPROTO_UDP );
+    configASSERT( xSocket != FREERTOS_INVALID_SOCKET );
+
+    xBindAddress.sin_addr = 0;
+    xBindAddress.sin_port = FreeRTOS_htons( usPort );
+    FreeRTOS_bind( xSocket, &xBindAddress, sizeof( xBindAddress ) );
+
+    return xSocket;
+}
+/*-----------------------------------------------------------*/
+
+static void prvUDPEchoTask( void * pvParameters )
+{
+    Socket_t xSocket = prvBoundUDPSocket( NETBENCH_UDP_ECHO_PORT );
+    struct freertos_sockaddr xClient;
+    uint32_t ulClientLength = sizeof( xClient );
+    uint8_t * pucPayload;
+    int32_t lBytes;
+
+    ( void ) pvParameters;
+
+    for( ; ; )
+    {
+        /* Zero-copy both ways: the received buffer is sent straight back */
+        lBytes = FreeRTOS_recvfrom( xSocket, &pucPayload, 0, FREERTOS_ZERO_COPY, &xClient, &ulClientLength );
+
+        if( lBytes <= 0 )
+        {
+            continue;
+        }
+
+        xCounters.ulUDPDatagrams++;
+        xCounters.ullUDPBytes += ( uint64_t ) lBytes;
+
+        if( FreeRTOS_sendto( xSocket, pucPayload, ( size_t ) lBytes, FREERTOS_ZERO_COPY, &xClient, sizeof( xClient ) ) == 0 )
+        {
+            FreeRTOS_ReleaseUDPPayloadBuffer( pucPayload );
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvSendAll( Socket_t xSocket,
+                              const uint8_t * pucData,
+                              size_t uxLength )
+{
+    size_t uxSent = 0;
+
+    while( uxSent < uxLength )
+    {
+        BaseType_t xSent = FreeRTOS_send( xSocket, &pucData[ uxSent ], uxLength - uxSent, 0 );
+
+        if( xSent < 0 )
+        {
+            return pdFALSE;
+        }
+
+        uxSent += ( size_t ) xSent;
+    }
+
+    xCounters.ullTCPTxBytes += uxLength;
+
+    return pdTRUE;
+}
+/*-----------------------------------------------------------*/
+
+static void prvServeConnection( Socket_t xConnected,
+                                NetbenchService_t eService,
+                                uint8_t * pucBuffer )
+{
+    BaseType_t xBytes;
+
+    if( eService == eNetbenchSource )
+    {
+        uint32_t ulRemaining = 0;
+        size_t uxHave = 0;
+
+        /* The byte count comes first */
+        while( uxHave < sizeof( ulRemaining ) )
+        {
+            xBytes = FreeRTOS_recv( xConnected, &pucBuffer[ uxHave ], sizeof( ulRemaining ) - uxHave, 0 );
+
+            if( xBytes <= 0 )
+            {
+                return;
+            }
+
+            uxHave += ( size_t ) xBytes;
+        }
+
+        xCounters.ullTCPRxBytes += sizeof( ulRemaining );
+        ulRemaining = ( ( uint32_t ) pucBuffer[ 0 ] << 24 ) | ( ( uint32_t ) pucBuffer[ 1 ] << 16 ) |
+                      ( ( uint32_t ) pucBuffer[ 2 ] << 8 ) | pucBuffer[ 3 ];
+
+        memset( pucBuffer, 0xa5, ipconfigTCP_MSS );
+
+        while( ulRemaining > 0 )
+        {
+            size_t uxChunk = ( ulRemaining < ipconfigTCP_MSS ) ? ulRemaining : ipconfigTCP_MSS;
+
+            if( prvSendAll( xConnected, pucBuffer, uxChunk ) == pdFALSE )
+            {
+                return;
+            }
+
+            ulRemaining -= uxChunk;
+        }
+
+        return;
+    }
+
+    for( ; ; )
+    {
+        xBytes = FreeRTOS_recv( xConnected, pucBuffer, ipconfigTCP_MSS, 0 );
+
+        if( xBytes <= 0 )
+        {
+            /* Closed by the peer, or idle for netbenchCONNECTION_TIMEOUT */
+            return;
+        }
+
+        xCounters.ullTCPRxBytes += ( uint64_t ) xBytes;
+
+        if( ( eService == eNetbenchEcho ) && ( prvSendAll( xConnected, pucBuffer, ( size_t ) xBytes ) == pdFALSE ) )
+        {
+            return;
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void prvTCPServerTask( void * pvParameters )
+{
+    NetbenchService_t eService = ( NetbenchService_t ) ( uintptr_t ) pvParameters;
+    static const uint16_t usPorts[] = { NETBENCH_TCP_ECHO_PORT, NETBENCH_TCP_DISCARD_PORT, NETBENCH_TCP_SOURCE_PORT };
+    const TickType_t xAcceptTimeout = portMAX_DELAY;
+    const TickType_t xTimeout = netbenchCONNECTION_TIMEOUT;
+    const BaseType_t xBacklog = 8;
+    struct freertos_sockaddr xClient, xBindAddress;
+    socklen_t xSize = sizeof( xClient );
+    Socket_t xListening, xConnected;
+    uint8_t * pucBuffer = ucTCPBuffers[ eService ];
+    TickType_t xTimeOnShutdown;
+
+    xListening = FreeRTOS_socket( FREERTOS_AF_INET, FREERTOS_SOCK_STREAM, FREERTOS_IPPROTO_TCP );
+    configASSERT( xListening != FREERTOS_INVALID_SOCKET );
+
+    FreeRTOS_setsockopt( xListening, 0, FREERTOS_SO_RCVTIMEO, &xAcceptTimeout, sizeof( xAcceptTimeout ) );
+
+    xBindAddress.sin_addr = 0;
+    xBindAddress.sin_port = FreeRTOS_htons( usPorts[ eService ] );
+    FreeRTOS_bind( xListening, &xBindAddress, sizeof( xBindAddress ) );
+    FreeRTOS_listen( xListening, xBacklog );
+
+    for( ; ; )
+    {
+        xConnected = FreeRTOS_accept( xListening, &xClient, &xSize );
+
+        if( ( xConnected == NULL ) || ( xConnected == FREERTOS_INVALID_SOCKET ) )
+        {
+            continue;
+        }
+
+        xCounters.ulTCPConnections++;
+
+        FreeRTOS_setsockopt( xConnected, 0, FREERTOS_SO_RCVTIMEO, &xTimeout, sizeof( xTimeout ) );
+        FreeRTOS_setsockopt( xConnected, 0, FREERTOS_SO_SNDTIMEO, &xTimeout, sizeof( xTimeout ) );
+
+        prvServeConnection( xConnected, eService, pucBuffer );
+
+        /* Graceful close: wait for the peer's FIN, so that the client sees
+         * every byte of a source transfer */
+        FreeRTOS_shutdown( xConnected, FREERTOS_SHUT_RDWR );
+        xTimeOnShutdown = xTaskGetTickCount();
+
+        while( ( FreeRTOS_recv( xConnected, pucBuffer, ipconfigTCP_MSS, 0 ) >= 0 ) &&
+               ( ( xTaskGetTickCount() - xTimeOnShutdown ) < netbenchSHUTDOWN_DELAY ) )
+        {
+        }
+
+        FreeRTOS_closesocket( xConnected );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static size_t prvReport( char * pcReport,
+                         size_t uxSize )
+{
+    char cEntry[ 96 ];
+    uint32_t ulDropped = 0;
+    size_t uxLength, uxFirst;
+    int lEntry;
+
+    PortStatCounters_DiffAll( &xStartHPMs, &xEndHPMs, &xEndHPMs );
+
+    uxLength = ( size_t ) snprintf( pcReport, uxSize,
+                                    "{\"udp_datagrams\": %" PRIu32 ", \"udp_bytes\": %" PRIu64 ", "
+                                    "\"tcp_connections\": %" PRIu32 ", \"tcp_rx_bytes\": %" PRIu64 ", "
+                                    "\"tcp_tx_bytes\": %" PRIu64 ", \"free_heap\": %u, \"hpm\": {",
+                                    xCounters.ulUDPDatagrams, xCounters.ullUDPBytes,
+                                    xCounters.ulTCPConnections, xCounters.ullTCPRxBytes,
+                                    xCounters.ullTCPTxBytes, ( unsigned ) xPortGetFreeHeapSize() );
+
+    configASSERT( uxLength + netbenchREPORT_TAIL < uxSize );
+    uxFirst = uxLength;
+
+    /* Whole counters only, as many as fit */
+    for( int i = 0; i < COUNTERS_NUM; i++ )
+    {
+        lEntry = snprintf( cEntry, sizeof( cEntry ), "%s\"%s\": %" PRIu64,
+                           ( uxLength == uxFirst ) ? "" : ", ", hpm_names[ i ], xEndHPMs.counters[ i ] );
+
+        if( ( lEntry < 0 ) || ( ( size_t ) lEntry >= sizeof( cEntry ) ) ||
+            ( uxLength + ( size_t ) lEntry + netbenchREPORT_TAIL >= uxSize ) )
+        {
+            ulDropped++;
+            continue;
+        }
+
+        memcpy( &pcReport[ uxLength ], cEntry, ( size_t ) lEntry );
+        uxLength += ( size_t ) lEntry;
+    }
+
+    uxLength += ( size_t ) snprintf( &pcReport[ uxLength ], uxSize - uxLength,
+                                     "}, \"hpm_dropped\": %" PRIu32 "}", ulDropped );
+
+    return uxLength;
+}
+/*-----------------------------------------------------------*/
+
+static void prvControlTask( void * pvParameters )
+{
+    static char cReport[ netbenchREPORT_SIZE ];
+    Socket_t xSocket = prvBoundUDPSocket( NETBENCH_CONTROL_PORT );
+    struct freertos_sockaddr xClient;
+    uint32_t ulClientLength = sizeof( xClient );
+    char cCommand[ 16 ];
+    int32_t lBytes;
+    size_t uxLength;
+
+    ( void ) pvParameters;
+
+    for( ; ; )
+    {
+        lBytes = FreeRTOS_recvfrom( xSocket, cCommand, sizeof( cCommand ) - 1, 0, &xClient, &ulClientLength );
+
+        if( lBytes <= 0 )
+        {
+            continue;
+        }
+
+        cCommand[ lBytes ] = '\0';
+
+        if( strncmp( cCommand, "start", strlen( "start" ) ) == 0 )
+        {
+            memset( &xCounters, 0, sizeof( xCounters ) );
+            PortStatCounters_ReadAll( &xStartHPMs );
+            uxLength = ( size_t ) snprintf( cReport, sizeof( cReport ), "{\"started\": true}" );
+        }
+        else if( strncmp( cCommand, "stop", strlen( "stop" ) ) == 0 )
+        {
+            PortStatCounters_ReadAll( &xEndHPMs );
+            uxLength = prvReport( cReport, sizeof( cReport ) );
+        }
+        else
+        {
+            uxLength = ( size_t ) snprintf( cReport, sizeof( cReport ),
+                                            "{\"demo\": \"netbench\", \"mtu\": %u, \"mss\": %u, \"tcp_profile\": %d}",
+                                            ( unsigned ) ipconfigNETWORK_MTU, ( unsigned ) ipconfigTCP_MSS, configTCP_PROFILE );
+        }
+
+        if( FreeRTOS_sendto( xSocket, cReport, uxLength, 0, &xClient, sizeof( xClient ) ) == 0 )
+        {
+            FreeRTOS_printf( ( "netbench: failed to send a %u byte control reply\n", ( unsigned ) uxLength ) );
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Callback that provides the inputs necessary to generate a randomized TCP
+ * Initial Sequence Number per RFC 6528.  THIS IS ONLY A DUMMY IMPLEMENTATION
+ * THAT RETURNS A PSEUDO RANDOM NUMBER SO IS NOT INTENDED FOR USE IN PRODUCTION
+ * SYSTEMS.
+ */
+uint32_t ulApplicationGetNextSequenceNumber( uint32_t ulSourceAddress,
+                                             uint16_t usSourcePort,
+                                             uint32_t ulDestinationAddress,
+                                             uint16_t usDestinationPort )
+{
+    ( void ) ulSourceAddress;
+    ( void ) usSourcePort;
+    ( void ) ulDestinationAddress;
+    ( void ) usDestinationPort;
+
+    return uxRand();
+}
+/*-----------------------------------------------------------*/
+
+/* Called automatically when a reply to an outgoing ping is received. */
+void vApplicationPingReplyHook( ePingReplyStatus_t eStatus,
+                                uint16_t usIdentifier )
+{
+    ( void ) eStatus;
+    ( void ) usIdentifier;
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,245 @@
+#!/usr/bin/python3
+
+#-
+# SPDX-License-Identifier: BSD-2-Clause
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+# ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+# FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+# DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+# OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+# HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+# OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+# SUCH DAMAGE.
+#
+
+# Host side of the netbench demo (demo/netbench): RTT percentiles, TCP
+# connection setup rate and bulk throughput, as one JSON document.
+#
+# With a TAP peer (qemu_tap.sh), talk to the target address directly:
+#
+#   ./netbench.py --server 10.88.88.2 --out netbench.json
+#
+# With QEMU user-mode networking the services have to be forwarded; print the
+# -netdev argument for a given host port base, then run against localhost:
+#
+#   ./netbench.py --hostfwd 20000
+#   qemu-system-riscv64 ... -netdev user,id=net0,hostfwd=...
+#   ./netbench.py --server 127.0.0.1 --port-base 20000
+#
+# Every test is bracketed by "start"/"stop" on the control port, and the
+# target's service counters and HPM deltas for the test are merged into its
+# result under "target".
+
+import argparse
+import json
+import os
+import socket
+import statistics
+import struct
+import sys
+import time
+
+parser = argparse.ArgumentParser(description='Network latency/throughput benchmark for the netbench demo.')
+parser.add_argument("--server", help="Target IP address", default='127.0.0.1')
+parser.add_argument("--port-base", help="Added to every port (user-mode networking hostfwd)", type=int, default=0)
+parser.add_argument("--udp-echo-port", help="UDP echo port in the target", type=int, default=7)
+parser.add_argument("--tcp-echo-port", help="TCP echo port in the target", type=int, default=7)
+parser.add_argument("--discard-port", help="TCP discard port in the target", type=int, default=9)
+parser.add_argument("--source-port", help="TCP source port in the target", type=int, default=19)
+parser.add_argument("--control-port", help="UDP control port in the target", type=int, default=5201)
+parser.add_argument("--sizes", help="Comma separated RTT message sizes in bytes, capped at the "
+                    "target's MTU less IP and UDP headers for UDP", default='16,64,256,1024,1172')
+parser.add_argument("--bulk-sizes", help="Comma separated bulk transfer sizes in bytes",
+                    default='65536,1048576,4194304')
+parser.add_argument("--rounds", help="Timed round trips per message size", type=int, default=1000)
+parser.add_argument("--warmup", help="Untimed round trips per message size", type=int, default=20)
+parser.add_argument("--connections", help="Connections for the setup rate test", type=int, default=200)
+parser.add_argument("--timeout", help="Socket timeout in seconds", type=float, default=5.0)
+parser.add_argument("--skip", help="Comma separated tests to skip (udp_rtt,tcp_rtt,connect,upload,download)",
+                    default='')
+parser.add_argument("--out", help="Write the JSON here instead of stdout")
+parser.add_argument("--hostfwd", help="Print the QEMU user-mode -netdev for this host port base and exit",
+                    type=int, metavar='BASE')
+
+args = parser.parse_args()
+
+
+def port(p):
+    return args.port_base + p
+
+
+def hostfwd(base):
+    fwd = [('udp', args.udp_echo_port), ('tcp', args.tcp_echo_port), ('tcp', args.discard_port),
+           ('tcp', args.source_port), ('udp', args.control_port)]
+    return 'user,id=net0,' + ','.join('hostfwd=%s::%d-:%d' % (proto, base + p, p) for proto, p in fwd)
+
+
+def control(command):
+    with socket.socket(socket.AF_INET, socket.SOCK_DGRAM) as s:
+        s.settimeout(args.timeout)
+        s.sendto(command.encode(), (args.server, port(args.control_port)))
+        data, _ = s.recvfrom(4096)
+    try:
+        return json.loads(data.decode(errors='replace'))
+    except ValueError:
+        return {'invalid_report': data.decode(errors='replace')}
+
+
+def bracketed(test):
+    # Results of a single test, plus what the target counted meanwhile
+    control('start')
+    result = test()
+    result['target'] = control('stop')
+    return result
+
+
+def percentiles(samples):
+    samples = sorted(samples)
+    pick = lambda q: samples[min(len(samples) - 1, int(q * len(samples)))]
+    return {'samples': len(samples),
+            'min_us': round(samples[0] * 1e6, 1),
+            'p50_us': round(pick(0.50) * 1e6, 1),
+            'p90_us': round(pick(0.90) * 1e6, 1),
+            'p99_us': round(pick(0.99) * 1e6, 1),
+            'max_us': round(samples[-1] * 1e6, 1),
+            'mean_us': round(statistics.mean(samples) * 1e6, 1)}
+
+
+def udp_rtt(size):
+    payload = os.urandom(size)
+    samples = []
+    lost = 0
+    with socket.socket(socket.AF_INET, socket.SOCK_DGRAM) as s:
+        s.settimeout(args.timeout)
+        s.connect((args.server, port(args.udp_echo_port)))
+        for i in range(args.warmup + args.rounds):
+            start = time.perf_counter()
+            s.send(payload)
+            try:
+                while s.recv(size + 1) != payload:
+                    # A late echo of an earlier round
+                    pass
+            except socket.timeout:
+                lost += 1
+                continue
+            if i >= args.warmup:
+                samples.append(time.perf_counter() - start)
+    if not samples:
+        raise RuntimeError('no UDP echo from %s' % args.server)
+    result = percentiles(samples)
+    result.update(size=size, lost=lost)
+    return result
+
+
+def recv_exactly(s, size):
+    got = bytearray()
+    while len(got) < size:
+        chunk = s.recv(min(size - len(got), 65536))
+        if not chunk:
+            raise RuntimeError('connection closed after %d of %d bytes' % (len(got), size))
+        got += chunk
+    return bytes(got)
+
+
+def tcp_rtt(size):
+    payload = os.urandom(size)
+    samples = []
+    with socket.create_connection((args.server, port(args.tcp_echo_port)), args.timeout) as s:
+        s.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        for i in range(args.warmup + args.rounds):
+            start = time.perf_counter()
+            s.sendall(payload)
+            if recv_exactly(s, size) != payload:
+                raise RuntimeError('TCP echo mismatch at size %d' % size)
+            if i >= args.warmup:
+                samples.append(time.perf_counter() - start)
+    result = percentiles(samples)
+    result['size'] = size
+    return result
+
+
+def connect_rate():
+    samples = []
+    start = time.perf_counter()
+    for _ in range(args.connections):
+        t = time.perf_counter()
+        with socket.create_connection((args.server, port(args.tcp_echo_port)), args.timeout) as s:
+            samples.append(time.perf_counter() - t)
+            # One byte round trip: the target has accepted, not just the backlog
+            s.sendall(b'x')
+            recv_exactly(s, 1)
+    elapsed = time.perf_counter() - start
+    result = percentiles(samples)
+    result['connections_per_s'] = round(args.connections / elapsed, 1)
+    return result
+
+
+def upload(size):
+    data = os.urandom(size)
+    with socket.create_connection((args.server, port(args.discard_port)), args.timeout) as s:
+        start = time.perf_counter()
+        s.sendall(data)
+        s.shutdown(socket.SHUT_WR)
+        # The target closes once it has read everything
+        while s.recv(65536):
+            pass
+        elapsed = time.perf_counter() - start
+    return {'size': size, 'seconds': round(elapsed, 4), 'kib_s': round(size / 1024 / elapsed, 2)}
+
+
+def download(size):
+    with socket.create_connection((args.server, port(args.source_port)), args.timeout) as s:
+        start = time.perf_counter()
+        s.sendall(struct.pack('>I', size))
+        recv_exactly(s, size)
+        elapsed = time.perf_counter() - start
+    return {'size': size, 'seconds': round(elapsed, 4), 'kib_s': round(size / 1024 / elapsed, 2)}
+
+
+if args.hostfwd is not None:
+    print(hostfwd(args.hostfwd))
+    sys.exit(0)
+
+skip = set(t for t in args.skip.split(',') if t)
+sizes = [int(s) for s in args.sizes.split(',')]
+bulk_sizes = [int(s) for s in args.bulk_sizes.split(',')]
+
+report = {'server': args.server, 'port_base': args.port_base, 'config': control('info')}
+
+# The target does not reassemble fragments, a UDP echo has to fit one frame
+udp_limit = report['config'].get('mtu', 1200) - 28
+udp_sizes = sorted(set(min(size, udp_limit) for size in sizes))
+if udp_sizes != sizes:
+    print('UDP RTT sizes capped at %d bytes: %s' % (udp_limit, ','.join(str(s) for s in udp_sizes)),
+          file=sys.stderr)
+
+if 'udp_rtt' not in skip:
+    report['udp_rtt'] = [bracketed(lambda: udp_rtt(size)) for size in udp_sizes]
+if 'tcp_rtt' not in skip:
+    report['tcp_rtt'] = [bracketed(lambda: tcp_rtt(size)) for size in sizes]
+if 'connect' not in skip:
+    report['connect'] = bracketed(connect_rate)
+if 'upload' not in skip:
+    report['upload'] = [bracketed(lambda: upload(size)) for size in bulk_sizes]
+if 'download' not in skip:
+    report['download'] = [bracketed(lambda: download(size)) for size in bulk_sizes]
+
+text = json.dumps(report, indent=2)
+if args.out:
+    with open(args.out, 'w') as f:
+        f.write(text + '\n')
+else:
+    print(text)
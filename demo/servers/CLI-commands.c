@@ -86,6 +86,9 @@
 #include "FreeRTOS_IP.h"
 #include "FreeRTOS_Sockets.h"
 
+/* FreeRTOS+FAT includes, for the profiler's and the event trace's file output. */
+#include "ff_stdio.h"
+
 #ifdef ipconfigUSE_FAT_LIBDL
 /* FreeRTOS-libdl includes to dynamically load and link objects */
     #include <dlfcn.h>
@@ -101,6 +104,13 @@
 #endif
 
 #include "portstatcounters.h"
+#include "dns_resolver.h"
+#include "clock.h"
+#include "ntp_client.h"
+#include "periodic_task.h"
+#include "tickless_idle.h"
+#include "pc_profiler.h"
+#include "event_trace.h"
 
 /*
  * Implements the run-time-stats command.
@@ -158,6 +168,53 @@ static BaseType_t prvNetStatCommand( char * pcWriteBuffer,
                                      size_t xWriteBufferLen,
                                      const char * pcCommandString );
 
+/*
+ * Shows the DNS resolver's counters, "dns-cache flush" empties its cache.
+ */
+static BaseType_t prvDNSCacheCommand( char * pcWriteBuffer,
+                                      size_t xWriteBufferLen,
+                                      const char * pcCommandString );
+
+/*
+ * Shows the wall clock and the NTP client's counters, "ntp-stats poll" asks
+ * for a burst of requests right away.
+ */
+static BaseType_t prvNTPStatsCommand( char * pcWriteBuffer,
+                                      size_t xWriteBufferLen,
+                                      const char * pcCommandString );
+
+/*
+ * Shows the timing of each periodic task, one per call, "periodic-stats reset"
+ * clears it.
+ */
+static BaseType_t prvPeriodicStatsCommand( char * pcWriteBuffer,
+                                           size_t xWriteBufferLen,
+                                           const char * pcCommandString );
+
+/*
+ * Shows how long the hart slept in tickless idle and how late it woke,
+ * "idle-stats reset" clears it.
+ */
+static BaseType_t prvIdleStatsCommand( char * pcWriteBuffer,
+                                       size_t xWriteBufferLen,
+                                       const char * pcCommandString );
+
+/*
+ * Starts the PC profiler writing to a file or sending to a UDP port, stops
+ * it, or shows its counters.
+ */
+static BaseType_t prvProfileCommand( char * pcWriteBuffer,
+                                     size_t xWriteBufferLen,
+                                     const char * pcCommandString );
+
+/*
+ * Starts the kernel event trace writing to a file or sending to a UDP port,
+ * with optional trigger and stop conditions, stops it, or shows its counters.
+ */
+static BaseType_t prvEventTraceCommand( char * pcWriteBuffer,
+                                        size_t xWriteBufferLen,
+                                        const char * pcCommandString );
+
 /*
  * Defines a command that sends a shutdown signal to the underlying platform.
  */
@@ -224,6 +281,63 @@ static const CLI_Command_Definition_t xIPConfig =
     0
 };
 
+/* Structure that defines the "dns-cache" command line command. */
+static const CLI_Command_Definition_t xDNSCache =
+{
+    "dns-cache",
+    "dns-cache <optional:flush>:\r\n Shows the DNS resolver cache counters, or empties the cache\r\n\r\n",
+    prvDNSCacheCommand,
+    -1
+};
+
+/* Structure that defines the "ntp-stats" command line command. */
+static const CLI_Command_Definition_t xNTPStats =
+{
+    "ntp-stats",
+    "ntp-stats <optional:poll>:\r\n Shows the clock discipline and NTP client counters, or polls the server now\r\n\r\n",
+    prvNTPStatsCommand,
+    -1
+};
+
+/* Structure that defines the "periodic-stats" command line command. */
+static const CLI_Command_Definition_t xPeriodicStats =
+{
+    "periodic-stats",
+    "periodic-stats <optional:reset>:\r\n Shows release jitter, execution time and deadline misses of the periodic tasks, or clears them\r\n\r\n",
+    prvPeriodicStatsCommand,
+    -1
+};
+
+/* Structure that defines the "idle-stats" command line command. */
+static const CLI_Command_Definition_t xIdleStats =
+{
+    "idle-stats",
+    "idle-stats <optional:reset>:\r\n Shows the ticks suppressed in tickless idle, time asleep and wakeup latency, or clears them\r\n\r\n",
+    prvIdleStatsCommand,
+    -1
+};
+
+/* Structure that defines the "profile" command line command. */
+static const CLI_Command_Definition_t xProfile =
+{
+    "profile",
+    "profile <optional:file <path> | udp <ip> <port> | stop>:\r\n Samples the pc on every tick into a file or to the host for scripts/pcprof.py, stops, or shows the counters\r\n\r\n",
+    prvProfileCommand,
+    -1
+};
+
+/* Structure that defines the "event-trace" command line command. */
+static const CLI_Command_Definition_t xEventTrace =
+{
+    "event-trace",
+    "event-trace <optional:file <path> | udp <ip> <port> | stop> <optional:trigger|stop-on <event>, pre|stop-after <records>, only <event,...>>:\r\n"
+    " Records kernel events into a file or to the host for scripts/etrace2perfetto.py, stops, or shows the counters. Events are switch, ready,"
+    " delay, delay-until, create, delete, inherit, disinherit, send, send-isr, receive, receive-isr, block-send, block-receive, irq, irq-exit,"
+    " tick and marker\r\n\r\n",
+    prvEventTraceCommand,
+    -1
+};
+
 #if configINCLUDE_DEMO_DEBUG_STATS != 0
     /* Structure that defines the "ip-debug-stats" command line command. */
     static const CLI_Command_Definition_t xIPDebugStats =
@@ -406,6 +520,12 @@ void vRegisterCLICommands( void )
         FreeRTOS_CLIRegisterCommand( &xParameterEcho );
         FreeRTOS_CLIRegisterCommand( &xIPDebugStats );
         FreeRTOS_CLIRegisterCommand( &xIPConfig );
+        FreeRTOS_CLIRegisterCommand( &xDNSCache );
+        FreeRTOS_CLIRegisterCommand( &xNTPStats );
+        FreeRTOS_CLIRegisterCommand( &xPeriodicStats );
+        FreeRTOS_CLIRegisterCommand( &xIdleStats );
+        FreeRTOS_CLIRegisterCommand( &xProfile );
+        FreeRTOS_CLIRegisterCommand( &xEventTrace );
 
         #if ipconfigSUPPORT_OUTGOING_PINGS == 1
             {
@@ -714,8 +834,8 @@ static BaseType_t prvParameterEchoCommand( char * pcWriteBuffer,
             /* Terminate the host name. */
             pcParameter[ lParameterStringLength ] = 0x00;
 
-            /* Attempt to resolve host. */
-            ulIPAddress = FreeRTOS_gethostbyname( pcParameter );
+            /* Attempt to resolve host, through the resolver's cache. */
+            ulIPAddress = ulDNSResolverGetHostByName( pcParameter, pdMS_TO_TICKS( 5000 ) );
         }
 
         /* Convert IP address, which may have come from a DNS lookup, to string. */
@@ -784,6 +904,490 @@ static BaseType_t prvParameterEchoCommand( char * pcWriteBuffer,
 
 #endif /* configINCLUDE_DEMO_DEBUG_STATS */
 
+static BaseType_t prvDNSCacheCommand( char * pcWriteBuffer,
+                                      size_t xWriteBufferLen,
+                                      const char * pcCommandString )
+{
+    DNSResolverStats_t xStats;
+    BaseType_t lParameterStringLength;
+    const char * pcParameter;
+
+    pcParameter = FreeRTOS_CLIGetParameter( pcCommandString, 1, &lParameterStringLength );
+
+    if( ( pcParameter != NULL ) && ( strncmp( pcParameter, "flush", strlen( "flush" ) ) == 0 ) )
+    {
+        vDNSResolverFlush();
+        snprintf( pcWriteBuffer, xWriteBufferLen, "DNS cache flushed\r\n" );
+        return pdFALSE;
+    }
+
+    vDNSResolverGetStats( &xStats );
+    snprintf( pcWriteBuffer, xWriteBufferLen,
+              "hits %u, negative hits %u, misses %u (%u joined a query), queries %u, "
+              "answers %u, name errors %u, timeouts %u\r\n",
+              ( unsigned ) xStats.ulHits, ( unsigned ) xStats.ulNegativeHits, ( unsigned ) xStats.ulMisses,
+              ( unsigned ) xStats.ulCoalesced, ( unsigned ) xStats.ulQueries, ( unsigned ) xStats.ulAnswers,
+              ( unsigned ) xStats.ulNameErrors, ( unsigned ) xStats.ulTimeouts );
+
+    return pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvNTPStatsCommand( char * pcWriteBuffer,
+                                      size_t xWriteBufferLen,
+                                      const char * pcCommandString )
+{
+    ClockStats_t xClock;
+    NTPClientStats_t xClient;
+    BaseType_t lParameterStringLength;
+    const char * pcParameter;
+    uint32_t ulSeconds, ulNanoseconds;
+
+    pcParameter = FreeRTOS_CLIGetParameter( pcCommandString, 1, &lParameterStringLength );
+
+    if( ( pcParameter != NULL ) && ( strncmp( pcParameter, "poll", strlen( "poll" ) ) == 0 ) )
+    {
+        vNTPClientPoll();
+        snprintf( pcWriteBuffer, xWriteBufferLen, "NTP burst requested\r\n" );
+        return pdFALSE;
+    }
+
+    ulSeconds = ulClockRealtime( &ulNanoseconds );
+    vClockGetStats( &xClock );
+    vNTPClientGetStats( &xClient );
+
+    snprintf( pcWriteBuffer, xWriteBufferLen,
+              "time %u.%09u (%s), offset %ld ns, delay %lu ns, freq %ld ppb, slewing %ld ns, "
+              "updates %u (%u steps)\r\nrequests %u, replies %u, rejected %u, unexpected %u, "
+              "timeouts %u, discarded %u, bursts %u (%u empty), min delay %lu ns\r\n",
+              ( unsigned ) ulSeconds, ( unsigned ) ulNanoseconds,
+              ( xClockIsSynchronised() != pdFALSE ) ? "synchronised" : "free running",
+              ( long ) xClock.llLastOffsetNs, ( unsigned long ) xClock.ullLastDelayNs, ( long ) xClock.llFreqPpb,
+              ( long ) xClock.llSlewNs, ( unsigned ) xClock.ulUpdates, ( unsigned ) xClock.ulSteps,
+              ( unsigned ) xClient.ulRequests, ( unsigned ) xClient.ulReplies, ( unsigned ) xClient.ulRejected,
+              ( unsigned ) xClient.ulUnexpected, ( unsigned ) xClient.ulTimeouts, ( unsigned ) xClient.ulDiscarded,
+              ( unsigned ) xClient.ulBursts, ( unsigned ) xClient.ulEmptyBursts, ( unsigned long ) xClient.ullMinDelayNs );
+
+    return pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvPeriodicStatsCommand( char * pcWriteBuffer,
+                                           size_t xWriteBufferLen,
+                                           const char * pcCommandString )
+{
+    static UBaseType_t uxIndex = 0;
+    BaseType_t lParameterStringLength;
+    const char * pcParameter;
+
+    if( uxIndex == 0 )
+    {
+        pcParameter = FreeRTOS_CLIGetParameter( pcCommandString, 1, &lParameterStringLength );
+
+        if( ( pcParameter != NULL ) && ( strncmp( pcParameter, "reset", strlen( "reset" ) ) == 0 ) )
+        {
+            vPeriodicTaskResetStats();
+            snprintf( pcWriteBuffer, xWriteBufferLen, "Periodic task statistics cleared\r\n" );
+            return pdFALSE;
+        }
+
+        if( uxPeriodicTaskCount() == 0 )
+        {
+            snprintf( pcWriteBuffer, xWriteBufferLen, "No periodic tasks\r\n" );
+            return pdFALSE;
+        }
+    }
+
+    /* One task per call, the CLI calls again while pdPASS is returned */
+    if( uxPeriodicTaskReport( uxIndex, pcWriteBuffer, xWriteBufferLen ) > 0 )
+    {
+        uxIndex++;
+        return pdPASS;
+    }
+
+    /* Reset the index for the next time it is called. */
+    uxIndex = 0;
+    pcWriteBuffer[ 0 ] = 0x00;
+
+    return pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvIdleStatsCommand( char * pcWriteBuffer,
+                                       size_t xWriteBufferLen,
+                                       const char * pcCommandString )
+{
+    TicklessIdleStats_t xStats;
+    BaseType_t lParameterStringLength;
+    const char * pcParameter;
+
+    pcParameter = FreeRTOS_CLIGetParameter( pcCommandString, 1, &lParameterStringLength );
+
+    if( ( pcParameter != NULL ) && ( strncmp( pcParameter, "reset", strlen( "reset" ) ) == 0 ) )
+    {
+        vTicklessIdleResetStats();
+        snprintf( pcWriteBuffer, xWriteBufferLen, "Tickless idle statistics cleared\r\n" );
+        return pdFALSE;
+    }
+
+    #if configUSE_TICKLESS_IDLE == 0
+        snprintf( pcWriteBuffer, xWriteBufferLen, "Tickless idle is not enabled\r\n" );
+        return pdFALSE;
+    #endif
+
+    vTicklessIdleGetStats( &xStats );
+    snprintf( pcWriteBuffer, xWriteBufferLen,
+              "sleeps %u (%u aborted), timer wakes %u, early wakes %u, suppressed ticks %lu, "
+              "asleep %lu ms\r\nwakeup latency min %u ns, max %u ns, mean %lu ns\r\n",
+              ( unsigned ) xStats.ulSleeps, ( unsigned ) xStats.ulAborted, ( unsigned ) xStats.ulTimerWakes,
+              ( unsigned ) xStats.ulEarlyWakes, ( unsigned long ) xStats.ullSuppressedTicks,
+              ( unsigned long ) ( xStats.ullIdleNs / 1000000ULL ),
+              ( unsigned ) xStats.ulMinLatencyNs, ( unsigned ) xStats.ulMaxLatencyNs,
+              ( unsigned long ) ( ( xStats.ulTimerWakes > 0 ) ? xStats.ullTotalLatencyNs / xStats.ulTimerWakes : 0 ) );
+
+    return pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+#if ( configPC_PROFILER == 1 ) || ( configEVENT_TRACE == 1 )
+
+    /* Where the profiler or the event trace sends its chunks */
+    typedef struct UDP_SINK
+    {
+        Socket_t xSocket;
+        struct freertos_sockaddr xAddress;
+    } UDPSink_t;
+
+    static BaseType_t prvFileSinkWrite( const uint8_t * pucData,
+                                        size_t uxLength,
+                                        void * pvContext )
+    {
+        FF_FILE * pxFile = ( FF_FILE * ) pvContext;
+
+        if( pucData == NULL )
+        {
+            ff_fclose( pxFile );
+            return pdPASS;
+        }
+
+        return ( ff_fwrite( pucData, 1, uxLength, pxFile ) == uxLength ) ? pdPASS : pdFAIL;
+    }
+    /*-----------------------------------------------------------*/
+
+    static BaseType_t prvUDPSinkWrite( const uint8_t * pucData,
+                                       size_t uxLength,
+                                       void * pvContext )
+    {
+        UDPSink_t * pxSink = ( UDPSink_t * ) pvContext;
+
+        if( pucData == NULL )
+        {
+            FreeRTOS_closesocket( pxSink->xSocket );
+            pxSink->xSocket = FREERTOS_INVALID_SOCKET;
+            return pdPASS;
+        }
+
+        return ( FreeRTOS_sendto( pxSink->xSocket, pucData, uxLength, 0, &pxSink->xAddress, sizeof( pxSink->xAddress ) ) > 0 ) ? pdPASS : pdFAIL;
+    }
+    /*-----------------------------------------------------------*/
+
+    /* Opens a socket to pcAddress, which is terminated here, only once the
+     * port that follows it has been read. Fails if pxSink is open already. */
+    static BaseType_t prvUDPSinkOpen( UDPSink_t * pxSink,
+                                      char * pcAddress,
+                                      BaseType_t xAddressLength,
+                                      const char * pcPort )
+    {
+        if( pxSink->xSocket != FREERTOS_INVALID_SOCKET )
+        {
+            return pdFAIL;
+        }
+
+        pxSink->xAddress.sin_port = FreeRTOS_htons( ( uint16_t ) atol( pcPort ) );
+
+        pcAddress[ xAddressLength ] = 0x00;
+        pxSink->xAddress.sin_addr = FreeRTOS_inet_addr( pcAddress );
+
+        pxSink->xSocket = FreeRTOS_socket( FREERTOS_AF_INET, FREERTOS_SOCK_DGRAM, FREERTOS_IPPROTO_UDP );
+
+        return ( pxSink->xSocket != FREERTOS_INVALID_SOCKET ) ? pdPASS : pdFAIL;
+    }
+    /*-----------------------------------------------------------*/
+
+#endif /* configPC_PROFILER || configEVENT_TRACE */
+
+#if ( configPC_PROFILER == 1 )
+    static UDPSink_t xProfileSink = { .xSocket = FREERTOS_INVALID_SOCKET };
+#endif
+
+static BaseType_t prvProfileCommand( char * pcWriteBuffer,
+                                     size_t xWriteBufferLen,
+                                     const char * pcCommandString )
+{
+    #if ( configPC_PROFILER == 1 )
+        PcProfilerStats_t xStats;
+        BaseType_t lParameterStringLength, lPortLength, xStarted = pdFAIL;
+        char * pcParameter, * pcArgument, * pcPort;
+
+        pcParameter = ( char * ) FreeRTOS_CLIGetParameter( pcCommandString, 1, &lParameterStringLength );
+        pcArgument = ( char * ) FreeRTOS_CLIGetParameter( pcCommandString, 2, &lParameterStringLength );
+
+        if( pcParameter == NULL )
+        {
+            vPcProfilerGetStats( &xStats );
+            snprintf( pcWriteBuffer, xWriteBufferLen,
+                      "%s, samples %u, dropped %u, chunks %u (%u failed), tasks %u\r\n",
+                      ( xStats.xRunning != pdFALSE ) ? "running" : "stopped",
+                      ( unsigned ) xStats.ulSamples, ( unsigned ) xStats.ulDropped, ( unsigned ) xStats.ulChunks,
+                      ( unsigned ) xStats.ulWriteErrors, ( unsigned ) xStats.ulTasks );
+        }
+        else if( strncmp( pcParameter, "stop", strlen( "stop" ) ) == 0 )
+        {
+            vPcProfilerStop();
+            snprintf( pcWriteBuffer, xWriteBufferLen, "Profile stopped\r\n" );
+        }
+        else if( ( strncmp( pcParameter, "file", strlen( "file" ) ) == 0 ) && ( pcArgument != NULL ) )
+        {
+            FF_FILE * pxFile;
+
+            /* Terminate the path. */
+            pcArgument[ lParameterStringLength ] = 0x00;
+            pxFile = ff_fopen( pcArgument, "w" );
+
+            if( pxFile != NULL )
+            {
+                xStarted = xPcProfilerStart( prvFileSinkWrite, pxFile );
+
+                if( xStarted == pdFAIL )
+                {
+                    ff_fclose( pxFile );
+                }
+            }
+
+            snprintf( pcWriteBuffer, xWriteBufferLen, ( xStarted == pdPASS ) ? "Profiling into %s\r\n" :
+                      "Could not start profiling into %s, already running?\r\n", pcArgument );
+        }
+        else if( ( strncmp( pcParameter, "udp", strlen( "udp" ) ) == 0 ) && ( pcArgument != NULL ) &&
+                 ( ( pcPort = ( char * ) FreeRTOS_CLIGetParameter( pcCommandString, 3, &lPortLength ) ) != NULL ) )
+        {
+            if( prvUDPSinkOpen( &xProfileSink, pcArgument, lParameterStringLength, pcPort ) == pdPASS )
+            {
+                xStarted = xPcProfilerStart( prvUDPSinkWrite, &xProfileSink );
+
+                if( xStarted == pdFAIL )
+                {
+                    ( void ) prvUDPSinkWrite( NULL, 0, &xProfileSink );
+                }
+            }
+
+            snprintf( pcWriteBuffer, xWriteBufferLen, ( xStarted == pdPASS ) ? "Profiling to UDP port %s\r\n" :
+                      "Could not start profiling to UDP port %s, already running?\r\n", pcPort );
+        }
+        else
+        {
+            snprintf( pcWriteBuffer, xWriteBufferLen, "Valid parameters are 'file <path>', 'udp <ip> <port>' and 'stop'.\r\n" );
+        }
+    #else /* if ( configPC_PROFILER == 1 ) */
+        ( void ) pcCommandString;
+        snprintf( pcWriteBuffer, xWriteBufferLen, "The PC profiler is not enabled\r\n" );
+    #endif /* configPC_PROFILER */
+
+    return pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+#if ( configEVENT_TRACE == 1 )
+
+    static UDPSink_t xEventTraceSink = { .xSocket = FREERTOS_INVALID_SOCKET };
+
+    /* Event ids of a comma separated list of event names as a mask, 0 if
+     * one of them is not an event */
+    static uint32_t prvEventTraceMask( const char * pcList,
+                                       BaseType_t xLength )
+    {
+        uint32_t ulMask = 0, ulEvent;
+        BaseType_t xStart = 0, xEnd;
+
+        while( xStart < xLength )
+        {
+            for( xEnd = xStart; ( xEnd < xLength ) && ( pcList[ xEnd ] != ',' ); xEnd++ )
+            {
+            }
+
+            ulEvent = ulEventTraceEventFromName( &pcList[ xStart ], ( size_t ) ( xEnd - xStart ) );
+
+            if( ulEvent == eventtraceNONE )
+            {
+                return 0;
+            }
+
+            ulMask |= 1UL << ulEvent;
+            xStart = xEnd + 1;
+        }
+
+        return ulMask;
+    }
+    /*-----------------------------------------------------------*/
+
+    /* Reads the "<option> <value>" pairs from parameter uxFirst on. They have
+     * to be read before the path or the address is terminated. */
+    static BaseType_t prvEventTraceConditions( const char * pcCommandString,
+                                               UBaseType_t uxFirst,
+                                               EventTraceConditions_t * pxConditions )
+    {
+        BaseType_t xOptionLength, xValueLength;
+        const char * pcOption, * pcValue;
+        UBaseType_t x;
+
+        memset( pxConditions, 0, sizeof( *pxConditions ) );
+
+        for( x = uxFirst; ( pcOption = FreeRTOS_CLIGetParameter( pcCommandString, x, &xOptionLength ) ) != NULL; x += 2 )
+        {
+            pcValue = FreeRTOS_CLIGetParameter( pcCommandString, x + 1, &xValueLength );
+
+            if( pcValue == NULL )
+            {
+                return pdFAIL;
+            }
+
+            if( strncmp( pcOption, "trigger", strlen( "trigger" ) ) == 0 )
+            {
+                pxConditions->ulTriggerEvent = ulEventTraceEventFromName( pcValue, ( size_t ) xValueLength );
+
+                if( pxConditions->ulTriggerEvent == eventtraceNONE )
+                {
+                    return pdFAIL;
+                }
+            }
+            else if( strncmp( pcOption, "stop-on", strlen( "stop-on" ) ) == 0 )
+            {
+                pxConditions->ulStopEvent = ulEventTraceEventFromName( pcValue, ( size_t ) xValueLength );
+
+                if( pxConditions->ulStopEvent == eventtraceNONE )
+                {
+                    return pdFAIL;
+                }
+            }
+            else if( strncmp( pcOption, "stop-after", strlen( "stop-after" ) ) == 0 )
+            {
+                pxConditions->ulStopAfter = ( uint32_t ) strtoul( pcValue, NULL, 10 );
+            }
+            else if( strncmp( pcOption, "pre", strlen( "pre" ) ) == 0 )
+            {
+                pxConditions->ulPreTrigger = ( uint32_t ) strtoul( pcValue, NULL, 10 );
+            }
+            else if( strncmp( pcOption, "only", strlen( "only" ) ) == 0 )
+            {
+                pxConditions->ulEventMask = prvEventTraceMask( pcValue, xValueLength );
+
+                if( pxConditions->ulEventMask == 0 )
+                {
+                    return pdFAIL;
+                }
+            }
+            else
+            {
+                return pdFAIL;
+            }
+        }
+
+        return pdPASS;
+    }
+    /*-----------------------------------------------------------*/
+
+#endif /* configEVENT_TRACE */
+
+static BaseType_t prvEventTraceCommand( char * pcWriteBuffer,
+                                        size_t xWriteBufferLen,
+                                        const char * pcCommandString )
+{
+    #if ( configEVENT_TRACE == 1 )
+        static const char * const pcStates[] = { "idle", "armed", "running", "stopped" };
+        EventTraceConditions_t xConditions;
+        EventTraceStats_t xStats;
+        BaseType_t lParameterStringLength, lPortLength, xStarted = pdFAIL;
+        char * pcParameter, * pcArgument, * pcPort;
+
+        pcParameter = ( char * ) FreeRTOS_CLIGetParameter( pcCommandString, 1, &lParameterStringLength );
+        pcArgument = ( char * ) FreeRTOS_CLIGetParameter( pcCommandString, 2, &lParameterStringLength );
+
+        if( pcParameter == NULL )
+        {
+            vEventTraceGetStats( &xStats );
+            snprintf( pcWriteBuffer, xWriteBufferLen,
+                      "%s, recorded %u, written %u, lost %u, chunks %u (%u failed), tasks %u\r\n",
+                      pcStates[ xStats.ulState & 3 ], ( unsigned ) xStats.ulRecorded, ( unsigned ) xStats.ulWritten,
+                      ( unsigned ) xStats.ulLost, ( unsigned ) xStats.ulChunks, ( unsigned ) xStats.ulWriteErrors,
+                      ( unsigned ) xStats.ulNames );
+        }
+        else if( strncmp( pcParameter, "stop", strlen( "stop" ) ) == 0 )
+        {
+            vEventTraceStop();
+            snprintf( pcWriteBuffer, xWriteBufferLen, "Event trace stopped\r\n" );
+        }
+        else if( ( strncmp( pcParameter, "file", strlen( "file" ) ) == 0 ) && ( pcArgument != NULL ) )
+        {
+            FF_FILE * pxFile;
+
+            if( prvEventTraceConditions( pcCommandString, 3, &xConditions ) == pdFAIL )
+            {
+                snprintf( pcWriteBuffer, xWriteBufferLen, "Unknown event or option, see 'help'.\r\n" );
+                return pdFALSE;
+            }
+
+            /* Terminate the path. */
+            pcArgument[ lParameterStringLength ] = 0x00;
+            pxFile = ff_fopen( pcArgument, "w" );
+
+            if( pxFile != NULL )
+            {
+                xStarted = xEventTraceStart( &xConditions, prvFileSinkWrite, pxFile );
+
+                if( xStarted == pdFAIL )
+                {
+                    ff_fclose( pxFile );
+                }
+            }
+
+            snprintf( pcWriteBuffer, xWriteBufferLen, ( xStarted == pdPASS ) ? "Tracing into %s\r\n" :
+                      "Could not start tracing into %s, already running?\r\n", pcArgument );
+        }
+        else if( ( strncmp( pcParameter, "udp", strlen( "udp" ) ) == 0 ) && ( pcArgument != NULL ) &&
+                 ( ( pcPort = ( char * ) FreeRTOS_CLIGetParameter( pcCommandString, 3, &lPortLength ) ) != NULL ) )
+        {
+            if( prvEventTraceConditions( pcCommandString, 4, &xConditions ) == pdFAIL )
+            {
+                snprintf( pcWriteBuffer, xWriteBufferLen, "Unknown event or option, see 'help'.\r\n" );
+                return pdFALSE;
+            }
+
+            if( prvUDPSinkOpen( &xEventTraceSink, pcArgument, lParameterStringLength, pcPort ) == pdPASS )
+            {
+                xStarted = xEventTraceStart( &xConditions, prvUDPSinkWrite, &xEventTraceSink );
+
+                if( xStarted == pdFAIL )
+                {
+                    ( void ) prvUDPSinkWrite( NULL, 0, &xEventTraceSink );
+                }
+            }
+
+            /* The port is not terminated, print only its digits */
+            snprintf( pcWriteBuffer, xWriteBufferLen, ( xStarted == pdPASS ) ? "Tracing to UDP port %.*s\r\n" :
+                      "Could not start tracing to UDP port %.*s, already running?\r\n", ( int ) lPortLength, pcPort );
+        }
+        else
+        {
+            snprintf( pcWriteBuffer, xWriteBufferLen, "Valid parameters are 'file <path>', 'udp <ip> <port>' and 'stop'.\r\n" );
+        }
+    #else /* if ( configEVENT_TRACE == 1 ) */
+        ( void ) pcCommandString;
+        snprintf( pcWriteBuffer, xWriteBufferLen, "The event trace is not enabled\r\n" );
+    #endif /* configEVENT_TRACE */
+
+    return pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
 static BaseType_t prvDisplayIPConfig( char * pcWriteBuffer,
                                       size_t xWriteBufferLen,
                                       const char * pcCommandString )
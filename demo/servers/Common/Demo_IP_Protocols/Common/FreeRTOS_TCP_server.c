@@ -106,7 +106,7 @@
 
                             #if ( ipconfigHTTP_RX_BUFSIZE > 0 )
                                 {
-                                    if( pxConfigs[ xIndex ].eType == eSERVER_HTTP )
+                                    if( ( pxConfigs[ xIndex ].eType == eSERVER_HTTP ) && ( pxConfigs[ xIndex ].pxWinProperties == NULL ) )
                                     {
                                         WinProperties_t xWinProps;
 
@@ -125,6 +125,14 @@
                                 }
                             #endif /* if ( ipconfigHTTP_RX_BUFSIZE > 0 ) */
 
+                            /* Per-server override, inherited by each new child socket as above */
+                            if( pxConfigs[ xIndex ].pxWinProperties != NULL )
+                            {
+                                WinProperties_t xWinProps = *( pxConfigs[ xIndex ].pxWinProperties );
+
+                                FreeRTOS_setsockopt( xSocket, 0, FREERTOS_SO_WIN_PROPERTIES, ( void * ) &xWinProps, sizeof( xWinProps ) );
+                            }
+
                             FreeRTOS_FD_SET( xSocket, xSocketSet, eSELECT_READ | eSELECT_EXCEPT );
                             pxServer->xServers[ xIndex ].xSocket = xSocket;
                             pxServer->xServers[ xIndex ].eType = pxConfigs[ xIndex ].eType;
@@ -112,6 +112,7 @@
         BaseType_t xPortNumber;       /* e.g. 80, 8080, 21 */
         BaseType_t xBackLog;          /* e.g. 10, maximum number of connected TCP clients */
         const char * const pcRootDir; /* Treat this directory as the root directory */
+        const WinProperties_t * pxWinProperties; /* Window/buffer sizes for the clients, NULL: ipconfig defaults */
     };
 
     struct xTCP_SERVER;
@@ -76,49 +76,14 @@
 
 #include "date_and_time.h"
 
-int iTimeZone;
-
-uint32_t ulSeconds, ulMsec;
-
-/*
- * You can add the following code to you FreeRTOSConfig file:
- *
- *  extern TickType_t ulSeconds, ulMsec;
- *
- #define traceINCREASE_TICK_COUNT( xTicksToJump ) \
- *  { \
- *      ulMsec += xTicksToJump; \
- *      if( ulMsec >= 1000 ) \
- *      { \
- *          ulSeconds += ( ulMsec / 1000ul ); \
- *          ulMsec = ( ulMsec % 1000ul ); \
- *      } \
- *  }
- *
- *
- #define traceTASK_INCREMENT_TICK( xTickCount ) \
- *  if( uxSchedulerSuspended == ( UBaseType_t ) pdFALSE ) \
- *  { \
- *      if( ++ulMsec >= 1000 ) \
- *      { \
- *          ulMsec = 0; \
- *          ulSeconds++; \
- *      } \
- *  }
- *
- */
+/* The wall clock kept by bsp/clock.c, and steered by its NTP client */
+#include "clock.h"
 
+int iTimeZone;
 
 time_t FreeRTOS_time( time_t * pxTime )
 {
-    time_t uxTime;
-
-    /* Critical section required if running on a 16 bit processor. */
-    portTICK_TYPE_ENTER_CRITICAL();
-    {
-        uxTime = ( time_t ) ulSeconds;
-    }
-    portTICK_TYPE_EXIT_CRITICAL();
+    time_t uxTime = ( time_t ) ulClockRealtime( NULL );
 
     if( pxTime != NULL )
     {
@@ -131,31 +96,19 @@ time_t FreeRTOS_time( time_t * pxTime )
 
 void FreeRTOS_settime( time_t * pxTime )
 {
-    /* Critical section required if running on a 16 bit processor. */
-    portTICK_TYPE_ENTER_CRITICAL();
-    {
-        ulSeconds = ( uint32_t ) *pxTime;
-        ulMsec = ( uint32_t ) 0;
-    }
-    portTICK_TYPE_EXIT_CRITICAL();
+    vClockSetRealtime( ( int64_t ) *pxTime * clockNS_PER_SECOND );
 }
 /*-----------------------------------------------------------*/
 
 time_t FreeRTOS_get_secs_msec( time_t * pulMsec )
 {
-    time_t uxReturn;
+    uint32_t ulNanoseconds;
+    time_t uxReturn = ( time_t ) ulClockRealtime( &ulNanoseconds );
 
-    /* Critical section required if running on a 16 bit processor. */
-    portTICK_TYPE_ENTER_CRITICAL();
+    if( pulMsec != NULL )
     {
-        uxReturn = ( time_t ) ulSeconds;
-
-        if( pulMsec != NULL )
-        {
-            *pulMsec = ulMsec;
-        }
+        *pulMsec = ( time_t ) ( ulNanoseconds / 1000000UL );
     }
-    portTICK_TYPE_EXIT_CRITICAL();
 
     return uxReturn;
 }
@@ -165,16 +118,13 @@ time_t FreeRTOS_get_secs_msec( time_t * pulMsec )
 void FreeRTOS_set_secs_msec( time_t * pulSeconds,
                              time_t * pulMsec )
 {
-    /* Critical section required if running on a 16 bit processor. */
-    portTICK_TYPE_ENTER_CRITICAL();
-    {
-        ulSeconds = *pulSeconds;
+    int64_t llNs = ( int64_t ) *pulSeconds * clockNS_PER_SECOND;
 
-        if( pulMsec != NULL )
-        {
-            ulMsec = *pulMsec;
-        }
+    if( pulMsec != NULL )
+    {
+        llNs += ( int64_t ) *pulMsec * 1000000LL;
     }
-    portTICK_TYPE_EXIT_CRITICAL();
+
+    vClockSetRealtime( llNs );
 }
 /*-----------------------------------------------------------*/
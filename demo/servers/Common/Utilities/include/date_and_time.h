@@ -76,7 +76,6 @@
 
     #include <time.h>
 
-    extern uint32_t ulSeconds, ulMsec;
     extern int iTimeZone;
 
     extern time_t FreeRTOS_get_secs_msec( time_t * pulMsec );
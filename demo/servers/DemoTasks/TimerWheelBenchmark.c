@@ -0,0 +1,305 @@
+/*
+ * Timer wheel benchmark, see TimerWheelBenchmark.h.
+ *
+ * Insertion cost: for growing numbers of timers with random delays, every
+ * timer is started and then stopped and each call is timed with the cycle
+ * counter. The same is done with FreeRTOS software timers; their daemon task
+ * runs at a higher priority than this one, so xTimerStart() returns once the
+ * timer is in the daemon's sorted list and the time includes the insertion.
+ *
+ * Lateness: every timer is started with a random delay of up to
+ * timerbenchSPREAD_MS and the wheel's counters are printed once all of them
+ * have fired: how late the callbacks ran, as a log2 histogram, and how many
+ * timers each pass of the service task handled.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
+
+/* FreeRTOS+TCP includes, for FreeRTOS_printf(). */
+#include "FreeRTOS_IP.h"
+
+/* Demo project includes. */
+#include "TimerWheelBenchmark.h"
+#include "timer_wheel.h"
+#include "rand.h"
+
+/* The largest population, all timers are allocated at once */
+#define timerbenchTIMERS             ( 4096 )
+
+/* Delays for the insertion runs, long enough that nothing fires meanwhile */
+#define timerbenchINSERT_MIN_MS      ( 10000 )
+#define timerbenchINSERT_SPREAD_MS   ( 50000 )
+
+/* Delays for the lateness run */
+#define timerbenchSPREAD_MS          ( 2000 )
+
+#define timerbenchSERVICE_STACK      ( configMINIMAL_STACK_SIZE * 2 )
+
+extern uint64_t get_cycle_count( void );
+
+typedef struct TIMER_BENCH_COST
+{
+    uint64_t ullStartCycles;
+    uint64_t ullStopCycles;
+    uint32_t ulMaxStart;
+    uint32_t ulMaxStop;
+} TimerBenchCost_t;
+
+static TaskHandle_t xBenchmarkTask = NULL;
+static volatile uint32_t ulPending = 0;
+/*-----------------------------------------------------------*/
+
+static uint32_t prvInsertDelayMs( void )
+{
+    return timerbenchINSERT_MIN_MS + ( uint32_t ) ( uxRand() % timerbenchINSERT_SPREAD_MS );
+}
+/*-----------------------------------------------------------*/
+
+static void prvTimed( uint64_t ullStart,
+                      uint64_t * pullTotal,
+                      uint32_t * pulMax )
+{
+    uint64_t ullCycles = get_cycle_count() - ullStart;
+
+    *pullTotal += ullCycles;
+
+    if( ullCycles > *pulMax )
+    {
+        *pulMax = ( uint32_t ) ullCycles;
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void prvNeverCalled( TimerWheelTimer_t * pxTimer,
+                            void * pvContext )
+{
+    ( void ) pxTimer;
+    ( void ) pvContext;
+}
+/*-----------------------------------------------------------*/
+
+static void prvSoftwareTimerCallback( TimerHandle_t xTimer )
+{
+    ( void ) xTimer;
+}
+/*-----------------------------------------------------------*/
+
+static void prvWheelCost( TimerWheelTimer_t * pxTimers,
+                          uint32_t ulCount,
+                          TimerBenchCost_t * pxCost )
+{
+    uint64_t ullStart;
+
+    memset( pxCost, 0, sizeof( *pxCost ) );
+
+    for( uint32_t x = 0; x < ulCount; x++ )
+    {
+        uint32_t ulDelayUs = prvInsertDelayMs() * 1000;
+
+        vTimerWheelInitTimer( &pxTimers[ x ], prvNeverCalled, NULL );
+
+        ullStart = get_cycle_count();
+        vTimerWheelStart( &pxTimers[ x ], ulDelayUs, 0 );
+        prvTimed( ullStart, &pxCost->ullStartCycles, &pxCost->ulMaxStart );
+    }
+
+    for( uint32_t x = 0; x < ulCount; x++ )
+    {
+        ullStart = get_cycle_count();
+        xTimerWheelStop( &pxTimers[ x ] );
+        prvTimed( ullStart, &pxCost->ullStopCycles, &pxCost->ulMaxStop );
+    }
+}
+/*-----------------------------------------------------------*/
+
+/* Returns the number of timers that could be created */
+static uint32_t prvSoftwareTimerCost( TimerHandle_t * pxTimers,
+                                      uint32_t ulCount,
+                                      TimerBenchCost_t * pxCost )
+{
+    uint64_t ullStart;
+    uint32_t ulCreated;
+
+    memset( pxCost, 0, sizeof( *pxCost ) );
+
+    for( ulCreated = 0; ulCreated < ulCount; ulCreated++ )
+    {
+        pxTimers[ ulCreated ] = xTimerCreate( "Bench", pdMS_TO_TICKS( prvInsertDelayMs() ), pdFALSE, NULL, prvSoftwareTimerCallback );
+
+        if( pxTimers[ ulCreated ] == NULL )
+        {
+            break;
+        }
+    }
+
+    for( uint32_t x = 0; x < ulCreated; x++ )
+    {
+        ullStart = get_cycle_count();
+        xTimerStart( pxTimers[ x ], portMAX_DELAY );
+        prvTimed( ullStart, &pxCost->ullStartCycles, &pxCost->ulMaxStart );
+    }
+
+    for( uint32_t x = 0; x < ulCreated; x++ )
+    {
+        ullStart = get_cycle_count();
+        xTimerStop( pxTimers[ x ], portMAX_DELAY );
+        prvTimed( ullStart, &pxCost->ullStopCycles, &pxCost->ulMaxStop );
+    }
+
+    for( uint32_t x = 0; x < ulCreated; x++ )
+    {
+        xTimerDelete( pxTimers[ x ], portMAX_DELAY );
+    }
+
+    return ulCreated;
+}
+/*-----------------------------------------------------------*/
+
+static void prvPrintCost( const char * pcName,
+                          uint32_t ulCount,
+                          const TimerBenchCost_t * pxCost )
+{
+    if( ulCount == 0 )
+    {
+        return;
+    }
+
+    FreeRTOS_printf( ( "%s %u timers: start %u cycles (max %u), stop %u cycles (max %u)\n",
+                       pcName, ( unsigned ) ulCount,
+                       ( unsigned ) ( pxCost->ullStartCycles / ulCount ), ( unsigned ) pxCost->ulMaxStart,
+                       ( unsigned ) ( pxCost->ullStopCycles / ulCount ), ( unsigned ) pxCost->ulMaxStop ) );
+}
+/*-----------------------------------------------------------*/
+
+static void prvLatenessCallback( TimerWheelTimer_t * pxTimer,
+                                 void * pvContext )
+{
+    ( void ) pxTimer;
+    ( void ) pvContext;
+
+    if( --ulPending == 0 )
+    {
+        xTaskNotifyGive( xBenchmarkTask );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void prvPrintLateness( void )
+{
+    TimerWheelStats_t xStats;
+    char cBins[ configTIMER_WHEEL_HISTOGRAM_BINS * 20 ];
+    size_t uxUsed = 0;
+
+    vTimerWheelGetStats( &xStats );
+
+    FreeRTOS_printf( ( "Timer wheel: %u fired in %u passes (max %u per pass), %u cascaded, late mean %u us, max %u us\n",
+                       ( unsigned ) xStats.ulFired, ( unsigned ) xStats.ulBatches, ( unsigned ) xStats.ulMaxBatch,
+                       ( unsigned ) xStats.ulCascades,
+                       ( unsigned ) ( ( xStats.ulFired != 0 ) ? ( xStats.ullTotalLateUs / xStats.ulFired ) : 0 ),
+                       ( unsigned ) xStats.ulMaxLateUs ) );
+
+    cBins[ 0 ] = '\0';
+
+    for( UBaseType_t x = 0; x < configTIMER_WHEEL_HISTOGRAM_BINS; x++ )
+    {
+        if( ( xStats.ulLate[ x ] != 0 ) && ( uxUsed < sizeof( cBins ) ) )
+        {
+            /* The upper bound of the bin, "+" for the last one */
+            if( x == configTIMER_WHEEL_HISTOGRAM_BINS - 1 )
+            {
+                uxUsed += snprintf( &cBins[ uxUsed ], sizeof( cBins ) - uxUsed, " +:%u", ( unsigned ) xStats.ulLate[ x ] );
+            }
+            else
+            {
+                uxUsed += snprintf( &cBins[ uxUsed ], sizeof( cBins ) - uxUsed, " %u:%u",
+                                    ( unsigned ) ( ( x == 0 ) ? 0 : ( 1U << x ) ), ( unsigned ) xStats.ulLate[ x ] );
+            }
+        }
+    }
+
+    FreeRTOS_printf( ( "Timer wheel lateness (us:count):%s\n", cBins ) );
+}
+/*-----------------------------------------------------------*/
+
+static void prvTimerWheelBenchmarkTask( void * pvParameters )
+{
+    static const uint32_t ulPopulations[] = { 64, 512, timerbenchTIMERS };
+    TimerWheelTimer_t * pxTimers;
+    TimerHandle_t * pxSoftwareTimers;
+    TimerBenchCost_t xCost;
+    uint32_t ulCreated;
+
+    ( void ) pvParameters;
+
+    xBenchmarkTask = xTaskGetCurrentTaskHandle();
+
+    /* The service task above this one, so that callbacks are not held up by
+     * the benchmark */
+    if( xTimerWheelInit( timerbenchSERVICE_STACK, uxTaskPriorityGet( NULL ) + 1 ) != pdPASS )
+    {
+        FreeRTOS_printf( ( "Timer wheel benchmark: no service task\n" ) );
+        vTaskDelete( NULL );
+    }
+
+    pxTimers = pvPortMalloc( timerbenchTIMERS * sizeof( TimerWheelTimer_t ) );
+    pxSoftwareTimers = pvPortMalloc( timerbenchTIMERS * sizeof( TimerHandle_t ) );
+
+    if( ( pxTimers == NULL ) || ( pxSoftwareTimers == NULL ) )
+    {
+        FreeRTOS_printf( ( "Timer wheel benchmark: out of memory for %u timers\n", ( unsigned ) timerbenchTIMERS ) );
+        vPortFree( pxTimers );
+        vPortFree( pxSoftwareTimers );
+        vTaskDelete( NULL );
+    }
+
+    for( size_t x = 0; x < sizeof( ulPopulations ) / sizeof( ulPopulations[ 0 ] ); x++ )
+    {
+        prvWheelCost( pxTimers, ulPopulations[ x ], &xCost );
+        prvPrintCost( "Timer wheel", ulPopulations[ x ], &xCost );
+
+        ulCreated = prvSoftwareTimerCost( pxSoftwareTimers, ulPopulations[ x ], &xCost );
+        prvPrintCost( "Software timers", ulCreated, &xCost );
+    }
+
+    vPortFree( pxSoftwareTimers );
+
+    vTimerWheelResetStats();
+    ulPending = timerbenchTIMERS;
+    ( void ) xTaskNotifyStateClear( NULL );
+
+    for( uint32_t x = 0; x < timerbenchTIMERS; x++ )
+    {
+        vTimerWheelInitTimer( &pxTimers[ x ], prvLatenessCallback, NULL );
+        vTimerWheelStart( &pxTimers[ x ], ( uint32_t ) ( uxRand() % ( timerbenchSPREAD_MS * 1000 ) ), 0 );
+    }
+
+    if( ulTaskNotifyTake( pdTRUE, pdMS_TO_TICKS( timerbenchSPREAD_MS * 2 ) ) == 0 )
+    {
+        FreeRTOS_printf( ( "Timer wheel benchmark: %u timers did not fire\n", ( unsigned ) ulPending ) );
+
+        for( uint32_t x = 0; x < timerbenchTIMERS; x++ )
+        {
+            xTimerWheelStop( &pxTimers[ x ] );
+        }
+    }
+
+    prvPrintLateness();
+
+    vPortFree( pxTimers );
+    vTaskDelete( NULL );
+}
+/*-----------------------------------------------------------*/
+
+void vStartTimerWheelBenchmarkTask( uint16_t usStackSize,
+                                    UBaseType_t uxPriority )
+{
+    xTaskCreate( prvTimerWheelBenchmarkTask, "TWBench", usStackSize, NULL, uxPriority, NULL );
+}
+/*-----------------------------------------------------------*/
@@ -77,11 +77,19 @@
  * See the following web page for essential demo usage and configuration
  * details:
  * http://www.FreeRTOS.org/FreeRTOS-Plus/FreeRTOS_Plus_TCP/examples_FreeRTOS_simulator.html
+ *
+ * vStartUDPPpsBenchmarkTask() reuses the select() set of sockets to measure
+ * the small-datagram rate: the sockets take turns sending to the UDP echo
+ * server at configECHO_SERVER_ADDR0..3 and receive the echoes, once with one
+ * FreeRTOS_sendto()/FreeRTOS_recvfrom() per datagram, once with the zero-copy
+ * batch API in udp_batch.h.  The stack has no loopback, so a peer on the wire
+ * is needed.
  */
 
 /* Standard includes. */
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 /* FreeRTOS includes. */
 #include "FreeRTOS.h"
@@ -94,6 +102,7 @@
 
 /* Demo project includes. */
 #include "UDPSelectServer.h"
+#include "udp_batch.h"
 
 /* Exclude the whole file if select() is not being supported. */
 #if ( ipconfigSUPPORT_SELECT_FUNCTION == 1 )
@@ -105,6 +114,18 @@
  * the set. */
     #define selMAX_TX_VALUE         ( 100 )
 
+    #ifndef configWINDOWS_MAC_INTERRUPT_SIMULATOR_DELAY
+        #define configWINDOWS_MAC_INTERRUPT_SIMULATOR_DELAY    ( 0 )
+    #endif
+
+/* Datagrams sent per payload size and mode by the pps benchmark, in bursts of
+ * selPPS_BURST (one batch call each in batch mode). */
+    #define selPPS_DATAGRAMS        ( 10000 )
+    #define selPPS_BURST            ( 16 )
+    #define selPPS_RX_TIMEOUT       pdMS_TO_TICKS( 200 )
+
+    extern uint64_t get_cycle_count( void );
+
 /*-----------------------------------------------------------*/
 
 /*
@@ -121,6 +142,11 @@
  */
     static void prvMultipleSocketRxTask( void * pvParameters );
 
+/*
+ * Measures datagrams per second through the stack, see the top of the file.
+ */
+    static void prvUDPPpsBenchmarkTask( void * pvParameters );
+
 /*-----------------------------------------------------------*/
 
 /* The sockets used in FreeRTOS_select(). */
@@ -137,6 +163,9 @@
 /* The Tx task needs to know the handle of the Rx task. */
     static TaskHandle_t xRxTaskHandle;
 
+/* Port of the echo server the pps benchmark sends to. */
+    static uint32_t ulPpsEchoPort;
+
 /*-----------------------------------------------------------*/
 
     void vStartUDPSelectServerTasks( uint16_t usStackSize,
@@ -404,5 +433,178 @@
         return !ulError;
     }
 
+
+    void vStartUDPPpsBenchmarkTask( uint16_t usStackSize,
+                                    uint32_t ulFirstPortNumber,
+                                    uint32_t ulEchoPort,
+                                    UBaseType_t uxPriority )
+    {
+        ulPpsEchoPort = ulEchoPort;
+        xTaskCreate( prvUDPPpsBenchmarkTask, "UDPpps", usStackSize, ( void * ) ulFirstPortNumber, uxPriority, NULL );
+    }
+/*-----------------------------------------------------------*/
+
+    static uint32_t prvPpsReceive( SocketSet_t xFD_Set,
+                                   Socket_t * pxSockets,
+                                   BaseType_t xBatch )
+    {
+        UDPBatchItem_t xItems[ selPPS_BURST ];
+        static uint8_t ucBuffer[ ipconfigNETWORK_MTU ];
+        uint32_t ulReceived = 0;
+        BaseType_t x, xCount;
+
+        for( x = 0; x < selNUMBER_OF_SOCKETS; x++ )
+        {
+            if( FreeRTOS_FD_ISSET( pxSockets[ x ], xFD_Set ) == 0 )
+            {
+                continue;
+            }
+
+            if( xBatch != pdFALSE )
+            {
+                while( ( xCount = xUDPBatchRecvFrom( pxSockets[ x ], xItems, selPPS_BURST, FREERTOS_MSG_DONTWAIT ) ) > 0 )
+                {
+                    ulReceived += xCount;
+                    vUDPBatchRelease( xItems, xCount );
+                }
+            }
+            else
+            {
+                struct freertos_sockaddr xAddress;
+                uint32_t ulAddressLength = sizeof( xAddress );
+
+                while( FreeRTOS_recvfrom( pxSockets[ x ], ucBuffer, sizeof( ucBuffer ), FREERTOS_MSG_DONTWAIT,
+                                          &xAddress, &ulAddressLength ) > 0 )
+                {
+                    ulReceived++;
+                }
+            }
+        }
+
+        return ulReceived;
+    }
+/*-----------------------------------------------------------*/
+
+    static void prvUDPPpsBenchmarkTask( void * pvParameters )
+    {
+        static const size_t xSizes[] = { 16, 64, 256 };
+        UDPBatchItem_t xItems[ selPPS_BURST ];
+        uint8_t ucPayload[ 256 ] = { 0 };
+        Socket_t xPpsSockets[ selNUMBER_OF_SOCKETS ];
+        struct freertos_sockaddr xAddress, xEchoServer;
+        uint32_t ulFirstPortNumber, ulSent, ulReceived, x;
+        const TickType_t xNoBlock = 0;
+        SocketSet_t xFD_Set;
+        Socket_t xTxSocket;
+        uint64_t ullCycles;
+
+        ulFirstPortNumber = ( uint32_t ) pvParameters;
+
+        xEchoServer.sin_addr = FreeRTOS_inet_addr_quick( configECHO_SERVER_ADDR0,
+                                                         configECHO_SERVER_ADDR1,
+                                                         configECHO_SERVER_ADDR2,
+                                                         configECHO_SERVER_ADDR3 );
+        xEchoServer.sin_port = FreeRTOS_htons( ( uint16_t ) ulPpsEchoPort );
+
+        xFD_Set = FreeRTOS_CreateSocketSet();
+
+        for( x = 0; x < selNUMBER_OF_SOCKETS; x++ )
+        {
+            xPpsSockets[ x ] = FreeRTOS_socket( FREERTOS_AF_INET, FREERTOS_SOCK_DGRAM, FREERTOS_IPPROTO_UDP );
+            configASSERT( xPpsSockets[ x ] != FREERTOS_INVALID_SOCKET );
+
+            xAddress.sin_port = FreeRTOS_htons( ( uint16_t ) ( ulFirstPortNumber + x ) );
+            FreeRTOS_bind( xPpsSockets[ x ], &xAddress, sizeof( struct freertos_sockaddr ) );
+            FreeRTOS_setsockopt( xPpsSockets[ x ], 0, FREERTOS_SO_RCVTIMEO, &xNoBlock, sizeof( xNoBlock ) );
+            FreeRTOS_setsockopt( xPpsSockets[ x ], 0, FREERTOS_SO_SNDTIMEO, &xSendBlockTime, sizeof( xSendBlockTime ) );
+            FreeRTOS_FD_SET( xPpsSockets[ x ], xFD_Set, eSELECT_READ );
+        }
+
+        for( BaseType_t xBatch = pdFALSE; xBatch <= pdTRUE; xBatch++ )
+        {
+            for( size_t xSize = 0; xSize < sizeof( xSizes ) / sizeof( xSizes[ 0 ] ); xSize++ )
+            {
+                ulSent = 0;
+                ulReceived = 0;
+                ullCycles = get_cycle_count();
+
+                while( ulSent < selPPS_DATAGRAMS )
+                {
+                    BaseType_t xCount = 0;
+
+                    /* Each burst goes out of the next socket in the set, the
+                     * echoes come back to it */
+                    xTxSocket = xPpsSockets[ ( ulSent / selPPS_BURST ) % selNUMBER_OF_SOCKETS ];
+
+                    if( xBatch != pdFALSE )
+                    {
+                        xCount = xUDPBatchGetBuffers( xItems, selPPS_BURST, xSizes[ xSize ], xSendBlockTime );
+
+                        for( x = 0; x < ( uint32_t ) xCount; x++ )
+                        {
+                            memcpy( xItems[ x ].pvPayload, &ulSent, sizeof( ulSent ) );
+                            xItems[ x ].xAddress = xEchoServer;
+                        }
+
+                        x = ( uint32_t ) xUDPBatchSendTo( xTxSocket, xItems, xCount );
+                        vUDPBatchRelease( &xItems[ x ], xCount - ( BaseType_t ) x );
+                        xCount = ( BaseType_t ) x;
+                    }
+                    else
+                    {
+                        for( x = 0; x < selPPS_BURST; x++ )
+                        {
+                            memcpy( ucPayload, &ulSent, sizeof( ulSent ) );
+
+                            if( FreeRTOS_sendto( xTxSocket, ucPayload, xSizes[ xSize ], 0, &xEchoServer, sizeof( xEchoServer ) ) > 0 )
+                            {
+                                xCount++;
+                            }
+                        }
+                    }
+
+                    if( xCount == 0 )
+                    {
+                        /* Out of network buffers for a whole send timeout */
+                        break;
+                    }
+
+                    ulSent += ( uint32_t ) xCount;
+
+                    /* Drain what arrived, so that the stack does not run out of
+                     * buffers holding unread datagrams */
+                    while( ulReceived < ulSent )
+                    {
+                        if( FreeRTOS_select( xFD_Set, selPPS_RX_TIMEOUT ) == 0 )
+                        {
+                            break;
+                        }
+
+                        ulReceived += prvPpsReceive( xFD_Set, xPpsSockets, xBatch );
+                    }
+                }
+
+                ullCycles = get_cycle_count() - ullCycles;
+
+                FreeRTOS_printf( ( "UDP pps %s %u bytes: %u sent, %u received, %u pps, %u cycles/datagram\n",
+                                   ( xBatch != pdFALSE ) ? "batch" : "single", ( unsigned ) xSizes[ xSize ],
+                                   ( unsigned ) ulSent, ( unsigned ) ulReceived,
+                                   ( unsigned ) ( ( ullCycles != 0 ) ? ( ( uint64_t ) ulReceived * configCPU_CLOCK_HZ / ullCycles ) : 0 ),
+                                   ( unsigned ) ( ( ulReceived != 0 ) ? ( ullCycles / ulReceived ) : 0 ) ) );
+            }
+        }
+
+        for( x = 0; x < selNUMBER_OF_SOCKETS; x++ )
+        {
+            FreeRTOS_FD_CLR( xPpsSockets[ x ], xFD_Set, eSELECT_READ );
+            FreeRTOS_closesocket( xPpsSockets[ x ] );
+        }
+
+        FreeRTOS_DeleteSocketSet( xFD_Set );
+
+        vTaskDelete( NULL );
+    }
+/*-----------------------------------------------------------*/
+
 /* The whole file is excluded if select() is not being supported. */
 #endif /* ipconfigSUPPORT_SELECT_FUNCTION */
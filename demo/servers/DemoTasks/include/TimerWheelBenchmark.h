@@ -0,0 +1,12 @@
+#ifndef TIMER_WHEEL_BENCHMARK_H
+#define TIMER_WHEEL_BENCHMARK_H
+
+/*
+ * One-shot benchmark of the timer wheel (timer_wheel.h): the cost of starting
+ * and stopping timers as their number grows, against FreeRTOS software timers,
+ * then the lateness of thousands of timers firing.
+ */
+void vStartTimerWheelBenchmarkTask( uint16_t usStackSize,
+                                    UBaseType_t uxPriority );
+
+#endif /* TIMER_WHEEL_BENCHMARK_H */
@@ -75,4 +75,11 @@ void vStartUDPSelectServerTasks( uint16_t usStackSize,
                                  UBaseType_t uxPriority );
 BaseType_t xAreUDPSelectTasksStillRunning( void );
 
+/* One-shot datagrams per second benchmark against the UDP echo server at
+ * configECHO_SERVER_ADDR0..3, single vs. batched send/receive */
+void vStartUDPPpsBenchmarkTask( uint16_t usStackSize,
+                                uint32_t ulFirstPortNumber,
+                                uint32_t ulEchoPort,
+                                UBaseType_t uxPriority );
+
 #endif /* UDP_SELECT_SERVER_H */
@@ -118,6 +118,15 @@
     static void prvStoreLowest( uint32_t * pulCurrentValue,
                                 uint32_t ulCount );
 
+/*
+ * Each row in the xIPTraceValues[] table contains a pointer to a function that
+ * updates the value for that row.  Rows that latch the highest value point to
+ * this function (for example, the longest time a task waited for a network
+ * buffer).
+ */
+    static void prvStoreHighest( uint32_t * pulCurrentValue,
+                                 uint32_t ulCount );
+
 /*
  * Each row in the xIPTraceValues[] table contains a pointer to a function that
  * updates the value for that row.  Rows that simply increment an event count
@@ -153,7 +162,15 @@
         { iptraceID_WAIT_FOR_TX_DMA_DESCRIPTOR,      "Number of times task had to wait to obtain a DMA Tx descriptor", prvIncrementEventCount, 0        },
         { iptraceID_FAILED_TO_NOTIFY_SELECT_GROUP,   "Failed to notify select group",                                  prvIncrementEventCount, 0        },
         { iptraceID_TOTAL_NETWORK_BUFFERS_OBTAINED,  "Total network buffers obtained",                                 prvIncrementEventCount, 0        },
-        { iptraceID_TOTAL_NETWORK_BUFFERS_RELEASED,  "Total network buffers released",                                 prvIncrementEventCount, 0        }
+        { iptraceID_TOTAL_NETWORK_BUFFERS_RELEASED,  "Total network buffers released",                                 prvIncrementEventCount, 0        },
+        { iptraceID_NETWORK_BUFFER_WAITS,            "Count of times a task blocked on an exhausted buffer pool",      prvIncrementEventCount, 0        },
+        { iptraceID_NETWORK_BUFFER_LONGEST_WAIT,     "Longest wait for a network buffer (cycles)",                     prvStoreHighest,        0        },
+        { iptraceID_ARP_CACHE_HIT,                   "ARP lookups served by the hashed cache",                         prvIncrementEventCount, 0        },
+        { iptraceID_ARP_CACHE_MISS,                  "ARP lookups that fell back to the ARP table",                    prvIncrementEventCount, 0        },
+        { iptraceID_ARP_CACHE_STALL,                 "ARP lookups that had to wait for resolution",                    prvIncrementEventCount, 0        },
+        { iptraceID_ARP_CACHE_REFRESH,               "ARP entries refreshed before they expired",                      prvIncrementEventCount, 0        },
+        { iptraceID_UDP_FAST_TX,                     "UDP datagrams sent directly to the driver",                      prvIncrementEventCount, 0        },
+        { iptraceID_UDP_FAST_TX_FALLBACK,            "UDP datagrams the direct path left to the IP task",              prvIncrementEventCount, 0        }
     };
 
 /*-----------------------------------------------------------*/
@@ -218,5 +235,15 @@
     }
 /*-----------------------------------------------------------*/
 
+    static void prvStoreHighest( uint32_t * pulCurrentValue,
+                                 uint32_t ulCount )
+    {
+        if( ulCount > *pulCurrentValue )
+        {
+            *pulCurrentValue = ulCount;
+        }
+    }
+/*-----------------------------------------------------------*/
+
 
 #endif /* configINCLUDE_DEMO_DEBUG_STATS == 1 */
@@ -132,6 +132,14 @@ typedef struct ExampleDebugStatEntry
 #define iptraceID_FAILED_TO_NOTIFY_SELECT_GROUP       18
 #define iptraceID_TOTAL_NETWORK_BUFFERS_OBTAINED      19
 #define iptraceID_TOTAL_NETWORK_BUFFERS_RELEASED      20
+#define iptraceID_NETWORK_BUFFER_WAITS                21
+#define iptraceID_NETWORK_BUFFER_LONGEST_WAIT         22
+#define iptraceID_ARP_CACHE_HIT                       23
+#define iptraceID_ARP_CACHE_MISS                      24
+#define iptraceID_ARP_CACHE_STALL                     25
+#define iptraceID_ARP_CACHE_REFRESH                   26
+#define iptraceID_UDP_FAST_TX                         27
+#define iptraceID_UDP_FAST_TX_FALLBACK                28
 
 /* It is possible to remove the trace macros using the
  * configINCLUDE_DEMO_DEBUG_STATS setting in FreeRTOSIPConfig.h. */
@@ -143,6 +151,16 @@ typedef struct ExampleDebugStatEntry
     #define iptraceNETWORK_BUFFER_OBTAINED( pxBufferAddress )             vExampleDebugStatUpdate( iptraceID_NETWORK_BUFFER_OBTAINED, uxQueueMessagesWaiting( ( QueueHandle_t ) xNetworkBufferSemaphore ) ); vExampleDebugStatUpdate( iptraceID_TOTAL_NETWORK_BUFFERS_OBTAINED, 0 )
     #define iptraceNETWORK_BUFFER_RELEASED( pxBufferAddress )             vExampleDebugStatUpdate( iptraceID_TOTAL_NETWORK_BUFFERS_RELEASED, 0 )
     #define iptraceNETWORK_BUFFER_OBTAINED_FROM_ISR( pxBufferAddress )    vExampleDebugStatUpdate( iptraceID_NETWORK_BUFFER_OBTAINED, uxQueueMessagesWaiting( ( QueueHandle_t ) xNetworkBufferSemaphore ) )
+    /* Only raised by the static pool (bsp/net_buffer_pool.c) when it had to block */
+    #define iptraceNETWORK_BUFFER_WAIT( ulCycles )                        vExampleDebugStatUpdate( iptraceID_NETWORK_BUFFER_WAITS, 0 ); vExampleDebugStatUpdate( iptraceID_NETWORK_BUFFER_LONGEST_WAIT, ulCycles )
+    /* Only raised by the hashed ARP front cache (bsp/arp_cache.c) */
+    #define iptraceARP_CACHE_HIT( ulIPAddress )                           vExampleDebugStatUpdate( iptraceID_ARP_CACHE_HIT, 0 )
+    #define iptraceARP_CACHE_MISS( ulIPAddress )                          vExampleDebugStatUpdate( iptraceID_ARP_CACHE_MISS, 0 )
+    #define iptraceARP_CACHE_STALL( ulIPAddress )                         vExampleDebugStatUpdate( iptraceID_ARP_CACHE_STALL, 0 )
+    #define iptraceARP_CACHE_REFRESH( ulIPAddress )                       vExampleDebugStatUpdate( iptraceID_ARP_CACHE_REFRESH, 0 )
+    /* Only raised by the direct UDP transmit path (bsp/udp_fast_tx.c) */
+    #define iptraceUDP_FAST_TX( ulIPAddress )                             vExampleDebugStatUpdate( iptraceID_UDP_FAST_TX, 0 )
+    #define iptraceUDP_FAST_TX_FALLBACK( ulIPAddress )                    vExampleDebugStatUpdate( iptraceID_UDP_FAST_TX_FALLBACK, 0 )
 
     #define iptraceNETWORK_EVENT_RECEIVED( eEvent )                           \
     {                                                                         \
@@ -0,0 +1,376 @@
+#!/usr/bin/python3
+
+#-
+# SPDX-License-Identifier: BSD-2-Clause
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+# ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+# FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+# DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+# OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+# HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+# OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+# SUCH DAMAGE.
+#
+
+# Turns a kernel event trace (bsp/event_trace.h) into Chrome trace event JSON,
+# which ui.perfetto.dev and chrome://tracing open, and prints scheduling
+# latency and priority inheritance figures per task.
+#
+# The trace comes from a file the target wrote ("event-trace file
+# /ram/trace.bin" on the CLI, then fetch it over FTP or TFTP):
+#
+#   ./etrace2perfetto.py --file trace.bin --out trace.json
+#
+# or straight from the target ("event-trace udp <host ip> 5021" on the CLI):
+#
+#   ./etrace2perfetto.py --listen 5021 --duration 10 --save trace.bin --out trace.json
+#
+# Every task gets a track with the slices it ran in, the time it spent ready
+# before it ran, and the time it ran with an inherited priority; every hart
+# gets a track with the task it ran, and one with the interrupts it took.
+# Queue operations, delays and markers are instants on the task or interrupt
+# they happened in. Cycles are turned into time with a line fitted through
+# the SYNC records, so that a cycle counter that does not run at its nominal
+# rate, as under QEMU, still gives wall-clock times.
+
+import argparse
+import json
+import socket
+import struct
+import sys
+import time
+
+MAGIC = 0x31525445
+VERSION = 1
+
+RECORD_INFO = 1
+RECORD_SYNC = 2
+RECORD_NAME = 3
+RECORD_EVENTS = 4
+RECORD_LOST = 5
+
+# Event ids, event_trace_hooks.h, and their names as the CLI spells them
+EVENTS = ['none', 'switch', 'ready', 'delay', 'delay-until', 'create', 'delete', 'inherit', 'disinherit',
+          'send', 'send-isr', 'receive', 'receive-isr', 'block-send', 'block-receive', 'irq', 'irq-exit',
+          'tick', 'marker']
+EVENT = {name: number for number, name in enumerate(EVENTS)}
+
+QUEUE_EVENTS = {EVENT[name] for name in ('send', 'send-isr', 'receive', 'receive-isr', 'block-send', 'block-receive')}
+
+CHUNK_HEADER = struct.Struct('<IIHH')
+RECORD = struct.Struct('<QIIBB')
+
+PID_TASKS = 1
+PID_HARTS = 2
+PID_IRQS = 3
+
+parser = argparse.ArgumentParser(description='Kernel event trace to Perfetto / Chrome trace JSON.')
+parser.add_argument("--file", help="A trace the target wrote to a file")
+parser.add_argument("--listen", help="UDP port to receive the trace on instead", type=int)
+parser.add_argument("--duration", help="Seconds to listen, 0 until interrupted", type=float, default=0)
+parser.add_argument("--save", help="Also write the received chunks here, for --file later")
+parser.add_argument("--out", help="Trace event JSON, not written if not given")
+parser.add_argument("--ticks", help="Show tick interrupts as instants", action='store_true')
+parser.add_argument("--events", help="Print every event as well", action='store_true')
+
+args = parser.parse_args()
+
+if (args.file is None) == (args.listen is None):
+    parser.error("one of --file and --listen is needed")
+
+
+class Trace:
+    def __init__(self):
+        self.rate = 0
+        self.syncs = []
+        self.names = {}
+        self.records = []
+        self.lost = 0
+        self.lost_chunks = 0
+        self.bad_chunks = 0
+        self.last_seq = None
+
+    def chunk(self, data):
+        if len(data) < CHUNK_HEADER.size:
+            self.bad_chunks += 1
+            return
+        magic, seq, length, records = CHUNK_HEADER.unpack_from(data)
+        if magic != MAGIC or length > len(data):
+            self.bad_chunks += 1
+            return
+
+        # The sequence starts again at 0 with every "event-trace" start
+        if self.last_seq is not None and seq > self.last_seq + 1:
+            self.lost_chunks += seq - self.last_seq - 1
+        self.last_seq = seq
+
+        offset = CHUNK_HEADER.size
+        for _ in range(records):
+            kind = data[offset]
+            if kind == RECORD_INFO:
+                version, _, self.rate = struct.unpack_from('<BHI', data, offset + 1)
+                if version != VERSION:
+                    sys.exit("Unknown trace version %d" % version)
+                offset += 8
+            elif kind == RECORD_SYNC:
+                self.syncs.append(struct.unpack_from('<QQ', data, offset + 4))
+                offset += 20
+            elif kind == RECORD_NAME:
+                name_length, task = struct.unpack_from('<BI', data, offset + 1)
+                self.names[task] = data[offset + 6:offset + 6 + name_length].decode('ascii', 'replace')
+                offset += 6 + name_length
+            elif kind == RECORD_EVENTS:
+                _, count = struct.unpack_from('<BH', data, offset + 1)
+                offset += 4
+                for _ in range(count):
+                    self.records.append(RECORD.unpack_from(data, offset))
+                    offset += RECORD.size
+            elif kind == RECORD_LOST:
+                self.lost += struct.unpack_from('<I', data, offset + 4)[0]
+                offset += 8
+            else:
+                self.bad_chunks += 1
+                return
+
+    def clock(self):
+        """Cycles to nanoseconds, from the SYNC records or the nominal rate"""
+        syncs = sorted(set(self.syncs))
+        if len(syncs) >= 2 and syncs[-1][0] > syncs[0][0]:
+            n = len(syncs)
+            mean_c = sum(c for c, _ in syncs) / n
+            mean_t = sum(t for _, t in syncs) / n
+            var = sum((c - mean_c) ** 2 for c, _ in syncs)
+            slope = sum((c - mean_c) * (t - mean_t) for c, t in syncs) / var
+            return lambda cycles: mean_t + (cycles - mean_c) * slope
+        rate = self.rate or 100000000
+        if syncs:
+            c0, t0 = syncs[0]
+            return lambda cycles: t0 + (cycles - c0) * 1e9 / rate
+        return lambda cycles: cycles * 1e9 / rate
+
+
+def receive(trace):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind(('', args.listen))
+    sock.settimeout(1.0)
+    save = open(args.save, 'wb') if args.save else None
+    started = time.monotonic()
+
+    try:
+        while not args.duration or time.monotonic() - started < args.duration:
+            try:
+                datagram, _ = sock.recvfrom(65536)
+            except socket.timeout:
+                continue
+            trace.chunk(datagram)
+            if save:
+                save.write(datagram)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        if save:
+            save.close()
+
+
+def read(trace):
+    with open(args.file, 'rb') as f:
+        data = f.read()
+
+    offset = 0
+    while offset + CHUNK_HEADER.size <= len(data):
+        length = CHUNK_HEADER.unpack_from(data, offset)[2]
+        if length < CHUNK_HEADER.size:
+            trace.bad_chunks += 1
+            break
+        trace.chunk(data[offset:offset + length])
+        offset += length
+
+
+def percentile(values, fraction):
+    return values[min(len(values) - 1, int(fraction * len(values)))]
+
+
+class Timeline:
+    def __init__(self, trace):
+        self.trace = trace
+        self.out = []
+        self.tids = {}
+        self.running = {}      # hart -> (task, start)
+        self.irqs = {}         # hart -> [(source, start)]
+        self.ready = {}        # task -> time it became ready
+        self.inherited = {}    # task -> (priority, start)
+        self.priority = {}
+        self.latency = {}
+        self.inversions = {}
+        self.run_time = {}
+        self.switches = {}
+        self.harts = set()
+        self.queues = set()
+
+    def task_name(self, task):
+        return self.trace.names.get(task, 'task 0x%08x' % task)
+
+    def tid(self, task):
+        if task not in self.tids:
+            self.tids[task] = len(self.tids) + 1
+            self.out.append({'ph': 'M', 'name': 'thread_name', 'pid': PID_TASKS, 'tid': self.tids[task],
+                             'args': {'name': self.task_name(task)}})
+        return self.tids[task]
+
+    def slice(self, pid, tid, name, start, end, **extra):
+        self.out.append({'ph': 'X', 'name': name, 'pid': pid, 'tid': tid, 'ts': start, 'dur': max(end - start, 0),
+                         'args': extra})
+
+    def instant(self, pid, tid, name, ts, **extra):
+        self.out.append({'ph': 'i', 's': 't', 'name': name, 'pid': pid, 'tid': tid, 'ts': ts, 'args': extra})
+
+    def set_priority(self, task, priority, ts):
+        if self.priority.get(task) != priority:
+            self.priority[task] = priority
+            self.out.append({'ph': 'C', 'name': 'priority ' + self.task_name(task), 'pid': PID_TASKS, 'ts': ts,
+                             'args': {'priority': priority}})
+
+    def context(self, hart):
+        """Where an instant goes: the interrupt being handled or the running task"""
+        if self.irqs.get(hart):
+            return PID_IRQS, hart
+        if hart in self.running:
+            return PID_TASKS, self.tid(self.running[hart][0])
+        return PID_HARTS, hart
+
+    def end_run(self, hart, ts):
+        if hart in self.running:
+            task, start = self.running.pop(hart)
+            self.slice(PID_TASKS, self.tid(task), 'running', start, ts, hart=hart)
+            self.slice(PID_HARTS, hart, self.task_name(task), start, ts)
+            self.run_time[task] = self.run_time.get(task, 0) + ts - start
+
+    def event(self, ts, event, obj, arg, hart):
+        if hart not in self.harts:
+            self.harts.add(hart)
+            self.out.append({'ph': 'M', 'name': 'thread_name', 'pid': PID_HARTS, 'tid': hart,
+                             'args': {'name': 'hart %d' % hart}})
+            self.out.append({'ph': 'M', 'name': 'thread_name', 'pid': PID_IRQS, 'tid': hart,
+                             'args': {'name': 'hart %d interrupts' % hart}})
+
+        if event == EVENT['switch']:
+            if self.running.get(hart, (None,))[0] == obj:
+                return
+            self.end_run(hart, ts)
+            self.running[hart] = (obj, ts)
+            self.switches[obj] = self.switches.get(obj, 0) + 1
+            self.set_priority(obj, arg, ts)
+            if obj in self.ready:
+                became_ready = self.ready.pop(obj)
+                self.slice(PID_TASKS, self.tid(obj), 'ready', became_ready, ts)
+                self.latency.setdefault(obj, []).append(ts - became_ready)
+        elif event == EVENT['ready']:
+            if obj not in self.ready and all(task != obj for task, _ in self.running.values()):
+                self.ready[obj] = ts
+            self.set_priority(obj, arg, ts)
+        elif event == EVENT['inherit']:
+            self.instant(PID_TASKS, self.tid(obj), 'inherits priority %d' % arg, ts)
+            if obj not in self.inherited:
+                self.inherited[obj] = (self.priority.get(obj), ts)
+            self.set_priority(obj, arg, ts)
+        elif event == EVENT['disinherit']:
+            self.instant(PID_TASKS, self.tid(obj), 'back to priority %d' % arg, ts)
+            if obj in self.inherited:
+                _, start = self.inherited.pop(obj)
+                self.slice(PID_TASKS, self.tid(obj), 'inherited priority', start, ts)
+                self.inversions.setdefault(obj, []).append(ts - start)
+            self.set_priority(obj, arg, ts)
+        elif event in (EVENT['delay'], EVENT['delay-until']):
+            self.instant(PID_TASKS, self.tid(obj), EVENTS[event], ts, ticks=arg)
+        elif event == EVENT['create']:
+            self.instant(PID_TASKS, self.tid(obj), 'created', ts, priority=arg)
+            self.set_priority(obj, arg, ts)
+        elif event == EVENT['delete']:
+            self.instant(PID_TASKS, self.tid(obj), 'deleted', ts)
+            self.ready.pop(obj, None)
+        elif event in QUEUE_EVENTS:
+            pid, tid = self.context(hart)
+            self.queues.add(obj)
+            self.instant(pid, tid, '%s 0x%08x' % (EVENTS[event], obj), ts, queue='0x%08x' % obj, waiting=arg)
+        elif event == EVENT['irq']:
+            self.irqs.setdefault(hart, []).append((arg, ts))
+        elif event == EVENT['irq-exit']:
+            stack = self.irqs.get(hart)
+            if stack:
+                source, start = stack.pop()
+                self.slice(PID_IRQS, hart, 'irq %d' % source, start, ts, source=source)
+        elif event == EVENT['tick']:
+            if args.ticks:
+                self.instant(PID_HARTS, hart, 'tick', ts, tick=arg)
+        elif event == EVENT['marker']:
+            pid, tid = self.context(hart)
+            self.instant(pid, tid, 'marker', ts, object='0x%08x' % obj, argument=arg)
+
+    def finish(self, ts):
+        for hart in list(self.running):
+            self.end_run(hart, ts)
+        for hart, stack in self.irqs.items():
+            for source, start in stack:
+                self.slice(PID_IRQS, hart, 'irq %d' % source, start, ts, source=source)
+
+        for pid, name in ((PID_TASKS, 'Tasks'), (PID_HARTS, 'Harts'), (PID_IRQS, 'Interrupts')):
+            self.out.append({'ph': 'M', 'name': 'process_name', 'pid': pid, 'args': {'name': name}})
+
+
+trace = Trace()
+if args.file:
+    read(trace)
+else:
+    receive(trace)
+
+if not trace.records:
+    sys.exit("No events")
+
+to_ns = trace.clock()
+records = sorted(trace.records, key=lambda record: record[0])
+origin = to_ns(records[0][0])
+
+timeline = Timeline(trace)
+for cycles, obj, arg, event, hart in records:
+    ts = (to_ns(cycles) - origin) / 1000.0
+    if args.events:
+        print("%14.3f us  hart %d  %-13s 0x%08x %u" % (ts, hart, EVENTS[event] if event < len(EVENTS) else event,
+                                                       obj, arg))
+    timeline.event(ts, event, obj, arg, hart)
+
+span = (to_ns(records[-1][0]) - origin) / 1000.0
+timeline.finish(span)
+
+if args.out:
+    with open(args.out, 'w') as f:
+        json.dump({'traceEvents': timeline.out, 'displayTimeUnit': 'ns',
+                   'otherData': {'lost': trace.lost, 'lost_chunks': trace.lost_chunks}}, f)
+
+print("%d events over %.3f ms, %d lost on the target, %d chunks lost, %d bad, %d SYNC records" %
+      (len(records), span / 1000.0, trace.lost, trace.lost_chunks, trace.bad_chunks, len(trace.syncs)))
+print()
+print("%-16s %7s %7s %9s %9s %9s %9s %9s" % ('task', 'run %', 'runs', 'ready', 'mean us', 'p99 us', 'max us',
+                                            'inherit'))
+for task in sorted(timeline.tids, key=lambda task: -timeline.run_time.get(task, 0)):
+    latency = sorted(timeline.latency.get(task, []))
+    inversions = timeline.inversions.get(task, [])
+    print("%-16s %7.2f %7d %9d %9s %9s %9s %9s" % (
+        timeline.task_name(task)[:16], 100.0 * timeline.run_time.get(task, 0) / span if span else 0,
+        timeline.switches.get(task, 0), len(latency),
+        '%.1f' % (sum(latency) / len(latency)) if latency else '-',
+        '%.1f' % percentile(latency, 0.99) if latency else '-',
+        '%.1f' % latency[-1] if latency else '-',
+        '%d/%.0fus' % (len(inversions), max(inversions)) if inversions else '-'))
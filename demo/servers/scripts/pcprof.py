@@ -0,0 +1,275 @@
+#!/usr/bin/python3
+
+#-
+# SPDX-License-Identifier: BSD-2-Clause
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+# ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+# FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+# DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+# OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+# HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+# OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+# SUCH DAMAGE.
+#
+
+# Symbolizes the samples of the PC-sampling profiler (bsp/pc_profiler.h)
+# against the ELF and writes a flat profile and flame graph input.
+#
+# Samples come from a file the target wrote ("profile file /ram/prof.bin" on
+# the CLI, then fetch it over FTP or TFTP):
+#
+#   ./pcprof.py --elf build/RISC-V-Generic_main_servers.elf --file prof.bin \
+#       --folded prof.folded
+#
+# or straight from the target ("profile udp <host ip> 5020" on the CLI):
+#
+#   ./pcprof.py --elf ... --listen 5020 --duration 30 --save prof.bin --folded prof.folded
+#
+# The folded output has one line per task;[compartment];function and a count,
+# for flamegraph.pl or speedscope. Without call stacks every sample is one
+# frame deep. Pcs in compartments loaded at run time are not in the ELF and
+# are kept as addresses.
+
+import argparse
+import bisect
+import collections
+import socket
+import struct
+import subprocess
+import sys
+import time
+
+MAGIC = 0x31504350
+VERSION = 1
+
+RECORD_INFO = 1
+RECORD_TASK = 2
+RECORD_SAMPLES = 3
+RECORD_DROPPED = 4
+
+NO_COMPARTMENT = 0xffff
+NO_TASK = 0xff
+FLAG_SCHEDULER_SUSPENDED = 0x01
+
+CHUNK_HEADER = struct.Struct('<IIHH')
+SAMPLE = struct.Struct('<QIHBB')
+
+parser = argparse.ArgumentParser(description='Symbolizer for the PC-sampling profiler.')
+parser.add_argument("--elf", help="The image the target runs, to symbolize against")
+parser.add_argument("--file", help="Samples the target wrote to a file")
+parser.add_argument("--listen", help="UDP port to receive samples on instead", type=int)
+parser.add_argument("--duration", help="Seconds to listen, 0 until interrupted", type=float, default=0)
+parser.add_argument("--save", help="Also write the received chunks here, for --file later")
+parser.add_argument("--folded", help="Flame graph input (folded stacks), not written if not given")
+parser.add_argument("--lines", help="Resolve to source lines as well as functions", action='store_true')
+parser.add_argument("--top", help="Functions in the flat profile", type=int, default=30)
+parser.add_argument("--nm", help="nm to read the symbols with", default='llvm-nm')
+parser.add_argument("--addr2line", help="addr2line for --lines", default='llvm-addr2line')
+
+args = parser.parse_args()
+
+if (args.file is None) == (args.listen is None):
+    parser.error("one of --file and --listen is needed")
+
+
+class Profile:
+    def __init__(self):
+        self.rate = 0
+        self.tasks = {}
+        self.samples = []
+        self.dropped = 0
+        self.lost_chunks = 0
+        self.bad_chunks = 0
+        self.last_seq = None
+
+    def chunk(self, data):
+        if len(data) < CHUNK_HEADER.size:
+            self.bad_chunks += 1
+            return
+        magic, seq, length, records = CHUNK_HEADER.unpack_from(data)
+        if magic != MAGIC or length > len(data):
+            self.bad_chunks += 1
+            return
+
+        # The sequence starts again at 0 with every "profile" start
+        if self.last_seq is not None and seq > self.last_seq + 1:
+            self.lost_chunks += seq - self.last_seq - 1
+        self.last_seq = seq
+
+        offset = CHUNK_HEADER.size
+        for _ in range(records):
+            kind = data[offset]
+            if kind == RECORD_INFO:
+                version, _, self.rate = struct.unpack_from('<BHI', data, offset + 1)
+                if version != VERSION:
+                    sys.exit("Unknown profile version %d" % version)
+                offset += 8
+            elif kind == RECORD_TASK:
+                index, name_length = struct.unpack_from('<BB', data, offset + 1)
+                self.tasks[index] = data[offset + 3:offset + 3 + name_length].decode('ascii', 'replace')
+                offset += 3 + name_length
+            elif kind == RECORD_SAMPLES:
+                _, count = struct.unpack_from('<BH', data, offset + 1)
+                offset += 4
+                for _ in range(count):
+                    self.samples.append(SAMPLE.unpack_from(data, offset))
+                    offset += SAMPLE.size
+            elif kind == RECORD_DROPPED:
+                self.dropped += struct.unpack_from('<I', data, offset + 4)[0]
+                offset += 8
+            else:
+                self.bad_chunks += 1
+                return
+
+
+class Symbols:
+    def __init__(self, elf):
+        self.starts = []
+        self.ends = []
+        self.names = []
+        self.elf = elf
+        self.lines = {}
+
+        if elf is None:
+            return
+
+        output = subprocess.run([args.nm, '-n', '-S', '--defined-only', elf],
+                                check=True, capture_output=True, text=True).stdout
+        for line in output.splitlines():
+            fields = line.split()
+            if len(fields) == 4:
+                address, size, kind, name = fields
+            elif len(fields) == 3:
+                address, kind, name = fields
+                size = None
+            else:
+                continue
+            if kind not in 'tTwW':
+                continue
+            start = int(address, 16)
+            self.starts.append(start)
+            self.ends.append(start + int(size, 16) if size else None)
+            self.names.append(name)
+
+    def function(self, pc):
+        i = bisect.bisect_right(self.starts, pc) - 1
+        if i < 0 or (self.ends[i] is not None and pc >= self.ends[i]):
+            return None
+        return self.names[i]
+
+    def resolve_lines(self, pcs):
+        if self.elf is None or not pcs:
+            return
+        pcs = sorted(pcs)
+        output = subprocess.run([args.addr2line, '-f', '-C', '-e', self.elf],
+                                input='\n'.join('0x%x' % pc for pc in pcs),
+                                check=True, capture_output=True, text=True).stdout.splitlines()
+        for pc, (function, location) in zip(pcs, zip(output[0::2], output[1::2])):
+            self.lines[pc] = '%s (%s)' % (function, location.rsplit('/', 1)[-1])
+
+
+def receive(profile):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind(('', args.listen))
+    sock.settimeout(1.0)
+    save = open(args.save, 'wb') if args.save else None
+    started = time.monotonic()
+
+    try:
+        while not args.duration or time.monotonic() - started < args.duration:
+            try:
+                datagram, _ = sock.recvfrom(65536)
+            except socket.timeout:
+                continue
+            profile.chunk(datagram)
+            if save:
+                save.write(datagram)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        if save:
+            save.close()
+
+
+def read(profile):
+    with open(args.file, 'rb') as f:
+        data = f.read()
+
+    offset = 0
+    while offset + CHUNK_HEADER.size <= len(data):
+        length = CHUNK_HEADER.unpack_from(data, offset)[2]
+        if length < CHUNK_HEADER.size:
+            profile.bad_chunks += 1
+            break
+        profile.chunk(data[offset:offset + length])
+        offset += length
+
+
+profile = Profile()
+if args.file:
+    read(profile)
+else:
+    receive(profile)
+
+if not profile.samples:
+    sys.exit("No samples")
+
+symbols = Symbols(args.elf)
+if args.lines:
+    symbols.resolve_lines({pc for pc, _, _, _, _ in profile.samples})
+
+functions = collections.Counter()
+stacks = collections.Counter()
+per_task = collections.Counter()
+suspended = 0
+
+for pc, tick, compartment, task, flags in profile.samples:
+    if args.lines and pc in symbols.lines:
+        frame = symbols.lines[pc]
+    else:
+        frame = symbols.function(pc) or '0x%x' % pc
+    task_name = profile.tasks.get(task, 'task %d' % task) if task != NO_TASK else '[other tasks]'
+
+    stack = [task_name]
+    if compartment != NO_COMPARTMENT:
+        stack.append('[compartment %d]' % compartment)
+    stack.append(frame)
+
+    functions[frame] += 1
+    stacks[';'.join(stack)] += 1
+    per_task[task_name] += 1
+    if flags & FLAG_SCHEDULER_SUSPENDED:
+        suspended += 1
+
+if args.folded:
+    with open(args.folded, 'w') as f:
+        for stack, count in sorted(stacks.items()):
+            f.write('%s %d\n' % (stack, count))
+
+total = len(profile.samples)
+seconds = total / profile.rate if profile.rate else 0
+
+print("%d samples (%.1f s at %d Hz), %d dropped on the target, %d chunks lost, %d bad, "
+      "%d with the scheduler suspended" % (total, seconds, profile.rate, profile.dropped,
+                                          profile.lost_chunks, profile.bad_chunks, suspended))
+print()
+print("%7s %6s  %s" % ('samples', '%', 'task'))
+for name, count in per_task.most_common():
+    print("%7d %6.2f  %s" % (count, 100.0 * count / total, name))
+print()
+print("%7s %6s  %s" % ('samples', '%', 'function'))
+for name, count in functions.most_common(args.top):
+    print("%7d %6.2f  %s" % (count, 100.0 * count / total, name))
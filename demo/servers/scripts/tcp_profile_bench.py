@@ -0,0 +1,149 @@
+#!/usr/bin/python3
+
+#-
+# SPDX-License-Identifier: BSD-2-Clause
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+# ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+# FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+# DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+# OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+# HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+# OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+# SUCH DAMAGE.
+#
+
+# Throughput and RAM of one main_servers build, configured with
+# ./waf configure --tcp-profile=<profile>. Run once per profile (with the
+# same --csv file) to compare them:
+#
+#   ./tcp_profile_bench.py --server 10.0.2.15 --elf build/RISC-V-Generic_main_servers.elf \
+#       --serial-log qemu.log --csv profiles.csv
+#
+# Throughput is an FTP upload (STOR) and an HTTP download (GET) of the same
+# file. RAM is the static .data/.bss/.netbufs footprint from the ELF plus the
+# heap low water mark and network buffer low water mark the firmware prints.
+
+import argparse
+import csv
+import os
+import re
+import statistics
+import subprocess
+import time
+import urllib.request
+from ftplib import FTP
+
+parser = argparse.ArgumentParser(description='Benchmark a FreeRTOS+TCP profile.')
+parser.add_argument("--server", help="Server/host IP address", default='127.0.0.1')
+parser.add_argument("--ftp-port", help="FTP port in the server", type=int, default=21)
+parser.add_argument("--http-port", help="HTTP port in the server", type=int, default=80)
+parser.add_argument("--sizes", help="Comma separated transfer sizes in bytes",
+                    default='65536,1048576')
+parser.add_argument("--runs", help="Transfers per size (median is reported)", type=int, default=5)
+parser.add_argument("--elf", help="Firmware ELF, for static RAM usage")
+parser.add_argument("--size-tool", help="size(1) compatible tool", default='llvm-size')
+parser.add_argument("--serial-log", help="Firmware console log, for the profile and low water marks")
+parser.add_argument("--csv", help="Append the results to this CSV file")
+
+args = parser.parse_args()
+
+REMOTE_DIR = '/ram/websrc/'
+REMOTE_NAME = 'tcpbench.bin'
+
+
+def ftp_upload(data):
+    ftp = FTP()
+    ftp.connect(args.server, args.ftp_port)
+    ftp.login()
+    ftp.set_pasv(True)
+    with open(REMOTE_NAME, 'wb') as f:
+        f.write(data)
+    with open(REMOTE_NAME, 'rb') as f:
+        start = time.time()
+        ftp.storbinary('STOR ' + REMOTE_DIR + REMOTE_NAME, f)
+        end = time.time()
+    ftp.quit()
+    os.remove(REMOTE_NAME)
+    return end - start
+
+
+def http_download(size):
+    url = 'http://%s:%d/%s' % (args.server, args.http_port, REMOTE_NAME)
+    start = time.time()
+    with urllib.request.urlopen(url, timeout=60) as resp:
+        got = len(resp.read())
+    end = time.time()
+    if got != size:
+        raise RuntimeError('HTTP returned %d bytes, expected %d' % (got, size))
+    return end - start
+
+
+def static_ram(elf):
+    # Berkeley format does not split out .netbufs, use the SysV listing
+    out = subprocess.check_output([args.size_tool, '-A', elf], text=True)
+    total = 0
+    for line in out.splitlines():
+        fields = line.split()
+        if len(fields) >= 2 and fields[0] in ('.data', '.sdata', '.bss', '.sbss', '.netbufs'):
+            total += int(fields[1])
+    return total
+
+
+def serial_stats(log):
+    stats = {}
+    with open(log, errors='replace') as f:
+        for line in f:
+            m = re.search(r'TCP profile (\d+): MTU (\d+), (\d+) network buffers, (\d+) window segments, '
+                          r'(\d+)/(\d+) byte', line)
+            if m:
+                stats.update(profile=int(m.group(1)), mtu=int(m.group(2)), buffers=int(m.group(3)),
+                             win_segs=int(m.group(4)), rx_buf=int(m.group(5)), tx_buf=int(m.group(6)))
+            m = re.search(r'TCP profile \d+: heap min free (\d+), network buffers min free (\d+)', line)
+            if m:
+                # Keep the last (lowest) sample
+                stats.update(heap_min_free=int(m.group(1)), buffers_min_free=int(m.group(2)))
+    return stats
+
+
+results = []
+
+for size in [int(s) for s in args.sizes.split(',')]:
+    data = os.urandom(size)
+    up = statistics.median(ftp_upload(data) for _ in range(args.runs))
+    down = statistics.median(http_download(size) for _ in range(args.runs))
+    results.append({'size': size,
+                    'ftp_up_kib_s': round(size / 1024 / up, 2),
+                    'http_down_kib_s': round(size / 1024 / down, 2)})
+
+extra = {}
+if args.elf:
+    extra['static_ram'] = static_ram(args.elf)
+if args.serial_log:
+    extra.update(serial_stats(args.serial_log))
+
+for r in results:
+    r.update(extra)
+    print(', '.join('%s=%s' % (k, v) for k, v in r.items()))
+
+if args.csv:
+    fields = ['profile', 'mtu', 'buffers', 'win_segs', 'rx_buf', 'tx_buf', 'size', 'ftp_up_kib_s',
+              'http_down_kib_s', 'static_ram', 'heap_min_free', 'buffers_min_free']
+    new_file = not os.path.exists(args.csv)
+    with open(args.csv, 'a', newline='') as f:
+        writer = csv.DictWriter(f, fieldnames=fields, extrasaction='ignore')
+        if new_file:
+            writer.writeheader()
+        writer.writerows(results)
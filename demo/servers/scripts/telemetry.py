@@ -0,0 +1,243 @@
+#!/usr/bin/python3
+
+#-
+# SPDX-License-Identifier: BSD-2-Clause
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+# ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+# FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+# DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+# OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+# HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+# OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+# SUCH DAMAGE.
+#
+
+# Subscribes to the binary telemetry of main_servers (demo/servers/telemetry.h,
+# mainCREATE_TELEMETRY_SERVER) and writes the snapshots as CSV: one row per
+# snapshot with the system, HPM and IP trace counters, and optionally one row
+# per task per snapshot.
+#
+#   ./telemetry.py --server 10.88.88.2 --interval-ms 50 --duration 60 \
+#       --out system.csv --tasks-out tasks.csv
+#
+# Counters are written as the target reports them, cumulative; --hpm-deltas
+# writes the HPM counters as the change since the previous snapshot instead.
+# Lost datagrams show up as gaps in the sequence numbers and are counted on
+# stderr at the end.
+
+import argparse
+import csv
+import socket
+import struct
+import sys
+import time
+
+MAGIC = 0x314D4C54
+SUBSCRIBE_MAGIC = 0x534D4C54
+VERSION = 1
+FLAG_TRUNCATED = 0x01
+
+SECTION_SYSTEM = 1
+SECTION_TASKS = 2
+SECTION_HPM = 3
+SECTION_IPTRACE = 4
+SECTION_HPM_NAMES = 16
+SECTION_IPTRACE_NAMES = 17
+
+SECTIONS = {'system': SECTION_SYSTEM, 'tasks': SECTION_TASKS, 'hpm': SECTION_HPM, 'iptrace': SECTION_IPTRACE}
+TASK_STATES = ['running', 'ready', 'blocked', 'suspended', 'deleted', 'invalid']
+
+# Renew the subscription well within the target's lease (configTELEMETRY_LEASE_MS)
+RENEW_S = 10
+
+parser = argparse.ArgumentParser(description='CSV recorder for the main_servers binary telemetry.')
+parser.add_argument("--server", help="Target IP address", default='127.0.0.1')
+parser.add_argument("--port", help="Telemetry UDP port in the target", type=int, default=5010)
+parser.add_argument("--interval-ms", help="Time between snapshots", type=int, default=100)
+parser.add_argument("--sections", help="Comma separated sections to ask for (" + ','.join(SECTIONS) + ")",
+                    default=','.join(SECTIONS))
+parser.add_argument("--duration", help="Seconds to record, 0 until interrupted", type=float, default=0)
+parser.add_argument("--count", help="Snapshots to record, 0 for no limit", type=int, default=0)
+parser.add_argument("--out", help="System CSV, stdout if not given")
+parser.add_argument("--tasks-out", help="Per-task CSV, not written if not given")
+parser.add_argument("--hpm-deltas", help="Write HPM counters as differences between snapshots",
+                    action='store_true')
+parser.add_argument("--timeout", help="Give up after this many seconds without a datagram", type=float, default=5.0)
+
+args = parser.parse_args()
+
+
+class Reader:
+    def __init__(self, data):
+        self.data = data
+        self.offset = 0
+
+    def take(self, fmt):
+        values = struct.unpack_from('<' + fmt, self.data, self.offset)
+        self.offset += struct.calcsize('<' + fmt)
+        return values if len(values) > 1 else values[0]
+
+    def array(self, code):
+        count = self.take('H')
+        values = struct.unpack_from('<%d%s' % (count, code), self.data, self.offset)
+        self.offset += struct.calcsize('<%d%s' % (count, code))
+        return list(values)
+
+    def name(self):
+        length = self.take('B')
+        name = self.data[self.offset:self.offset + length].decode('ascii', 'replace')
+        self.offset += length
+        return name
+
+
+def parse(datagram):
+    magic, version, flags, count, seq, time_us = struct.unpack_from('<IBBHIQ', datagram)
+
+    if magic != MAGIC or version != VERSION:
+        return None
+
+    sections = {}
+    offset = 20
+
+    for _ in range(count):
+        kind, _, length = struct.unpack_from('<BBH', datagram, offset)
+        offset += 4
+        sections[kind] = Reader(datagram[offset:offset + length])
+        offset += length
+
+    return {'flags': flags, 'seq': seq, 'time_us': time_us, 'sections': sections}
+
+
+def names(reader):
+    return [reader.name() for _ in range(reader.take('H'))]
+
+
+def subscribe(sock, interval_ms, mask):
+    sock.sendto(struct.pack('<IHH', SUBSCRIBE_MAGIC, interval_ms, mask), (args.server, args.port))
+
+
+mask = 0
+for section in args.sections.split(','):
+    mask |= 1 << SECTIONS[section.strip()]
+
+sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+sock.settimeout(args.timeout)
+
+out = open(args.out, 'w', newline='') if args.out else sys.stdout
+writer = csv.writer(out)
+tasks_writer = csv.writer(open(args.tasks_out, 'w', newline='')) if args.tasks_out else None
+if tasks_writer:
+    tasks_writer.writerow(['seq', 'time_us', 'number', 'name', 'state', 'priority', 'base_priority',
+                           'run_time', 'run_time_pct', 'stack_high_water'])
+
+hpm_names = []
+iptrace_names = []
+header = None
+last_hpm = None
+last_total = None
+last_task_time = {}
+last_seq = None
+received = lost = truncated = snapshots = 0
+
+subscribe(sock, args.interval_ms, mask)
+started = renewed = time.monotonic()
+
+try:
+    while True:
+        now = time.monotonic()
+
+        if (args.duration and now - started >= args.duration) or (args.count and snapshots >= args.count):
+            break
+
+        if now - renewed >= RENEW_S:
+            subscribe(sock, args.interval_ms, mask)
+            renewed = now
+
+        try:
+            datagram, _ = sock.recvfrom(2048)
+        except socket.timeout:
+            print("No telemetry from %s:%d for %.1f s" % (args.server, args.port, args.timeout), file=sys.stderr)
+            break
+
+        snapshot = parse(datagram)
+        if snapshot is None:
+            continue
+
+        received += 1
+        if last_seq is not None and snapshot['seq'] > last_seq + 1:
+            lost += snapshot['seq'] - last_seq - 1
+        last_seq = snapshot['seq']
+
+        sections = snapshot['sections']
+
+        if SECTION_HPM_NAMES in sections:
+            hpm_names = names(sections[SECTION_HPM_NAMES])
+        if SECTION_IPTRACE_NAMES in sections:
+            iptrace_names = names(sections[SECTION_IPTRACE_NAMES])
+
+        if not any(kind in sections for kind in SECTIONS.values()):
+            continue
+
+        snapshots += 1
+        if snapshot['flags'] & FLAG_TRUNCATED:
+            truncated += 1
+
+        system = [''] * 5
+        total = None
+        if SECTION_SYSTEM in sections:
+            system = list(sections[SECTION_SYSTEM].take('IIIIQ'))
+            total = system[4]
+
+        hpm = []
+        if SECTION_HPM in sections:
+            hpm = sections[SECTION_HPM].array('Q')
+            if args.hpm_deltas:
+                current = hpm
+                hpm = [c - p for c, p in zip(current, last_hpm)] if last_hpm else [''] * len(current)
+                last_hpm = current
+
+        iptrace = []
+        if SECTION_IPTRACE in sections:
+            iptrace = sections[SECTION_IPTRACE].array('I')
+
+        if header is None:
+            header = ['seq', 'time_us', 'flags', 'tick', 'free_heap', 'min_free_heap', 'tasks', 'total_run_time']
+            header += ['hpm:' + (hpm_names[i] if i < len(hpm_names) else str(i)) for i in range(len(hpm))]
+            header += ['ip:' + (iptrace_names[i] if i < len(iptrace_names) else str(i)) for i in range(len(iptrace))]
+            writer.writerow(header)
+
+        writer.writerow([snapshot['seq'], snapshot['time_us'], snapshot['flags']] + system + hpm + iptrace)
+
+        if tasks_writer and SECTION_TASKS in sections:
+            reader = sections[SECTION_TASKS]
+            for _ in range(reader.take('H')):
+                number, run_time, stack, state, priority, base = reader.take('IQIBBB')
+                name = reader.name()
+                pct = ''
+                if total is not None and last_total is not None and number in last_task_time and total > last_total:
+                    pct = '%.2f' % (100.0 * (run_time - last_task_time[number]) / (total - last_total))
+                last_task_time[number] = run_time
+                tasks_writer.writerow([snapshot['seq'], snapshot['time_us'], number, name,
+                                       TASK_STATES[min(state, len(TASK_STATES) - 1)], priority, base,
+                                       run_time, pct, stack])
+
+        last_total = total
+except KeyboardInterrupt:
+    pass
+finally:
+    subscribe(sock, 0, mask)
+
+print("%d datagrams, %d snapshots (%d truncated), %d lost" % (received, snapshots, truncated, lost), file=sys.stderr)
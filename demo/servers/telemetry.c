@@ -0,0 +1,458 @@
+/*
+ * Binary telemetry over UDP, see telemetry.h for the protocol.
+ *
+ * One task owns the socket: it waits for subscription requests until the next
+ * snapshot is due, then builds the snapshot in a static datagram buffer and
+ * sends it. A snapshot costs one uxTaskGetSystemState() and a few counter
+ * reads, nothing is formatted as text.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* FreeRTOS+TCP includes. */
+#include "FreeRTOS_IP.h"
+#include "FreeRTOS_Sockets.h"
+
+/* Demo includes. */
+#include "DemoIPTrace.h"
+#include "portstatcounters.h"
+#include "clock.h"
+#include "telemetry.h"
+
+/* What fits in one unfragmented datagram: the MTU less the IPv4 and UDP
+ * headers */
+#define telemetryDATAGRAM_SIZE    ( ipconfigNETWORK_MTU - 20 - 8 )
+
+#define telemetryHEADER_SIZE      20
+#define telemetrySECTION_HEADER   4
+
+/* A datagram being built */
+typedef struct TELEMETRY_WRITER
+{
+    uint8_t * pucData;
+    size_t uxLength;
+    size_t uxSections;
+    size_t uxSectionStart; /* Where the open section's header is */
+    uint8_t ucFlags;
+} TelemetryWriter_t;
+
+static uint8_t ucDatagram[ telemetryDATAGRAM_SIZE ];
+static TaskStatus_t xTaskStatus[ configTELEMETRY_MAX_TASKS ];
+static uint32_t ulSequence = 0;
+/*-----------------------------------------------------------*/
+
+/* Append uxBytes of ullValue, little-endian. pdFALSE, and nothing written, if
+ * it does not fit. */
+static BaseType_t prvPut( TelemetryWriter_t * pxWriter,
+                          uint64_t ullValue,
+                          size_t uxBytes )
+{
+    if( pxWriter->uxLength + uxBytes > telemetryDATAGRAM_SIZE )
+    {
+        pxWriter->ucFlags |= telemetryFLAG_TRUNCATED;
+        return pdFALSE;
+    }
+
+    for( size_t x = 0; x < uxBytes; x++ )
+    {
+        pxWriter->pucData[ pxWriter->uxLength++ ] = ( uint8_t ) ullValue;
+        ullValue >>= 8;
+    }
+
+    return pdTRUE;
+}
+/*-----------------------------------------------------------*/
+
+static void prvPatch16( TelemetryWriter_t * pxWriter,
+                        size_t uxOffset,
+                        uint16_t usValue )
+{
+    pxWriter->pucData[ uxOffset ] = ( uint8_t ) usValue;
+    pxWriter->pucData[ uxOffset + 1 ] = ( uint8_t ) ( usValue >> 8 );
+}
+/*-----------------------------------------------------------*/
+
+/* A length-prefixed name, cut to what a uint8 length allows */
+static BaseType_t prvPutName( TelemetryWriter_t * pxWriter,
+                              const char * pcName )
+{
+    size_t uxName = strnlen( pcName, UINT8_MAX );
+
+    if( pxWriter->uxLength + 1 + uxName > telemetryDATAGRAM_SIZE )
+    {
+        pxWriter->ucFlags |= telemetryFLAG_TRUNCATED;
+        return pdFALSE;
+    }
+
+    pxWriter->pucData[ pxWriter->uxLength++ ] = ( uint8_t ) uxName;
+    memcpy( &pxWriter->pucData[ pxWriter->uxLength ], pcName, uxName );
+    pxWriter->uxLength += uxName;
+
+    return pdTRUE;
+}
+/*-----------------------------------------------------------*/
+
+static void prvBegin( TelemetryWriter_t * pxWriter )
+{
+    pxWriter->pucData = ucDatagram;
+    pxWriter->uxLength = telemetryHEADER_SIZE;
+    pxWriter->uxSections = 0;
+    pxWriter->ucFlags = 0;
+}
+/*-----------------------------------------------------------*/
+
+/* Fill in the header, returning the length of the datagram */
+static size_t prvFinish( TelemetryWriter_t * pxWriter )
+{
+    size_t uxLength = pxWriter->uxLength;
+
+    pxWriter->uxLength = 0;
+    ( void ) prvPut( pxWriter, telemetryMAGIC, 4 );
+    ( void ) prvPut( pxWriter, telemetryVERSION, 1 );
+    ( void ) prvPut( pxWriter, pxWriter->ucFlags, 1 );
+    ( void ) prvPut( pxWriter, pxWriter->uxSections, 2 );
+    ( void ) prvPut( pxWriter, ulSequence++, 4 );
+    ( void ) prvPut( pxWriter, ullClockMonotonicNs() / 1000, 8 );
+
+    return uxLength;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvSectionOpen( TelemetryWriter_t * pxWriter,
+                                  uint8_t ucType )
+{
+    pxWriter->uxSectionStart = pxWriter->uxLength;
+
+    if( prvPut( pxWriter, ucType, 1 ) && prvPut( pxWriter, 0, 1 ) && prvPut( pxWriter, 0, 2 ) )
+    {
+        return pdTRUE;
+    }
+
+    pxWriter->uxLength = pxWriter->uxSectionStart;
+
+    return pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+static void prvSectionClose( TelemetryWriter_t * pxWriter )
+{
+    prvPatch16( pxWriter, pxWriter->uxSectionStart + 2,
+                ( uint16_t ) ( pxWriter->uxLength - pxWriter->uxSectionStart - telemetrySECTION_HEADER ) );
+    pxWriter->uxSections++;
+}
+/*-----------------------------------------------------------*/
+
+/* Drop a section that did not fit whole */
+static void prvSectionAbandon( TelemetryWriter_t * pxWriter )
+{
+    pxWriter->uxLength = pxWriter->uxSectionStart;
+    pxWriter->ucFlags |= telemetryFLAG_TRUNCATED;
+}
+/*-----------------------------------------------------------*/
+
+static void prvSystemAndTasks( TelemetryWriter_t * pxWriter,
+                               uint32_t ulMask )
+{
+    uint32_t ulTotalRunTime = 0;
+    UBaseType_t uxTasks;
+    size_t uxCount;
+
+    /* Fails, and reports no task, when there are more than the array holds */
+    uxTasks = uxTaskGetSystemState( xTaskStatus, configTELEMETRY_MAX_TASKS, &ulTotalRunTime );
+
+    if( ( ulMask & telemetryMASK( telemetrySECTION_SYSTEM ) ) && prvSectionOpen( pxWriter, telemetrySECTION_SYSTEM ) )
+    {
+        if( prvPut( pxWriter, xTaskGetTickCount(), 4 ) &&
+            prvPut( pxWriter, xPortGetFreeHeapSize(), 4 ) &&
+            prvPut( pxWriter, xPortGetMinimumEverFreeHeapSize(), 4 ) &&
+            prvPut( pxWriter, uxTaskGetNumberOfTasks(), 4 ) &&
+            prvPut( pxWriter, ulTotalRunTime, 8 ) )
+        {
+            prvSectionClose( pxWriter );
+        }
+        else
+        {
+            prvSectionAbandon( pxWriter );
+        }
+    }
+
+    if( ( ulMask & telemetryMASK( telemetrySECTION_TASKS ) ) && prvSectionOpen( pxWriter, telemetrySECTION_TASKS ) )
+    {
+        size_t uxCountOffset = pxWriter->uxLength;
+
+        if( prvPut( pxWriter, 0, 2 ) == pdFALSE )
+        {
+            prvSectionAbandon( pxWriter );
+            return;
+        }
+
+        if( uxTasks == 0 )
+        {
+            pxWriter->ucFlags |= telemetryFLAG_TRUNCATED;
+        }
+
+        for( uxCount = 0; uxCount < uxTasks; uxCount++ )
+        {
+            const TaskStatus_t * pxStatus = &xTaskStatus[ uxCount ];
+            size_t uxRecord = pxWriter->uxLength;
+
+            if( !( prvPut( pxWriter, pxStatus->xTaskNumber, 4 ) &&
+                   prvPut( pxWriter, pxStatus->ulRunTimeCounter, 8 ) &&
+                   prvPut( pxWriter, pxStatus->usStackHighWaterMark, 4 ) &&
+                   prvPut( pxWriter, pxStatus->eCurrentState, 1 ) &&
+                   prvPut( pxWriter, pxStatus->uxCurrentPriority, 1 ) &&
+                   prvPut( pxWriter, pxStatus->uxBasePriority, 1 ) &&
+                   prvPutName( pxWriter, pxStatus->pcTaskName ) ) )
+            {
+                /* Whole records only */
+                pxWriter->uxLength = uxRecord;
+                break;
+            }
+        }
+
+        prvPatch16( pxWriter, uxCountOffset, ( uint16_t ) uxCount );
+        prvSectionClose( pxWriter );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void prvCounters( TelemetryWriter_t * pxWriter,
+                         uint32_t ulMask )
+{
+    if( ( ulMask & telemetryMASK( telemetrySECTION_HPM ) ) && prvSectionOpen( pxWriter, telemetrySECTION_HPM ) )
+    {
+        cheri_riscv_hpms xHPMs;
+        BaseType_t xFits;
+
+        PortStatCounters_ReadAll( &xHPMs );
+        xFits = prvPut( pxWriter, COUNTERS_NUM, 2 );
+
+        for( int i = 0; ( i < COUNTERS_NUM ) && xFits; i++ )
+        {
+            xFits = prvPut( pxWriter, xHPMs.counters[ i ], 8 );
+        }
+
+        if( xFits )
+        {
+            prvSectionClose( pxWriter );
+        }
+        else
+        {
+            prvSectionAbandon( pxWriter );
+        }
+    }
+
+    #if configINCLUDE_DEMO_DEBUG_STATS != 0
+        if( ( ulMask & telemetryMASK( telemetrySECTION_IPTRACE ) ) && prvSectionOpen( pxWriter, telemetrySECTION_IPTRACE ) )
+        {
+            extern ExampleDebugStatEntry_t xIPTraceValues[];
+            BaseType_t xEntries = xExampleDebugStatEntries();
+            BaseType_t xFits = prvPut( pxWriter, ( uint64_t ) xEntries, 2 );
+
+            for( BaseType_t x = 0; ( x < xEntries ) && xFits; x++ )
+            {
+                xFits = prvPut( pxWriter, xIPTraceValues[ x ].ulData, 4 );
+            }
+
+            if( xFits )
+            {
+                prvSectionClose( pxWriter );
+            }
+            else
+            {
+                prvSectionAbandon( pxWriter );
+            }
+        }
+    #endif /* configINCLUDE_DEMO_DEBUG_STATS */
+}
+/*-----------------------------------------------------------*/
+
+static void prvSendNames( Socket_t xSocket,
+                          const struct freertos_sockaddr * pxSubscriber )
+{
+    TelemetryWriter_t xWriter;
+    size_t uxCountOffset;
+    uint16_t usCount;
+
+    prvBegin( &xWriter );
+
+    if( prvSectionOpen( &xWriter, telemetrySECTION_HPM_NAMES ) )
+    {
+        uxCountOffset = xWriter.uxLength;
+        ( void ) prvPut( &xWriter, 0, 2 );
+
+        for( usCount = 0; ( usCount < COUNTERS_NUM ) && prvPutName( &xWriter, hpm_names[ usCount ] ); usCount++ )
+        {
+        }
+
+        prvPatch16( &xWriter, uxCountOffset, usCount );
+        prvSectionClose( &xWriter );
+    }
+
+    FreeRTOS_sendto( xSocket, ucDatagram, prvFinish( &xWriter ), 0, pxSubscriber, sizeof( *pxSubscriber ) );
+
+    #if configINCLUDE_DEMO_DEBUG_STATS != 0
+        {
+            extern ExampleDebugStatEntry_t xIPTraceValues[];
+            BaseType_t xEntries = xExampleDebugStatEntries();
+
+            prvBegin( &xWriter );
+
+            if( prvSectionOpen( &xWriter, telemetrySECTION_IPTRACE_NAMES ) )
+            {
+                uxCountOffset = xWriter.uxLength;
+                ( void ) prvPut( &xWriter, 0, 2 );
+
+                for( usCount = 0; ( usCount < xEntries ) &&
+                     prvPutName( &xWriter, ( const char * ) xIPTraceValues[ usCount ].pucDescription ); usCount++ )
+                {
+                }
+
+                prvPatch16( &xWriter, uxCountOffset, usCount );
+                prvSectionClose( &xWriter );
+            }
+
+            FreeRTOS_sendto( xSocket, ucDatagram, prvFinish( &xWriter ), 0, pxSubscriber, sizeof( *pxSubscriber ) );
+        }
+    #endif /* configINCLUDE_DEMO_DEBUG_STATS */
+}
+/*-----------------------------------------------------------*/
+
+static uint32_t prvGet( const uint8_t * pucData,
+                        size_t uxBytes )
+{
+    uint32_t ulValue = 0;
+
+    while( uxBytes-- > 0 )
+    {
+        ulValue = ( ulValue << 8 ) | pucData[ uxBytes ];
+    }
+
+    return ulValue;
+}
+/*-----------------------------------------------------------*/
+
+static void prvTelemetryTask( void * pvParameters )
+{
+    Socket_t xSocket;
+    struct freertos_sockaddr xAddress, xSubscriber;
+    uint32_t ulAddressLength = sizeof( xAddress );
+    uint8_t ucRequest[ 8 ];
+    TelemetryWriter_t xWriter;
+    BaseType_t xNew;
+    TickType_t xInterval = 0, xLastSnapshot = 0, xLastRequest = 0, xWait;
+    uint32_t ulMask = 0, ulSnapshots = 0;
+    int32_t lBytes;
+
+    memset( &xSubscriber, 0, sizeof( xSubscriber ) );
+
+    xSocket = FreeRTOS_socket( FREERTOS_AF_INET, FREERTOS_SOCK_DGRAM, FREERTOS_IPPROTO_UDP );
+    configASSERT( xSocket != FREERTOS_INVALID_SOCKET );
+
+    xAddress.sin_addr = 0;
+    xAddress.sin_port = FreeRTOS_htons( ( uint16_t ) ( uintptr_t ) pvParameters );
+    FreeRTOS_bind( xSocket, &xAddress, sizeof( xAddress ) );
+
+    for( ; ; )
+    {
+        if( xInterval == 0 )
+        {
+            xWait = portMAX_DELAY;
+        }
+        else
+        {
+            TickType_t xElapsed = xTaskGetTickCount() - xLastSnapshot;
+
+            xWait = ( xElapsed < xInterval ) ? xInterval - xElapsed : 0;
+        }
+
+        FreeRTOS_setsockopt( xSocket, 0, FREERTOS_SO_RCVTIMEO, &xWait, sizeof( xWait ) );
+        lBytes = FreeRTOS_recvfrom( xSocket, ucRequest, sizeof( ucRequest ), 0, &xAddress, &ulAddressLength );
+
+        if( ( lBytes == ( int32_t ) sizeof( ucRequest ) ) && ( prvGet( ucRequest, 4 ) == telemetrySUBSCRIBE_MAGIC ) )
+        {
+            uint32_t ulIntervalMs = prvGet( &ucRequest[ 4 ], 2 );
+
+            xNew = ( ( xInterval == 0 ) ||
+                     ( xAddress.sin_addr != xSubscriber.sin_addr ) ||
+                     ( xAddress.sin_port != xSubscriber.sin_port ) ) ? pdTRUE : pdFALSE;
+
+            if( ulIntervalMs == 0 )
+            {
+                /* Only the subscriber can cancel */
+                if( xNew == pdFALSE )
+                {
+                    xInterval = 0;
+                }
+
+                continue;
+            }
+
+            if( ulIntervalMs < configTELEMETRY_MIN_INTERVAL_MS )
+            {
+                ulIntervalMs = configTELEMETRY_MIN_INTERVAL_MS;
+            }
+
+            xSubscriber = xAddress;
+            xInterval = pdMS_TO_TICKS( ulIntervalMs ) > 0 ? pdMS_TO_TICKS( ulIntervalMs ) : 1;
+            ulMask = prvGet( &ucRequest[ 6 ], 2 );
+            ulMask = ( ulMask != 0 ) ? ulMask : telemetryMASK_ALL;
+            xLastRequest = xTaskGetTickCount();
+
+            if( xNew )
+            {
+                /* First snapshot right away, after the names */
+                ulSnapshots = 0;
+                xLastSnapshot = xLastRequest - xInterval;
+            }
+        }
+
+        if( xInterval == 0 )
+        {
+            continue;
+        }
+
+        if( ( xTaskGetTickCount() - xLastRequest ) >= pdMS_TO_TICKS( configTELEMETRY_LEASE_MS ) )
+        {
+            xInterval = 0;
+            continue;
+        }
+
+        if( ( xTaskGetTickCount() - xLastSnapshot ) < xInterval )
+        {
+            continue;
+        }
+
+        /* Keep the cadence, unless a whole interval was missed */
+        xLastSnapshot += xInterval;
+
+        if( ( xTaskGetTickCount() - xLastSnapshot ) >= xInterval )
+        {
+            xLastSnapshot = xTaskGetTickCount();
+        }
+
+        if( ( ulSnapshots++ % configTELEMETRY_NAMES_EVERY ) == 0 )
+        {
+            prvSendNames( xSocket, &xSubscriber );
+        }
+
+        prvBegin( &xWriter );
+        prvSystemAndTasks( &xWriter, ulMask );
+        prvCounters( &xWriter, ulMask );
+        FreeRTOS_sendto( xSocket, ucDatagram, prvFinish( &xWriter ), 0, &xSubscriber, sizeof( xSubscriber ) );
+    }
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xTelemetryStart( uint16_t usPort,
+                            uint16_t usStackSize,
+                            UBaseType_t uxPriority )
+{
+    return xTaskCreate( prvTelemetryTask, "Telemetry", usStackSize, ( void * ) ( uintptr_t ) usPort, uxPriority, NULL );
+}
+/*-----------------------------------------------------------*/
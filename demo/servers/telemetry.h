@@ -0,0 +1,90 @@
+/**
+ * Binary telemetry over UDP (demo/servers/telemetry.c).
+ *
+ * The CLI's task-stats, run-time-stats, ip-debug-stats and print_hpms format
+ * text into the console buffer, which costs the target far more than the
+ * numbers are worth when they are polled at a high rate. The telemetry task
+ * instead streams fixed-layout snapshots to a subscriber:
+ * demo/servers/scripts/telemetry.py subscribes and writes them out as CSV.
+ *
+ * Everything on the wire is little-endian. A subscription is a datagram to
+ * the telemetry port:
+ *
+ *   uint32 magic ("TLMS")  uint16 interval ms (0 stops)  uint16 section mask
+ *
+ * The sender's address gets a datagram every interval until the subscription
+ * is renewed by another one, replaced by a subscription from elsewhere, or
+ * configTELEMETRY_LEASE_MS goes by without either. Every datagram is a header
+ *
+ *   uint32 magic ("TLM1")  uint8 version  uint8 flags  uint16 sections
+ *   uint32 sequence  uint64 monotonic time (us)
+ *
+ * then that many sections, each a uint8 type, a uint8 pad, a uint16 body
+ * length and the body. Snapshots carry the sections the mask selects:
+ *
+ *   SYSTEM   uint32 tick count, free heap, minimum ever free heap, tasks;
+ *            uint64 total run time
+ *   TASKS    uint16 count, then per task: uint32 number, uint64 run time,
+ *            uint32 stack high water mark (words), uint8 state, current and
+ *            base priority, name length, then the name
+ *   HPM      uint16 count, uint64 counters (PortStatCounters_ReadAll())
+ *   IPTRACE  uint16 count, uint32 values (DemoIPTrace.c)
+ *
+ * Counters are sent as they are, the host takes the differences. The names
+ * of the HPM and IP trace counters go in datagrams of their own, one section
+ * each (uint16 count, then a uint8 length and the name per entry), after a
+ * subscription and every configTELEMETRY_NAMES_EVERY snapshots.
+ */
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include "FreeRTOS.h"
+
+/* A subscription ends this long after the last request renewing it */
+#ifndef configTELEMETRY_LEASE_MS
+    #define configTELEMETRY_LEASE_MS        30000
+#endif
+
+/* Shortest interval a subscriber can ask for */
+#ifndef configTELEMETRY_MIN_INTERVAL_MS
+    #define configTELEMETRY_MIN_INTERVAL_MS 10
+#endif
+
+/* Snapshots between repeats of the counter names */
+#ifndef configTELEMETRY_NAMES_EVERY
+    #define configTELEMETRY_NAMES_EVERY     64
+#endif
+
+/* Tasks a snapshot has room for. With more, uxTaskGetSystemState() reports
+ * none: the TASKS section is empty and the snapshot flagged truncated. */
+#ifndef configTELEMETRY_MAX_TASKS
+    #define configTELEMETRY_MAX_TASKS       32
+#endif
+
+#define telemetryMAGIC                      0x314D4C54UL /* "TLM1" */
+#define telemetrySUBSCRIBE_MAGIC            0x534D4C54UL /* "TLMS" */
+#define telemetryVERSION                    1
+
+/* Header flags */
+#define telemetryFLAG_TRUNCATED             0x01 /* Something did not fit */
+
+/* Section types, and the mask bits that select them */
+#define telemetrySECTION_SYSTEM             1
+#define telemetrySECTION_TASKS              2
+#define telemetrySECTION_HPM                3
+#define telemetrySECTION_IPTRACE            4
+#define telemetrySECTION_HPM_NAMES          16
+#define telemetrySECTION_IPTRACE_NAMES      17
+
+#define telemetryMASK( xSection )    ( 1U << ( xSection ) )
+#define telemetryMASK_ALL                                                       \
+    ( telemetryMASK( telemetrySECTION_SYSTEM ) | telemetryMASK( telemetrySECTION_TASKS ) | \
+      telemetryMASK( telemetrySECTION_HPM ) | telemetryMASK( telemetrySECTION_IPTRACE ) )
+
+/* Create the task serving subscriptions on usPort */
+BaseType_t xTelemetryStart( uint16_t usPort,
+                            uint16_t usStackSize,
+                            UBaseType_t uxPriority );
+
+#endif /* TELEMETRY_H */
@@ -0,0 +1,96 @@
+/*
+ * Per-phase instrumentation of the dynamic loader, see libdl_phases.h.
+ */
+
+/* Standard includes. */
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "portstatcounters.h"
+
+#include "libdl_phases.h"
+
+typedef struct LIBDL_PHASE_STATS
+{
+    cheri_riscv_hpms xStart;
+    cheri_riscv_hpms xTotal;
+    uint32_t ulCount;
+    BaseType_t xActive;
+} xLibdlPhaseStats_t;
+
+static const char * const pcPhaseNames[ eLibdlPhaseNum ] =
+{
+    "open",
+    "read",
+    "lookup"
+};
+
+static xLibdlPhaseStats_t xPhaseStats[ eLibdlPhaseNum ];
+/*-----------------------------------------------------------*/
+
+void vLibdlPhaseBegin( eLibdlPhase_t xPhase )
+{
+    configASSERT( xPhase < eLibdlPhaseNum );
+
+    if( ( xPhase == eLibdlPhaseRead ) && ( xPhaseStats[ eLibdlPhaseOpen ].xActive == pdFALSE ) )
+    {
+        return;
+    }
+
+    xPhaseStats[ xPhase ].xActive = pdTRUE;
+    PortStatCounters_ReadAll( &xPhaseStats[ xPhase ].xStart );
+}
+/*-----------------------------------------------------------*/
+
+void vLibdlPhaseEnd( eLibdlPhase_t xPhase )
+{
+    cheri_riscv_hpms xEnd;
+    int i;
+
+    configASSERT( xPhase < eLibdlPhaseNum );
+
+    if( xPhaseStats[ xPhase ].xActive == pdFALSE )
+    {
+        return;
+    }
+
+    PortStatCounters_ReadAll( &xEnd );
+    PortStatCounters_DiffAll( &xPhaseStats[ xPhase ].xStart, &xEnd, &xEnd );
+
+    for( i = 0; i < COUNTERS_NUM; i++ )
+    {
+        xPhaseStats[ xPhase ].xTotal.counters[ i ] += xEnd.counters[ i ];
+    }
+
+    xPhaseStats[ xPhase ].ulCount++;
+    xPhaseStats[ xPhase ].xActive = pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+void vLibdlPhasePrint( void )
+{
+    int i, xPhase;
+
+    for( xPhase = 0; xPhase < eLibdlPhaseNum; xPhase++ )
+    {
+        if( xPhaseStats[ xPhase ].ulCount == 0 )
+        {
+            continue;
+        }
+
+        printf( "libdl phase %s (%" PRIu32 " calls)\n", pcPhaseNames[ xPhase ], xPhaseStats[ xPhase ].ulCount );
+
+        for( i = 0; i < COUNTERS_NUM; i++ )
+        {
+            printf( "HPM %s: %" PRIu64 "\n", hpm_names[ i ], xPhaseStats[ xPhase ].xTotal.counters[ i ] );
+        }
+    }
+
+    memset( xPhaseStats, 0, sizeof( xPhaseStats ) );
+}
+/*-----------------------------------------------------------*/
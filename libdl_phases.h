@@ -0,0 +1,38 @@
+/**
+ * Per-phase instrumentation of the dynamic loader (libdl_phases.c).
+ *
+ * prvLoader() in main.c brackets dlopen() and dlsym(), and the newlib file
+ * syscalls in bsp/syscalls.c bracket every read of a compartment archive that
+ * happens while dlopen() runs, whether it comes from FAT or, with
+ * configLIBDL_EMBEDDED_XIP, from .rom. Allocating sections, relocating and
+ * building the captables happen inside FreeRTOS-libdl and are not split up
+ * here; they are what is left of eLibdlPhaseOpen once eLibdlPhaseRead, which
+ * nests inside it, is taken away.
+ */
+#ifndef LIBDL_PHASES_H
+#define LIBDL_PHASES_H
+
+/* Loader phases that are timed separately. */
+typedef enum
+{
+    eLibdlPhaseOpen = 0, /* dlopen() as a whole */
+    eLibdlPhaseRead,     /* Archive file access within dlopen() */
+    eLibdlPhaseLookup,   /* dlsym() */
+    eLibdlPhaseNum
+} eLibdlPhase_t;
+
+/*
+ * Bracket a loader phase. Calls may nest across phases but not within one;
+ * the cycles and HPMs spent are accumulated per phase. eLibdlPhaseRead is only
+ * counted while eLibdlPhaseOpen is open, so file access after loading is not
+ * charged to the loader.
+ */
+void vLibdlPhaseBegin( eLibdlPhase_t xPhase );
+void vLibdlPhaseEnd( eLibdlPhase_t xPhase );
+
+/*
+ * Print and reset the accumulated per-phase counters.
+ */
+void vLibdlPhasePrint( void );
+
+#endif /* LIBDL_PHASES_H */
@@ -0,0 +1,25 @@
+/**
+ * Compartment archives embedded in the image (libs_fat_embedded.c), whose
+ * contents come from the libs_fat_embedded.h that waf generates.
+ */
+#ifndef LIBS_FAT_EMBED_H
+#define LIBS_FAT_EMBED_H
+
+#include <stddef.h>
+
+/*
+ * Make the embedded archives and libdl.conf visible to the loader: all of
+ * them are copied into FAT, or with configLIBDL_EMBEDDED_XIP only libdl.conf
+ * is and the archives are read in place through pvFatEmbedLibMap().
+ */
+void vFatEmbedLibFiles( void );
+
+/*
+ * With configLIBDL_EMBEDDED_XIP, the embedded archive a libdl path names
+ * (any ":member" suffix ignored), read-only, and its size in *pxFileSize.
+ * NULL if the archive is not embedded.
+ */
+const void * pvFatEmbedLibMap( const char * pcFileName,
+                               size_t * pxFileSize );
+
+#endif /* LIBS_FAT_EMBED_H */
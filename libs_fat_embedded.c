@@ -67,11 +67,19 @@
  *  1 tab == 4 spaces!
  */
 
+/* Standard includes. */
+#include <string.h>
+
 /* FreeRTOS+FAT headers. */
 #include "ff_headers.h"
 #include "ff_stdio.h"
 
+#ifdef __CHERI_PURE_CAPABILITY__
+    #include <cheric.h>
+#endif
+
 #include "libs_fat_embedded.h"
+#include "libs_fat_embed.h"
 
 #ifndef configLIBDL_LIB_PATH
     #error configLIB_LIB_PATH must be defined to a string that holds the directory to be used as the root for static libs
@@ -81,15 +89,130 @@
     #error configLIB_CONF_PATH must be defined to a string that containts libdl.conf file
 #endif
 
-static void prvCreateLibs( void );
+#ifndef configLIBDL_EMBEDDED_XIP
+    #define configLIBDL_EMBEDDED_XIP    0
+#endif
+
+#define embedLIB_ENTRIES    ( sizeof( xLibFilesToCopy ) / sizeof( xLibFileToCopy_t ) )
+
+#if configLIBDL_EMBEDDED_XIP
+    static void prvCreateConf( void );
+#else
+    static void prvCreateLibs( void );
+#endif
 /*-----------------------------------------------------------*/
 
 void vFatEmbedLibFiles( void )
 {
-    prvCreateLibs();
+    #if configLIBDL_EMBEDDED_XIP
+        /* The archives stay in .rom, open() in syscalls.c reads them from there
+         * through pvFatEmbedLibMap(), only libdl.conf has to be visible through
+         * the filesystem. */
+        prvCreateConf();
+    #else
+        prvCreateLibs();
+    #endif
 }
 /*-----------------------------------------------------------*/
 
+#if configLIBDL_EMBEDDED_XIP
+
+    const xLibFileToCopy_t * pxFatEmbedLibFind( const char * pcFileName )
+    {
+        size_t x;
+        size_t xNameLen;
+        const char * pcMember;
+
+        if( pcFileName == NULL )
+        {
+            return NULL;
+        }
+
+        /* libdl names archive members as "/lib/libfoo.a:foo.c.1.o", only the
+         * archive part is embedded. */
+        pcMember = strchr( pcFileName, ':' );
+        xNameLen = ( pcMember != NULL ) ? ( size_t ) ( pcMember - pcFileName ) : strlen( pcFileName );
+
+        for( x = 0; x < embedLIB_ENTRIES; x++ )
+        {
+            if( ( strncmp( xLibFilesToCopy[ x ].pcFileName, pcFileName, xNameLen ) == 0 ) &&
+                ( xLibFilesToCopy[ x ].pcFileName[ xNameLen ] == '\0' ) )
+            {
+                return &xLibFilesToCopy[ x ];
+            }
+        }
+
+        return NULL;
+    }
+/*-----------------------------------------------------------*/
+
+    const void * pvFatEmbedLibMap( const char * pcFileName,
+                                   size_t * pxFileSize )
+    {
+        const xLibFileToCopy_t * pxLib = pxFatEmbedLibFind( pcFileName );
+        const void * pvData;
+
+        if( pxLib == NULL )
+        {
+            return NULL;
+        }
+
+        pvData = pxLib->pucFileData;
+
+        #ifdef __CHERI_PURE_CAPABILITY__
+            /* Hand out a read-only capability bounded to this archive so its
+             * readers cannot touch neighbouring archives or write to .rom. */
+            pvData = cheri_csetbounds( pvData, pxLib->xFileSize );
+            pvData = cheri_andperm( pvData, ~( CHERI_PERM_STORE | CHERI_PERM_STORE_CAP | CHERI_PERM_STORE_LOCAL_CAP ) );
+        #endif
+
+        if( pxFileSize != NULL )
+        {
+            *pxFileSize = pxLib->xFileSize;
+        }
+
+        return pvData;
+    }
+/*-----------------------------------------------------------*/
+
+    static void prvCreateConf( void )
+    {
+        FF_FILE * pxFile;
+        const xLibFileToCopy_t * pxConf;
+        size_t x;
+        size_t xOverAllEmbeddedSize = 0;
+
+        pxConf = pxFatEmbedLibFind( configLIBDL_CONF_PATH "libdl.conf" );
+        configASSERT( pxConf != NULL );
+
+        ff_mkdir( configLIBDL_CONF_PATH );
+
+        pxFile = ff_fopen( pxConf->pcFileName, "w+" );
+
+        if( pxFile != NULL )
+        {
+            ff_fwrite( pxConf->pucFileData, pxConf->xFileSize, 1, pxFile );
+            ff_fclose( pxFile );
+        }
+
+        for( x = 0; x < embedLIB_ENTRIES; x++ )
+        {
+            if( &xLibFilesToCopy[ x ] != pxConf )
+            {
+                printf( "Embedded Loader: Reading  %-32s of size %-10zu bytes from .rom @ %p\n",
+                        xLibFilesToCopy[ x ].pcFileName,
+                        xLibFilesToCopy[ x ].xFileSize,
+                        ( void * ) xLibFilesToCopy[ x ].pucFileData );
+                xOverAllEmbeddedSize += xLibFilesToCopy[ x ].xFileSize;
+            }
+        }
+
+        printf( "Embedded Loader: overall compartments size = %zu (not copied)\n", xOverAllEmbeddedSize );
+    }
+/*-----------------------------------------------------------*/
+
+#else /* configLIBDL_EMBEDDED_XIP */
+
 static void prvCreateLibs( void )
 {
     int iReturned;
@@ -108,7 +231,7 @@ static void prvCreateLibs( void )
 
         /* Create each file defined by the xLibFilesToCopy array, which is
          * defined in libs_fat_embedded.h. */
-        for( x = 0; x < sizeof( xLibFilesToCopy ) / sizeof( xLibFileToCopy_t ); x++ )
+        for( x = 0; x < embedLIB_ENTRIES; x++ )
         {
             /* Create the file. */
             pxFile = ff_fopen( xLibFilesToCopy[ x ].pcFileName, "w+" );
@@ -131,3 +254,5 @@ static void prvCreateLibs( void )
     }
 }
 /*-----------------------------------------------------------*/
+
+#endif /* configLIBDL_EMBEDDED_XIP */
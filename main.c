@@ -41,6 +41,14 @@
     #include <dlfcn.h>
     #include <rtl/rtl-trace.h>
     #include <rtl/rtl-archive.h>
+
+    #if configLIBDL_PHASES
+        #include "libdl_phases.h"
+    #endif
+
+    #if configCOMPARTMENT_FAST_RESTART
+        #include "compartment_recovery.h"
+    #endif
 #endif
 
 #if mainCONFIG_INIT_FAT_FILESYSTEM
@@ -57,6 +65,7 @@
 
 /* Bsp includes. */
 #include "bsp.h"
+#include "pc_profiler.h"
 
 #ifdef __CHERI_PURE_CAPABILITY__
     #include <cheri_init_globals.h>
@@ -197,6 +206,12 @@ uint64_t port_get_current_mtime( void )
 
 #if mainCONFIG_USE_DYNAMIC_LOADER
 
+    #include <inttypes.h>
+
+    #ifndef configLIBDL_EMBEDDED_XIP
+        #define configLIBDL_EMBEDDED_XIP    0
+    #endif
+
     #ifndef configPROG_ENTRY
         #error "configPROG_ENTRY must be defined as the entry function for the application \
     "to which the dynamic loader jumps to"
@@ -207,19 +222,25 @@ uint64_t port_get_current_mtime( void )
     #endif
 
     #ifndef configFF_FORMATTED_DISK_IMAGE
-        void vFatEmbedLibFiles( void );
+        #include "libs_fat_embed.h"
     #endif
 
     static void prvLoader( void* unused )
     {
         typedef void (* prog_entry_t)( int argc, char *argv[]);
         prog_entry_t entry = NULL;
+        uint64_t ullStart, ullEmbedCycles, ullLoadCycles;
+        size_t xHeapBefore;
+
+        ullStart = get_cycle_count();
 
         #ifndef configFF_FORMATTED_DISK_IMAGE
         /* Embed the libs in the file systems*/
             vFatEmbedLibFiles();
         #endif
 
+        ullEmbedCycles = get_cycle_count() - ullStart;
+
         #if DEBUG
 
             rtems_rtl_trace_set_mask( RTEMS_RTL_TRACE_UNRESOLVED );
@@ -242,14 +263,32 @@ uint64_t port_get_current_mtime( void )
             printf("main.c: Loading %s\n", configLIBDL_PROG_START_OBJ);
         #endif
 
+        xHeapBefore = xPortGetFreeHeapSize();
+        ullStart = get_cycle_count();
+
+        #if configLIBDL_PHASES
+            vLibdlPhaseBegin( eLibdlPhaseOpen );
+        #endif
+
         void * obj = dlopen( configLIBDL_PROG_START_OBJ, RTLD_GLOBAL | RTLD_NOW );
 
+        #if configLIBDL_PHASES
+            vLibdlPhaseEnd( eLibdlPhaseOpen );
+        #endif
+
+        ullLoadCycles = get_cycle_count() - ullStart;
+
         if( obj == NULL )
         {
             printf( "Failed to dynamically load the app and/or libs\n" );
             exit( -1 );
         }
 
+        #if configCOMPARTMENT_FAST_RESTART
+            /* Pristine globals to restart faulted compartments from */
+            vCompartmentRecoverySnapshotAll();
+        #endif
+
     #define str( s )     # s
     #define xstr( s )    str( s )
 
@@ -257,8 +296,16 @@ uint64_t port_get_current_mtime( void )
             printf( "Searching loaded objects for %s\n", xstr( configPROG_ENTRY ) );
         #endif
 
+        #if configLIBDL_PHASES
+            vLibdlPhaseBegin( eLibdlPhaseLookup );
+        #endif
+
         entry = ( prog_entry_t ) dlsym( obj, xstr( configPROG_ENTRY ) );
 
+        #if configLIBDL_PHASES
+            vLibdlPhaseEnd( eLibdlPhaseLookup );
+        #endif
+
         if( entry == NULL )
         {
             printf( "Failed to to find the specified prog entry: %s\n", xstr( configPROG_ENTRY ) );
@@ -271,6 +318,21 @@ uint64_t port_get_current_mtime( void )
             #endif
         }
 
+        #if DEBUG || configLIBDL_PHASES
+            printf( "Embedded Loader: embed %" PRIu64 " cycles, dlopen %" PRIu64 " cycles, heap used %zu bytes%s\n",
+                    ullEmbedCycles, ullLoadCycles, xHeapBefore - xPortGetFreeHeapSize(),
+                    configLIBDL_EMBEDDED_XIP ? " (xip)" : "" );
+        #else
+            ( void ) ullEmbedCycles;
+            ( void ) ullLoadCycles;
+            ( void ) xHeapBefore;
+        #endif
+
+        #if configLIBDL_PHASES
+            /* Allocation, relocation and captables are the open phase less reads */
+            vLibdlPhasePrint();
+        #endif
+
         #if DEBUG
             printf( "Jumping to the app entry: %s\n", xstr( configPROG_ENTRY ) );
         #endif
@@ -433,6 +495,10 @@ void vApplicationStackOverflowHook( TaskHandle_t pxTask,
 
 void vApplicationTickHook( void )
 {
+    #if ( configPC_PROFILER == 1 )
+        vPcProfilerTickHook();
+    #endif
+
     /* The tests in the full demo expect some interaction with interrupts. */
     #if ( mainDEMO_TYPE == 2 )
         {